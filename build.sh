@@ -6,6 +6,6 @@ cd "build$1"
 conan install -s build_type=$1 --buil=missing ..
 cmake -DCMAKE_BUILD_TYPE=$1 -Dprotobuf_MODULE_COMPATIBLE=1 ..
 make pbviewc
-./bin/pbviewc --cpp_out=test --proto_path=../test samples-pb2.proto
+./bin/pbviewc --cpp_out=test --proto_path=../test --projections=../test/samples-pb2.projections samples-pb2.proto
 make
 cd ..
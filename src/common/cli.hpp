@@ -0,0 +1,38 @@
+#pragma once
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Parsing of the command line options of the tools (pbviewc, pbview-index and pbview-sort)
+
+inline bool startsWith(std::string_view val, std::string_view part)
+{
+   if (val.size() < part.size())
+      return false;
+
+   return val.substr(0, part.size()) == part;
+}
+
+// The value of the first option of params starting with name (e.g. "--out=")
+template <typename Rng>
+std::optional<std::string_view> optionalParameter(Rng&& params, std::string_view name)
+{
+   for (auto&& p : params)
+   {
+      if (startsWith(p, name))
+         return p.substr(name.size());
+   }
+
+   return {};
+}
+
+template <typename Rng>
+std::string_view requiredParameter(Rng&& params, std::string_view name)
+{
+   if (auto p = optionalParameter(params, name))
+      return *p;
+
+   throw std::runtime_error("The option '" + std::string{name} + "' is missing!");
+}
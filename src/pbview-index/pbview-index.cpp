@@ -0,0 +1,65 @@
+#include <pbview/fieldtypes.hpp>
+#include <pbview/recordindex.hpp>
+
+#include <common/cli.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+pbview::IndexField indexField(int fieldNo, std::string_view typeName)
+{
+   return pbview::visitFieldType(typeName, [fieldNo](auto type) { return pbview::IndexField::of<decltype(type)>(fieldNo); });
+}
+
+int main(int argc, char* argsCStr[])
+{
+   try
+   {
+      std::vector<std::string_view> opts, files;
+      for (std::string_view arg : std::vector<std::string_view>{argsCStr + 1, argsCStr + argc})
+         (startsWith(arg, "-") ? opts : files).push_back(arg);
+      if (files.size() != 1)
+         throw std::runtime_error("Exactly one record file is required");
+
+      const std::string recordPath{files.front()};
+      const auto fieldNo = std::stoi(std::string{requiredParameter(opts, "--field=")});
+      const auto field = indexField(fieldNo, requiredParameter(opts, "--type="));
+      const std::string indexPath{optionalParameter(opts, "--out=").value_or(recordPath + ".idx")};
+
+      pbview::ParallelScanOptions scanOptions;
+      if (auto threads = optionalParameter(opts, "--threads="))
+         scanOptions.threadCount = std::stoul(std::string{*threads});
+
+      const auto start = std::chrono::steady_clock::now();
+      pbview::MappedRecordFile<> records{recordPath};
+      std::ofstream os{indexPath, std::ios::binary};
+      if (!os)
+         throw std::runtime_error("Failed to create " + indexPath);
+      const auto count = pbview::buildRecordIndex(records, field, os, scanOptions);
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      std::cout << "Indexed " << count << " records in " << elapsed.count() << " s: " << indexPath << std::endl;
+      return 0;
+   }
+   catch (std::exception& e)
+   {
+      std::cerr << R"(Usage: pbview-index [OPTION] RECORD_FILE
+Writes an index of a file of length delimited messages, for lookups with
+pbview::RecordIndex.
+  --field=NUMBER              Number of the indexed field.
+  --type=TYPE                 Type of the field (double, float, int32, int64,
+                              uint32, uint64, sint32, sint64, fixed32, fixed64,
+                              sfixed32, sfixed64, bool, enum, string, bytes).
+  --out=INDEX_FILE            Path of the index (default: RECORD_FILE.idx).
+  --threads=N                 Number of threads (default: one per hardware
+                              thread).
+)" << std::endl;
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+   }
+}
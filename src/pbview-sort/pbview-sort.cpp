@@ -0,0 +1,98 @@
+#include <pbview/externalsort.hpp>
+#include <pbview/fieldtypes.hpp>
+
+#include <common/cli.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+std::vector<std::string_view> split(std::string_view str, char separator)
+{
+   std::vector<std::string_view> res;
+   for (auto pos = str.find(separator); pos != std::string_view::npos; pos = str.find(separator))
+   {
+      res.push_back(str.substr(0, pos));
+      str.remove_prefix(pos + 1);
+   }
+   res.push_back(str);
+   return res;
+}
+
+// PATH:TYPE[:desc], e.g. 17.1:int32:desc
+void addKey(pbview::SortKeyBuilder& keys, std::string_view spec)
+{
+   const auto parts = split(spec, ':');
+   if (parts.size() < 2 || parts.size() > 3 || (parts.size() == 3 && parts[2] != "desc" && parts[2] != "asc"))
+      throw std::runtime_error("Invalid sort key '" + std::string{spec} + "'");
+
+   std::vector<int> path;
+   for (auto fieldNo : split(parts[0], '.'))
+      path.push_back(std::stoi(std::string{fieldNo}));
+   const auto order = parts.size() == 3 && parts[2] == "desc" ? pbview::SortOrder::Descending : pbview::SortOrder::Ascending;
+   pbview::visitFieldType(parts[1], [&](auto type) { keys.add<decltype(type)>(path, order); });
+}
+
+int main(int argc, char* argsCStr[])
+{
+   try
+   {
+      std::vector<std::string_view> opts, files;
+      for (std::string_view arg : std::vector<std::string_view>{argsCStr + 1, argsCStr + argc})
+         (startsWith(arg, "-") ? opts : files).push_back(arg);
+      if (files.size() != 1)
+         throw std::runtime_error("Exactly one record file is required");
+
+      pbview::SortKeyBuilder keys;
+      for (auto opt : opts)
+      {
+         if (startsWith(opt, "--key="))
+            addKey(keys, opt.substr("--key="sv.size()));
+      }
+      if (keys.size() == 0)
+         throw std::runtime_error("The option '--key=' is missing!");
+
+      const std::string recordPath{files.front()};
+      const std::string outPath{optionalParameter(opts, "--out=").value_or(recordPath + ".sorted")};
+      pbview::ExternalSortOptions sortOptions;
+      if (auto memory = optionalParameter(opts, "--memory="))
+         sortOptions.memoryLimit = std::stoull(std::string{*memory}) << 20;
+      if (auto temp = optionalParameter(opts, "--temp="))
+         sortOptions.tempDirectory = std::string{*temp};
+      if (auto threads = optionalParameter(opts, "--threads="))
+         sortOptions.threadCount = std::stoul(std::string{*threads});
+
+      pbview::MappedRecordFile<> records{recordPath};
+      std::ofstream os{outPath, std::ios::binary};
+      if (!os)
+         throw std::runtime_error("Failed to create " + outPath);
+      const auto stats = pbview::sortRecords(records, keys, os, sortOptions);
+
+      std::cout << "Sorted " << stats.records << " records (" << stats.bytes / 1e6 << " MB, " << stats.runs << " runs) in " << stats.seconds
+                << " s: " << stats.megabytesPerSecond() << " MB/s, " << outPath << std::endl;
+      return 0;
+   }
+   catch (std::exception& e)
+   {
+      std::cerr << R"(Usage: pbview-sort [OPTION] RECORD_FILE
+Sorts a file of length delimited messages by one or more fields, without
+deserializing the messages.
+  --key=PATH:TYPE[:desc]      Field of the sort key, repeated for further keys.
+                              PATH is the field number, or the numbers of
+                              sub-messages and field separated by '.' (17.1).
+                              TYPE is one of double, float, int32, int64,
+                              uint32, uint64, sint32, sint64, fixed32, fixed64,
+                              sfixed32, sfixed64, bool, enum, string, bytes.
+  --out=SORTED_FILE           Path of the output (default: RECORD_FILE.sorted).
+  --memory=MB                 Memory for sorting a run (default: 1024).
+  --temp=DIR                  Directory for the sorted runs (default: /tmp).
+  --threads=N                 Number of threads (default: one per hardware
+                              thread).
+)" << std::endl;
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+   }
+}
@@ -0,0 +1,529 @@
+#pragma once
+
+#include "parallelscan.hpp"
+#include "recordindex.hpp"
+#include "sortkey.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace pbview
+{
+
+enum class AggregateFunction
+{
+   Count,
+   Sum,
+   Min,
+   Max,
+   Avg
+};
+
+namespace impl
+{
+   // Reads a numeric field of a message as double (with views of all parser modes)
+   class NumberReader
+   {
+    public:
+      template <typename T>
+      static NumberReader of()
+      {
+         static_assert(!std::is_same_v<typename T::CppType, std::string_view>, "Only numeric fields can be aggregated");
+         return NumberReader{std::make_tuple(&read<T, ParserMode::Fast_WithoutBoundsChecking>, &read<T, ParserMode::Fast>,
+                                             &read<T, ParserMode::StrictConforming>)};
+      }
+
+      template <ParserMode mode>
+      std::optional<double> operator()(const BinMessageView<mode>& view, int fieldNo) const
+      {
+         return std::get<Read<mode>>(mReaders)(view, fieldNo);
+      }
+
+    private:
+      template <ParserMode mode>
+      using Read = std::optional<double> (*)(const BinMessageView<mode>&, int);
+
+      using Readers = std::tuple<Read<ParserMode::Fast_WithoutBoundsChecking>, Read<ParserMode::Fast>, Read<ParserMode::StrictConforming>>;
+      Readers mReaders;
+
+      explicit NumberReader(Readers readers)
+         : mReaders(readers)
+      {
+      }
+
+      template <typename T, ParserMode mode>
+      static std::optional<double> read(const BinMessageView<mode>& view, int fieldNo)
+      {
+         const auto val = view.template get<T>(fieldNo);
+         if (!val)
+            return std::nullopt;
+         if constexpr (std::is_enum_v<typename T::CppType>)
+            return static_cast<double>(static_cast<std::underlying_type_t<typename T::CppType>>(*val));
+         else
+            return static_cast<double>(*val);
+      }
+   };
+}
+
+// An aggregate of the records of a group:
+//   AggregateField::count()                       // number of records
+//   AggregateField::count(5)                      // number of records with field 5
+//   AggregateField::sum<type::Double>(1)          // also min, max and avg
+// The values are read with BinMessageView::get() (see impl::FieldReader for which value of a
+// repeated field is read) and aggregated as double.
+struct AggregateField
+{
+   AggregateFunction function;
+   // 0: all records (count() only)
+   int fieldNo;
+   // empty for count()
+   std::optional<impl::NumberReader> reader;
+
+   static AggregateField count(int fieldNo = 0)
+   {
+      return AggregateField{AggregateFunction::Count, fieldNo, std::nullopt};
+   }
+
+   template <typename T>
+   static AggregateField sum(int fieldNo)
+   {
+      return AggregateField{AggregateFunction::Sum, fieldNo, impl::NumberReader::of<T>()};
+   }
+
+   template <typename T>
+   static AggregateField min(int fieldNo)
+   {
+      return AggregateField{AggregateFunction::Min, fieldNo, impl::NumberReader::of<T>()};
+   }
+
+   template <typename T>
+   static AggregateField max(int fieldNo)
+   {
+      return AggregateField{AggregateFunction::Max, fieldNo, impl::NumberReader::of<T>()};
+   }
+
+   template <typename T>
+   static AggregateField avg(int fieldNo)
+   {
+      return AggregateField{AggregateFunction::Avg, fieldNo, impl::NumberReader::of<T>()};
+   }
+};
+
+// Value of a group-by field: std::monostate if the records of the group don't have the field,
+// std::int64_t for signed fields (and enums), std::uint64_t for unsigned ones (and bool), double
+// for floating point fields and std::string for strings and bytes
+using GroupValue = std::variant<std::monostate, std::int64_t, std::uint64_t, double, std::string>;
+
+struct AggregateResult
+{
+   struct Group
+   {
+      // values of the group-by fields
+      std::vector<GroupValue> keys;
+      std::uint64_t records = 0;
+      // values of the aggregates, empty if no record of the group has the field (except for counts)
+      std::vector<std::optional<double>> values;
+   };
+
+   // ordered by the values of the group-by fields (groups without a field first)
+   std::vector<Group> groups;
+};
+
+namespace impl
+{
+   // Groups and aggregates of one worker thread. The records are collected in batches of columns
+   // (the group of each record and the value of each aggregate), which are aggregated with tight
+   // loops over the columns. All fields of a record are extracted in one pass over it.
+   class AggregateState
+   {
+    public:
+      static constexpr std::size_t batchSize = 1024;
+
+      AggregateState(const std::vector<IndexField>* groupBy, const std::vector<AggregateField>* aggregates)
+         : mGroupBy(groupBy), mAggregates(aggregates), mBatchValues(aggregates->size()), mBatchValid(aggregates->size()),
+           mValues(aggregates->size()), mCounts(aggregates->size())
+      {
+         for (const auto& field : *mGroupBy)
+            mFieldNos.push_back(field.fieldNo);
+         for (const auto& aggregate : *mAggregates)
+         {
+            if (aggregate.fieldNo > 0)
+               mFieldNos.push_back(aggregate.fieldNo);
+         }
+         std::sort(mFieldNos.begin(), mFieldNos.end());
+         mFieldNos.erase(std::unique(mFieldNos.begin(), mFieldNos.end()), mFieldNos.end());
+         mSpans.resize(mFieldNos.size());
+
+         for (const auto& field : *mGroupBy)
+            mGroupBySlots.push_back(slotOf(field.fieldNo));
+         for (const auto& aggregate : *mAggregates)
+            mAggregateSlots.push_back(aggregate.fieldNo > 0 ? slotOf(aggregate.fieldNo) : noSlot);
+      }
+
+      template <ParserMode mode>
+      void add(const BinMessageView<mode>& record)
+      {
+         if (mBatchGroups.capacity() < batchSize)
+         {
+            mBatchGroups.reserve(batchSize);
+            for (std::size_t a = 0; a < mAggregates->size(); a++)
+            {
+               mBatchValues[a].reserve(batchSize);
+               mBatchValid[a].reserve(batchSize);
+            }
+         }
+
+         extractFields(record);
+         mBatchGroups.push_back(groupOf<mode>());
+         for (std::size_t a = 0; a < mAggregates->size(); a++)
+         {
+            const auto& aggregate = (*mAggregates)[a];
+            const auto slot = mAggregateSlots[a];
+            std::optional<double> val;
+            if (slot == noSlot)
+               val = 0;
+            else if (const auto& span = mSpans[slot])
+               val = aggregate.reader ? (*aggregate.reader)(BinMessageView<mode>{*span}, aggregate.fieldNo) : 0;
+            // missing values are neutral, so that they can be aggregated without branches
+            mBatchValues[a].push_back(val ? *val : neutral(aggregate.function));
+            mBatchValid[a].push_back(val.has_value());
+         }
+
+         if (mBatchGroups.size() == batchSize)
+            flush();
+      }
+
+      // aggregates the current batch
+      void flush()
+      {
+         const auto n = mBatchGroups.size();
+         const auto* groups = mBatchGroups.data();
+         for (std::size_t i = 0; i < n; i++)
+            mRecords[groups[i]]++;
+
+         for (std::size_t a = 0; a < mAggregates->size(); a++)
+         {
+            const auto* vals = mBatchValues[a].data();
+            const auto* valid = mBatchValid[a].data();
+            auto* acc = mValues[a].data();
+            auto* counts = mCounts[a].data();
+            for (std::size_t i = 0; i < n; i++)
+               counts[groups[i]] += valid[i];
+
+            switch ((*mAggregates)[a].function)
+            {
+            case AggregateFunction::Count:
+               break;
+            case AggregateFunction::Sum:
+            case AggregateFunction::Avg:
+               if (mKeys.size() == 1)
+                  acc[0] += sum(vals, n);
+               else
+                  for (std::size_t i = 0; i < n; i++)
+                     acc[groups[i]] += vals[i];
+               break;
+            case AggregateFunction::Min:
+               for (std::size_t i = 0; i < n; i++)
+                  acc[groups[i]] = std::min(acc[groups[i]], vals[i]);
+               break;
+            case AggregateFunction::Max:
+               for (std::size_t i = 0; i < n; i++)
+                  acc[groups[i]] = std::max(acc[groups[i]], vals[i]);
+               break;
+            }
+            mBatchValues[a].clear();
+            mBatchValid[a].clear();
+         }
+         mBatchGroups.clear();
+      }
+
+      // adds the (flushed) groups and aggregates of other
+      void merge(const AggregateState& other)
+      {
+         for (std::size_t g = 0; g < other.mKeys.size(); g++)
+         {
+            const auto group = groupOfKey(other.mKeys[g]);
+            mRecords[group] += other.mRecords[g];
+            for (std::size_t a = 0; a < mAggregates->size(); a++)
+            {
+               mCounts[a][group] += other.mCounts[a][g];
+               auto& acc = mValues[a][group];
+               const auto val = other.mValues[a][g];
+               switch ((*mAggregates)[a].function)
+               {
+               case AggregateFunction::Count:
+                  break;
+               case AggregateFunction::Sum:
+               case AggregateFunction::Avg:
+                  acc += val;
+                  break;
+               case AggregateFunction::Min:
+                  acc = std::min(acc, val);
+                  break;
+               case AggregateFunction::Max:
+                  acc = std::max(acc, val);
+                  break;
+               }
+            }
+         }
+      }
+
+      AggregateResult result() const
+      {
+         std::vector<std::uint32_t> order(mKeys.size());
+         for (std::uint32_t g = 0; g < order.size(); g++)
+            order[g] = g;
+         std::sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b) { return mKeys[a] < mKeys[b]; });
+
+         AggregateResult res;
+         for (auto g : order)
+         {
+            auto& group = res.groups.emplace_back();
+            group.keys = decodeKey(mKeys[g]);
+            group.records = mRecords[g];
+            for (std::size_t a = 0; a < mAggregates->size(); a++)
+            {
+               const auto function = (*mAggregates)[a].function;
+               const auto count = mCounts[a][g];
+               if (function == AggregateFunction::Count)
+                  group.values.push_back(static_cast<double>(count));
+               else if (count == 0)
+                  group.values.emplace_back();
+               else if (function == AggregateFunction::Avg)
+                  group.values.push_back(mValues[a][g] / static_cast<double>(count));
+               else
+                  group.values.push_back(mValues[a][g]);
+            }
+         }
+         return res;
+      }
+
+    private:
+      static constexpr auto noSlot = std::numeric_limits<std::size_t>::max();
+
+      const std::vector<IndexField>* mGroupBy;
+      const std::vector<AggregateField>* mAggregates;
+
+      // the distinct numbers of the fields to extract (sorted), and the slot of the field of each group-by field and aggregate
+      std::vector<int> mFieldNos;
+      std::vector<std::size_t> mGroupBySlots;
+      std::vector<std::size_t> mAggregateSlots;
+      // the occurrence of each field in the current record, that get() would read (tag and value)
+      std::vector<std::optional<DataSpan>> mSpans;
+
+      // the current batch, by column
+      std::vector<std::uint32_t> mBatchGroups;
+      std::vector<std::vector<double>> mBatchValues;
+      std::vector<std::vector<std::uint8_t>> mBatchValid;
+
+      // the groups by their encoded keys
+      std::unordered_map<std::string, std::uint32_t> mGroups;
+      std::vector<std::string> mKeys;
+      std::vector<std::uint64_t> mRecords;
+      // per aggregate and group
+      std::vector<std::vector<double>> mValues;
+      std::vector<std::vector<std::uint64_t>> mCounts;
+      std::string mKey;
+
+      static double neutral(AggregateFunction function)
+      {
+         if (function == AggregateFunction::Min)
+            return std::numeric_limits<double>::infinity();
+         if (function == AggregateFunction::Max)
+            return -std::numeric_limits<double>::infinity();
+         return 0;
+      }
+
+      // with independent partial sums, that the compiler can keep in vector registers
+      static double sum(const double* vals, std::size_t n)
+      {
+         double partial[4] = {0, 0, 0, 0};
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+            for (std::size_t j = 0; j < 4; j++)
+               partial[j] += vals[i + j];
+         for (; i < n; i++)
+            partial[0] += vals[i];
+         return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+      }
+
+      std::size_t slotOf(int fieldNo) const
+      {
+         return static_cast<std::size_t>(std::lower_bound(mFieldNos.begin(), mFieldNos.end(), fieldNo) - mFieldNos.begin());
+      }
+
+      // Finds the fields of all slots in one pass over the record. Like get(), the fast modes take
+      // the first occurrence of a field and stop after the largest field number (fields below the
+      // next one of a slot are skipped in blocks), StrictConforming takes the last occurrence.
+      template <ParserMode mode>
+      void extractFields(const BinMessageView<mode>& record)
+      {
+         using View = BinMessageView<mode>;
+         constexpr std::uint32_t WireTypeBitMask = 0b111;
+         std::fill(mSpans.begin(), mSpans.end(), std::nullopt);
+         if (mFieldNos.empty())
+            return;
+
+         auto bin = record.bytes;
+         std::size_t next = 0;
+         while (mode == ParserMode::StrictConforming || next < mFieldNos.size())
+         {
+            if constexpr (mode != ParserMode::StrictConforming)
+               bin.remove_prefix(skipFieldsBelow(bin.data(), bin.size(), mFieldNos[next]));
+
+            const auto fieldBegin = bin.data();
+            const auto tag = View::popTag(bin);
+            if (!tag)
+               break;
+            const int fieldNo = tag >> 3;
+            View::skipValue(bin, WireType{tag & WireTypeBitMask});
+            const DataSpan span{fieldBegin, static_cast<std::size_t>(bin.data() - fieldBegin)};
+
+            if constexpr (mode == ParserMode::StrictConforming)
+            {
+               const auto slot = slotOf(fieldNo);
+               if (slot < mFieldNos.size() && mFieldNos[slot] == fieldNo)
+                  mSpans[slot] = span;
+            }
+            else
+            {
+               // get() doesn't find fields below the current one anymore
+               while (next < mFieldNos.size() && mFieldNos[next] < fieldNo)
+                  next++;
+               if (next < mFieldNos.size() && mFieldNos[next] == fieldNo)
+                  mSpans[next++] = span;
+            }
+         }
+      }
+
+      // Key of the group of the current record, ordered like the values of the group-by fields: per
+      // field a presence byte followed by the order preserving key of numbers (big endian) or the
+      // escaped bytes of strings (see appendSortKey())
+      template <ParserMode mode>
+      std::uint32_t groupOf()
+      {
+         mKey.clear();
+         for (std::size_t g = 0; g < mGroupBy->size(); g++)
+         {
+            const auto& field = (*mGroupBy)[g];
+            const auto& span = mSpans[mGroupBySlots[g]];
+            const auto val = span ? field.reader(BinMessageView<mode>{*span}, field.fieldNo) : std::nullopt;
+            mKey.push_back(val ? '\x01' : '\0');
+            if (!val)
+               continue;
+            if (field.kind == StatisticsKind::Bytes)
+               appendSortKey<type::Bytes>(mKey, val->bytes);
+            else
+               appendBigEndian(mKey, val->key);
+         }
+         return groupOfKey(mKey);
+      }
+
+      std::uint32_t groupOfKey(const std::string& key)
+      {
+         if (const auto it = mGroups.find(key); it != mGroups.end())
+            return it->second;
+
+         enforce(mKeys.size() < std::numeric_limits<std::uint32_t>::max(), "Too many groups");
+         const auto group = static_cast<std::uint32_t>(mKeys.size());
+         mGroups.emplace(key, group);
+         mKeys.push_back(key);
+         mRecords.push_back(0);
+         for (std::size_t a = 0; a < mAggregates->size(); a++)
+         {
+            mValues[a].push_back(neutral((*mAggregates)[a].function));
+            mCounts[a].push_back(0);
+         }
+         return group;
+      }
+
+      std::vector<GroupValue> decodeKey(std::string_view key) const
+      {
+         std::vector<GroupValue> res;
+         for (const auto& field : *mGroupBy)
+         {
+            const bool present = key.front() == '\x01';
+            key.remove_prefix(1);
+            if (!present)
+            {
+               res.emplace_back();
+               continue;
+            }
+            if (field.kind == StatisticsKind::Bytes)
+            {
+               std::string str;
+               std::size_t i = 0;
+               for (; key[i] != '\0' || key[i + 1] != '\0'; i++)
+               {
+                  str.push_back(key[i]);
+                  // an escaped 0x00
+                  if (key[i] == '\0')
+                     i++;
+               }
+               key.remove_prefix(i + 2);
+               res.emplace_back(std::move(str));
+               continue;
+            }
+
+            std::uint64_t val = 0;
+            for (int i = 0; i < 8; i++)
+               val = (val << 8) | static_cast<std::uint8_t>(key[i]);
+            key.remove_prefix(8);
+            constexpr auto signBit = std::uint64_t{1} << 63;
+            if (field.kind == StatisticsKind::Signed)
+               res.emplace_back(static_cast<std::int64_t>(val ^ signBit));
+            else if (field.kind == StatisticsKind::Unsigned)
+               res.emplace_back(val);
+            else
+            {
+               const auto bits = (val & signBit) ? val ^ signBit : ~val;
+               double d;
+               memcpy(&d, &bits, sizeof(d));
+               res.emplace_back(d);
+            }
+         }
+         return res;
+      }
+   };
+}
+
+// Aggregates the records of file (a MappedRecordFile or a BlockRecordReader) grouped by the
+// values of the groupBy fields (all records form one group without group-by fields):
+//   auto res = aggregate(file, {IndexField::of<type::String>(14)}, {AggregateField::count(), AggregateField::sum<type::Double>(1)});
+//   for (const auto& group : res.groups)
+//      std::cout << std::get<std::string>(group.keys[0]) << ": " << *group.values[1] << std::endl;
+//
+// The records are scanned in parallel (parallelForEachRecord()) without being deserialized. Each
+// worker thread extracts the group and the values of its records (in one pass over each record)
+// into columns of a batch and aggregates the batch into its own hash table of groups, the tables
+// are combined at the end.
+// Records with a NaN in a group-by field are grouped as if they didn't have the field.
+template <typename File>
+AggregateResult aggregate(const File& file, const std::vector<IndexField>& groupBy, const std::vector<AggregateField>& aggregates,
+                          ParallelScanOptions options = {})
+{
+   using BinView = typename File::BinView;
+   for (const auto& field : groupBy)
+      impl::enforce(field.fieldNo > 0, "Invalid field number for group-by");
+   for (const auto& field : aggregates)
+      impl::enforce(field.fieldNo > 0 || (field.fieldNo == 0 && !field.reader), "Invalid field number for aggregate");
+
+   const impl::AggregateState init{&groupBy, &aggregates};
+   auto states = parallelForEachRecord(file, init, [](impl::AggregateState& state, BinView record) { state.add(record); }, options);
+
+   auto& res = states.front();
+   res.flush();
+   for (std::size_t i = 1; i < states.size(); i++)
+   {
+      states[i].flush();
+      res.merge(states[i]);
+   }
+   return res.result();
+}
+
+} // namespace pbview
@@ -2,7 +2,15 @@
 
 #include <string_view>
 #include <optional>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
 #include "variant.hpp"
+#include "varintkernels.hpp"
 
 #include <google/protobuf/message.h>
 #include <google/protobuf/wire_format_lite.h>
@@ -19,6 +27,14 @@
 #define PBVIEW_FORCE_INLINE inline
 #endif
 
+#ifdef __GNUC__
+#define PBVIEW_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define PBVIEW_NOINLINE __declspec(noinline)
+#else
+#define PBVIEW_NOINLINE
+#endif
+
 namespace pbview
 {
 
@@ -71,6 +87,8 @@ struct BinMessageView;
 
 namespace impl
 {
+class AggregateState;
+
 template <typename Exception = std::runtime_error, typename T, typename... ExceptionArgs>
 decltype(auto) enforce(T &&t, ExceptionArgs &&... exceptionArgs)
 {
@@ -219,6 +237,14 @@ struct MessageWithIrregularEncoding
 };
 } // namespace type
 
+// A field of a message, as requested by getMany()
+template <typename T, int fieldNo>
+struct Field
+{
+   using Type = T;
+   static constexpr int number = fieldNo;
+};
+
 template <ParserMode mode>
 struct BinMessageView
 {
@@ -230,10 +256,17 @@ struct BinMessageView
 
    static BinMessageView fromBytesString(std::string_view sv)
    {
-      return pbview::BinMessageView{pbview::DataSpan{reinterpret_cast<const std::byte *>(sv.data()), sv.size()}};
+      return BinMessageView{pbview::DataSpan{reinterpret_cast<const std::byte *>(sv.data()), sv.size()}};
    }
 
  private:
+   template <ParserMode> friend struct IndexedBinMessageView;
+   template <ParserMode> friend struct CachingBinMessageView;
+   template <ParserMode> friend struct SegmentedBinMessageView;
+   friend class CacheLineIndex;
+   friend class PredicatePlan;
+   friend class impl::AggregateState;
+
    static PBVIEW_FORCE_INLINE char pop(DataSpan &bin)
    {
       char c = static_cast<char>(bin[0]);
@@ -341,6 +374,20 @@ struct BinMessageView
       return popVarint<std::uint32_t>(bin);
    }
 
+   // Canonical encoding of a tag, returns the number of used bytes
+   static std::size_t encodeTag(std::uint8_t (&out)[5], int fieldNo, WireType type)
+   {
+      auto tag = (static_cast<std::uint32_t>(fieldNo) << 3) | static_cast<std::uint32_t>(type);
+      std::size_t len = 0;
+      while (tag >= 0x80)
+      {
+         out[len++] = static_cast<std::uint8_t>(tag | 0x80);
+         tag >>= 7;
+      }
+      out[len++] = static_cast<std::uint8_t>(tag);
+      return len;
+   }
+
    template<typename T>
    static inline T popFixed(DataSpan& bin)
    {
@@ -410,6 +457,10 @@ struct BinMessageView
 
    inline static std::optional<WireType> seekToNextField(DataSpan& bin, int fieldNo)
    {
+      // skips the fields with lower numbers in blocks, the loop below handles the rest
+      if constexpr (mode != ParserMode::StrictConforming)
+         bin.remove_prefix(impl::skipFieldsBelow(bin.data(), bin.size(), fieldNo));
+
       while (auto tag = popTag(bin))
       {
          const int currentFieldNumber = tag >> 3;
@@ -522,6 +573,58 @@ struct BinMessageView
       return {};
    }
 
+   // Pops the value of all requested fields with the given number (a field may be requested multiple times)
+   template <typename Tuple, typename... Fields, std::size_t... I>
+   static bool popMatchingValues(Tuple& res, DataSpan& bin, int fieldNo, WireType type, std::index_sequence<I...>)
+   {
+      bool found = false;
+      auto valueEnd = bin;
+
+      auto pop = [&](auto& slot, auto field) {
+         using F = decltype(field);
+         if (F::number != fieldNo)
+            return;
+
+         // the first occurrence of a field is used in the fast modes (like in get()), the last one in StrictConforming
+         if constexpr (mode != ParserMode::StrictConforming)
+         {
+            if (slot)
+               return;
+         }
+
+         if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+            impl::enforce(type == wireTypeOf<typename F::Type>(), "Invalid wire type!");
+
+         auto pos = bin;
+         slot = popNextValue<typename F::Type>(pos);
+         valueEnd = pos;
+         found = true;
+      };
+      (pop(std::get<I>(res), Fields{}), ...);
+
+      if (found)
+         bin = valueEnd;
+      return found;
+   }
+
+   // Appends all elements of rng to out with a single allocation
+   template <typename Rng, typename CppType, typename Alloc>
+   static void appendTo(const Rng& rng, std::vector<CppType, Alloc>& out)
+   {
+      const auto offset = out.size();
+      const auto count = rng.size();
+      if constexpr (std::is_default_constructible_v<CppType> && !std::is_same_v<CppType, bool>)
+      {
+         out.resize(offset + count);
+         out.resize(offset + rng.decodeInto(out.data() + offset, count));
+      }
+      else
+      {
+         out.reserve(offset + count);
+         rng.copyTo(std::back_inserter(out));
+      }
+   }
+
    template <typename T>
    struct Repeated
        : ranges::view_facade<Repeated<T>, ranges::finite>
@@ -583,6 +686,72 @@ struct BinMessageView
           : mBytes(bytes), mFieldNo(fieldNo)
       {
       }
+
+      // Number of elements (scans the message, but does not decode the values)
+      std::size_t size() const
+      {
+         auto bin = mBytes;
+         std::size_t n = 0;
+         while (auto wireType = seekToNextField(bin, mFieldNo))
+         {
+            skipValue(bin, *wireType);
+            n++;
+         }
+         return n;
+      }
+
+      // Decodes up to capacity elements into out and returns the number of decoded elements.
+      // Consecutive elements of fixed width types are copied with a known stride.
+      std::size_t decodeInto(typename T::CppType* out, std::size_t capacity) const
+      {
+         using CppType = typename T::CppType;
+         auto bin = mBytes;
+
+         std::uint8_t tag[5];
+         const auto tagSize = encodeTag(tag, mFieldNo, wireTypeOf<T>());
+         constexpr auto valueSize = sizeof(CppType);
+
+         std::size_t n = 0;
+         while (n < capacity)
+         {
+            auto val = popNextField<T>(bin, mFieldNo);
+            if (!val)
+               break;
+            out[n++] = *val;
+
+            if constexpr (T::serialization == Serialization::Fixed)
+            {
+               while (n < capacity && bin.size() >= tagSize + valueSize && memcmp(bin.data(), tag, tagSize) == 0)
+               {
+                  memcpy(out + n++, bin.data() + tagSize, valueSize);
+                  bin.remove_prefix(tagSize + valueSize);
+               }
+            }
+         }
+
+         return n;
+      }
+
+      template <typename OutputIt>
+      OutputIt copyTo(OutputIt out) const
+      {
+         auto bin = mBytes;
+         while (auto val = popNextField<T>(bin, mFieldNo))
+            *out++ = *val;
+         return out;
+      }
+
+      std::size_t copyTo(typename T::CppType* out, std::size_t capacity) const
+      {
+         return decodeInto(out, capacity);
+      }
+
+      // Appends the elements (also usable with std::pmr::vector)
+      template <typename Alloc>
+      void copyTo(std::vector<typename T::CppType, Alloc>& out) const
+      {
+         appendTo(*this, out);
+      }
    };
 
    template <typename T>
@@ -654,6 +823,90 @@ struct BinMessageView
             mBytes = bytes.substr(0, len);
          }
       }
+
+      // Number of elements (counted without decoding them)
+      std::size_t size() const
+      {
+         if constexpr (wireTypeOf<T>() == WireType::Varint)
+            return std::count_if(mBytes.begin(), mBytes.end(), [](std::byte b) { return lastByteOfVarint(b); });
+         else
+            return mBytes.size() / sizeof(typename T::CppType);
+      }
+
+      // Decodes up to capacity elements into out and returns the number of decoded elements.
+      // Varints are decoded in bulk by SIMD kernels, if supported by the CPU.
+      std::size_t decodeInto(typename T::CppType* out, std::size_t capacity) const
+      {
+         return decodeInto(out, capacity, impl::detectSimdLevel());
+      }
+
+      std::size_t decodeInto(typename T::CppType* out, std::size_t capacity, impl::SimdLevel level) const
+      {
+         using CppType = typename T::CppType;
+         auto bin = mBytes;
+
+         if constexpr (wireTypeOf<T>() != WireType::Varint)
+         {
+            if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+               impl::enforce(bin.size() % sizeof(CppType) == 0, "Input is too short to contain the expected fixed length value");
+            const auto n = std::min(capacity, bin.size() / sizeof(CppType));
+            memcpy(out, bin.data(), n * sizeof(CppType));
+            return n;
+         }
+         else
+         {
+            // bools are rare in large arrays and not worth own kernels
+            constexpr bool bulkDecodable = sizeof(CppType) == sizeof(std::uint32_t) || sizeof(CppType) == sizeof(std::uint64_t);
+            using Int = std::conditional_t<sizeof(CppType) == sizeof(std::uint64_t), std::uint64_t, std::uint32_t>;
+
+            std::size_t n = 0;
+            // values to be decoded by the scalar code before the next try of the kernels
+            int scalarSteps = 0;
+            while (!bin.empty() && n < capacity)
+            {
+               if constexpr (bulkDecodable)
+               {
+                  if (scalarSteps == 0 && level != impl::SimdLevel::Scalar)
+                  {
+                     constexpr bool zigZag = T::serialization == Serialization::VarintZigZag;
+                     auto res = impl::decodeVarints<Int, zigZag>(bin.data(), bin.size(), reinterpret_cast<std::byte*>(out + n), capacity - n, level);
+                     bin.remove_prefix(res.bytesConsumed);
+                     n += res.valuesWritten;
+                     // the kernels stopped at a value (or the end of the input), that has to be decoded by the scalar code
+                     scalarSteps = res.valuesWritten == 0 ? 16 : 1;
+                     continue;
+                  }
+               }
+
+               out[n++] = popNextValue<T>(bin);
+               if (scalarSteps)
+                  scalarSteps--;
+            }
+
+            return n;
+         }
+      }
+
+      template <typename OutputIt>
+      OutputIt copyTo(OutputIt out) const
+      {
+         auto bin = mBytes;
+         while (!bin.empty())
+            *out++ = popNextValue<T>(bin);
+         return out;
+      }
+
+      std::size_t copyTo(typename T::CppType* out, std::size_t capacity) const
+      {
+         return decodeInto(out, capacity);
+      }
+
+      // Appends the elements (also usable with std::pmr::vector)
+      template <typename Alloc>
+      void copyTo(std::vector<typename T::CppType, Alloc>& out) const
+      {
+         appendTo(*this, out);
+      }
    };
 
  public:
@@ -670,6 +923,21 @@ struct BinMessageView
       return popField<T>(bin, fieldNo);
    }
 
+   // The encoded value of a field as it is stored in the message (without tag, and without the
+   // length for length delimited fields), e.g. for hashing keys without decoding them
+   std::optional<DataSpan> getRaw(int fieldNo) const
+   {
+      auto bin = bytes;
+      const auto type = seekToField(bin, fieldNo);
+      if (!type)
+         return std::nullopt;
+      if (*type == WireType::LengthDelimited)
+         return popLengthDelimited(bin);
+      const auto begin = bin;
+      skipValue(bin, *type);
+      return begin.substr(0, bin.data() - begin.data());
+   }
+
    template <typename T>
    auto getRepeated(int fieldNo) const
    {
@@ -677,6 +945,122 @@ struct BinMessageView
       return Repeated<T>(bin, fieldNo);
    }
 
+   // A field passed to the visitor of visitFields(), its value can be read once (otherwise it is skipped)
+   class FieldValue
+   {
+    public:
+      FieldValue(DataSpan& bin, WireType type) : mBin(bin), mType(type)
+      {
+      }
+
+      WireType wireType() const
+      {
+         return mType;
+      }
+
+      template <typename T>
+      auto value() -> typename T::CppType
+      {
+         if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+         {
+            impl::enforce(!mRead, "Field value was already read");
+            impl::enforce(mType == wireTypeOf<T>(), "Invalid wire type!");
+         }
+         mRead = true;
+         return popNextValue<T>(mBin);
+      }
+
+      BinMessageView message()
+      {
+         return BinMessageView{value<Bytes>()};
+      }
+
+    private:
+      friend struct BinMessageView;
+
+      struct Bytes
+      {
+         using CppType = DataSpan;
+         static constexpr auto serialization = Serialization::LengthDelimited;
+      };
+
+      DataSpan& mBin;
+      WireType mType;
+      bool mRead = false;
+   };
+
+   // Calls visitor(fieldNo, FieldValue&) for all fields in one pass.
+   // The fast modes stop at the first field number above maxFieldNo.
+   template <typename Visitor>
+   void visitFields(Visitor&& visitor, int maxFieldNo = std::numeric_limits<int>::max()) const
+   {
+      auto bin = bytes;
+      while (auto tag = popTag(bin))
+      {
+         const int currentFieldNumber = tag >> 3;
+         constexpr uint32_t WireTypeBitMask = 0b111;
+         const WireType type{tag & WireTypeBitMask};
+
+         if constexpr (mode != ParserMode::StrictConforming)
+         {
+            if (currentFieldNumber > maxFieldNo)
+               return;
+         }
+
+         FieldValue field{bin, type};
+         visitor(currentFieldNumber, field);
+         if (!field.mRead)
+            skipValue(bin, type);
+      }
+   }
+
+   // Reads all requested fields in one pass, e.g.:
+   //    auto [id, name] = view.getMany<Field<type::Int32, 2>, Field<type::String, 7>>();
+   // The fast modes stop after the largest requested field number, StrictConforming at the end of the message.
+   template <typename... Fields>
+   auto getMany() const -> std::tuple<std::optional<typename Fields::Type::CppType>...>
+   {
+      static_assert(sizeof...(Fields) > 0, "No fields requested");
+
+      std::tuple<std::optional<typename Fields::Type::CppType>...> res;
+      constexpr int maxFieldNo = std::max({Fields::number...});
+
+      // the smallest requested field number above fieldNo (fields with lower numbers are skipped in blocks)
+      auto nextFieldNoAfter = [](int fieldNo) {
+         int next = maxFieldNo + 1;
+         ((Fields::number > fieldNo && Fields::number < next ? next = Fields::number : 0), ...);
+         return next;
+      };
+
+      auto bin = bytes;
+      int nextFieldNo = std::min({Fields::number...});
+      while (true)
+      {
+         if constexpr (mode != ParserMode::StrictConforming)
+            bin.remove_prefix(impl::skipFieldsBelow(bin.data(), bin.size(), nextFieldNo));
+
+         const auto tag = popTag(bin);
+         if (!tag)
+            break;
+
+         const int currentFieldNumber = tag >> 3;
+         constexpr uint32_t WireTypeBitMask = 0b111;
+         const WireType type{tag & WireTypeBitMask};
+
+         if constexpr (mode != ParserMode::StrictConforming)
+         {
+            if (currentFieldNumber > maxFieldNo)
+               break;
+            nextFieldNo = nextFieldNoAfter(currentFieldNumber);
+         }
+
+         if (!popMatchingValues<decltype(res), Fields...>(res, bin, currentFieldNumber, type, std::index_sequence_for<Fields...>{}))
+            skipValue(bin, type);
+      }
+
+      return res;
+   }
+
    template <typename T>
    auto getPackedRepeated(int fieldNo) const
    {
@@ -696,6 +1080,27 @@ T deserialize(BinMessageView<parserMode> msgView)
    return msg;
 }
 
+namespace impl
+{
+   template <typename BinView, typename = void, typename... Fields>
+   struct HasGetMany : std::false_type
+   {};
+
+   template <typename BinView, typename... Fields>
+   struct HasGetMany<BinView, std::void_t<decltype(std::declval<const BinView&>().template getMany<Fields...>())>, Fields...> : std::true_type
+   {};
+}
+
+// Reads the requested fields in one pass, if supported by BinView (otherwise field by field)
+template <typename... Fields, typename BinView>
+auto getMany(const BinView& binView) -> std::tuple<std::optional<typename Fields::Type::CppType>...>
+{
+   if constexpr (impl::HasGetMany<BinView, void, Fields...>::value)
+      return binView.template getMany<Fields...>();
+   else
+      return {binView.template get<typename Fields::Type>(Fields::number)...};
+}
+
 template <typename Msg, typename BinView>
 struct ViewFor
 {};
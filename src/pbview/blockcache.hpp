@@ -0,0 +1,253 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace pbview
+{
+
+// Decompressed data of a block. Holding a BlockPin keeps the data alive (and its cache entry
+// from being evicted), the last pin returns the buffer to its pool.
+using BlockPin = std::shared_ptr<const std::vector<std::byte>>;
+
+// Pool of reusable buffers, so that decompressing blocks does not allocate in the steady state
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+ public:
+   using Buffer = std::shared_ptr<std::vector<std::byte>>;
+
+   static std::shared_ptr<BufferPool> create(std::size_t maxPooled = 64)
+   {
+      return std::shared_ptr<BufferPool>{new BufferPool{maxPooled}};
+   }
+
+   // A buffer of the given size (contents undefined), that returns to the pool when released
+   Buffer acquire(std::size_t size)
+   {
+      std::unique_ptr<std::vector<std::byte>> buffer;
+      {
+         std::lock_guard<std::mutex> lock{mMutex};
+         if (!mFree.empty())
+         {
+            buffer = std::move(mFree.back());
+            mFree.pop_back();
+         }
+      }
+      if (!buffer)
+         buffer = std::make_unique<std::vector<std::byte>>();
+      buffer->resize(size);
+
+      std::weak_ptr<BufferPool> pool = shared_from_this();
+      return Buffer{buffer.release(), [pool](std::vector<std::byte>* released) {
+                       if (auto self = pool.lock())
+                          self->release(std::unique_ptr<std::vector<std::byte>>{released});
+                       else
+                          delete released;
+                    }};
+   }
+
+   // Number of buffers available for reuse
+   std::size_t pooledCount() const
+   {
+      std::lock_guard<std::mutex> lock{mMutex};
+      return mFree.size();
+   }
+
+ private:
+   explicit BufferPool(std::size_t maxPooled)
+      : mMaxPooled(maxPooled)
+   {
+   }
+
+   void release(std::unique_ptr<std::vector<std::byte>> buffer)
+   {
+      std::lock_guard<std::mutex> lock{mMutex};
+      if (mFree.size() < mMaxPooled)
+         mFree.push_back(std::move(buffer));
+   }
+
+   std::size_t mMaxPooled;
+   mutable std::mutex mMutex;
+   std::vector<std::unique_ptr<std::vector<std::byte>>> mFree;
+};
+
+// Thread-safe LRU cache of decompressed blocks, that can be shared by several readers.
+//
+// A block is decompressed only once, even if several threads request it at the same time.
+// Entries are evicted in LRU order when the decompressed size exceeds the capacity, but pinned
+// entries (with a BlockPin held outside of the cache) are skipped. Evicted buffers return to the
+// pool as soon as their last pin is released.
+class BlockCache
+{
+ public:
+   struct Key
+   {
+      // identifies the file, the same for all readers of a file (BlockRecordReader uses a hash of its sync marker)
+      std::uint64_t file;
+      std::uint64_t offset;
+
+      bool operator==(const Key& other) const
+      {
+         return file == other.file && offset == other.offset;
+      }
+   };
+
+   struct Stats
+   {
+      std::uint64_t hits;
+      std::uint64_t misses;
+      std::uint64_t evictions;
+      // decompressed bytes in the cache
+      std::size_t size;
+      // cached blocks, including the ones being decompressed
+      std::size_t entries;
+   };
+
+   explicit BlockCache(std::size_t capacity, std::shared_ptr<BufferPool> pool = BufferPool::create())
+      : mCapacity(capacity), mPool(std::move(pool))
+   {
+   }
+
+   BlockCache(const BlockCache&) = delete;
+   BlockCache& operator=(const BlockCache&) = delete;
+
+   const std::shared_ptr<BufferPool>& pool() const
+   {
+      return mPool;
+   }
+
+   // The block for key, decompressed by load(std::byte* out, std::size_t size) into a buffer
+   // of size bytes if it is not cached. If load throws, the entry is removed and the exception
+   // is rethrown (the next request of the block loads it again).
+   template <typename Load>
+   BlockPin get(const Key& key, std::size_t size, Load&& load)
+   {
+      std::shared_ptr<Slot> slot;
+      {
+         std::lock_guard<std::mutex> lock{mMutex};
+         auto it = mEntries.find(key);
+         if (it != mEntries.end())
+         {
+            mLru.splice(mLru.begin(), mLru, it->second);
+            slot = *it->second;
+            mHits++;
+            // entries, that were pinned at the last eviction, may be released now
+            evict();
+         }
+         else
+         {
+            slot = std::make_shared<Slot>();
+            mLru.push_front(slot);
+            mEntries.emplace(key, mLru.begin());
+            slot->key = key;
+            mMisses++;
+         }
+      }
+
+      {
+         // the first thread decompresses, the others wait for it
+         std::lock_guard<std::mutex> lock{slot->mutex};
+         if (!slot->buffer)
+         {
+            auto buffer = mPool->acquire(size);
+            try
+            {
+               load(buffer->data(), size);
+            }
+            catch (...)
+            {
+               std::lock_guard<std::mutex> cacheLock{mMutex};
+               remove(slot);
+               throw;
+            }
+
+            std::lock_guard<std::mutex> cacheLock{mMutex};
+            slot->buffer = std::move(buffer);
+            // the slot was removed after a failed load of another thread, that this one waited for
+            auto it = mEntries.find(key);
+            if (it == mEntries.end())
+            {
+               mLru.push_front(slot);
+               it = mEntries.emplace(key, mLru.begin()).first;
+            }
+            // otherwise the block is cached by a slot of a later request, this one is only held by its pins
+            if (*it->second == slot)
+            {
+               mSize += size;
+               evict();
+            }
+         }
+      }
+      return BlockPin{slot, slot->buffer.get()};
+   }
+
+   Stats stats() const
+   {
+      std::lock_guard<std::mutex> lock{mMutex};
+      return {mHits, mMisses, mEvictions, mSize, mEntries.size()};
+   }
+
+ private:
+   struct Slot
+   {
+      Key key;
+      std::mutex mutex;
+      // set once decompressed (with mutex and the mutex of the cache locked)
+      BufferPool::Buffer buffer;
+   };
+
+   struct KeyHash
+   {
+      std::size_t operator()(const Key& key) const
+      {
+         return std::hash<std::uint64_t>{}(key.offset * 0x9e3779b97f4a7c15ull ^ key.file);
+      }
+   };
+
+   using Lru = std::list<std::shared_ptr<Slot>>;
+
+   std::size_t mCapacity;
+   std::shared_ptr<BufferPool> mPool;
+
+   mutable std::mutex mMutex;
+   Lru mLru;
+   std::unordered_map<Key, Lru::iterator, KeyHash> mEntries;
+   std::size_t mSize = 0;
+   std::uint64_t mHits = 0;
+   std::uint64_t mMisses = 0;
+   std::uint64_t mEvictions = 0;
+
+   // removes the entry of a slot, that failed to load (requires mMutex)
+   void remove(const std::shared_ptr<Slot>& slot)
+   {
+      auto it = mEntries.find(slot->key);
+      if (it == mEntries.end() || *it->second != slot)
+         return;
+      mLru.erase(it->second);
+      mEntries.erase(it);
+   }
+
+   // evicts least recently used entries, that are loaded and not pinned (requires mMutex)
+   void evict()
+   {
+      for (auto it = mLru.end(); mSize > mCapacity && it != mLru.begin();)
+      {
+         --it;
+         auto& slot = *it;
+         // the cache holds the only reference: no pins and nobody waiting for the slot
+         if (slot.use_count() != 1 || !slot->buffer)
+            continue;
+         mSize -= slot->buffer->size();
+         mEntries.erase(slot->key);
+         it = mLru.erase(it);
+         mEvictions++;
+      }
+   }
+};
+
+} // namespace pbview
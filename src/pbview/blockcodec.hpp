@@ -0,0 +1,28 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace pbview
+{
+
+// Compression of the blocks of a block record file (see BlockRecordWriter). The id of the codec is
+// stored in the file header, a reader needs a codec with the same id.
+class BlockCodec
+{
+ public:
+   virtual ~BlockCodec() = default;
+
+   // Id stored in the file header (0 is reserved for uncompressed files)
+   virtual std::uint32_t id() const = 0;
+
+   // Appends the compressed data to out
+   virtual void compress(DataSpan in, std::vector<std::byte>& out) const = 0;
+
+   // Decompresses in into exactly outSize bytes at out, throws on corrupt data
+   virtual void decompress(DataSpan in, std::byte* out, std::size_t outSize) const = 0;
+};
+
+} // namespace pbview
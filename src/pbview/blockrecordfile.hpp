@@ -0,0 +1,689 @@
+#pragma once
+
+#include "blockcache.hpp"
+#include "blockcodec.hpp"
+#include "blockstatistics.hpp"
+#include "crc32c.hpp"
+#include "mappedrecordfile.hpp"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace pbview
+{
+
+// Block based container for length delimited records, that can be split at arbitrary byte
+// offsets (e.g. for parallel reading) and recovers from corrupted blocks.
+//
+// File header (32 bytes):
+//   magic "PBVBLK01" | block size (uint32) | codec id (uint16) | flags (uint16) | sync marker (16 random bytes)
+// followed by blocks at the offsets 32 + k * block size. Each block starts with a header (32 bytes):
+//   sync marker | record count (uint32) | payload size (uint32) | CRC32C of payload (uint32) | CRC32C of the header before (uint32)
+// followed by the payload of length delimited records. A block is padded with zeros to a multiple
+// of the block size (except the last block of a file). Blocks only contain more records than fit
+// into one block size, if a single record is larger.
+//
+// With a codec (id != 0) the payload is stored as the uncompressed size (varint) followed by the
+// compressed records. The CRC32C is computed over the stored payload.
+//
+// With the statistics flag, the stored payload starts with the statistics of the block (see
+// StatisticsField): their size (varint) | statistics | CRC32C of the statistics (uint32), which
+// are not compressed, so that a reader can skip blocks by their statistics without reading or
+// decompressing the records.
+//
+// To find the blocks in a byte range, a reader checks all block aligned offsets for the sync
+// marker and a valid header. All integers are stored little endian.
+namespace block_format
+{
+   constexpr std::array<char, 8> magic{'P', 'B', 'V', 'B', 'L', 'K', '0', '1'};
+   constexpr std::size_t syncMarkerSize = 16;
+   constexpr std::size_t fileHeaderSize = 32;
+   constexpr std::size_t blockHeaderSize = 32;
+   constexpr std::size_t minBlockSize = 64;
+   constexpr std::uint32_t defaultBlockSize = 64 << 10;
+   // flags in the file header
+   constexpr std::uint16_t statisticsFlag = 1;
+
+   using SyncMarker = std::array<std::byte, syncMarkerSize>;
+
+   struct BlockHeader
+   {
+      std::uint32_t recordCount;
+      std::uint32_t payloadSize;
+      std::uint32_t payloadCrc;
+   };
+
+   inline void store32(std::byte* out, std::uint32_t val)
+   {
+      memcpy(out, &val, sizeof(val));
+   }
+
+   inline std::uint32_t load32(const std::byte* in)
+   {
+      std::uint32_t val;
+      memcpy(&val, in, sizeof(val));
+      return val;
+   }
+
+   inline std::array<std::byte, blockHeaderSize> encodeBlockHeader(const SyncMarker& sync, const BlockHeader& header)
+   {
+      std::array<std::byte, blockHeaderSize> res;
+      std::copy(sync.begin(), sync.end(), res.begin());
+      store32(res.data() + 16, header.recordCount);
+      store32(res.data() + 20, header.payloadSize);
+      store32(res.data() + 24, header.payloadCrc);
+      store32(res.data() + 28, impl::crc32c(res.data(), 28));
+      return res;
+   }
+
+   // Header of the block at the start of bin, if there is a valid one
+   inline std::optional<BlockHeader> decodeBlockHeader(const SyncMarker& sync, DataSpan bin)
+   {
+      if (bin.size() < blockHeaderSize || !std::equal(sync.begin(), sync.end(), bin.begin()))
+         return std::nullopt;
+      if (load32(bin.data() + 28) != impl::crc32c(bin.data(), 28))
+         return std::nullopt;
+      return BlockHeader{load32(bin.data() + 16), load32(bin.data() + 20), load32(bin.data() + 24)};
+   }
+}
+
+struct BlockWriterOptions
+{
+   // alignment of the blocks (readers check all multiples of it for block headers)
+   std::uint32_t blockSize = block_format::defaultBlockSize;
+   // compression of the blocks (nullptr: uncompressed)
+   std::shared_ptr<const BlockCodec> codec;
+   // uncompressed size of the records in a block (0: the block size without header, or four
+   // times that if compressed, as a compressed block is padded up to a multiple of the block size)
+   std::size_t payloadSize = 0;
+   // fields with statistics in each block, that let BlockRecordReader::scan() skip blocks
+   std::vector<StatisticsField> statistics;
+};
+
+// Writes records into the block based container format to a std::ostream
+class BlockRecordWriter
+{
+ public:
+   explicit BlockRecordWriter(std::ostream& os, std::uint32_t blockSize = block_format::defaultBlockSize)
+      : BlockRecordWriter(os, BlockWriterOptions{blockSize})
+   {
+   }
+
+   BlockRecordWriter(std::ostream& os, BlockWriterOptions options)
+      : mOs(os),
+        mBlockSize(options.blockSize),
+        mCodec(std::move(options.codec)),
+        mPayloadSize(options.payloadSize),
+        mStatistics(std::move(options.statistics))
+   {
+      impl::enforce(mBlockSize >= block_format::minBlockSize, "Block size is too small");
+      if (mPayloadSize == 0)
+         mPayloadSize = (mBlockSize - block_format::blockHeaderSize) * (mCodec ? 4 : 1);
+
+      std::random_device random;
+      for (auto& b : mSync)
+         b = static_cast<std::byte>(random());
+
+      std::array<std::byte, block_format::fileHeaderSize> header{};
+      memcpy(header.data(), block_format::magic.data(), block_format::magic.size());
+      block_format::store32(header.data() + 8, mBlockSize);
+      const std::uint32_t codecId = mCodec ? mCodec->id() : 0;
+      impl::enforce(!mCodec || (codecId > 0 && codecId <= 0xffff), "Codec ids must be in [1, 65535]");
+      const std::uint32_t flags = mStatistics.empty() ? 0 : block_format::statisticsFlag;
+      block_format::store32(header.data() + 12, codecId | flags << 16);
+      std::copy(mSync.begin(), mSync.end(), header.begin() + 16);
+      write(header.data(), header.size());
+   }
+
+   BlockRecordWriter(const BlockRecordWriter&) = delete;
+   BlockRecordWriter& operator=(const BlockRecordWriter&) = delete;
+
+   // Writes the last block (errors are ignored, call close() to get them)
+   ~BlockRecordWriter()
+   {
+      try
+      {
+         close();
+      }
+      catch (...)
+      {
+      }
+   }
+
+   // Appends a serialized message
+   void add(DataSpan serialized)
+   {
+      std::array<std::byte, 10> len;
+      const auto lenSize = block_format::encodeVarint(len.data(), serialized.size());
+      reserve(lenSize + serialized.size());
+      if (!mStatistics.empty())
+         mStatistics.add(serialized);
+      mPayload.insert(mPayload.end(), len.begin(), len.begin() + lenSize);
+      mPayload.insert(mPayload.end(), serialized.begin(), serialized.end());
+      mBlockRecords++;
+   }
+
+   template <ParserMode mode>
+   void add(const BinMessageView<mode>& view)
+   {
+      add(view.bytes);
+   }
+
+   void add(const google::protobuf::MessageLite& msg)
+   {
+      const auto size = msg.ByteSizeLong();
+      std::array<std::byte, 10> len;
+      const auto lenSize = block_format::encodeVarint(len.data(), size);
+      reserve(lenSize + size);
+      mPayload.insert(mPayload.end(), len.begin(), len.begin() + lenSize);
+      const auto offset = mPayload.size();
+      mPayload.resize(offset + size);
+      msg.SerializeWithCachedSizesToArray(reinterpret_cast<std::uint8_t*>(mPayload.data() + offset));
+      if (!mStatistics.empty())
+         mStatistics.add(DataSpan{mPayload.data() + offset, size});
+      mBlockRecords++;
+   }
+
+   // Finishes the current block (the next record starts a new block)
+   void flush()
+   {
+      if (mBlockRecords == 0)
+         return;
+
+      // padding of the block before
+      static const std::array<std::byte, 4096> zeros{};
+      for (auto padding = mPadding; padding > 0;)
+      {
+         const auto n = std::min(padding, zeros.size());
+         write(zeros.data(), n);
+         padding -= n;
+      }
+
+      auto* payload = &mPayload;
+      if (mCodec)
+      {
+         mCompressed.resize(10);
+         mCompressed.resize(block_format::encodeVarint(mCompressed.data(), mPayload.size()));
+         mCodec->compress(DataSpan{mPayload.data(), mPayload.size()}, mCompressed);
+         impl::enforce(mCompressed.size() <= std::numeric_limits<std::uint32_t>::max(), "Compressed block is too large");
+         payload = &mCompressed;
+      }
+
+      // statistics before the (compressed) records
+      mStatisticsSection.clear();
+      if (!mStatistics.empty())
+      {
+         mStatisticsData.clear();
+         mStatistics.finish(mStatisticsData);
+         block_format::appendVarint(mStatisticsSection, mStatisticsData.size());
+         mStatisticsSection.insert(mStatisticsSection.end(), mStatisticsData.begin(), mStatisticsData.end());
+         mStatisticsSection.resize(mStatisticsSection.size() + 4);
+         block_format::store32(mStatisticsSection.data() + mStatisticsSection.size() - 4, impl::crc32c(mStatisticsData.data(), mStatisticsData.size()));
+      }
+
+      const auto storedSize = mStatisticsSection.size() + payload->size();
+      impl::enforce(storedSize <= std::numeric_limits<std::uint32_t>::max(), "Block is too large");
+      const auto crc = impl::crc32c(payload->data(), payload->size(), impl::crc32c(mStatisticsSection.data(), mStatisticsSection.size()));
+      const auto header = block_format::encodeBlockHeader(mSync, {mBlockRecords, static_cast<std::uint32_t>(storedSize), crc});
+      write(header.data(), header.size());
+      write(mStatisticsSection.data(), mStatisticsSection.size());
+      write(payload->data(), payload->size());
+
+      const auto blockBytes = header.size() + storedSize;
+      mPadding = (mBlockSize - blockBytes % mBlockSize) % mBlockSize;
+      mRecordCount += mBlockRecords;
+      mBlockCount++;
+      mBlockRecords = 0;
+      mPayload.clear();
+   }
+
+   // Writes the last block and flushes the stream
+   void close()
+   {
+      flush();
+      mOs.flush();
+      impl::enforce(mOs.good(), "Failed to write record file");
+   }
+
+   std::uint64_t recordCount() const
+   {
+      return mRecordCount + mBlockRecords;
+   }
+
+   // Number of finished blocks
+   std::uint64_t blockCount() const
+   {
+      return mBlockCount;
+   }
+
+ private:
+   std::ostream& mOs;
+   std::uint32_t mBlockSize;
+   std::shared_ptr<const BlockCodec> mCodec;
+   std::size_t mPayloadSize;
+   impl::BlockStatisticsBuilder mStatistics;
+   block_format::SyncMarker mSync;
+
+   std::vector<std::byte> mPayload;
+   std::vector<std::byte> mCompressed;
+   std::vector<std::byte> mStatisticsData;
+   std::vector<std::byte> mStatisticsSection;
+   std::uint32_t mBlockRecords = 0;
+   std::size_t mPadding = 0;
+   std::uint64_t mRecordCount = 0;
+   std::uint64_t mBlockCount = 0;
+
+   // starts a new block, if the record does not fit into the current one
+   void reserve(std::size_t recordSize)
+   {
+      if (mBlockRecords > 0 && mPayload.size() + recordSize > mPayloadSize)
+         flush();
+      impl::enforce(mPayload.size() + recordSize <= std::numeric_limits<std::uint32_t>::max(), "Record is too large");
+   }
+
+   void write(const std::byte* data, std::size_t size)
+   {
+      mOs.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+      impl::enforce(mOs.good(), "Failed to write record file");
+   }
+};
+
+struct BlockReaderOptions
+{
+   // compare the CRC32C of each block before reading its records
+   bool verifyChecksums = true;
+   // skip blocks with invalid checksums or framing instead of throwing
+   bool skipCorruptBlocks = false;
+   // codec of compressed files (with the id stored in the file)
+   std::shared_ptr<const BlockCodec> codec;
+   // cache of decompressed blocks, that may be shared by several readers
+   // (without cache each block is decompressed into a pooled buffer whenever it is read)
+   std::shared_ptr<BlockCache> cache;
+};
+
+// Result of BlockRecordReader::scan()
+struct ScanResult
+{
+   // blocks, of which the records were read
+   std::uint64_t scannedBlocks = 0;
+   // blocks skipped, as their statistics ruled out matching records
+   std::uint64_t prunedBlocks = 0;
+   // skipped corrupt blocks (see BlockReaderOptions::skipCorruptBlocks)
+   std::uint64_t skippedBlocks = 0;
+   std::uint64_t matchedRecords = 0;
+
+   // for combining the results of several byte ranges
+   ScanResult& operator+=(const ScanResult& other)
+   {
+      scannedBlocks += other.scannedBlocks;
+      prunedBlocks += other.prunedBlocks;
+      skippedBlocks += other.skippedBlocks;
+      matchedRecords += other.matchedRecords;
+      return *this;
+   }
+};
+
+// Reads files of the block based container format (see BlockRecordWriter). The records are
+// views directly into the file data, or into the decompressed block for compressed files. These
+// are valid as long as a copy of the Block or of the Record (both hold a BlockPin) exists.
+//
+// forEachBlock() and forEachRecord() take a byte range and process all blocks starting in this
+// range, so that several threads can read disjoint ranges of the same file independently.
+// scan() additionally filters the records by FieldPredicates and skips blocks by their statistics.
+//
+// As the checksums of all blocks are verified before their records are read, files written by a
+// trusted BlockRecordWriter may be read with ParserMode::Fast_WithoutBoundsChecking (the framing
+// of the records is always checked).
+template <ParserMode parserMode = ParserMode::Fast>
+class BlockRecordReader
+{
+ public:
+   using BinView = BinMessageView<parserMode>;
+
+   struct Block
+   {
+      // offset of the block header in the file
+      std::uint64_t offset;
+      std::uint32_t recordCount;
+      // the (decompressed) records
+      DataSpan payload;
+      // keeps the decompressed payload alive (empty for uncompressed files)
+      BlockPin pin;
+      // encoded statistics of the block (see FieldPredicate::mayMatch())
+      DataSpan statistics;
+
+      DelimitedRecords<BinView> records() const
+      {
+         return DelimitedRecords<BinView>{payload};
+      }
+   };
+
+   // A record passed by forEachRecord() and scan(). Copies keep the block of the record pinned,
+   // so that they stay valid after the callback returned (also after eviction from the cache).
+   struct Record : BinView
+   {
+      // empty for uncompressed files
+      BlockPin pin;
+
+      Record(BinView view, BlockPin blockPin)
+         : BinView(view), pin(std::move(blockPin))
+      {
+      }
+   };
+
+   explicit BlockRecordReader(DataSpan bytes, BlockReaderOptions options = {})
+      : mBytes(bytes), mOptions(options)
+   {
+      if constexpr (parserMode == ParserMode::Fast_WithoutBoundsChecking)
+         impl::enforce(options.verifyChecksums, "Reading without bounds checking requires verified checksums");
+
+      impl::enforce(mBytes.size() >= block_format::fileHeaderSize
+                       && std::equal(block_format::magic.begin(), block_format::magic.end(), reinterpret_cast<const char*>(mBytes.data())),
+                    "Not a block record file");
+      mBlockSize = block_format::load32(mBytes.data() + 8);
+      impl::enforce(mBlockSize >= block_format::minBlockSize, "Invalid block size in record file");
+      std::copy(mBytes.begin() + 16, mBytes.begin() + 32, mSync.begin());
+
+      const auto codecId = block_format::load32(mBytes.data() + 12) & 0xffff;
+      const auto flags = block_format::load32(mBytes.data() + 12) >> 16;
+      impl::enforce((flags & ~block_format::statisticsFlag) == 0, "Record file uses unsupported features");
+      mHasStatistics = flags & block_format::statisticsFlag;
+      if (codecId)
+      {
+         impl::enforce(mOptions.codec && mOptions.codec->id() == codecId, "Record file needs codec " + std::to_string(codecId));
+         // the sync marker is random per file, so all readers of a file (and of its copies) share the cached blocks
+         mFileId = impl::hashBytes(std::string_view{reinterpret_cast<const char*>(mSync.data()), mSync.size()});
+         mPool = mOptions.cache ? mOptions.cache->pool() : BufferPool::create();
+      }
+      else
+         mOptions.codec = nullptr;
+   }
+
+   // Maps the file into memory
+   explicit BlockRecordReader(const std::string& path, BlockReaderOptions options = {}, MappingOptions mappingOptions = {})
+      : BlockRecordReader(std::make_unique<MappedFile>(path, mappingOptions), options)
+   {
+   }
+
+   DataSpan bytes() const
+   {
+      return mBytes;
+   }
+
+   std::uint32_t blockSize() const
+   {
+      return mBlockSize;
+   }
+
+   bool compressed() const
+   {
+      return mOptions.codec != nullptr;
+   }
+
+   // Whether the blocks have statistics (see BlockWriterOptions::statistics)
+   bool hasStatistics() const
+   {
+      return mHasStatistics;
+   }
+
+   // Calls f(Block) for all blocks with a header starting in [begin, end).
+   // Returns the number of skipped corrupt blocks (a corrupt header at the first block offset of
+   // a range that does not start at the beginning of the file can't be detected).
+   template <typename F>
+   std::size_t forEachBlock(std::uint64_t begin, std::uint64_t end, F&& f) const
+   {
+      return visitBlocks(begin, end, [](DataSpan) { return false; }, std::forward<F>(f));
+   }
+
+   // The block with its header at offset (e.g. Block::offset of an earlier scan)
+   Block block(std::uint64_t offset) const
+   {
+      std::optional<Block> res;
+      forEachBlock(offset, offset + 1, [&](const Block& block) { res = block; });
+      impl::enforce(res && res->offset == offset, "No valid block at offset " + std::to_string(offset));
+      return std::move(*res);
+   }
+
+   // Calls f(const Record&) for all records in blocks starting in [begin, end).
+   // Returns the number of skipped corrupt blocks.
+   template <typename F>
+   std::size_t forEachRecord(std::uint64_t begin, std::uint64_t end, F&& f) const
+   {
+      std::size_t skippedFraming = 0;
+      const auto skipped = forEachBlock(begin, end, [&](const Block& block) {
+         if (!forEachRecordOfBlock(block, f))
+            skippedFraming++;
+      });
+      return skipped + skippedFraming;
+   }
+
+   // Calls f(const Record&) for all records of the file
+   template <typename F>
+   std::size_t forEachRecord(F&& f) const
+   {
+      return forEachRecord(0, mBytes.size(), std::forward<F>(f));
+   }
+
+   // Calls f(const Record&) for the records in blocks starting in [begin, end), that match all
+   // predicates. Blocks whose statistics rule out matches are skipped without reading (or
+   // decompressing) their records.
+   template <typename F>
+   ScanResult scan(std::uint64_t begin, std::uint64_t end, const std::vector<FieldPredicate>& predicates, F&& f) const
+   {
+      ScanResult res;
+      auto prune = [&](DataSpan statistics) {
+         for (const auto& predicate : predicates)
+         {
+            if (!predicate.mayMatch(statistics))
+            {
+               res.prunedBlocks++;
+               return true;
+            }
+         }
+         return false;
+      };
+
+      res.skippedBlocks = visitBlocks(begin, end, prune, [&](const Block& block) {
+         const bool valid = forEachRecordOfBlock(block, [&](const Record& record) {
+            for (const auto& predicate : predicates)
+               if (!predicate.matches(record))
+                  return;
+            res.matchedRecords++;
+            f(record);
+         });
+         if (valid)
+            res.scannedBlocks++;
+         else
+            res.skippedBlocks++;
+      });
+      return res;
+   }
+
+   template <typename F>
+   ScanResult scan(const std::vector<FieldPredicate>& predicates, F&& f) const
+   {
+      return scan(0, mBytes.size(), predicates, std::forward<F>(f));
+   }
+
+ private:
+   std::unique_ptr<MappedFile> mFile;
+   DataSpan mBytes;
+   BlockReaderOptions mOptions;
+   std::uint32_t mBlockSize = 0;
+   block_format::SyncMarker mSync;
+   bool mHasStatistics = false;
+   // for compressed files
+   std::uint64_t mFileId = 0;
+   std::shared_ptr<BufferPool> mPool;
+
+   // forEachBlock(), that skips blocks for which prune(statistics) returns true
+   template <typename Prune, typename F>
+   std::size_t visitBlocks(std::uint64_t begin, std::uint64_t end, Prune&& prune, F&& f) const
+   {
+      end = std::min<std::uint64_t>(end, mBytes.size());
+      std::size_t skipped = 0;
+
+      // first block aligned offset in the range
+      std::uint64_t pos = block_format::fileHeaderSize;
+      if (begin > pos)
+         pos += (begin - pos + mBlockSize - 1) / mBlockSize * mBlockSize;
+
+      // a block header is expected after a valid block (at other offsets there may be the inside of a large block)
+      bool expectHeader = pos == block_format::fileHeaderSize;
+      while (pos < end)
+      {
+         auto header = block_format::decodeBlockHeader(mSync, mBytes.substr(pos));
+         if (!header)
+         {
+            if (expectHeader)
+            {
+               impl::enforce(mOptions.skipCorruptBlocks, "Corrupt block header in record file at offset " + std::to_string(pos));
+               skipped++;
+            }
+            // resync at the next block aligned offset
+            expectHeader = false;
+            pos += mBlockSize;
+            continue;
+         }
+
+         const auto payloadBegin = pos + block_format::blockHeaderSize;
+         const auto blockUnits = (block_format::blockHeaderSize + header->payloadSize + mBlockSize - 1) / mBlockSize;
+         const auto next = pos + blockUnits * mBlockSize;
+
+         bool valid = header->payloadSize <= mBytes.size() - payloadBegin;
+         Block block{pos, header->recordCount, valid ? mBytes.substr(payloadBegin, header->payloadSize) : DataSpan{}, nullptr, {}};
+         const auto stored = block.payload;
+         if (valid && mHasStatistics)
+         {
+            valid = splitStatistics(block);
+            if (valid && prune(block.statistics))
+            {
+               expectHeader = true;
+               pos = next;
+               continue;
+            }
+         }
+         if (valid && mOptions.verifyChecksums)
+            valid = impl::crc32c(stored.data(), stored.size()) == header->payloadCrc;
+         if (valid && mOptions.codec)
+            valid = decompress(block);
+
+         if (valid)
+            f(block);
+         else
+         {
+            impl::enforce(mOptions.skipCorruptBlocks, "Corrupt block in record file at offset " + std::to_string(pos));
+            skipped++;
+         }
+         expectHeader = true;
+         pos = next;
+      }
+      return skipped;
+   }
+
+   // calls f(const Record&) for the records of a block, returns false, if it was skipped as corrupt
+   template <typename F>
+   bool forEachRecordOfBlock(const Block& block, F&& f) const
+   {
+      // without checksums, corrupted blocks can only be skipped if they are detected before reading
+      if (mOptions.skipCorruptBlocks && !mOptions.verifyChecksums && !validFraming(block))
+         return false;
+      auto bin = block.payload;
+      std::uint32_t count = 0;
+      // one record per block, so that the pin is only copied by callers keeping records
+      Record record{BinView{DataSpan{}}, block.pin};
+      for (; !bin.empty(); count++)
+      {
+         record.bytes = impl::popDelimitedRecord(bin);
+         f(static_cast<const Record&>(record));
+      }
+      impl::enforce(count == block.recordCount, "Invalid record count in block at offset " + std::to_string(block.offset));
+      return true;
+   }
+
+   // moves the statistics from the front of the stored payload to Block::statistics, returns false
+   // for corrupt statistics, if these may be skipped
+   bool splitStatistics(Block& block) const
+   {
+      try
+      {
+         auto stored = block.payload;
+         const auto size = block_format::popVarint(stored);
+         impl::enforce(size <= stored.size() && stored.size() - size >= 4, "Invalid block statistics");
+         block.statistics = stored.substr(0, size);
+         stored.remove_prefix(size);
+         impl::enforce(!mOptions.verifyChecksums || block_format::load32(stored.data()) == impl::crc32c(block.statistics.data(), size),
+                       "Invalid checksum of block statistics");
+         block.payload = stored.substr(4);
+         return true;
+      }
+      catch (const std::runtime_error&)
+      {
+         if (!mOptions.skipCorruptBlocks)
+            throw;
+         return false;
+      }
+   }
+
+   // replaces the stored payload by the decompressed one, returns false for corrupt data, if these may be skipped
+   bool decompress(Block& block) const
+   {
+      try
+      {
+         auto stored = block.payload;
+         const auto size = block_format::popVarint(stored);
+         impl::enforce(size <= std::numeric_limits<std::uint32_t>::max(), "Invalid uncompressed size of block");
+
+         auto load = [&](std::byte* out, std::size_t outSize) { mOptions.codec->decompress(stored, out, outSize); };
+         if (mOptions.cache)
+            block.pin = mOptions.cache->get({mFileId, block.offset}, size, load);
+         else
+         {
+            auto buffer = mPool->acquire(size);
+            load(buffer->data(), size);
+            block.pin = std::move(buffer);
+         }
+         block.payload = DataSpan{block.pin->data(), block.pin->size()};
+         return true;
+      }
+      catch (const std::runtime_error&)
+      {
+         if (!mOptions.skipCorruptBlocks)
+            throw;
+         return false;
+      }
+   }
+
+   BlockRecordReader(std::unique_ptr<MappedFile> file, BlockReaderOptions options)
+      : BlockRecordReader(file->bytes(), options)
+   {
+      mFile = std::move(file);
+   }
+
+   // the records exactly fill the payload and match the record count of the header
+   static bool validFraming(const Block& block)
+   {
+      auto bin = block.payload;
+      std::uint32_t count = 0;
+      try
+      {
+         while (!bin.empty())
+         {
+            impl::popDelimitedRecord(bin);
+            count++;
+         }
+      }
+      catch (const std::runtime_error&)
+      {
+         return false;
+      }
+      return count == block.recordCount;
+   }
+};
+
+} // namespace pbview
@@ -0,0 +1,595 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace pbview
+{
+
+namespace block_format
+{
+   // Writes val as varint to out (at most 10 bytes), returns the number of bytes written
+   inline std::size_t encodeVarint(std::byte* out, std::uint64_t val)
+   {
+      std::size_t len = 0;
+      while (val >= 0x80)
+      {
+         out[len++] = static_cast<std::byte>(val | 0x80);
+         val >>= 7;
+      }
+      out[len++] = static_cast<std::byte>(val);
+      return len;
+   }
+
+   inline void appendVarint(std::vector<std::byte>& out, std::uint64_t val)
+   {
+      std::array<std::byte, 10> buf;
+      out.insert(out.end(), buf.begin(), buf.begin() + encodeVarint(buf.data(), val));
+   }
+
+   // Pops a varint from the front of bin
+   inline std::uint64_t popVarint(DataSpan& bin)
+   {
+      std::uint64_t val = 0;
+      for (int shift = 0;; shift += 7)
+      {
+         impl::enforce(!bin.empty() && shift < 64, "Invalid varint in record file");
+         const auto c = static_cast<std::uint8_t>(bin.front());
+         bin.remove_prefix(1);
+         val |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+         if (!(c & 0x80))
+            return val;
+      }
+   }
+
+   inline void append64(std::vector<std::byte>& out, std::uint64_t val)
+   {
+      const auto offset = out.size();
+      out.resize(offset + sizeof(val));
+      memcpy(out.data() + offset, &val, sizeof(val));
+   }
+
+   inline std::uint64_t pop64(DataSpan& bin)
+   {
+      impl::enforce(bin.size() >= sizeof(std::uint64_t), "Invalid block statistics");
+      std::uint64_t val;
+      memcpy(&val, bin.data(), sizeof(val));
+      bin.remove_prefix(sizeof(val));
+      return val;
+   }
+}
+
+// How the values of a field are compared in block statistics
+enum class StatisticsKind : std::uint8_t
+{
+   Signed,
+   Unsigned,
+   Floating,
+   // strings and bytes (only compared for equality with Bloom filters)
+   Bytes
+};
+
+namespace impl
+{
+   // Value of a field in block statistics: an order preserving key for numbers (so that the
+   // values of all kinds compare as unsigned integers), a hash for strings and bytes
+   struct StatisticsValue
+   {
+      std::uint64_t key;
+      std::string_view bytes;
+   };
+
+   inline std::uint64_t mix64(std::uint64_t x)
+   {
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9ull;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111ebull;
+      return x ^ (x >> 31);
+   }
+
+   // FNV-1a (the hashes are stored in files, so std::hash can't be used)
+   inline std::uint64_t hashBytes(std::string_view str)
+   {
+      std::uint64_t hash = 0xcbf29ce484222325ull;
+      for (char c : str)
+         hash = (hash ^ static_cast<std::uint8_t>(c)) * 0x100000001b3ull;
+      return mix64(hash);
+   }
+
+   // hash of a value in the Bloom filters
+   inline std::uint64_t bloomHash(StatisticsKind kind, std::uint64_t key)
+   {
+      return kind == StatisticsKind::Bytes ? key : mix64(key);
+   }
+
+   template <typename T>
+   constexpr StatisticsKind statisticsKind()
+   {
+      using Cpp = typename T::CppType;
+      if constexpr (std::is_same_v<Cpp, std::string_view>)
+         return StatisticsKind::Bytes;
+      else if constexpr (std::is_floating_point_v<Cpp>)
+         return StatisticsKind::Floating;
+      else if constexpr (std::is_enum_v<Cpp> || std::is_signed_v<Cpp>)
+         return StatisticsKind::Signed;
+      else
+      {
+         static_assert(std::is_unsigned_v<Cpp>, "Statistics are only supported for scalar, string and bytes fields");
+         return StatisticsKind::Unsigned;
+      }
+   }
+
+   // NaN has no value (it is neither equal, less nor greater than anything)
+   template <typename T>
+   std::optional<StatisticsValue> statisticsValue(typename T::CppType val)
+   {
+      constexpr auto kind = statisticsKind<T>();
+      constexpr auto signBit = std::uint64_t{1} << 63;
+      if constexpr (kind == StatisticsKind::Bytes)
+         return StatisticsValue{hashBytes(val), val};
+      else if constexpr (kind == StatisticsKind::Floating)
+      {
+         double d = val;
+         if (std::isnan(d))
+            return std::nullopt;
+         // -0.0 == 0.0
+         if (d == 0)
+            d = 0;
+         std::uint64_t bits;
+         memcpy(&bits, &d, sizeof(bits));
+         return StatisticsValue{(bits & signBit) ? ~bits : bits | signBit, {}};
+      }
+      else if constexpr (kind == StatisticsKind::Signed)
+         return StatisticsValue{static_cast<std::uint64_t>(static_cast<std::int64_t>(val)) ^ signBit, {}};
+      else
+         return StatisticsValue{static_cast<std::uint64_t>(val), {}};
+   }
+
+   // Reads a field of a message as StatisticsValue (with views of all parser modes). Like
+   // BinMessageView::get(), the value of a field that occurs several times (a repeated field, or
+   // e.g. concatenated messages) depends on the parser mode: the fast modes read the first
+   // occurrence and stop at the first higher field number, StrictConforming reads the last
+   // occurrence in the whole message. The record processing functions (statistics, indexes, sort
+   // keys, aggregates, columns and predicates) read their fields this way.
+   class FieldReader
+   {
+    public:
+      using FieldValue = BinMessageView<ParserMode::StrictConforming>::FieldValue;
+
+      template <typename T>
+      static FieldReader of()
+      {
+         return FieldReader{std::make_tuple(&read<T, ParserMode::Fast_WithoutBoundsChecking>, &read<T, ParserMode::Fast>,
+                                            &read<T, ParserMode::StrictConforming>),
+                            &readValue<T>};
+      }
+
+      template <ParserMode mode>
+      std::optional<StatisticsValue> operator()(const BinMessageView<mode>& view, int fieldNo) const
+      {
+         return std::get<Read<mode>>(mReaders)(view, fieldNo);
+      }
+
+      // a single occurrence of the field, e.g. from visitFields()
+      std::optional<StatisticsValue> operator()(FieldValue& field) const
+      {
+         return mReadValue(field);
+      }
+
+    private:
+      template <ParserMode mode>
+      using Read = std::optional<StatisticsValue> (*)(const BinMessageView<mode>&, int);
+      using ReadValue = std::optional<StatisticsValue> (*)(FieldValue&);
+
+      using Readers = std::tuple<Read<ParserMode::Fast_WithoutBoundsChecking>, Read<ParserMode::Fast>, Read<ParserMode::StrictConforming>>;
+      Readers mReaders;
+      ReadValue mReadValue;
+
+      FieldReader(Readers readers, ReadValue readValue)
+         : mReaders(readers), mReadValue(readValue)
+      {
+      }
+
+      template <typename T>
+      static std::optional<StatisticsValue> readValue(FieldValue& field)
+      {
+         return statisticsValue<T>(field.template value<T>());
+      }
+
+      template <typename T, ParserMode mode>
+      static std::optional<StatisticsValue> read(const BinMessageView<mode>& view, int fieldNo)
+      {
+         const auto val = view.template get<T>(fieldNo);
+         if (!val)
+            return std::nullopt;
+         return statisticsValue<T>(*val);
+      }
+   };
+}
+
+// A field, for which BlockRecordWriter stores statistics in each block (see BlockWriterOptions):
+//   StatisticsField::of<type::Int64>(4)                          // min/max
+//   StatisticsField::of<type::Uint32>(5).withBloomFilter()       // min/max and Bloom filter
+//   StatisticsField::of<type::String>(14)                        // Bloom filter
+// The statistics cover every occurrence of the field, so they hold for the value that scan()
+// compares in any parser mode (see impl::FieldReader).
+struct StatisticsField
+{
+   int fieldNo;
+   StatisticsKind kind;
+   // minimum and maximum of the values (not for strings and bytes)
+   bool minMax;
+   // bits per value of the Bloom filters (0: no Bloom filters), 10 bits give ~1% false positives
+   std::uint32_t bloomBitsPerValue;
+   impl::FieldReader reader;
+
+   template <typename T>
+   static StatisticsField of(int fieldNo)
+   {
+      constexpr auto kind = impl::statisticsKind<T>();
+      constexpr bool isBytes = kind == StatisticsKind::Bytes;
+      return StatisticsField{fieldNo, kind, !isBytes, isBytes ? 10u : 0u, impl::FieldReader::of<T>()};
+   }
+
+   StatisticsField withBloomFilter(std::uint32_t bitsPerValue = 10) const
+   {
+      auto res = *this;
+      res.bloomBitsPerValue = bitsPerValue;
+      return res;
+   }
+};
+
+namespace impl
+{
+   // Statistics of a field in a block, as stored in the file
+   struct FieldStatistics
+   {
+      enum Flags : std::uint8_t
+      {
+         HasMinMax = 1,
+         HasBloomFilter = 2,
+         // no record of the block has the field
+         NoValues = 4
+      };
+
+      StatisticsKind kind;
+      std::uint8_t flags;
+      std::uint64_t min = 0;
+      std::uint64_t max = 0;
+      // 64 bit words of the Bloom filter
+      DataSpan bloomFilter;
+      std::uint32_t bloomHashes = 0;
+
+      bool mayContain(std::uint64_t hash) const
+      {
+         const std::uint64_t bits = bloomFilter.size() * 8;
+         const auto delta = (hash >> 33) | (hash << 31) | 1;
+         for (std::uint32_t i = 0; i < bloomHashes; i++, hash += delta)
+         {
+            const auto bit = hash % bits;
+            if (!(static_cast<std::uint8_t>(bloomFilter[bit / 8]) & (1u << (bit % 8))))
+               return false;
+         }
+         return true;
+      }
+   };
+
+   // Encoded statistics of a block:
+   //   field count (varint), for each field:
+   //   field number (varint) | kind (byte) | flags (byte) | [min | max (uint64)] | [Bloom filter: words (varint) | hashes (byte) | words (uint64)]
+   // Throws for malformed statistics.
+   inline std::optional<FieldStatistics> findFieldStatistics(DataSpan stats, int fieldNo)
+   {
+      for (auto count = block_format::popVarint(stats); count > 0; count--)
+      {
+         const auto no = block_format::popVarint(stats);
+         impl::enforce(stats.size() >= 2, "Invalid block statistics");
+         FieldStatistics res{static_cast<StatisticsKind>(stats[0]), static_cast<std::uint8_t>(stats[1])};
+         stats.remove_prefix(2);
+         if (res.flags & FieldStatistics::HasMinMax)
+         {
+            res.min = block_format::pop64(stats);
+            res.max = block_format::pop64(stats);
+         }
+         if (res.flags & FieldStatistics::HasBloomFilter)
+         {
+            const auto words = block_format::popVarint(stats);
+            impl::enforce(words > 0 && !stats.empty() && words <= (stats.size() - 1) / 8, "Invalid block statistics");
+            res.bloomHashes = static_cast<std::uint8_t>(stats[0]);
+            res.bloomFilter = stats.substr(1, words * 8);
+            stats.remove_prefix(1 + words * 8);
+         }
+         if (no == static_cast<std::uint64_t>(fieldNo))
+            return res;
+      }
+      return std::nullopt;
+   }
+
+   // Collects the statistics of the records of a block
+   class BlockStatisticsBuilder
+   {
+    public:
+      explicit BlockStatisticsBuilder(std::vector<StatisticsField> fields)
+         : mFields(std::move(fields)), mAccumulators(mFields.size())
+      {
+         for (const auto& field : mFields)
+         {
+            impl::enforce(field.fieldNo > 0, "Invalid field number for statistics");
+            impl::enforce(std::count_if(mFields.begin(), mFields.end(), [&](const auto& f) { return f.fieldNo == field.fieldNo; }) == 1,
+                          "Duplicate field for statistics");
+            impl::enforce(field.minMax || field.bloomBitsPerValue > 0, "Statistics of a field need min/max or a Bloom filter");
+            impl::enforce(!field.minMax || field.kind != StatisticsKind::Bytes, "Strings and bytes have no min/max statistics");
+         }
+      }
+
+      bool empty() const
+      {
+         return mFields.empty();
+      }
+
+      // Adds every occurrence of the fields in a serialized record (in one pass over the whole
+      // record), so that the statistics cover the value that any parser mode reads (see FieldReader)
+      void add(DataSpan record)
+      {
+         BinMessageView<ParserMode::StrictConforming>{record}.visitFields([this](int fieldNo, auto& value) {
+            const auto field = std::find_if(mFields.begin(), mFields.end(), [fieldNo](const auto& f) { return f.fieldNo == fieldNo; });
+            if (field != mFields.end())
+               addValue(static_cast<std::size_t>(field - mFields.begin()), field->reader(value));
+         });
+      }
+
+      // Appends the statistics of the records since the last call to out
+      void finish(std::vector<std::byte>& out)
+      {
+         block_format::appendVarint(out, mFields.size());
+         for (std::size_t i = 0; i < mFields.size(); i++)
+         {
+            const auto& field = mFields[i];
+            auto& acc = mAccumulators[i];
+
+            std::uint8_t flags = 0;
+            if (acc.count == 0)
+               flags = FieldStatistics::NoValues;
+            else
+            {
+               if (field.minMax)
+                  flags |= FieldStatistics::HasMinMax;
+               if (field.bloomBitsPerValue > 0)
+                  flags |= FieldStatistics::HasBloomFilter;
+            }
+
+            block_format::appendVarint(out, static_cast<std::uint64_t>(field.fieldNo));
+            out.push_back(static_cast<std::byte>(field.kind));
+            out.push_back(static_cast<std::byte>(flags));
+            if (flags & FieldStatistics::HasMinMax)
+            {
+               block_format::append64(out, acc.min);
+               block_format::append64(out, acc.max);
+            }
+            if (flags & FieldStatistics::HasBloomFilter)
+               appendBloomFilter(out, field.bloomBitsPerValue, acc.hashes);
+
+            acc = Accumulator{};
+         }
+      }
+
+    private:
+      struct Accumulator
+      {
+         std::uint64_t count = 0;
+         std::uint64_t min = 0;
+         std::uint64_t max = 0;
+         std::vector<std::uint64_t> hashes;
+      };
+
+      std::vector<StatisticsField> mFields;
+      std::vector<Accumulator> mAccumulators;
+
+      void addValue(std::size_t idx, std::optional<StatisticsValue> val)
+      {
+         if (!val)
+            return;
+         const auto& field = mFields[idx];
+         auto& acc = mAccumulators[idx];
+         if (acc.count++ == 0)
+            acc.min = acc.max = val->key;
+         else
+         {
+            acc.min = std::min(acc.min, val->key);
+            acc.max = std::max(acc.max, val->key);
+         }
+         if (field.bloomBitsPerValue > 0)
+            acc.hashes.push_back(bloomHash(field.kind, val->key));
+      }
+
+      static void appendBloomFilter(std::vector<std::byte>& out, std::uint32_t bitsPerValue, const std::vector<std::uint64_t>& hashes)
+      {
+         const auto words = std::max<std::size_t>(1, (hashes.size() * bitsPerValue + 63) / 64);
+         // optimal number of hashes: ln(2) * bits per value
+         const auto hashCount = static_cast<std::uint8_t>(std::clamp(std::lround(bitsPerValue * 0.69), 1l, 30l));
+         block_format::appendVarint(out, words);
+         out.push_back(static_cast<std::byte>(hashCount));
+
+         const auto offset = out.size();
+         out.resize(offset + words * 8);
+         const std::uint64_t bits = words * 64;
+         for (auto hash : hashes)
+         {
+            const auto delta = (hash >> 33) | (hash << 31) | 1;
+            for (std::uint8_t i = 0; i < hashCount; i++, hash += delta)
+            {
+               const auto bit = hash % bits;
+               out[offset + bit / 8] |= static_cast<std::byte>(1u << (bit % 8));
+            }
+         }
+      }
+   };
+}
+
+// Condition on a field for BlockRecordReader::scan(), that can rule out blocks by their
+// statistics. The value is read like impl::FieldReader does (which occurrence depends on the
+// parser mode), records without the field (or with NaN) never match.
+class FieldPredicate
+{
+ public:
+   template <typename T>
+   static FieldPredicate equal(int fieldNo, typename T::CppType value)
+   {
+      FieldPredicate res{fieldNo, impl::statisticsKind<T>(), impl::FieldReader::of<T>()};
+      if (const auto val = impl::statisticsValue<T>(value))
+      {
+         res.mLo = res.mHi = val->key;
+         res.mBytes = val->bytes;
+      }
+      return res;
+   }
+
+   // lo <= value <= hi
+   template <typename T>
+   static FieldPredicate between(int fieldNo, typename T::CppType lo, typename T::CppType hi)
+   {
+      static_assert(impl::statisticsKind<T>() != StatisticsKind::Bytes, "Strings and bytes can only be compared for equality");
+      FieldPredicate res{fieldNo, impl::statisticsKind<T>(), impl::FieldReader::of<T>()};
+      const auto loVal = impl::statisticsValue<T>(lo);
+      const auto hiVal = impl::statisticsValue<T>(hi);
+      if (loVal && hiVal)
+      {
+         res.mLo = loVal->key;
+         res.mHi = hiVal->key;
+      }
+      return res;
+   }
+
+   // strings and bytes starting with prefix (blocks are not skipped by these)
+   template <typename T>
+   static FieldPredicate startsWith(int fieldNo, std::string_view prefix)
+   {
+      static_assert(impl::statisticsKind<T>() == StatisticsKind::Bytes, "Only strings and bytes have a prefix");
+      FieldPredicate res{fieldNo, impl::statisticsKind<T>(), impl::FieldReader::of<T>()};
+      res.mLo = 0;
+      res.mHi = std::numeric_limits<std::uint64_t>::max();
+      res.mBytes = prefix;
+      res.mPrefix = true;
+      return res;
+   }
+
+   template <typename T>
+   static FieldPredicate less(int fieldNo, typename T::CppType value)
+   {
+      return lessEqual<T>(fieldNo, value).withoutBound(true);
+   }
+
+   template <typename T>
+   static FieldPredicate lessEqual(int fieldNo, typename T::CppType value)
+   {
+      auto res = between<T>(fieldNo, value, value);
+      if (res.mLo <= res.mHi)
+         res.mLo = 0;
+      return res;
+   }
+
+   template <typename T>
+   static FieldPredicate greater(int fieldNo, typename T::CppType value)
+   {
+      return greaterEqual<T>(fieldNo, value).withoutBound(false);
+   }
+
+   template <typename T>
+   static FieldPredicate greaterEqual(int fieldNo, typename T::CppType value)
+   {
+      auto res = between<T>(fieldNo, value, value);
+      if (res.mLo <= res.mHi)
+         res.mHi = std::numeric_limits<std::uint64_t>::max();
+      return res;
+   }
+
+   int fieldNo() const
+   {
+      return mFieldNo;
+   }
+
+   // False, if the statistics of a block rule out matching records
+   bool mayMatch(DataSpan blockStatistics) const
+   {
+      if (mLo > mHi)
+         return false;
+      if (blockStatistics.empty())
+         return true;
+      const auto stats = impl::findFieldStatistics(blockStatistics, mFieldNo);
+      if (!stats || stats->kind != mKind)
+         return true;
+      if (stats->flags & impl::FieldStatistics::NoValues)
+         return false;
+      if ((stats->flags & impl::FieldStatistics::HasMinMax) && (mHi < stats->min || mLo > stats->max))
+         return false;
+      if ((stats->flags & impl::FieldStatistics::HasBloomFilter) && mLo == mHi)
+         return stats->mayContain(impl::bloomHash(mKind, mLo));
+      return true;
+   }
+
+   template <ParserMode mode>
+   bool matches(const BinMessageView<mode>& record) const
+   {
+      const auto val = mReader(record, mFieldNo);
+      if (!val || val->key < mLo || val->key > mHi)
+         return false;
+      if (mKind != StatisticsKind::Bytes)
+         return true;
+      return mPrefix ? val->bytes.substr(0, mBytes.size()) == mBytes : val->bytes == mBytes;
+   }
+
+ private:
+   int mFieldNo;
+   StatisticsKind mKind;
+   impl::FieldReader mReader;
+   // range of the keys (lo > hi: matches nothing)
+   std::uint64_t mLo = 1;
+   std::uint64_t mHi = 0;
+   // value compared with strings and bytes
+   std::string mBytes;
+   // mBytes is a prefix of the matching values
+   bool mPrefix = false;
+
+   FieldPredicate(int fieldNo, StatisticsKind kind, impl::FieldReader reader)
+      : mFieldNo(fieldNo), mKind(kind), mReader(reader)
+   {
+   }
+
+   // removes the value itself from the range (of a predicate ending or starting at it)
+   FieldPredicate withoutBound(bool upper) const
+   {
+      auto res = *this;
+      if (res.mLo > res.mHi)
+         return res;
+      if (upper)
+      {
+         if (res.mHi == 0)
+            res.mLo = 1;
+         else
+            res.mHi--;
+      }
+      else
+      {
+         if (res.mLo == std::numeric_limits<std::uint64_t>::max())
+         {
+            res.mLo = 1;
+            res.mHi = 0;
+         }
+         else
+            res.mLo++;
+      }
+      return res;
+   }
+};
+
+} // namespace pbview
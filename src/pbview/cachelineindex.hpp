@@ -0,0 +1,263 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace pbview
+{
+
+// Side index over a serialized buffer, that stores the number of the first field starting in each
+// 64 byte cache-line. Lookups binary-search the line that has to contain the requested field and
+// only parse the fields from there on (instead of all fields before the requested one).
+//
+// The index is built once per buffer and shared by all views over this buffer (it has to outlive them).
+// The table of the top-level message is built by the constructor, the tables of sub-messages are
+// built on their first use (the wire format does not tell, which length delimited fields are messages).
+// Messages of at most lineSize bytes get no table, they are scanned. So the tables need at most
+// 8 bytes per line and nesting level of the buffer.
+//
+// As in ParserMode::Fast, the fields of the messages are expected to be ordered by field number.
+class CacheLineIndex
+{
+ public:
+   static constexpr std::size_t lineSize = 64;
+
+   struct Entry
+   {
+      std::uint32_t firstFieldNo;
+      // offset of the tag relative to the beginning of the message
+      std::uint32_t offset;
+   };
+
+   using Table = std::vector<Entry>;
+
+   explicit CacheLineIndex(DataSpan buffer)
+      : mBuffer(buffer)
+   {
+      std::size_t buckets = 64;
+      while (buckets < buffer.size() / 1024 && buckets < (std::size_t{1} << 16))
+         buckets *= 2;
+      mBuckets = std::make_unique<std::atomic<Node*>[]>(buckets);
+      mBucketShift = 64 - static_cast<unsigned>(__builtin_ctzll(buckets));
+      tableFor(buffer);
+   }
+
+   CacheLineIndex(const CacheLineIndex&) = delete;
+   CacheLineIndex& operator=(const CacheLineIndex&) = delete;
+
+   ~CacheLineIndex()
+   {
+      for (std::size_t i = 0; i < (std::size_t{1} << (64 - mBucketShift)); i++)
+      {
+         auto node = mBuckets[i].load(std::memory_order_relaxed);
+         while (node)
+            delete std::exchange(node, node->next);
+      }
+   }
+
+   DataSpan buffer() const
+   {
+      return mBuffer;
+   }
+
+   // The table of a (sub-)message within the buffer, nullptr for messages of at most lineSize bytes.
+   // Thread-safe and lock-free: a table is published once and never changed, threads that build
+   // the same table at once keep the first one.
+   const Table* tableFor(DataSpan message) const
+   {
+      impl::enforce(message.data() >= mBuffer.data() && message.data() + message.size() <= mBuffer.data() + mBuffer.size(),
+                    "Message is not part of the indexed buffer");
+      impl::enforce(message.size() < std::numeric_limits<std::uint32_t>::max(), "Message is too large to be indexed");
+      if (message.size() <= lineSize)
+         return nullptr;
+
+      const auto offset = static_cast<std::size_t>(message.data() - mBuffer.data());
+      auto& bucket = mBuckets[(offset * 0x9e3779b97f4a7c15ull) >> mBucketShift];
+      auto head = bucket.load(std::memory_order_acquire);
+      if (auto node = find(head, nullptr, offset, message.size()))
+         return &node->table;
+
+      auto node = std::make_unique<Node>(Node{offset, message.size(), buildTable(message), head});
+      while (!bucket.compare_exchange_weak(node->next, node.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+         // only the nodes inserted since the last attempt have to be checked
+         if (auto other = find(node->next, head, offset, message.size()))
+            return &other->table;
+         head = node->next;
+      }
+      return &node.release()->table;
+   }
+
+   // The position from which on fieldNo has to be searched in message.
+   static DataSpan startFor(const Table& table, DataSpan message, int fieldNo)
+   {
+      // the last line starting with a lower field number (earlier occurrences of the field may be contained in this line)
+      auto it = std::lower_bound(table.begin(), table.end(), fieldNo,
+                                 [](const Entry& e, int no) { return static_cast<int>(e.firstFieldNo) < no; });
+      if (it == table.begin())
+         return message;
+      return message.substr(std::prev(it)->offset);
+   }
+
+ private:
+   using Reader = BinMessageView<ParserMode::Fast>;
+
+   // a table in the list of a hash bucket, nodes are only added at the head
+   struct Node
+   {
+      std::size_t offset;
+      std::size_t size;
+      Table table;
+      Node* next;
+   };
+
+   // the node of a message in the list from node up to (excluding) end
+   static const Node* find(const Node* node, const Node* end, std::size_t offset, std::size_t size)
+   {
+      for (; node != end; node = node->next)
+      {
+         if (node->offset == offset && node->size == size)
+            return node;
+      }
+      return nullptr;
+   }
+
+   Table buildTable(DataSpan message) const
+   {
+      Table table;
+      auto lastLine = std::numeric_limits<std::size_t>::max();
+      auto bin = message;
+
+      while (true)
+      {
+         const auto offset = static_cast<std::uint32_t>(bin.data() - message.data());
+         const auto tag = Reader::popTag(bin);
+         if (!tag)
+            break;
+
+         const auto line = static_cast<std::size_t>(message.data() + offset - mBuffer.data()) / lineSize;
+         if (line != lastLine)
+         {
+            table.push_back(Entry{tag >> 3, offset});
+            lastLine = line;
+         }
+
+         constexpr uint32_t WireTypeBitMask = 0b111;
+         Reader::skipValue(bin, WireType{tag & WireTypeBitMask});
+      }
+
+      return table;
+   }
+
+   DataSpan mBuffer;
+   std::unique_ptr<std::atomic<Node*>[]> mBuckets;
+   unsigned mBucketShift;
+};
+
+// BinView that uses a CacheLineIndex to seek to the requested fields.
+// Sub-message views of the generated classes share the index of their parent view.
+// Without index (or in ParserMode::StrictConforming) it behaves like BinMessageView.
+template <ParserMode mode = ParserMode::Fast>
+struct CacheLineIndexedBinMessageView
+{
+   DataSpan bytes;
+
+   explicit CacheLineIndexedBinMessageView(DataSpan span) : bytes(span)
+   {
+   }
+
+   CacheLineIndexedBinMessageView(DataSpan span, const CacheLineIndex& index)
+      : bytes(span), mIndex(&index)
+   {
+      if constexpr (mode != ParserMode::StrictConforming)
+         mTable = index.tableFor(span);
+   }
+
+   static CacheLineIndexedBinMessageView fromIndex(const CacheLineIndex& index)
+   {
+      return CacheLineIndexedBinMessageView{index.buffer(), index};
+   }
+
+ private:
+   using Reader = BinMessageView<mode>;
+
+   const CacheLineIndex* mIndex = nullptr;
+   // nullptr without index and for small messages, which are scanned
+   const CacheLineIndex::Table* mTable = nullptr;
+
+   // the sub-message bytes, so that the index can be passed on
+   struct SubMessageBytes
+   {
+      using CppType = DataSpan;
+      static constexpr auto serialization = Serialization::LengthDelimited;
+   };
+
+   template <typename T>
+   static constexpr bool isIndexedSubView = std::is_constructible_v<typename T::CppType, CacheLineIndexedBinMessageView>;
+
+   Reader readerFor(int fieldNo) const
+   {
+      if (!mTable)
+         return Reader{bytes};
+      return Reader{CacheLineIndex::startFor(*mTable, bytes, fieldNo)};
+   }
+
+ public:
+   bool has(int fieldNo) const
+   {
+      return readerFor(fieldNo).has(fieldNo);
+   }
+
+   template <typename T>
+   auto get(int fieldNo) const -> typename std::optional<typename T::CppType>
+   {
+      if constexpr (isIndexedSubView<T>)
+      {
+         if (mIndex)
+         {
+            if (auto sub = readerFor(fieldNo).template get<SubMessageBytes>(fieldNo))
+               return typename T::CppType{CacheLineIndexedBinMessageView{*sub, *mIndex}};
+            return {};
+         }
+      }
+
+      return readerFor(fieldNo).template get<T>(fieldNo);
+   }
+
+   template <typename T>
+   auto getRepeated(int fieldNo) const
+   {
+      if constexpr (isIndexedSubView<T>)
+      {
+         auto index = mIndex;
+         return readerFor(fieldNo).template getRepeated<SubMessageBytes>(fieldNo)
+            | ranges::view::transform([index](DataSpan sub) {
+                 if (index)
+                    return typename T::CppType{CacheLineIndexedBinMessageView{sub, *index}};
+                 return typename T::CppType{sub};
+              });
+      }
+      else
+         return readerFor(fieldNo).template getRepeated<T>(fieldNo);
+   }
+
+   template <typename T>
+   auto getPackedRepeated(int fieldNo) const
+   {
+      return readerFor(fieldNo).template getPackedRepeated<T>(fieldNo);
+   }
+};
+
+template <typename T, ParserMode parserMode>
+T deserialize(const CacheLineIndexedBinMessageView<parserMode>& msgView)
+{
+   return deserialize<T>(BinMessageView<parserMode>{msgView.bytes});
+}
+
+} // namespace pbview
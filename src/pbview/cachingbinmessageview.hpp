@@ -0,0 +1,331 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <limits>
+
+namespace pbview
+{
+
+// Remembers the offsets of all tags that were passed while seeking a field and the
+// position at which seeking stopped. Later lookups either jump directly to a known
+// offset or resume scanning at this position instead of the beginning of the message.
+//
+// The cache is allocated by the second lookup (the first one is done by the uncached parser),
+// so views that are read at most once (e.g. default constructed views or most sub-message views)
+// don't allocate. Copies of a view share its cache, if it already exists (copying costs one
+// reference count increment).
+// Concurrent readers are allowed: all cache entries are atomics and as the offsets are
+// determined by the (immutable) message, racing writers always store the same values.
+template <ParserMode mode = ParserMode::Fast>
+struct CachingBinMessageView
+{
+   DataSpan bytes;
+
+   explicit CachingBinMessageView(DataSpan span)
+      : bytes(span)
+   {
+      if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+         impl::enforce(bytes.size() < std::numeric_limits<std::uint32_t>::max(), "Message is too large to be cached");
+   }
+
+   CachingBinMessageView(const CachingBinMessageView& other)
+      : bytes(other.bytes), mCache(addReference(other.mCache.load(std::memory_order_acquire))),
+        mLookedUp(other.mLookedUp.load(std::memory_order_relaxed))
+   {}
+
+   CachingBinMessageView(CachingBinMessageView&& other) noexcept
+      : bytes(other.bytes), mCache(other.takeCache()), mLookedUp(other.mLookedUp.load(std::memory_order_relaxed))
+   {}
+
+   CachingBinMessageView& operator=(const CachingBinMessageView& other)
+   {
+      auto cache = addReference(other.mCache.load(std::memory_order_acquire));
+      bytes = other.bytes;
+      release(takeCache());
+      mCache.store(cache, std::memory_order_relaxed);
+      mLookedUp.store(other.mLookedUp.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+   }
+
+   CachingBinMessageView& operator=(CachingBinMessageView&& other) noexcept
+   {
+      auto cache = other.takeCache();
+      bytes = other.bytes;
+      release(takeCache());
+      mCache.store(cache, std::memory_order_relaxed);
+      mLookedUp.store(other.mLookedUp.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+   }
+
+   ~CachingBinMessageView()
+   {
+      release(mCache.load(std::memory_order_relaxed));
+   }
+
+   static CachingBinMessageView fromBytesString(std::string_view sv)
+   {
+      return CachingBinMessageView{DataSpan{reinterpret_cast<const std::byte *>(sv.data()), sv.size()}};
+   }
+
+ private:
+   using Reader = BinMessageView<mode>;
+
+   struct Cache
+   {
+      // only fields with lower field numbers are cached, all others are looked up by the uncached parser
+      static constexpr int cachedFieldCount = 64;
+
+      // all tags before the offset in the upper 32 bits are stored in firstTag and lastTag,
+      // the lower 32 bits hold the highest field number in front of this offset
+      std::atomic<std::uint64_t> scanState{0};
+      // offsets of the tags + 1 (0 is used for 'unknown')
+      std::array<std::atomic<std::uint32_t>, cachedFieldCount> firstTag{};
+      std::array<std::atomic<std::uint32_t>, cachedFieldCount> lastTag{};
+
+      std::atomic<std::uint32_t> references{1};
+   };
+
+   // reference counted, nullptr until the second lookup
+   mutable std::atomic<Cache*> mCache{nullptr};
+   mutable std::atomic<bool> mLookedUp{false};
+
+   static Cache* addReference(Cache* cache)
+   {
+      if (cache)
+         cache->references.fetch_add(1, std::memory_order_relaxed);
+      return cache;
+   }
+
+   static void release(Cache* cache)
+   {
+      if (cache && cache->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+         delete cache;
+   }
+
+   // no atomic read-modify-write: moved from and assigned views must not be read concurrently
+   Cache* takeCache()
+   {
+      auto cache = mCache.load(std::memory_order_relaxed);
+      mCache.store(nullptr, std::memory_order_relaxed);
+      return cache;
+   }
+
+   Cache& cache() const
+   {
+      if (auto cache = mCache.load(std::memory_order_acquire))
+         return *cache;
+      return allocateCache();
+   }
+
+   Cache& allocateCache() const
+   {
+      auto cache = std::make_unique<Cache>();
+      Cache* current = nullptr;
+      if (mCache.compare_exchange_strong(current, cache.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+         return *cache.release();
+      // allocated by a concurrent reader
+      return *current;
+   }
+
+   static void storeMin(std::atomic<std::uint32_t>& target, std::uint32_t val)
+   {
+      auto current = target.load(std::memory_order_relaxed);
+      while ((current == 0 || current > val) && !target.compare_exchange_weak(current, val, std::memory_order_relaxed))
+      {}
+   }
+
+   template <typename Int>
+   static void storeMax(std::atomic<Int>& target, Int val, std::memory_order order)
+   {
+      auto current = target.load(std::memory_order_relaxed);
+      while (current < val && !target.compare_exchange_weak(current, val, order, std::memory_order_relaxed))
+      {}
+   }
+
+   bool fullyScanned() const
+   {
+      return (cache().scanState.load(std::memory_order_acquire) >> 32) == bytes.size();
+   }
+
+   // Continues scanning at the furthest known position until fieldNo was found.
+   // StrictConforming always scans up to the end of the message (the last occurrence of a field is relevant).
+   // The fast modes only store the first tags, that the uncached parser finds (it stops at higher field numbers).
+   void scanFor(int fieldNo) const
+   {
+      auto& cache = this->cache();
+      const auto state = cache.scanState.load(std::memory_order_acquire);
+      int highestFieldNo = static_cast<int>(state & std::numeric_limits<std::uint32_t>::max());
+
+      if constexpr (mode != ParserMode::StrictConforming)
+      {
+         // fields below a higher one are not found anymore
+         if (highestFieldNo > fieldNo)
+            return;
+      }
+
+      auto bin = bytes.substr(static_cast<std::uint32_t>(state >> 32));
+      auto offsetOf = [this](DataSpan pos) { return static_cast<std::uint32_t>(pos.data() - bytes.data()); };
+
+      auto end = static_cast<std::uint32_t>(bytes.size());
+      while (true)
+      {
+         const auto tagOffset = offsetOf(bin);
+         const auto tag = Reader::popTag(bin);
+         if (!tag)
+            break;
+
+         const int currentFieldNumber = tag >> 3;
+         constexpr uint32_t WireTypeBitMask = 0b111;
+         const WireType type{tag & WireTypeBitMask};
+
+         if (currentFieldNumber < Cache::cachedFieldCount)
+         {
+            if (mode == ParserMode::StrictConforming || currentFieldNumber >= highestFieldNo)
+               storeMin(cache.firstTag[currentFieldNumber], tagOffset + 1);
+            storeMax(cache.lastTag[currentFieldNumber], tagOffset + 1, std::memory_order_relaxed);
+         }
+
+         if constexpr (mode != ParserMode::StrictConforming)
+         {
+            // the field is stored in the cache, but has to be read again on resuming (fields are expected in sorted order)
+            if (currentFieldNumber > fieldNo)
+            {
+               end = tagOffset;
+               break;
+            }
+         }
+
+         highestFieldNo = std::max(highestFieldNo, currentFieldNumber);
+         Reader::skipValue(bin, type);
+
+         if constexpr (mode != ParserMode::StrictConforming)
+         {
+            if (currentFieldNumber == fieldNo)
+            {
+               end = offsetOf(bin);
+               break;
+            }
+         }
+      }
+
+      // the highest field number only grows with the offset, so racing scanners store consistent states
+      storeMax(cache.scanState, static_cast<std::uint64_t>(end) << 32 | static_cast<std::uint32_t>(highestFieldNo), std::memory_order_release);
+   }
+
+   static std::atomic<std::uint32_t>& tagEntry(Cache& cache, int fieldNo, bool first)
+   {
+      return first ? cache.firstTag[fieldNo] : cache.lastTag[fieldNo];
+   }
+
+   // offset of the first tag (first == true) or the last tag of the given field, if it exists
+   std::optional<std::uint32_t> tagOffset(int fieldNo, bool first) const
+   {
+      if constexpr (mode != ParserMode::StrictConforming)
+      {
+         if (auto cache = mCache.load(std::memory_order_acquire))
+         {
+            if (auto offset = tagEntry(*cache, fieldNo, first).load(std::memory_order_relaxed))
+               return offset - 1;
+         }
+      }
+
+      return scannedTagOffset(fieldNo, first);
+   }
+
+   // kept out of line, so that the lookup of known offsets above is inlined
+   PBVIEW_NOINLINE std::optional<std::uint32_t> scannedTagOffset(int fieldNo, bool first) const
+   {
+      auto& entry = tagEntry(cache(), fieldNo, first);
+
+      if (!fullyScanned())
+         scanFor(fieldNo);
+
+      if (auto offset = entry.load(std::memory_order_relaxed))
+         return offset - 1;
+      return {};
+   }
+
+   static bool cached(int fieldNo)
+   {
+      return fieldNo >= 0 && fieldNo < Cache::cachedFieldCount;
+   }
+
+   bool uncachedLookup(int fieldNo) const
+   {
+      if (!cached(fieldNo))
+         return true;
+
+      if (mCache.load(std::memory_order_relaxed) || mLookedUp.load(std::memory_order_relaxed))
+         return false;
+      mLookedUp.store(true, std::memory_order_relaxed);
+      return true;
+   }
+
+   DataSpan fromFirstTag(int fieldNo) const
+   {
+      if (auto offset = tagOffset(fieldNo, true))
+         return bytes.substr(*offset);
+      return {};
+   }
+
+ public:
+   bool has(int fieldNo) const
+   {
+      if (uncachedLookup(fieldNo))
+         return Reader{bytes}.has(fieldNo);
+
+      return tagOffset(fieldNo, true) != std::nullopt;
+   }
+
+   template <typename T>
+   auto get(int fieldNo) const -> typename std::optional<typename T::CppType>
+   {
+      if (uncachedLookup(fieldNo))
+         return Reader{bytes}.template get<T>(fieldNo);
+
+      const bool first = mode != ParserMode::StrictConforming;
+      if (auto offset = tagOffset(fieldNo, first))
+      {
+         auto bin = bytes.substr(*offset);
+         const auto tag = Reader::popTag(bin);
+         constexpr uint32_t WireTypeBitMask = 0b111;
+         if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+            impl::enforce(WireType{tag & WireTypeBitMask} == Reader::template wireTypeOf<T>(), "Invalid wire type!");
+
+         return Reader::template popNextValue<T>(bin);
+      }
+
+      return {};
+   }
+
+   template <typename T>
+   auto getRepeated(int fieldNo) const
+   {
+      if (uncachedLookup(fieldNo))
+         return Reader{bytes}.template getRepeated<T>(fieldNo);
+
+      return typename Reader::template Repeated<T>(fromFirstTag(fieldNo), fieldNo);
+   }
+
+   template <typename T>
+   auto getPackedRepeated(int fieldNo) const
+   {
+      if (uncachedLookup(fieldNo))
+         return Reader{bytes}.template getPackedRepeated<T>(fieldNo);
+
+      return typename Reader::template PackedRepeated<T>(fromFirstTag(fieldNo), fieldNo);
+   }
+};
+
+template <typename T, ParserMode parserMode>
+T deserialize(const CachingBinMessageView<parserMode>& msgView)
+{
+   return deserialize<T>(BinMessageView<parserMode>{msgView.bytes});
+}
+
+} // namespace pbview
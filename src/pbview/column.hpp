@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace pbview
+{
+
+// Values of one field of many messages, with a validity bitmap (bit i of validity[i / 64]) for
+// messages without the field. Values of missing fields are value-initialized. Strings and bytes
+// are views into the messages.
+template <typename T>
+struct Column
+{
+   using CppType = typename T::CppType;
+
+   std::vector<CppType> values;
+   std::vector<std::uint64_t> validity;
+
+   std::size_t size() const
+   {
+      return values.size();
+   }
+
+   bool valid(std::size_t idx) const
+   {
+      return (validity[idx / 64] >> (idx % 64)) & 1;
+   }
+
+   // number of messages with the field
+   std::size_t validCount() const
+   {
+      std::size_t res = 0;
+      for (auto word : validity)
+         res += static_cast<std::size_t>(__builtin_popcountll(word));
+      return res;
+   }
+
+   void resize(std::size_t size)
+   {
+      values.resize(size);
+      validity.resize((size + 63) / 64);
+   }
+
+   void set(std::size_t idx, std::optional<CppType> val)
+   {
+      if (val)
+      {
+         values[idx] = *val;
+         validity[idx / 64] |= std::uint64_t{1} << (idx % 64);
+      }
+   }
+
+   void append(std::optional<CppType> val)
+   {
+      const auto idx = values.size();
+      if (idx % 64 == 0)
+         validity.push_back(0);
+      values.emplace_back();
+      set(idx, std::move(val));
+   }
+};
+
+} // namespace pbview
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "binmessageview.hpp"
+#include "column.hpp"
+#include "workstealingpool.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace pbview
+{
+
+struct ColumnOptions
+{
+   // number of threads of the internal pool (0: one per hardware thread), ignored if pool is set
+   std::size_t threadCount = 0;
+   // messages extracted by one task (rounded up to a multiple of 64), fewer messages are
+   // extracted on the calling thread
+   std::size_t chunkSize = 16384;
+   // existing pool to run the tasks on
+   WorkStealingPool* pool = nullptr;
+};
+
+namespace impl
+{
+   // calls f(begin, end) for ranges of messages, chunks start at multiples of 64, so that no two
+   // tasks write to the same word of a validity bitmap
+   template <typename F>
+   void forEachColumnChunk(std::size_t size, const ColumnOptions& options, F&& f)
+   {
+      const auto chunkSize = std::max<std::size_t>((options.chunkSize + 63) / 64 * 64, 64);
+      if (size <= chunkSize)
+      {
+         f(std::size_t{0}, size);
+         return;
+      }
+
+      std::unique_ptr<WorkStealingPool> ownPool;
+      auto* pool = options.pool;
+      if (!pool)
+      {
+         ownPool = std::make_unique<WorkStealingPool>(options.threadCount ? options.threadCount : WorkStealingPool::defaultThreadCount());
+         pool = ownPool.get();
+      }
+      for (std::size_t begin = 0; begin < size; begin += chunkSize)
+         pool->submit([&f, begin, end = std::min(begin + chunkSize, size)](std::size_t) { f(begin, end); });
+      pool->wait();
+   }
+}
+
+// Extracts the field fieldNo of all messages into a column, the batch counterpart of
+// BinMessageView::get() (see impl::FieldReader for which value of a repeated field is read):
+//   auto prices = extractColumn<type::Int64>(messages, 4);
+//   auto strictPrices = extractColumn<ParserMode::StrictConforming, type::Int64>(messages, 4);
+// Large batches are extracted in parallel (see ColumnOptions).
+template <ParserMode mode, typename T>
+Column<T> extractColumn(const std::vector<DataSpan>& messages, int fieldNo, ColumnOptions options = {})
+{
+   Column<T> res;
+   res.resize(messages.size());
+   impl::forEachColumnChunk(messages.size(), options, [&](std::size_t begin, std::size_t end) {
+      for (auto i = begin; i < end; i++)
+         res.set(i, BinMessageView<mode>{messages[i]}.template get<T>(fieldNo));
+   });
+   return res;
+}
+
+template <typename T>
+Column<T> extractColumn(const std::vector<DataSpan>& messages, int fieldNo, ColumnOptions options = {})
+{
+   return extractColumn<ParserMode::Fast, T>(messages, fieldNo, std::move(options));
+}
+
+namespace impl
+{
+   template <typename Columns, typename Values, std::size_t... I>
+   void setColumns(Columns& columns, Values& values, std::size_t idx, std::index_sequence<I...>)
+   {
+      (std::get<I>(columns).set(idx, std::get<I>(values)), ...);
+   }
+}
+
+// Extracts several fields of all messages into one column per field, reading all fields of a
+// message in one pass (see BinMessageView::getMany()):
+//   auto [ids, names] = extractColumns<Field<type::Int32, 2>, Field<type::String, 7>>(messages);
+//   auto [ids] = extractColumns<ParserMode::StrictConforming, Field<type::Int32, 2>>(messages);
+template <ParserMode mode, typename... Fields>
+std::tuple<Column<typename Fields::Type>...> extractColumns(const std::vector<DataSpan>& messages, ColumnOptions options = {})
+{
+   std::tuple<Column<typename Fields::Type>...> res;
+   std::apply([&](auto&... columns) { (columns.resize(messages.size()), ...); }, res);
+   impl::forEachColumnChunk(messages.size(), options, [&](std::size_t begin, std::size_t end) {
+      for (auto i = begin; i < end; i++)
+      {
+         auto values = BinMessageView<mode>{messages[i]}.template getMany<Fields...>();
+         impl::setColumns(res, values, i, std::index_sequence_for<Fields...>{});
+      }
+   });
+   return res;
+}
+
+template <typename... Fields>
+std::tuple<Column<typename Fields::Type>...> extractColumns(const std::vector<DataSpan>& messages, ColumnOptions options = {})
+{
+   return extractColumns<ParserMode::Fast, Fields...>(messages, std::move(options));
+}
+
+} // namespace pbview
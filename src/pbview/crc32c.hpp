@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PBVIEW_X86_CRC32C 1
+#include <immintrin.h>
+#endif
+
+namespace pbview
+{
+namespace impl
+{
+
+// CRC-32C (Castagnoli) table for the bytewise fallback
+inline const std::array<std::uint32_t, 256>& crc32cTable()
+{
+   static const auto table = [] {
+      std::array<std::uint32_t, 256> res{};
+      for (std::uint32_t i = 0; i < 256; i++)
+      {
+         auto crc = i;
+         for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78u : 0u);
+         res[i] = crc;
+      }
+      return res;
+   }();
+   return table;
+}
+
+inline std::uint32_t crc32cScalar(std::uint32_t crc, const std::uint8_t* p, std::size_t size)
+{
+   const auto& table = crc32cTable();
+   for (std::size_t i = 0; i < size; i++)
+      crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+   return crc;
+}
+
+#ifdef PBVIEW_X86_CRC32C
+__attribute__((target("sse4.2"))) inline std::uint32_t crc32cSse42(std::uint32_t crc, const std::uint8_t* p, std::size_t size)
+{
+#ifdef __x86_64__
+   std::uint64_t crc64 = crc;
+   for (; size >= 8; size -= 8, p += 8)
+   {
+      std::uint64_t word;
+      memcpy(&word, p, sizeof(word));
+      crc64 = _mm_crc32_u64(crc64, word);
+   }
+   crc = static_cast<std::uint32_t>(crc64);
+#endif
+   for (; size > 0; size--, p++)
+      crc = _mm_crc32_u8(crc, *p);
+   return crc;
+}
+#endif
+
+// CRC-32C of data (pass the result of a previous call as crc to continue a checksum).
+// Uses the crc32 instruction of SSE4.2 if the CPU supports it.
+inline std::uint32_t crc32c(const std::byte* data, std::size_t size, std::uint32_t crc = 0)
+{
+   auto p = reinterpret_cast<const std::uint8_t*>(data);
+#ifdef PBVIEW_X86_CRC32C
+   static const bool hasSse42 = [] {
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse4.2");
+   }();
+   if (hasSse42)
+      return ~crc32cSse42(~crc, p, size);
+#endif
+   return ~crc32cScalar(~crc, p, size);
+}
+
+} // namespace impl
+} // namespace pbview
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace pbview
+{
+
+// Reads a stream of length delimited messages (as written by SerializeDelimitedToOstream or
+// SerializeDelimitedToZeroCopyStream) from any ZeroCopyInputStream, e.g. a GzipInputStream.
+//
+// Records inside one buffer of the stream are returned without copying. Records crossing buffer
+// borders are copied into a buffer, that is reused for all records. So memory usage is bounded
+// by the size of the largest record, independent of the size of the stream.
+//
+// A returned view is only valid until the next call of next() (the stream may reuse its buffers).
+template <ParserMode parserMode = ParserMode::Fast>
+class DelimitedStreamReader
+{
+ public:
+   using BinView = BinMessageView<parserMode>;
+
+   static constexpr std::size_t defaultMaxRecordSize = 64 << 20;
+
+   explicit DelimitedStreamReader(google::protobuf::io::ZeroCopyInputStream& input, std::size_t maxRecordSize = defaultMaxRecordSize)
+      : mInput(input), mMaxRecordSize(maxRecordSize)
+   {
+   }
+
+   DelimitedStreamReader(const DelimitedStreamReader&) = delete;
+   DelimitedStreamReader& operator=(const DelimitedStreamReader&) = delete;
+
+   // Returns the unread part of the current buffer to the stream
+   ~DelimitedStreamReader()
+   {
+      if (!mChunk.empty())
+         mInput.BackUp(static_cast<int>(mChunk.size()));
+   }
+
+   // The next record or std::nullopt at the end of the stream.
+   // Throws if the stream ends within a record.
+   std::optional<BinView> next()
+   {
+      if (mChunk.empty() && !refill())
+         return std::nullopt;
+
+      const auto len = popLength();
+      impl::enforce(len <= mMaxRecordSize, "Record is larger than the maximal record size");
+      mRecordCount++;
+
+      if (len <= mChunk.size())
+      {
+         auto record = mChunk.substr(0, len);
+         mChunk.remove_prefix(len);
+         return BinView{record};
+      }
+
+      mStitchedCount++;
+      mBuffer.clear();
+      mBuffer.reserve(len);
+      while (true)
+      {
+         const auto part = mChunk.substr(0, len - mBuffer.size());
+         mBuffer.insert(mBuffer.end(), part.begin(), part.end());
+         mChunk.remove_prefix(part.size());
+         if (mBuffer.size() == len)
+            break;
+         impl::enforce(refill(), "Stream ended within a record");
+      }
+      return BinView{DataSpan{mBuffer.data(), mBuffer.size()}};
+   }
+
+   // The next record as generated view
+   template <typename Msg>
+   std::optional<View<Msg, BinView>> next()
+   {
+      if (auto record = next())
+         return View<Msg, BinView>{*record};
+      return std::nullopt;
+   }
+
+   // Calls f(BinView) for all remaining records
+   template <typename F>
+   void forEach(F&& f)
+   {
+      while (auto record = next())
+         f(*record);
+   }
+
+   // Number of records read so far
+   std::size_t recordCount() const
+   {
+      return mRecordCount;
+   }
+
+   // Number of records, that crossed buffer borders and had to be copied
+   std::size_t stitchedCount() const
+   {
+      return mStitchedCount;
+   }
+
+   // Capacity of the buffer for stitching records
+   std::size_t bufferCapacity() const
+   {
+      return mBuffer.capacity();
+   }
+
+ private:
+   google::protobuf::io::ZeroCopyInputStream& mInput;
+   std::size_t mMaxRecordSize;
+
+   // unread part of the last buffer returned by mInput
+   DataSpan mChunk;
+   std::vector<std::byte> mBuffer;
+
+   std::size_t mRecordCount = 0;
+   std::size_t mStitchedCount = 0;
+
+   bool refill()
+   {
+      const void* data;
+      int size;
+      do
+      {
+         if (!mInput.Next(&data, &size))
+            return false;
+      } while (size == 0);
+      mChunk = DataSpan{static_cast<const std::byte*>(data), static_cast<std::size_t>(size)};
+      return true;
+   }
+
+   // reads the varint length prefix, that may cross buffer borders
+   std::uint64_t popLength()
+   {
+      std::uint64_t res = 0;
+      for (int shift = 0; shift < 64; shift += 7)
+      {
+         if (mChunk.empty())
+            impl::enforce(refill(), "Stream ended within the length of a record");
+         const auto c = static_cast<std::uint8_t>(mChunk.front());
+         mChunk.remove_prefix(1);
+         res |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+         if (!(c & 0x80))
+            return res;
+      }
+      throw std::runtime_error{"Invalid length of a record"};
+   }
+};
+
+} // namespace pbview
@@ -0,0 +1,360 @@
+#pragma once
+
+#include "blockstatistics.hpp"
+#include "losertree.hpp"
+#include "mappedrecordfile.hpp"
+#include "sortkey.hpp"
+#include "workstealingpool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace pbview
+{
+
+struct ExternalSortOptions
+{
+   // approximate memory for one run: the bytes of its records (read from the mapped input file)
+   // plus their keys and offsets
+   std::size_t memoryLimit = std::size_t{1} << 30;
+   // directory for the temporary files of the runs
+   std::string tempDirectory = "/tmp";
+   // number of threads of the internal pool (0: one per hardware thread), ignored if pool is set
+   std::size_t threadCount = 0;
+   // existing pool for building and sorting the keys of a run
+   WorkStealingPool* pool = nullptr;
+};
+
+struct ExternalSortStats
+{
+   std::uint64_t records = 0;
+   // size of the input file
+   std::uint64_t bytes = 0;
+   // sorted runs (written to temporary files, if there is more than one)
+   std::uint64_t runs = 0;
+   double seconds = 0;
+
+   double megabytesPerSecond() const
+   {
+      return seconds > 0 ? static_cast<double>(bytes) / 1e6 / seconds : 0;
+   }
+};
+
+namespace impl
+{
+   // A record of a run, with its sort key in the keys of its chunk
+   struct SortEntry
+   {
+      // the first 8 bytes of the key (big endian, padded with zeros), to compare without indirection
+      std::uint64_t prefix;
+      std::uint64_t keyOffset;
+      // position of the message (without length) in the input
+      std::uint64_t recordOffset;
+      std::uint32_t keySize;
+      std::uint32_t recordSize;
+   };
+
+   inline std::uint64_t keyPrefix(std::string_view key)
+   {
+      std::uint64_t res = 0;
+      for (std::size_t i = 0; i < std::min<std::size_t>(key.size(), 8); i++)
+         res |= std::uint64_t{static_cast<std::uint8_t>(key[i])} << (56 - 8 * i);
+      return res;
+   }
+
+   // by key, records with equal keys in the order of the input
+   inline bool entryLess(const SortEntry& a, std::string_view aKey, const SortEntry& b, std::string_view bKey)
+   {
+      if (a.prefix != b.prefix)
+         return a.prefix < b.prefix;
+      if (const auto cmp = aKey.compare(bKey))
+         return cmp < 0;
+      return a.recordOffset < b.recordOffset;
+   }
+
+   // part of a run, whose keys are built and sorted by one task
+   struct SortChunk
+   {
+      std::string keys;
+      std::vector<SortEntry> entries;
+      // position while merging
+      std::size_t pos = 0;
+
+      std::string_view key(const SortEntry& entry) const
+      {
+         return std::string_view{keys}.substr(entry.keyOffset, entry.keySize);
+      }
+   };
+
+   // buffers small writes to a std::ostream, throws errorMessage if writing fails
+   class BufferedOutput
+   {
+    public:
+      BufferedOutput(std::ostream& os, std::string errorMessage, std::size_t capacity = 1 << 20)
+         : mOs(os), mErrorMessage(std::move(errorMessage)), mCapacity(capacity)
+      {
+         mBuffer.reserve(capacity);
+      }
+
+      void write(const void* data, std::size_t size)
+      {
+         if (mBuffer.size() + size > mCapacity)
+            flush();
+         if (size >= mCapacity)
+            writeToStream(data, size);
+         else
+            mBuffer.insert(mBuffer.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+      }
+
+      // writes the length as varint followed by the data
+      void writeDelimited(const void* data, std::size_t size)
+      {
+         std::array<std::byte, 10> len;
+         write(len.data(), block_format::encodeVarint(len.data(), size));
+         write(data, size);
+      }
+
+      void flush()
+      {
+         writeToStream(mBuffer.data(), mBuffer.size());
+         mBuffer.clear();
+         mOs.flush();
+         enforce(mOs.good(), mErrorMessage);
+      }
+
+    private:
+      std::ostream& mOs;
+      std::string mErrorMessage;
+      std::size_t mCapacity;
+      std::vector<char> mBuffer;
+
+      void writeToStream(const void* data, std::size_t size)
+      {
+         mOs.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+         enforce(mOs.good(), mErrorMessage);
+      }
+   };
+
+   // file with a unique name in dir, that is removed on destruction
+   class TempFile
+   {
+    public:
+      explicit TempFile(const std::string& dir, const std::string& prefix = "pbview_sort")
+      {
+         std::string name = dir + "/" + prefix + "_XXXXXX";
+         const int fd = ::mkstemp(name.data());
+         enforce(fd >= 0, "Failed to create a temporary file in " + dir);
+         ::close(fd);
+         mPath = std::move(name);
+      }
+
+      TempFile(const TempFile&) = delete;
+      TempFile& operator=(const TempFile&) = delete;
+
+      ~TempFile()
+      {
+         ::unlink(mPath.c_str());
+      }
+
+      const std::string& path() const
+      {
+         return mPath;
+      }
+
+    private:
+      std::string mPath;
+   };
+
+   // Run in a temporary file: (key, record) pairs, both length delimited
+   class RunReader
+   {
+    public:
+      explicit RunReader(const std::string& path)
+         : mFile(path), mRest(mFile.bytes())
+      {
+      }
+
+      // reads the next record, false at the end of the run
+      bool next()
+      {
+         if (mRest.empty())
+            return false;
+         const auto key = popDelimitedRecord(mRest);
+         mKey = std::string_view{reinterpret_cast<const char*>(key.data()), key.size()};
+         mRecord = popDelimitedRecord(mRest);
+         return true;
+      }
+
+      std::string_view key() const
+      {
+         return mKey;
+      }
+
+      DataSpan record() const
+      {
+         return mRecord;
+      }
+
+    private:
+      MappedFile mFile;
+      DataSpan mRest;
+      std::string_view mKey;
+      DataSpan mRecord;
+   };
+
+   // builds the keys of the records (offset and size in input) and sorts them, in one chunk per thread
+   template <ParserMode mode>
+   std::vector<SortChunk> sortRun(DataSpan input, const std::vector<std::pair<std::uint64_t, std::uint32_t>>& records,
+                                  const SortKeyBuilder& keys, WorkStealingPool& pool)
+   {
+      const auto chunkCount = std::max<std::size_t>(1, std::min(pool.threadCount(), records.size() / 1024));
+      std::vector<SortChunk> chunks(chunkCount);
+      for (std::size_t c = 0; c < chunkCount; c++)
+      {
+         pool.submit([&, c](std::size_t) {
+            auto& chunk = chunks[c];
+            const auto begin = records.size() * c / chunkCount;
+            const auto end = records.size() * (c + 1) / chunkCount;
+            chunk.entries.reserve(end - begin);
+            std::string key;
+            for (auto i = begin; i < end; i++)
+            {
+               const auto [offset, size] = records[i];
+               keys.build(BinMessageView<mode>{input.substr(offset, size)}, key);
+               enforce(key.size() <= std::numeric_limits<std::uint32_t>::max(), "Sort key is too large");
+               chunk.entries.push_back({keyPrefix(key), chunk.keys.size(), offset, static_cast<std::uint32_t>(key.size()), size});
+               chunk.keys += key;
+            }
+            std::sort(chunk.entries.begin(), chunk.entries.end(), [&chunk](const SortEntry& a, const SortEntry& b) {
+               return entryLess(a, chunk.key(a), b, chunk.key(b));
+            });
+         });
+      }
+      pool.wait();
+      return chunks;
+   }
+
+   // calls f(key, record) for the records of the sorted chunks in the order of their keys
+   template <typename F>
+   void mergeChunks(DataSpan input, std::vector<SortChunk>& chunks, F&& f)
+   {
+      std::vector<bool> exhausted;
+      for (const auto& chunk : chunks)
+         exhausted.push_back(chunk.entries.empty());
+      auto less = [&chunks](std::size_t a, std::size_t b) {
+         const auto& entryA = chunks[a].entries[chunks[a].pos];
+         const auto& entryB = chunks[b].entries[chunks[b].pos];
+         return entryLess(entryA, chunks[a].key(entryA), entryB, chunks[b].key(entryB));
+      };
+      for (LoserTree<decltype(less)> tree{chunks.size(), less, std::move(exhausted)}; !tree.empty();)
+      {
+         auto& chunk = chunks[tree.top()];
+         const auto& entry = chunk.entries[chunk.pos];
+         f(chunk.key(entry), input.substr(entry.recordOffset, entry.recordSize));
+         tree.advance(++chunk.pos == chunk.entries.size());
+      }
+   }
+}
+
+// Sorts the length delimited records of input by the keys of SortKeyBuilder and writes them
+// (length delimited) to os. Records with equal keys keep their order.
+//
+// The records are processed as views, they are never deserialized: input is split into runs of
+// about options.memoryLimit bytes, the sort keys of a run are built and sorted in parallel. If
+// there is more than one run, the sorted runs are written to temporary files, with the bytes of
+// the records copied verbatim, and merged at the end. Merging uses a LoserTree.
+template <ParserMode mode>
+ExternalSortStats sortRecords(const MappedRecordFile<mode>& input, const SortKeyBuilder& keys, std::ostream& os, ExternalSortOptions options = {})
+{
+   const auto start = std::chrono::steady_clock::now();
+   std::unique_ptr<WorkStealingPool> ownPool;
+   auto* pool = options.pool;
+   if (!pool)
+   {
+      ownPool = std::make_unique<WorkStealingPool>(options.threadCount ? options.threadCount : WorkStealingPool::defaultThreadCount());
+      pool = ownPool.get();
+   }
+
+   ExternalSortStats stats;
+   const auto all = input.bytes();
+   stats.bytes = all.size();
+   impl::BufferedOutput out{os, "Failed to write sorted records"};
+   std::vector<std::unique_ptr<impl::TempFile>> runs;
+
+   // offset and size of the records of the current run
+   std::vector<std::pair<std::uint64_t, std::uint32_t>> records;
+   // bytes per key, for estimating the memory of a run before building the keys
+   double keySize = 16;
+   for (auto bin = all; !bin.empty();)
+   {
+      records.clear();
+      double runBytes = 0;
+      do
+      {
+         const auto begin = bin.data();
+         const auto record = impl::popDelimitedRecord(bin);
+         impl::enforce(record.size() <= std::numeric_limits<std::uint32_t>::max(), "Record is too large");
+         records.emplace_back(static_cast<std::uint64_t>(record.data() - all.data()), static_cast<std::uint32_t>(record.size()));
+         runBytes += static_cast<double>(bin.data() - begin) + sizeof(impl::SortEntry) + keySize;
+      } while (!bin.empty() && runBytes < static_cast<double>(options.memoryLimit));
+
+      auto chunks = impl::sortRun<mode>(all, records, keys, *pool);
+      std::size_t keyBytes = 0;
+      for (const auto& chunk : chunks)
+         keyBytes += chunk.keys.size();
+      keySize = static_cast<double>(keyBytes) / static_cast<double>(records.size());
+      stats.records += records.size();
+      stats.runs++;
+
+      // a single run is written directly
+      if (bin.empty() && runs.empty())
+      {
+         impl::mergeChunks(all, chunks, [&](std::string_view, DataSpan record) { out.writeDelimited(record.data(), record.size()); });
+         break;
+      }
+
+      runs.push_back(std::make_unique<impl::TempFile>(options.tempDirectory));
+      std::ofstream runFile{runs.back()->path(), std::ios::binary};
+      impl::enforce(runFile.is_open(), "Failed to open sorted run " + runs.back()->path());
+      impl::BufferedOutput runOut{runFile, "Failed to write sorted run " + runs.back()->path()};
+      impl::mergeChunks(all, chunks, [&](std::string_view key, DataSpan record) {
+         runOut.writeDelimited(key.data(), key.size());
+         runOut.writeDelimited(record.data(), record.size());
+      });
+      runOut.flush();
+   }
+
+   if (!runs.empty())
+   {
+      std::vector<impl::RunReader> readers;
+      std::vector<bool> exhausted;
+      readers.reserve(runs.size());
+      for (const auto& run : runs)
+      {
+         readers.emplace_back(run->path());
+         exhausted.push_back(!readers.back().next());
+      }
+      auto less = [&readers](std::size_t a, std::size_t b) { return readers[a].key() < readers[b].key(); };
+      for (LoserTree<decltype(less)> tree{readers.size(), less, std::move(exhausted)}; !tree.empty();)
+      {
+         auto& reader = readers[tree.top()];
+         out.writeDelimited(reader.record().data(), reader.record().size());
+         tree.advance(!reader.next());
+      }
+   }
+
+   out.flush();
+   stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   return stats;
+}
+
+} // namespace pbview
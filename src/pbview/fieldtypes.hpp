@@ -0,0 +1,52 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace pbview
+{
+
+// Calls f(type::X{}) with the field type for the name of a protobuf scalar type (e.g. "int64",
+// "string", "enum"), for tools that get field types at runtime. Throws for unknown names.
+template <typename F>
+decltype(auto) visitFieldType(std::string_view typeName, F&& f)
+{
+   if (typeName == "double")
+      return f(type::Double{});
+   if (typeName == "float")
+      return f(type::Float{});
+   if (typeName == "int32")
+      return f(type::Int32{});
+   if (typeName == "int64")
+      return f(type::Int64{});
+   if (typeName == "uint32")
+      return f(type::Uint32{});
+   if (typeName == "uint64")
+      return f(type::Uint64{});
+   if (typeName == "sint32")
+      return f(type::Sint32{});
+   if (typeName == "sint64")
+      return f(type::Sint64{});
+   if (typeName == "fixed32")
+      return f(type::Fixed32{});
+   if (typeName == "fixed64")
+      return f(type::Fixed64{});
+   if (typeName == "sfixed32")
+      return f(type::Sfixed32{});
+   if (typeName == "sfixed64")
+      return f(type::Sfixed64{});
+   if (typeName == "bool")
+      return f(type::Bool{});
+   if (typeName == "enum")
+      return f(type::EnumUntyped{});
+   if (typeName == "string")
+      return f(type::String{});
+   if (typeName == "bytes")
+      return f(type::Bytes{});
+   throw std::runtime_error("Unsupported field type '" + std::string{typeName} + "'");
+}
+
+} // namespace pbview
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "binmessageview.hpp"
+#include "column.hpp"
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace pbview
+{
+
+namespace impl
+{
+   template <typename Msg, typename = void>
+   struct HasBinView : std::false_type
+   {};
+
+   template <typename Msg>
+   struct HasBinView<Msg, std::void_t<decltype(std::declval<const Msg&>().bin_view())>> : std::true_type
+   {};
+
+   // the BinView of a generated view, or the BinView itself
+   template <typename Msg>
+   decltype(auto) binViewOf(const Msg& msg)
+   {
+      if constexpr (HasBinView<Msg>::value)
+         return msg.bin_view();
+      else
+         return msg;
+   }
+
+   template <typename Columns, typename Values, std::size_t... I>
+   void appendColumns(Columns& columns, Values& values, std::index_sequence<I...>)
+   {
+      (std::get<I>(columns).append(std::move(std::get<I>(values))), ...);
+   }
+}
+
+// Reads the field fieldNo of all elements of a repeated sub-message field into a column (one
+// value per element, see Column for elements without the field):
+//   auto ids = gather<type::Int32>(view.getRepeated<type::Message>(17), 1);
+// Also accepts the repeated fields of generated views, e.g. gather<type::Int32>(view.mysubmsg_field(), 1).
+template <typename T, typename Rng>
+Column<T> gather(const Rng& messages, int fieldNo)
+{
+   Column<T> res;
+   for (const auto& msg : messages)
+      res.append(impl::binViewOf(msg).template get<T>(fieldNo));
+   return res;
+}
+
+// Reads several fields of all elements of a repeated sub-message field into one column per
+// field, in one pass over the elements and one pass over each element (see getMany()):
+//   auto [ids, values] = gather<Field<type::Int32, 1>, Field<type::String, 2>>(view.getRepeated<type::Message>(17));
+template <typename... Fields, typename Rng>
+std::tuple<Column<typename Fields::Type>...> gather(const Rng& messages)
+{
+   std::tuple<Column<typename Fields::Type>...> res;
+   for (const auto& msg : messages)
+   {
+      auto values = getMany<Fields...>(impl::binViewOf(msg));
+      impl::appendColumns(res, values, std::index_sequence_for<Fields...>{});
+   }
+   return res;
+}
+
+} // namespace pbview
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "externalsort.hpp"
+#include "recordindex.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pbview
+{
+
+struct HashJoinOptions
+{
+   // approximate memory for the hash table of the build side: the bytes of its records plus the
+   // entries of the table. Larger build sides are joined partition by partition (grace hash join).
+   std::size_t memoryLimit = std::size_t{1} << 30;
+   // directory for the temporary files of the partitions
+   std::string tempDirectory = "/tmp";
+   // number of partitions (0: join in memory if the build side fits into memoryLimit, otherwise
+   // chosen by its size), at most maxJoinPartitions
+   std::size_t partitionCount = 0;
+};
+
+// Every partition has an open file while the records are partitioned, so their number stays well
+// below the usual limit of 1024 open files. Partitions, that are still larger than the memory
+// limit, are partitioned again (up to maxJoinLevels times in all).
+constexpr std::size_t maxJoinPartitions = 256;
+constexpr std::size_t maxJoinLevels = 4;
+
+struct HashJoinStats
+{
+   std::uint64_t buildRecords = 0;
+   std::uint64_t probeRecords = 0;
+   // pairs of matching records
+   std::uint64_t matches = 0;
+   // 0 if the build side was joined in memory (including the partitions of partitions)
+   std::uint64_t partitions = 0;
+};
+
+namespace impl
+{
+   // Hash table of the records of the build side, by the values of their key field (as read by
+   // an IndexField). The entries are chained in one vector, a chain lists its entries in the order
+   // in which they were added.
+   class JoinTable
+   {
+    public:
+      // approximate memory per record (entry and bucket)
+      static constexpr std::size_t memoryPerRecord = 48;
+
+      explicit JoinTable(std::size_t capacity)
+      {
+         mEntries.reserve(capacity);
+      }
+
+      void add(const StatisticsValue& val, DataSpan record)
+      {
+         enforce(mEntries.size() < npos, "Too many records on the build side of a join");
+         mEntries.push_back({val.key, val.bytes, record, npos});
+      }
+
+      // builds the chains after all records were added
+      void finish()
+      {
+         std::size_t buckets = 16;
+         while (buckets < mEntries.size())
+            buckets *= 2;
+         mBuckets.assign(buckets, npos);
+         mMask = buckets - 1;
+         for (auto i = mEntries.size(); i-- > 0;)
+         {
+            auto& bucket = mBuckets[hash(mEntries[i].key) & mMask];
+            mEntries[i].next = bucket;
+            bucket = static_cast<std::uint32_t>(i);
+         }
+      }
+
+      // calls f(record) for all records with the value val
+      template <typename F>
+      void forEachMatch(const StatisticsValue& val, F&& f) const
+      {
+         for (auto i = mBuckets[hash(val.key) & mMask]; i != npos; i = mEntries[i].next)
+         {
+            const auto& entry = mEntries[i];
+            if (entry.key == val.key && entry.bytes == val.bytes)
+               f(entry.record);
+         }
+      }
+
+      // hash of a key, the lower half selects the bucket
+      static std::uint64_t hash(std::uint64_t key)
+      {
+         return mix64(key);
+      }
+
+    private:
+      static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+
+      struct Entry
+      {
+         std::uint64_t key;
+         std::string_view bytes;
+         DataSpan record;
+         std::uint32_t next;
+      };
+
+      std::vector<Entry> mEntries;
+      std::vector<std::uint32_t> mBuckets;
+      std::uint64_t mMask = 0;
+   };
+
+   // joins the records of build and probe (both length delimited) in memory, returns the number
+   // of probe records
+   template <ParserMode mode, typename F>
+   std::uint64_t joinInMemory(DataSpan build, const IndexField& buildKey, DataSpan probe, const IndexField& probeKey, std::size_t buildCount,
+                               F& f, HashJoinStats& stats)
+   {
+      JoinTable table{buildCount};
+      while (!build.empty())
+      {
+         const BinMessageView<mode> record{popDelimitedRecord(build)};
+         if (const auto val = buildKey.reader(record, buildKey.fieldNo))
+            table.add(*val, record.bytes);
+      }
+      table.finish();
+
+      std::uint64_t probeCount = 0;
+      for (; !probe.empty(); probeCount++)
+      {
+         const BinMessageView<mode> record{popDelimitedRecord(probe)};
+         if (const auto val = probeKey.reader(record, probeKey.fieldNo))
+         {
+            table.forEachMatch(*val, [&](DataSpan match) {
+               stats.matches++;
+               f(BinMessageView<mode>{match}, record);
+            });
+         }
+      }
+      return probeCount;
+   }
+
+   // partition of a key at a level of the grace hash join, each level splits by other bits of the hash
+   inline std::size_t joinPartitionOf(std::uint64_t key, std::size_t level, std::size_t partitionCount)
+   {
+      return (mix64(JoinTable::hash(key) + level) >> 32) % partitionCount;
+   }
+
+   // writes the records of input (length delimited) with a key to one temporary file per partition,
+   // returns the number of records of input
+   template <ParserMode mode>
+   std::uint64_t partitionRecords(DataSpan input, const IndexField& key, std::size_t level, const std::vector<std::unique_ptr<TempFile>>& files)
+   {
+      std::vector<std::ofstream> streams;
+      std::vector<std::unique_ptr<BufferedOutput>> outs;
+      streams.reserve(files.size());
+      for (const auto& file : files)
+      {
+         streams.emplace_back(file->path(), std::ios::binary);
+         enforce(streams.back().is_open(), "Failed to open join partition " + file->path());
+         outs.push_back(std::make_unique<BufferedOutput>(streams.back(), "Failed to write join partition " + file->path(), 64 << 10));
+      }
+      std::uint64_t count = 0;
+      for (; !input.empty(); count++)
+      {
+         const BinMessageView<mode> record{popDelimitedRecord(input)};
+         if (const auto val = key.reader(record, key.fieldNo))
+            outs[joinPartitionOf(val->key, level, files.size())]->writeDelimited(record.bytes.data(), record.bytes.size());
+      }
+      for (auto& out : outs)
+         out->flush();
+      return count;
+   }
+
+   inline std::uint64_t countRecords(DataSpan input)
+   {
+      std::uint64_t res = 0;
+      for (; !input.empty(); res++)
+         popDelimitedRecord(input);
+      return res;
+   }
+
+   // memory of the hash table of a build side
+   inline double joinMemory(std::size_t bytes, std::uint64_t records)
+   {
+      return static_cast<double>(bytes) + static_cast<double>(records * JoinTable::memoryPerRecord);
+   }
+
+   // grace hash join: partitions both sides into temporary files and joins the partitions one
+   // after another, returns the number of probe records
+   template <ParserMode mode, typename F>
+   std::uint64_t joinPartitioned(DataSpan build, const IndexField& buildKey, std::uint64_t buildCount, DataSpan probe,
+                                 const IndexField& probeKey, F& f, const HashJoinOptions& options, std::size_t level, HashJoinStats& stats)
+   {
+      // twice as many partitions as needed, for skewed keys
+      const auto limit = static_cast<double>(std::max<std::size_t>(options.memoryLimit, 1));
+      const auto partitionCount = level == 0 && options.partitionCount
+                                     ? options.partitionCount
+                                     : std::clamp<std::size_t>(static_cast<std::size_t>(2 * joinMemory(build.size(), buildCount) / limit) + 1, 2,
+                                                               maxJoinPartitions);
+      stats.partitions += partitionCount;
+      std::vector<std::unique_ptr<TempFile>> buildFiles, probeFiles;
+      for (std::size_t i = 0; i < partitionCount; i++)
+      {
+         buildFiles.push_back(std::make_unique<TempFile>(options.tempDirectory, "pbview_join"));
+         probeFiles.push_back(std::make_unique<TempFile>(options.tempDirectory, "pbview_join"));
+      }
+      partitionRecords<mode>(build, buildKey, level, buildFiles);
+      const auto probeCount = partitionRecords<mode>(probe, probeKey, level, probeFiles);
+
+      for (std::size_t i = 0; i < partitionCount; i++)
+      {
+         const MappedFile buildPart{buildFiles[i]->path()};
+         const MappedFile probePart{probeFiles[i]->path()};
+         const auto count = countRecords(buildPart.bytes());
+         // a partition, that got all records, has too many records of the same key to be split
+         if (joinMemory(buildPart.bytes().size(), count) > limit && level + 1 < maxJoinLevels && count < buildCount)
+            joinPartitioned<mode>(buildPart.bytes(), buildKey, count, probePart.bytes(), probeKey, f, options, level + 1, stats);
+         else
+            joinInMemory<mode>(buildPart.bytes(), buildKey, probePart.bytes(), probeKey, count, f, stats);
+         // the partitions are not needed anymore
+         buildFiles[i].reset();
+         probeFiles[i].reset();
+      }
+      return probeCount;
+   }
+}
+
+// Inner join of two sources of length delimited records (e.g. the bytes() of MappedRecordFiles)
+// on the values of a field: calls f(buildRecord, probeRecord) (as BinMessageView<mode>) for each
+// pair of records with equal keys.
+//
+// A hash table maps the keys of the smaller build side, read with BinMessageView::get(), to views
+// of its records, the probe side is streamed past it; records are never deserialized. Records
+// without the key field (or with NaN) are not joined. The key fields must be of the same kind
+// (signed, unsigned, floating point or bytes), e.g. an int32 field can be joined with an int64 one.
+//
+// If the build side doesn't fit into options.memoryLimit, both sides are split by the hash of
+// their keys into partitions in temporary files (with the bytes of the records copied verbatim),
+// which are joined one after another (grace hash join). Partitions, that still don't fit, are
+// split again, but the records of a single key are always joined in memory, even if they exceed
+// the limit. The views are then only valid during the call of f, and the pairs are ordered by
+// partition. Otherwise the pairs are ordered as the probe side, and the matches of a probe record
+// as the build side.
+template <ParserMode mode = ParserMode::Fast, typename F>
+HashJoinStats hashJoin(DataSpan build, const IndexField& buildKey, DataSpan probe, const IndexField& probeKey, F&& f,
+                       HashJoinOptions options = {})
+{
+   impl::enforce(buildKey.fieldNo > 0 && probeKey.fieldNo > 0, "Invalid field number for join");
+   impl::enforce(buildKey.kind == probeKey.kind, "The key fields of a join have different types");
+   impl::enforce(options.partitionCount <= maxJoinPartitions, "Too many partitions for a join (at most " + std::to_string(maxJoinPartitions) + ")");
+
+   HashJoinStats stats;
+   stats.buildRecords = impl::countRecords(build);
+   if (impl::joinMemory(build.size(), stats.buildRecords) <= static_cast<double>(options.memoryLimit) && options.partitionCount == 0)
+      stats.probeRecords = impl::joinInMemory<mode>(build, buildKey, probe, probeKey, stats.buildRecords, f, stats);
+   else
+      stats.probeRecords = impl::joinPartitioned<mode>(build, buildKey, stats.buildRecords, probe, probeKey, f, options, 0, stats);
+   return stats;
+}
+
+// Joins like hashJoin() and writes one length delimited message per pair to os: the bytes of the
+// build record followed by the bytes of the probe record, which protobuf parses as the merge of both
+// messages (fields of the probe record override singular fields of the build record).
+// The fields of the joined records are not in the order of their numbers, so they have to be read
+// with ParserMode::StrictConforming (or deserialized): the views of the fast modes (and RecordMerger,
+// aggregate() etc. on them) stop at the first higher field number and miss the probe fields with
+// lower numbers than the highest one of the build record.
+template <ParserMode mode = ParserMode::Fast>
+HashJoinStats hashJoinConcatenated(DataSpan build, const IndexField& buildKey, DataSpan probe, const IndexField& probeKey, std::ostream& os,
+                                   HashJoinOptions options = {})
+{
+   impl::BufferedOutput out{os, "Failed to write joined records"};
+   const auto stats = hashJoin<mode>(build, buildKey, probe, probeKey, [&out](BinMessageView<mode> buildRecord, BinMessageView<mode> probeRecord) {
+      std::array<std::byte, 10> len;
+      out.write(len.data(), block_format::encodeVarint(len.data(), buildRecord.bytes.size() + probeRecord.bytes.size()));
+      out.write(buildRecord.bytes.data(), buildRecord.bytes.size());
+      out.write(probeRecord.bytes.data(), probeRecord.bytes.size());
+   }, std::move(options));
+   out.flush();
+   return stats;
+}
+
+} // namespace pbview
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "blockstatistics.hpp"
+#include "parallelscan.hpp"
+
+#include <array>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pbview
+{
+
+struct HashPartitionOptions
+{
+   // buffer of each worker thread per partition, written to the partition in one piece when full
+   std::size_t bufferSize = 128 << 10;
+   // thread pool and chunk size of the scan
+   ParallelScanOptions scan;
+};
+
+struct HashPartitionStats
+{
+   // per partition
+   std::vector<std::uint64_t> records;
+   std::vector<std::uint64_t> bytes;
+};
+
+// Partition of a record with the encoded value key of the partitioning field (from
+// BinMessageView::getRaw(), empty if the field is missing). The hash is stable (FNV-1a), so
+// the same keys always go to the same partition.
+inline std::size_t hashPartitionOf(DataSpan key, std::size_t partitionCount)
+{
+   return impl::hashBytes(std::string_view{reinterpret_cast<const char*>(key.data()), key.size()}) % partitionCount;
+}
+
+namespace impl
+{
+   // an output of hashPartition(), shared by the worker threads
+   struct PartitionOutput
+   {
+      std::ostream* os;
+      std::mutex mutex;
+      std::uint64_t records = 0;
+      std::uint64_t bytes = 0;
+
+      void write(const std::string& buffer, std::uint64_t recordCount)
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         os->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+         enforce(os->good(), "Failed to write partition");
+         records += recordCount;
+         bytes += buffer.size();
+      }
+   };
+
+   // the buffers of one worker thread
+   struct PartitionBuffers
+   {
+      std::vector<std::string> buffers;
+      std::vector<std::uint64_t> records;
+   };
+}
+
+// Splits the records of file (a MappedRecordFile or a BlockRecordReader) into outputs.size()
+// partitions by the hash of the field fieldNo and writes them length delimited to the outputs.
+//
+// The key is hashed as it is encoded in the record (see hashPartitionOf()), so strings and
+// bytes are not decoded, and fields of different integer types only get the same partitions for
+// the same values if they are encoded alike (e.g. int32 and int64, but not sint32). Records
+// without the field all go to one partition.
+//
+// The records are scanned in parallel (parallelForEachRecord()), each worker thread appends the
+// records to its own buffer per partition and writes full buffers to the outputs in one piece,
+// so the records of a partition are not in the order of file.
+template <typename File>
+HashPartitionStats hashPartition(const File& file, int fieldNo, const std::vector<std::ostream*>& outputs, HashPartitionOptions options = {})
+{
+   using BinView = typename File::BinView;
+   impl::enforce(fieldNo > 0, "Invalid field number for partitioning");
+   impl::enforce(!outputs.empty(), "No outputs for partitioning");
+
+   std::vector<std::unique_ptr<impl::PartitionOutput>> partitions;
+   for (auto* os : outputs)
+   {
+      partitions.push_back(std::make_unique<impl::PartitionOutput>());
+      partitions.back()->os = os;
+   }
+
+   auto flush = [&partitions](impl::PartitionBuffers& own, std::size_t partition) {
+      partitions[partition]->write(own.buffers[partition], own.records[partition]);
+      own.buffers[partition].clear();
+      own.records[partition] = 0;
+   };
+
+   const impl::PartitionBuffers init{std::vector<std::string>(outputs.size()), std::vector<std::uint64_t>(outputs.size())};
+   auto rest = parallelForEachRecord(file, init, [&](impl::PartitionBuffers& own, BinView record) {
+      const auto partition = hashPartitionOf(record.getRaw(fieldNo).value_or(DataSpan{}), outputs.size());
+      auto& buffer = own.buffers[partition];
+      if (buffer.capacity() < options.bufferSize)
+         buffer.reserve(options.bufferSize);
+
+      std::array<std::byte, 10> len;
+      buffer.append(reinterpret_cast<const char*>(len.data()), block_format::encodeVarint(len.data(), record.bytes.size()));
+      buffer.append(reinterpret_cast<const char*>(record.bytes.data()), record.bytes.size());
+      own.records[partition]++;
+      if (buffer.size() >= options.bufferSize)
+         flush(own, partition);
+   }, options.scan);
+
+   HashPartitionStats stats;
+   for (std::size_t p = 0; p < partitions.size(); p++)
+   {
+      for (auto& own : rest)
+      {
+         if (!own.buffers[p].empty())
+            flush(own, p);
+      }
+      partitions[p]->os->flush();
+      impl::enforce(partitions[p]->os->good(), "Failed to write partition");
+      stats.records.push_back(partitions[p]->records);
+      stats.bytes.push_back(partitions[p]->bytes);
+   }
+   return stats;
+}
+
+// Partitions into the files at paths (see above)
+template <typename File>
+HashPartitionStats hashPartition(const File& file, int fieldNo, const std::vector<std::string>& paths, HashPartitionOptions options = {})
+{
+   std::vector<std::ofstream> files;
+   std::vector<std::ostream*> outputs;
+   files.reserve(paths.size());
+   for (const auto& path : paths)
+   {
+      files.emplace_back(path, std::ios::binary);
+      impl::enforce(files.back().good(), "Failed to create " + path);
+      outputs.push_back(&files.back());
+   }
+   return hashPartition(file, fieldNo, outputs, std::move(options));
+}
+
+} // namespace pbview
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+namespace pbview
+{
+
+// Walks the message once on construction and records the position of every field.
+// All following accesses jump directly to the recorded offsets.
+// Pays off as soon as more than a few fields of the same message are read.
+// As the whole message is walked, construction validates all of it (except for
+// Fast_WithoutBoundsChecking): a malformed message throws on construction, even if only fields
+// in front of the malformed part are read (BinMessageView would return those fields).
+// Can be used as BinView of the generated view classes (e.g. pbview::View<MyMessage, IndexedBinMessageView<>>).
+template <ParserMode mode = ParserMode::Fast>
+struct IndexedBinMessageView
+{
+ private:
+   using Reader = BinMessageView<mode>;
+
+   struct FieldLocation
+   {
+      static constexpr auto notFound = std::numeric_limits<std::uint32_t>::max();
+
+      // offset of the tag of the first occurrence (start of repeated fields)
+      std::uint32_t firstTagOffset = notFound;
+      // offset of the value that is returned by get() (first occurrence or last for StrictConforming)
+      std::uint32_t valueOffset = notFound;
+      WireType wireType{};
+
+      bool found() const
+      {
+         return firstTagOffset != notFound;
+      }
+   };
+
+   // field numbers below this limit are stored in a plain array, all others in a sorted vector
+   static constexpr int denseFieldCount = 32;
+
+   std::array<FieldLocation, denseFieldCount> mDense{};
+   std::vector<std::pair<int, FieldLocation>> mSparse;
+
+   FieldLocation& locationFor(int fieldNo)
+   {
+      if (fieldNo < denseFieldCount)
+         return mDense[fieldNo];
+
+      auto it = std::lower_bound(mSparse.begin(), mSparse.end(), fieldNo, [](auto&& entry, int no) { return entry.first < no; });
+      if (it == mSparse.end() || it->first != fieldNo)
+         it = mSparse.insert(it, {fieldNo, FieldLocation{}});
+      return it->second;
+   }
+
+   const FieldLocation* find(int fieldNo) const
+   {
+      if (fieldNo < 0)
+         return nullptr;
+
+      if (fieldNo < denseFieldCount)
+      {
+         auto& loc = mDense[fieldNo];
+         return loc.found() ? &loc : nullptr;
+      }
+
+      auto it = std::lower_bound(mSparse.begin(), mSparse.end(), fieldNo, [](auto&& entry, int no) { return entry.first < no; });
+      if (it == mSparse.end() || it->first != fieldNo)
+         return nullptr;
+      return &it->second;
+   }
+
+   void buildIndex()
+   {
+      if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+         impl::enforce(bytes.size() < FieldLocation::notFound, "Message is too large to be indexed");
+
+      auto bin = bytes;
+      while (true)
+      {
+         const auto tagOffset = static_cast<std::uint32_t>(bin.data() - bytes.data());
+         const auto tag = Reader::popTag(bin);
+         if (!tag)
+            break;
+
+         const int fieldNo = tag >> 3;
+         constexpr uint32_t WireTypeBitMask = 0b111;
+         const WireType type{tag & WireTypeBitMask};
+
+         auto& loc = locationFor(fieldNo);
+         if (!loc.found())
+            loc.firstTagOffset = tagOffset;
+         if (mode == ParserMode::StrictConforming || loc.valueOffset == FieldLocation::notFound)
+         {
+            loc.valueOffset = static_cast<std::uint32_t>(bin.data() - bytes.data());
+            loc.wireType = type;
+         }
+
+         Reader::skipValue(bin, type);
+      }
+   }
+
+   DataSpan fromFirstTag(int fieldNo) const
+   {
+      if (auto loc = find(fieldNo))
+         return bytes.substr(loc->firstTagOffset);
+      return {};
+   }
+
+ public:
+   DataSpan bytes;
+
+   explicit IndexedBinMessageView(DataSpan span) : bytes(span)
+   {
+      buildIndex();
+   }
+
+   static IndexedBinMessageView fromBytesString(std::string_view sv)
+   {
+      return IndexedBinMessageView{DataSpan{reinterpret_cast<const std::byte *>(sv.data()), sv.size()}};
+   }
+
+   bool has(int fieldNo) const
+   {
+      return find(fieldNo) != nullptr;
+   }
+
+   template <typename T>
+   auto get(int fieldNo) const -> typename std::optional<typename T::CppType>
+   {
+      auto loc = find(fieldNo);
+      if (!loc)
+         return {};
+
+      if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+         impl::enforce(loc->wireType == Reader::template wireTypeOf<T>(), "Invalid wire type!");
+
+      auto bin = bytes.substr(loc->valueOffset);
+      return Reader::template popNextValue<T>(bin);
+   }
+
+   template <typename T>
+   auto getRepeated(int fieldNo) const
+   {
+      return typename Reader::template Repeated<T>(fromFirstTag(fieldNo), fieldNo);
+   }
+
+   template <typename T>
+   auto getPackedRepeated(int fieldNo) const
+   {
+      return typename Reader::template PackedRepeated<T>(fromFirstTag(fieldNo), fieldNo);
+   }
+};
+
+template <typename T, ParserMode parserMode>
+T deserialize(const IndexedBinMessageView<parserMode>& msgView)
+{
+   return deserialize<T>(BinMessageView<parserMode>{msgView.bytes});
+}
+
+} // namespace pbview
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace pbview
+{
+
+// Tournament tree of losers for merging k sorted sources: after each step, the smallest head of
+// all sources is found with one comparison per tree level (two for equal heads), instead of the
+// 2 * log2(k) comparisons of a binary heap.
+//
+// less(i, j) compares the current heads of the sources i and j (it is only called for sources
+// that are not exhausted). Equal heads are taken from the source with the lower index first, so
+// merging is stable.
+template <typename Less>
+class LoserTree
+{
+ public:
+   // exhausted marks sources that are empty from the start (default: none)
+   LoserTree(std::size_t sourceCount, Less less, std::vector<bool> exhausted = {})
+      : mLess(std::move(less)), mExhausted(std::move(exhausted)), mTree(std::max<std::size_t>(sourceCount, 1))
+   {
+      mExhausted.resize(sourceCount, false);
+      mRemaining = 0;
+      for (bool e : mExhausted)
+         mRemaining += !e;
+      if (sourceCount == 0)
+         return;
+
+      // leaf i is node k + i, the children of node n are 2n and 2n + 1
+      const auto k = sourceCount;
+      std::vector<std::size_t> winners(k);
+      auto winnerOf = [&](std::size_t node) { return node >= k ? node - k : winners[node]; };
+      for (auto node = k - 1; node > 0; node--)
+      {
+         auto a = winnerOf(2 * node);
+         auto b = winnerOf(2 * node + 1);
+         if (beats(b, a))
+            std::swap(a, b);
+         winners[node] = a;
+         mTree[node] = b;
+      }
+      mTree[0] = winnerOf(1);
+   }
+
+   // All sources are exhausted
+   bool empty() const
+   {
+      return mRemaining == 0;
+   }
+
+   // Index of the source with the smallest head (if !empty())
+   std::size_t top() const
+   {
+      return mTree[0];
+   }
+
+   // The head of top() was consumed, exhausted: the source has no more elements
+   void advance(bool exhausted)
+   {
+      auto winner = mTree[0];
+      if (exhausted)
+      {
+         mExhausted[winner] = true;
+         mRemaining--;
+      }
+      for (auto node = (mExhausted.size() + winner) / 2; node > 0; node /= 2)
+      {
+         if (beats(mTree[node], winner))
+            std::swap(mTree[node], winner);
+      }
+      mTree[0] = winner;
+   }
+
+ private:
+   Less mLess;
+   std::vector<bool> mExhausted;
+   // mTree[0]: winner, mTree[1..k-1]: loser of the match at that node
+   std::vector<std::size_t> mTree;
+   std::size_t mRemaining;
+
+   // whether source a comes before source b
+   bool beats(std::size_t a, std::size_t b) const
+   {
+      if (mExhausted[a] || mExhausted[b])
+         return !mExhausted[a] && mExhausted[b];
+      if (mLess(a, b))
+         return true;
+      return !mLess(b, a) && a < b;
+   }
+};
+
+} // namespace pbview
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pbview
+{
+
+namespace impl
+{
+   // Pops a length delimited record (varint length + message) from the front of bin.
+   // The framing is always checked, independent of the parser mode used for the records.
+   inline DataSpan popDelimitedRecord(DataSpan& bin)
+   {
+      std::uint64_t len = 0;
+      for (int shift = 0;; shift += 7)
+      {
+         enforce(!bin.empty(), "Input ended within the length of a record");
+         enforce(shift < 64, "Invalid length of a record");
+         const auto c = static_cast<std::uint8_t>(bin.front());
+         bin.remove_prefix(1);
+         len |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+         if (!(c & 0x80))
+            break;
+      }
+      enforce(len <= bin.size(), "Input ended within a record");
+      auto record = bin.substr(0, len);
+      bin.remove_prefix(len);
+      return record;
+   }
+}
+
+// Hints for the kernel on how the mapping of a MappedFile will be used
+struct MappingOptions
+{
+   // madvise(MADV_SEQUENTIAL): aggressive read-ahead, pages may be dropped after being read
+   bool sequential = true;
+   // madvise(MADV_WILLNEED): start reading the whole file in the background
+   bool willNeed = false;
+   // madvise(MADV_HUGEPAGE): transparent huge pages (only effective on file systems supporting them)
+   bool hugePages = false;
+   // MAP_POPULATE: read the whole file and set up all page table entries before returning
+   bool prefault = false;
+};
+
+// A file mapped read-only into memory
+class MappedFile
+{
+ public:
+   explicit MappedFile(const std::string& path, MappingOptions options = {})
+   {
+      const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      impl::enforce(fd >= 0, "Failed to open " + path + ": " + std::strerror(errno));
+
+      struct stat st;
+      bool mapped = ::fstat(fd, &st) == 0;
+      if (mapped && st.st_size > 0)
+      {
+         int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+         if (options.prefault)
+            flags |= MAP_POPULATE;
+#endif
+         mData = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, flags, fd, 0);
+         mapped = mData != MAP_FAILED;
+         if (mapped)
+            mSize = static_cast<std::size_t>(st.st_size);
+      }
+      const auto err = errno;
+      // the mapping stays valid after closing the file
+      ::close(fd);
+      impl::enforce(mapped, "Failed to map " + path + ": " + std::strerror(err));
+      if (mSize == 0)
+         return;
+
+      // the hints are only advisory, failures are ignored
+      if (options.sequential)
+         ::madvise(mData, mSize, MADV_SEQUENTIAL);
+      if (options.willNeed)
+         ::madvise(mData, mSize, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+      if (options.hugePages)
+         ::madvise(mData, mSize, MADV_HUGEPAGE);
+#endif
+   }
+
+   MappedFile(MappedFile&& other) noexcept
+      : mData(other.mData), mSize(other.mSize)
+   {
+      other.mData = MAP_FAILED;
+      other.mSize = 0;
+   }
+
+   MappedFile& operator=(MappedFile&& other) noexcept
+   {
+      std::swap(mData, other.mData);
+      std::swap(mSize, other.mSize);
+      return *this;
+   }
+
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+
+   ~MappedFile()
+   {
+      if (mSize > 0)
+         ::munmap(mData, mSize);
+   }
+
+   // The whole content of the file
+   DataSpan bytes() const
+   {
+      if (mSize == 0)
+         return {};
+      return DataSpan{static_cast<const std::byte*>(mData), mSize};
+   }
+
+   std::size_t size() const
+   {
+      return mSize;
+   }
+
+ private:
+   // MAP_FAILED for empty files
+   void* mData = MAP_FAILED;
+   std::size_t mSize = 0;
+};
+
+// Forward range over the length delimited records in bytes (as BinView or as T constructed from a BinView)
+template <typename BinView, typename T = BinView>
+struct DelimitedRecords
+    : ranges::view_facade<DelimitedRecords<BinView, T>, ranges::finite>
+{
+ private:
+   friend ranges::range_access;
+   DataSpan mBytes{};
+
+   struct cursor
+   {
+    private:
+      DataSpan mBytes{};
+      DataSpan mRecord{};
+      bool mDone = false;
+
+    public:
+      cursor() = default;
+
+      explicit cursor(DataSpan bytes)
+          : mBytes{bytes}
+      {
+         next();
+      }
+
+      void next()
+      {
+         mDone = mBytes.empty();
+         if (!mDone)
+            mRecord = impl::popDelimitedRecord(mBytes);
+      }
+
+      T read() const
+      {
+         return T{BinView{mRecord}};
+      }
+
+      bool equal(ranges::default_sentinel) const
+      {
+         return mDone;
+      }
+
+      bool equal(const cursor& other) const
+      {
+         return mBytes == other.mBytes && mDone == other.mDone;
+      }
+   };
+
+   cursor begin_cursor() const
+   {
+      return cursor{mBytes};
+   }
+
+ public:
+   DelimitedRecords() = default;
+
+   explicit DelimitedRecords(DataSpan bytes)
+       : mBytes(bytes)
+   {
+   }
+};
+
+// A record of a file of length delimited records, with its length prefix
+template <typename BinView>
+struct DelimitedRecord : BinView
+{
+   // the length prefix and the record, as stored in the file (a length may have more bytes than
+   // its shortest encoding, so its size can't be derived from the size of the record)
+   DataSpan delimited;
+
+   DelimitedRecord(BinView view, DataSpan delimitedRecord)
+      : BinView(view), delimited(delimitedRecord)
+   {
+   }
+};
+
+namespace impl
+{
+   // pops the record at the start of bin, with its length prefix
+   template <typename BinView>
+   DelimitedRecord<BinView> popDelimitedRecordWithLength(DataSpan& bin)
+   {
+      const auto begin = bin.data();
+      const auto record = popDelimitedRecord(bin);
+      return DelimitedRecord<BinView>{BinView{record}, DataSpan{begin, static_cast<std::size_t>(bin.data() - begin)}};
+   }
+}
+
+// A file of length delimited messages (as written by SerializeDelimitedToOstream), mapped
+// read-only into memory. All records are views pointing directly into the mapping, so they
+// are valid as long as the MappedRecordFile exists.
+//
+// records() scans the file forward. After buildOffsetTable() records can be accessed by index.
+template <ParserMode parserMode = ParserMode::Fast>
+class MappedRecordFile
+{
+ public:
+   using BinView = BinMessageView<parserMode>;
+   // a record passed by parallelForEachRecord()
+   using Record = DelimitedRecord<BinView>;
+
+   explicit MappedRecordFile(const std::string& path, MappingOptions options = {})
+      : mFile(path, options)
+   {
+   }
+
+   // The whole content of the file
+   DataSpan bytes() const
+   {
+      return mFile.bytes();
+   }
+
+   template <typename T>
+   using Records = DelimitedRecords<BinView, T>;
+
+   // Forward range of all records as BinView
+   Records<BinView> records() const
+   {
+      return Records<BinView>{bytes()};
+   }
+
+   // Forward range of all records as generated views
+   template <typename Msg>
+   Records<View<Msg, BinView>> records() const
+   {
+      return Records<View<Msg, BinView>>{bytes()};
+   }
+
+   // Scans the file once and stores the offset of each record
+   void buildOffsetTable()
+   {
+      std::vector<std::uint64_t> offsets;
+      const auto all = bytes();
+      auto bin = all;
+      while (!bin.empty())
+      {
+         offsets.push_back(static_cast<std::uint64_t>(bin.data() - all.data()));
+         impl::popDelimitedRecord(bin);
+      }
+      mOffsets = std::move(offsets);
+   }
+
+   // Uses offsets that were stored before (e.g. in an index file) instead of scanning the file
+   void setOffsetTable(std::vector<std::uint64_t> offsets)
+   {
+      for (auto offset : offsets)
+         impl::enforce(offset < mFile.size(), "Record offset is beyond the end of the file");
+      mOffsets = std::move(offsets);
+   }
+
+   bool hasOffsetTable() const
+   {
+      return !mOffsets.empty() || mFile.size() == 0;
+   }
+
+   const std::vector<std::uint64_t>& offsets() const
+   {
+      return mOffsets;
+   }
+
+   // Number of records (requires the offset table)
+   std::size_t size() const
+   {
+      impl::enforce(hasOffsetTable(), "Offset table of record file was not built");
+      return mOffsets.size();
+   }
+
+   // Record at idx (requires the offset table)
+   BinView operator[](std::size_t idx) const
+   {
+      impl::enforce(idx < size(), "Record index out of range");
+      auto bin = bytes().substr(mOffsets[idx]);
+      return BinView{impl::popDelimitedRecord(bin)};
+   }
+
+   template <typename Msg>
+   View<Msg, BinView> at(std::size_t idx) const
+   {
+      return View<Msg, BinView>{(*this)[idx]};
+   }
+
+ private:
+   MappedFile mFile;
+   std::vector<std::uint64_t> mOffsets;
+};
+
+} // namespace pbview
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "mappedrecordfile.hpp"
+#include "workstealingpool.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <type_traits>
+
+namespace pbview
+{
+
+struct ParallelScanOptions
+{
+   // number of threads of the internal pool (0: one per hardware thread), ignored if pool is set
+   std::size_t threadCount = 0;
+   // approximate number of bytes of the records processed by one task
+   std::size_t chunkSize = 1 << 20;
+   // existing pool to run the tasks on
+   WorkStealingPool* pool = nullptr;
+};
+
+namespace impl
+{
+   // Files that find their records in arbitrary byte ranges themselves (forEachRecord(begin, end, f))
+   template <typename File, typename = void>
+   struct IsSplittable : std::false_type
+   {};
+
+   template <typename File>
+   struct IsSplittable<File, std::void_t<decltype(std::declval<const File&>().forEachRecord(
+                                std::uint64_t{}, std::uint64_t{}, std::declval<void (*)(typename File::BinView)>()))>> : std::true_type
+   {};
+
+   // Splits the records of file into chunks of about chunkSize bytes and calls
+   // submitChunk(DataSpan) for each chunk of complete records.
+   //
+   // Delimited records can't be found reliably at arbitrary positions, so without an offset table
+   // the chunk borders are found by walking the length prefixes (without parsing the records).
+   // The chunks are submitted while walking, so workers already start on the first ones.
+   template <typename File, typename F>
+   void forEachRecordChunk(const File& file, std::size_t chunkSize, F&& submitChunk)
+   {
+      const auto all = file.bytes();
+      chunkSize = std::max<std::size_t>(chunkSize, 1);
+
+      if (file.hasOffsetTable())
+      {
+         const auto& offsets = file.offsets();
+         auto it = offsets.begin();
+         while (it != offsets.end())
+         {
+            const auto chunkEnd = std::upper_bound(it + 1, offsets.end(), *it + chunkSize - 1);
+            const auto end = chunkEnd == offsets.end() ? all.size() : *chunkEnd;
+            submitChunk(all.substr(*it, end - *it));
+            it = chunkEnd;
+         }
+         return;
+      }
+
+      auto bin = all;
+      while (!bin.empty())
+      {
+         const auto chunkBegin = bin.data();
+         do
+            popDelimitedRecord(bin);
+         while (!bin.empty() && static_cast<std::size_t>(bin.data() - chunkBegin) < chunkSize);
+         submitChunk(DataSpan{chunkBegin, static_cast<std::size_t>(bin.data() - chunkBegin)});
+      }
+   }
+}
+
+// Calls fn(reducer, record) for all records of file (a MappedRecordFile or a BlockRecordReader) on
+// a work stealing thread pool. Each worker thread has its own reducer (a copy of init), so fn can
+// aggregate without locking. The reducers of all workers are returned for merging.
+//
+// The records are passed as const File::Record&, a File::BinView with the length prefix of the
+// record (MappedRecordFile) or the pin of its block (BlockRecordReader). Use
+// View<Msg, File::BinView>{record} for generated views.
+// Exceptions thrown by fn or on invalid framing are rethrown after all running tasks finished.
+// With options.pool set, this waits for all tasks of the pool.
+template <typename Reducer, typename File, typename Fn,
+          typename = std::enable_if_t<std::is_invocable_v<Fn&, Reducer&, const typename File::Record&>>>
+std::vector<Reducer> parallelForEachRecord(const File& file, const Reducer& init, Fn&& fn, ParallelScanOptions options = {})
+{
+   using BinView = typename File::BinView;
+   using Record = typename File::Record;
+
+   std::optional<WorkStealingPool> ownPool;
+   auto* pool = options.pool;
+   if (!pool)
+      pool = &ownPool.emplace(options.threadCount ? options.threadCount : WorkStealingPool::defaultThreadCount());
+
+   // padded to separate cache lines, as the reducers are updated concurrently
+   struct alignas(64) PaddedReducer
+   {
+      Reducer value;
+   };
+   std::vector<PaddedReducer> reducers(pool->threadCount(), PaddedReducer{init});
+   try
+   {
+      if constexpr (impl::IsSplittable<File>::value)
+      {
+         // each task finds the records of its byte range independently
+         const auto size = static_cast<std::uint64_t>(file.bytes().size());
+         const auto chunkSize = std::max<std::uint64_t>(options.chunkSize, 1);
+         for (std::uint64_t begin = 0; begin < size; begin += chunkSize)
+         {
+            pool->submit([&file, begin, end = begin + chunkSize, &reducers, &fn](std::size_t worker) {
+               auto& reducer = reducers[worker].value;
+               file.forEachRecord(begin, end, [&](const Record& record) { fn(reducer, record); });
+            });
+         }
+      }
+      else
+      {
+         impl::forEachRecordChunk(file, options.chunkSize, [&](DataSpan chunk) {
+            pool->submit([chunk, &reducers, &fn](std::size_t worker) {
+               auto& reducer = reducers[worker].value;
+               auto bin = chunk;
+               while (!bin.empty())
+               {
+                  const Record record = impl::popDelimitedRecordWithLength<BinView>(bin);
+                  fn(reducer, record);
+               }
+            });
+         });
+      }
+   }
+   catch (...)
+   {
+      // the submitted tasks reference local state
+      try
+      {
+         pool->wait();
+      }
+      catch (...)
+      {
+      }
+      throw;
+   }
+   pool->wait();
+
+   std::vector<Reducer> res;
+   res.reserve(reducers.size());
+   for (auto& reducer : reducers)
+      res.push_back(std::move(reducer.value));
+   return res;
+}
+
+// Calls fn(record) for all records of file on a work stealing thread pool (see above)
+template <typename File, typename Fn,
+          typename = std::enable_if_t<std::is_invocable_v<Fn&, const typename File::Record&>>>
+void parallelForEachRecord(const File& file, Fn&& fn, ParallelScanOptions options = {})
+{
+   struct NoReducer
+   {};
+   parallelForEachRecord(file, NoReducer{}, [&fn](NoReducer&, const typename File::Record& record) { fn(record); }, options);
+}
+
+} // namespace pbview
@@ -0,0 +1,533 @@
+#pragma once
+
+#include "binmessageview.hpp"
+#include "blockstatistics.hpp"
+#include "varintkernels.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace pbview
+{
+
+// Path of a field in sub-messages: 4 is field 4 of the message, {17, 1} field 1 of the sub-message
+// in field 17
+struct FieldPath
+{
+   std::vector<int> fieldNos;
+
+   FieldPath(int fieldNo) : fieldNos{fieldNo}
+   {
+   }
+
+   FieldPath(std::initializer_list<int> path) : fieldNos(path)
+   {
+   }
+};
+
+class PredicatePlan;
+
+// Condition on the fields of messages, combined with && and ||:
+//   auto pred = Predicate::equal<type::Enum<Status>>(16, Status::Active) && Predicate::greater<type::Int64>(4, 100) &&
+//               (Predicate::startsWith<type::String>(14, "x") || Predicate::equal<type::Int32>({17, 1}, 42));
+// A condition compares like FieldPredicate (see FieldReader for which value of a repeated field
+// is compared), messages without the field never match. compile() builds the plan, that evaluates it on messages.
+class Predicate
+{
+ public:
+   template <typename T>
+   static Predicate equal(const FieldPath& path, typename T::CppType value)
+   {
+      return condition(path, FieldPredicate::equal<T>(lastFieldNo(path), value));
+   }
+
+   // lo <= value <= hi
+   template <typename T>
+   static Predicate between(const FieldPath& path, typename T::CppType lo, typename T::CppType hi)
+   {
+      return condition(path, FieldPredicate::between<T>(lastFieldNo(path), lo, hi));
+   }
+
+   template <typename T>
+   static Predicate less(const FieldPath& path, typename T::CppType value)
+   {
+      return condition(path, FieldPredicate::less<T>(lastFieldNo(path), value));
+   }
+
+   template <typename T>
+   static Predicate lessEqual(const FieldPath& path, typename T::CppType value)
+   {
+      return condition(path, FieldPredicate::lessEqual<T>(lastFieldNo(path), value));
+   }
+
+   template <typename T>
+   static Predicate greater(const FieldPath& path, typename T::CppType value)
+   {
+      return condition(path, FieldPredicate::greater<T>(lastFieldNo(path), value));
+   }
+
+   template <typename T>
+   static Predicate greaterEqual(const FieldPath& path, typename T::CppType value)
+   {
+      return condition(path, FieldPredicate::greaterEqual<T>(lastFieldNo(path), value));
+   }
+
+   template <typename T>
+   static Predicate startsWith(const FieldPath& path, std::string_view prefix)
+   {
+      return condition(path, FieldPredicate::startsWith<T>(lastFieldNo(path), prefix));
+   }
+
+   friend Predicate operator&&(Predicate lhs, Predicate rhs)
+   {
+      return combine(Kind::And, std::move(lhs), std::move(rhs));
+   }
+
+   friend Predicate operator||(Predicate lhs, Predicate rhs)
+   {
+      return combine(Kind::Or, std::move(lhs), std::move(rhs));
+   }
+
+   PredicatePlan compile() const;
+
+ private:
+   friend class PredicatePlan;
+
+   enum class Kind : std::uint8_t
+   {
+      Condition,
+      And,
+      Or
+   };
+
+   Kind mKind;
+   // the sub-messages and the field of a condition
+   std::vector<int> mPath;
+   std::optional<FieldPredicate> mCondition;
+   // the operands of And and Or
+   std::vector<Predicate> mOperands;
+
+   explicit Predicate(Kind kind) : mKind(kind)
+   {
+   }
+
+   static int lastFieldNo(const FieldPath& path)
+   {
+      impl::enforce(!path.fieldNos.empty(), "Empty field path");
+      return path.fieldNos.back();
+   }
+
+   static Predicate condition(const FieldPath& path, FieldPredicate pred)
+   {
+      for (auto fieldNo : path.fieldNos)
+         impl::enforce(fieldNo > 0, "Invalid field number in field path");
+      Predicate res{Kind::Condition};
+      res.mPath = path.fieldNos;
+      res.mCondition = std::move(pred);
+      return res;
+   }
+
+   // (a && b) && c is a && b && c
+   static Predicate combine(Kind kind, Predicate lhs, Predicate rhs)
+   {
+      Predicate res{kind};
+      for (auto* operand : {&lhs, &rhs})
+      {
+         if (operand->mKind == kind)
+            std::move(operand->mOperands.begin(), operand->mOperands.end(), std::back_inserter(res.mOperands));
+         else
+            res.mOperands.push_back(std::move(*operand));
+      }
+      return res;
+   }
+};
+
+struct PredicateStats
+{
+   std::uint64_t messages = 0;
+   std::uint64_t matches = 0;
+   // conditions compared with a value (less than the conditions of all messages, if outcomes
+   // were known early)
+   std::uint64_t conditionsEvaluated = 0;
+};
+
+// A Predicate compiled for the evaluation on messages. The fields are read in one forward pass,
+// that stops as soon as the outcome is known: the fast modes know the value of a field at its first
+// occurrence. Conditions on the same field (and in StrictConforming mode, in
+// which all values are only known at the end of the message, all conditions) are evaluated in
+// the order of how often they decided the outcome so far, which is updated every 1024 messages.
+// A plan keeps statistics, so every thread needs its own copy.
+class PredicatePlan
+{
+ public:
+   explicit PredicatePlan(const Predicate& predicate)
+   {
+      std::vector<std::map<int, BuildSlot>> scopes(1);
+      addNode(predicate, -1, scopes);
+
+      // the slots of a scope are adjacent and ordered by field number
+      mScopes.resize(scopes.size());
+      for (std::size_t i = 0; i < scopes.size(); i++)
+      {
+         auto& scope = mScopes[i];
+         scope.firstSlot = mSlots.size();
+         for (auto& [fieldNo, slot] : scopes[i])
+         {
+            scope.order.push_back(mSlots.size());
+            mSlots.push_back({fieldNo, std::move(slot.conditions), slot.scope});
+         }
+         scope.endSlot = mSlots.size();
+      }
+
+      mState.resize(mNodes.size());
+      mPending.resize(mNodes.size());
+      mSpans.resize(mSlots.size());
+   }
+
+   template <ParserMode mode>
+   bool matches(const BinMessageView<mode>& msg)
+   {
+      if (++mStats.messages % AdaptInterval == 0)
+         adapt();
+
+      std::fill(mState.begin(), mState.end(), State::Unknown);
+      for (std::size_t i = 0; i < mNodes.size(); i++)
+         mPending[i] = mNodes[i].operands;
+      std::fill(mSpans.begin(), mSpans.end(), std::nullopt);
+
+      evaluateScope<mode>(0, msg.bytes);
+      assert(mState[0] != State::Unknown);
+
+      const bool res = mState[0] == State::True;
+      mStats.matches += res;
+      return res;
+   }
+
+   template <ParserMode mode>
+   bool operator()(const BinMessageView<mode>& msg)
+   {
+      return matches(msg);
+   }
+
+   const PredicateStats& stats() const
+   {
+      return mStats;
+   }
+
+ private:
+   static constexpr std::uint64_t AdaptInterval = 1024;
+
+   enum class State : std::uint8_t
+   {
+      Unknown,
+      False,
+      True
+   };
+
+   // a condition, an And or an Or (the root is node 0)
+   struct Node
+   {
+      Predicate::Kind kind;
+      int parent;
+      std::uint32_t operands;
+   };
+
+   struct Condition
+   {
+      FieldPredicate predicate;
+      int node;
+      // evaluations, and how often the value decided the parent
+      std::uint64_t evaluations = 0;
+      std::uint64_t decisive = 0;
+   };
+
+   // the conditions on a field of a message, and the sub-message in the field
+   struct Slot
+   {
+      int fieldNo;
+      // in the order of evaluation
+      std::vector<std::size_t> conditions;
+      // scope of the conditions in the sub-message (-1: none)
+      int scope;
+      // how often the outcome was known after the field
+      std::uint64_t finalized = 0;
+      std::uint64_t decisive = 0;
+   };
+
+   // a message or sub-message
+   struct Scope
+   {
+      std::size_t firstSlot = 0;
+      std::size_t endSlot = 0;
+      // the slots in the order of evaluation at the end of the message (StrictConforming)
+      std::vector<std::size_t> order;
+   };
+
+   struct BuildSlot
+   {
+      std::vector<std::size_t> conditions;
+      int scope = -1;
+   };
+
+   std::vector<Node> mNodes;
+   std::vector<Condition> mConditions;
+   std::vector<Slot> mSlots;
+   std::vector<Scope> mScopes;
+   PredicateStats mStats;
+
+   // state of the current message
+   std::vector<State> mState;
+   std::vector<std::uint32_t> mPending;
+   // the occurrence of the field of each slot, that FieldReader would read (tag and value)
+   std::vector<std::optional<DataSpan>> mSpans;
+
+   void addNode(const Predicate& pred, int parent, std::vector<std::map<int, BuildSlot>>& scopes)
+   {
+      const int node = static_cast<int>(mNodes.size());
+      mNodes.push_back({pred.mKind, parent, static_cast<std::uint32_t>(pred.mOperands.size())});
+      if (pred.mKind != Predicate::Kind::Condition)
+      {
+         for (const auto& operand : pred.mOperands)
+            addNode(operand, node, scopes);
+         return;
+      }
+
+      std::size_t scope = 0;
+      for (std::size_t i = 0; i + 1 < pred.mPath.size(); i++)
+      {
+         auto child = scopes[scope][pred.mPath[i]].scope;
+         if (child < 0)
+         {
+            child = static_cast<int>(scopes.size());
+            scopes.emplace_back();
+            scopes[scope][pred.mPath[i]].scope = child;
+         }
+         scope = static_cast<std::size_t>(child);
+      }
+      scopes[scope][pred.mPath.back()].conditions.push_back(mConditions.size());
+      mConditions.push_back({*pred.mCondition, node});
+   }
+
+   bool decided() const
+   {
+      return mState[0] != State::Unknown;
+   }
+
+   // the outcome of an operation above node is known (so node needn't be evaluated)
+   bool decidedAbove(int node) const
+   {
+      for (auto n = mNodes[node].parent; n >= 0; n = mNodes[n].parent)
+      {
+         if (mState[n] != State::Unknown)
+            return true;
+      }
+      return false;
+   }
+
+   // sets the outcome of a condition and of the operations that are decided by it
+   void resolve(int node, bool value)
+   {
+      while (true)
+      {
+         mState[node] = value ? State::True : State::False;
+         const auto parent = mNodes[node].parent;
+         if (parent < 0)
+            return;
+         // false decides an And, true an Or, otherwise the last operand decides
+         const bool decides = (mNodes[parent].kind == Predicate::Kind::And) != value;
+         if (!decides && --mPending[parent] > 0)
+            return;
+         node = parent;
+      }
+   }
+
+   void resolveCondition(Condition& cond, bool value)
+   {
+      cond.evaluations++;
+      const auto parent = mNodes[cond.node].parent;
+      if (parent < 0 || (mNodes[parent].kind == Predicate::Kind::And) != value)
+         cond.decisive++;
+      resolve(cond.node, value);
+   }
+
+   // all conditions in a missing sub-message are false, returns whether the outcome is known
+   bool resolveMissing(std::size_t scopeIdx)
+   {
+      const auto& scope = mScopes[scopeIdx];
+      for (auto slotIdx = scope.firstSlot; slotIdx < scope.endSlot; slotIdx++)
+      {
+         const auto& slot = mSlots[slotIdx];
+         for (auto c : slot.conditions)
+         {
+            if (!decidedAbove(mConditions[c].node))
+               resolveCondition(mConditions[c], false);
+            if (decided())
+               return true;
+         }
+         if (slot.scope >= 0 && resolveMissing(static_cast<std::size_t>(slot.scope)))
+            return true;
+      }
+      return false;
+   }
+
+   // evaluates the conditions of a slot with the value of its field, returns whether the outcome is known
+   template <ParserMode mode>
+   bool finalizeSlot(std::size_t slotIdx)
+   {
+      auto& slot = mSlots[slotIdx];
+      const auto& span = mSpans[slotIdx];
+      slot.finalized++;
+
+      for (auto c : slot.conditions)
+      {
+         auto& cond = mConditions[c];
+         if (decidedAbove(cond.node))
+            continue;
+         bool value = false;
+         if (span)
+         {
+            value = cond.predicate.matches(BinMessageView<mode>{*span});
+            mStats.conditionsEvaluated++;
+         }
+         resolveCondition(cond, value);
+         if (decided())
+         {
+            slot.decisive++;
+            return true;
+         }
+      }
+
+      if (slot.scope >= 0)
+      {
+         const auto scope = static_cast<std::size_t>(slot.scope);
+         if (span)
+            evaluateScope<mode>(scope, BinMessageView<mode>{*span}.template get<type::Message>(slot.fieldNo)->bytes);
+         else
+            resolveMissing(scope);
+         if (decided())
+         {
+            slot.decisive++;
+            return true;
+         }
+      }
+      return false;
+   }
+
+   template <ParserMode mode>
+   void evaluateScope(std::size_t scopeIdx, DataSpan bin)
+   {
+      using View = BinMessageView<mode>;
+      constexpr uint32_t WireTypeBitMask = 0b111;
+      const auto& scope = mScopes[scopeIdx];
+
+      if constexpr (mode == ParserMode::StrictConforming)
+      {
+         // a later value of a field replaces an earlier one, so no value is known before the end
+         const auto first = mSlots.begin() + static_cast<std::ptrdiff_t>(scope.firstSlot);
+         const auto last = mSlots.begin() + static_cast<std::ptrdiff_t>(scope.endSlot);
+         while (true)
+         {
+            const auto fieldBegin = bin.data();
+            const auto tag = View::popTag(bin);
+            if (!tag)
+               break;
+            const int fieldNo = tag >> 3;
+            View::skipValue(bin, WireType{tag & WireTypeBitMask});
+
+            const auto slot = std::lower_bound(first, last, fieldNo, [](const Slot& s, int n) { return s.fieldNo < n; });
+            if (slot != last && slot->fieldNo == fieldNo)
+               mSpans[static_cast<std::size_t>(slot - mSlots.begin())] = DataSpan{fieldBegin, static_cast<std::size_t>(bin.data() - fieldBegin)};
+         }
+
+         for (auto slotIdx : scope.order)
+         {
+            if (finalizeSlot<mode>(slotIdx))
+               return;
+         }
+      }
+      else
+      {
+         auto next = scope.firstSlot;
+         while (next < scope.endSlot)
+         {
+            bin.remove_prefix(impl::skipFieldsBelow(bin.data(), bin.size(), mSlots[next].fieldNo));
+
+            const auto fieldBegin = bin.data();
+            const auto tag = View::popTag(bin);
+            if (!tag)
+               break;
+            const int fieldNo = tag >> 3;
+
+            // the values of the fields below are final
+            for (; next < scope.endSlot && mSlots[next].fieldNo < fieldNo; next++)
+            {
+               if (finalizeSlot<mode>(next))
+                  return;
+            }
+
+            View::skipValue(bin, WireType{tag & WireTypeBitMask});
+            if (next < scope.endSlot && mSlots[next].fieldNo == fieldNo)
+            {
+               // like get(), the first occurrence decides, later ones are skipped as fields below the next slot
+               mSpans[next] = DataSpan{fieldBegin, static_cast<std::size_t>(bin.data() - fieldBegin)};
+               if (finalizeSlot<mode>(next++))
+                  return;
+            }
+         }
+
+         for (; next < scope.endSlot; next++)
+         {
+            if (finalizeSlot<mode>(next))
+               return;
+         }
+      }
+   }
+
+   // orders the conditions of each slot (and the slots for StrictConforming) by how often they
+   // decided the outcome, the statistics are halved to follow changes of the data
+   void adapt()
+   {
+      auto rate = [](std::uint64_t decisive, std::uint64_t total) {
+         return total ? static_cast<double>(decisive) / static_cast<double>(total) : 0.0;
+      };
+
+      for (auto& slot : mSlots)
+      {
+         std::stable_sort(slot.conditions.begin(), slot.conditions.end(), [&](std::size_t a, std::size_t b) {
+            return rate(mConditions[a].decisive, mConditions[a].evaluations) > rate(mConditions[b].decisive, mConditions[b].evaluations);
+         });
+      }
+      for (auto& scope : mScopes)
+      {
+         std::stable_sort(scope.order.begin(), scope.order.end(), [&](std::size_t a, std::size_t b) {
+            return rate(mSlots[a].decisive, mSlots[a].finalized) > rate(mSlots[b].decisive, mSlots[b].finalized);
+         });
+      }
+
+      for (auto& cond : mConditions)
+      {
+         cond.evaluations /= 2;
+         cond.decisive /= 2;
+      }
+      for (auto& slot : mSlots)
+      {
+         slot.finalized /= 2;
+         slot.decisive /= 2;
+      }
+   }
+};
+
+inline PredicatePlan Predicate::compile() const
+{
+   return PredicatePlan{*this};
+}
+
+} // namespace pbview
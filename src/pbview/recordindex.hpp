@@ -0,0 +1,278 @@
+#pragma once
+
+#include "blockstatistics.hpp"
+#include "parallelscan.hpp"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pbview
+{
+
+// Sidecar index of a file of length delimited records (see MappedRecordFile), mapping the values
+// of one field to the offsets of the records.
+//
+// Header (32 bytes):
+//   magic "PBVIDX01" | field number (uint32) | kind (uint32, see StatisticsKind) | entry count (uint64) | size of the record file (uint64)
+// followed by the entries sorted by key and offset:
+//   key (uint64) | offset of the length of the record (uint64)
+// Numbers are stored as order preserving keys, strings and bytes as hashes (so these can only be
+// looked up by equality). Records without the field are not indexed. All integers are stored
+// little endian.
+namespace index_format
+{
+   constexpr std::array<char, 8> magic{'P', 'B', 'V', 'I', 'D', 'X', '0', '1'};
+   constexpr std::size_t headerSize = 32;
+   constexpr std::size_t entrySize = 16;
+
+   struct Entry
+   {
+      std::uint64_t key;
+      std::uint64_t offset;
+
+      bool operator<(const Entry& other) const
+      {
+         return key < other.key || (key == other.key && offset < other.offset);
+      }
+   };
+}
+
+// The field of the records, that is indexed:
+//   IndexField::of<type::Int64>(4)
+//   IndexField::of<type::String>(14)
+// The values are read with impl::FieldReader (see there for which value of a repeated field is read).
+struct IndexField
+{
+   int fieldNo;
+   StatisticsKind kind;
+   impl::FieldReader reader;
+
+   template <typename T>
+   static IndexField of(int fieldNo)
+   {
+      return IndexField{fieldNo, impl::statisticsKind<T>(), impl::FieldReader::of<T>()};
+   }
+};
+
+// Extracts field from all records of file (in parallel) and writes the sorted index to os.
+// Returns the number of indexed records.
+template <ParserMode mode>
+std::uint64_t buildRecordIndex(const MappedRecordFile<mode>& file, const IndexField& field, std::ostream& os, ParallelScanOptions options = {})
+{
+   impl::enforce(field.fieldNo > 0, "Invalid field number for index");
+   const auto base = file.bytes().data();
+
+   using Record = typename MappedRecordFile<mode>::Record;
+   auto parts = parallelForEachRecord(file, std::vector<index_format::Entry>{}, [&](std::vector<index_format::Entry>& entries, const Record& record) {
+      if (const auto val = field.reader(record, field.fieldNo))
+         entries.push_back({val->key, static_cast<std::uint64_t>(record.delimited.data() - base)});
+   }, options);
+
+   std::vector<index_format::Entry> entries;
+   for (auto& part : parts)
+   {
+      entries.insert(entries.end(), part.begin(), part.end());
+      part = {};
+   }
+   std::sort(entries.begin(), entries.end());
+
+   std::array<std::byte, index_format::headerSize> header{};
+   memcpy(header.data(), index_format::magic.data(), index_format::magic.size());
+   const auto fieldNo = static_cast<std::uint32_t>(field.fieldNo);
+   const auto kind = static_cast<std::uint32_t>(field.kind);
+   const std::uint64_t count = entries.size();
+   const std::uint64_t dataSize = file.bytes().size();
+   memcpy(header.data() + 8, &fieldNo, 4);
+   memcpy(header.data() + 12, &kind, 4);
+   memcpy(header.data() + 16, &count, 8);
+   memcpy(header.data() + 24, &dataSize, 8);
+
+   os.write(reinterpret_cast<const char*>(header.data()), header.size());
+   static_assert(sizeof(index_format::Entry) == index_format::entrySize);
+   os.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(index_format::Entry)));
+   os.flush();
+   impl::enforce(os.good(), "Failed to write record index");
+   return count;
+}
+
+// Looks up records of a file of length delimited records by the values of a field, with a
+// binary search in an index written by buildRecordIndex() (or the pbview-index tool). The index
+// is mapped into memory, so a lookup only touches O(log n) pages of it and the pages of the found
+// records. The records are views into the data, that must outlive the index.
+template <ParserMode parserMode = ParserMode::Fast>
+class RecordIndex
+{
+ public:
+   using BinView = BinMessageView<parserMode>;
+
+   RecordIndex(DataSpan data, DataSpan index)
+      : mData(data), mIndex(index)
+   {
+      impl::enforce(mIndex.size() >= index_format::headerSize
+                       && std::equal(index_format::magic.begin(), index_format::magic.end(), reinterpret_cast<const char*>(mIndex.data())),
+                    "Not a record index");
+      std::uint32_t fieldNo, kind;
+      std::uint64_t dataSize;
+      memcpy(&fieldNo, mIndex.data() + 8, 4);
+      memcpy(&kind, mIndex.data() + 12, 4);
+      memcpy(&mSize, mIndex.data() + 16, 8);
+      memcpy(&dataSize, mIndex.data() + 24, 8);
+      mFieldNo = static_cast<int>(fieldNo);
+      mKind = static_cast<StatisticsKind>(kind);
+
+      impl::enforce(kind <= static_cast<std::uint32_t>(StatisticsKind::Bytes), "Invalid key kind in record index");
+      impl::enforce(mSize <= (mIndex.size() - index_format::headerSize) / index_format::entrySize, "Record index is truncated");
+      impl::enforce(dataSize == mData.size(), "Record index does not belong to the record file (different size)");
+   }
+
+   // Maps the index file at indexPath
+   RecordIndex(const MappedRecordFile<parserMode>& data, const std::string& indexPath)
+      : RecordIndex(data.bytes(), std::make_unique<MappedFile>(indexPath, MappingOptions{false}))
+   {
+   }
+
+   int fieldNo() const
+   {
+      return mFieldNo;
+   }
+
+   StatisticsKind kind() const
+   {
+      return mKind;
+   }
+
+   // Number of indexed records
+   std::uint64_t size() const
+   {
+      return mSize;
+   }
+
+   // Calls f(BinView) for all records with the value key (in the order of the file), returns
+   // the number of found records
+   template <typename T, typename F>
+   std::size_t forEachRecord(typename T::CppType key, F&& f) const
+   {
+      std::size_t count = 0;
+      visitMatches<T>(key, [&](const BinView& record) {
+         f(record);
+         count++;
+         return true;
+      });
+      return count;
+   }
+
+   // Calls f(BinView) for all records with lo <= value <= hi (ordered by the value), returns
+   // the number of found records
+   template <typename T, typename F>
+   std::size_t forEachRecordInRange(typename T::CppType lo, typename T::CppType hi, F&& f) const
+   {
+      static_assert(impl::statisticsKind<T>() != StatisticsKind::Bytes, "Strings and bytes can only be looked up by equality");
+      const auto loVal = keyOf<T>(lo);
+      const auto hiVal = keyOf<T>(hi);
+      if (!loVal || !hiVal)
+         return 0;
+      std::size_t count = 0;
+      for (auto pos = lowerBound(loVal->key); pos < mSize && entry(pos).key <= hiVal->key; pos++, count++)
+         f(recordAt(entry(pos).offset));
+      return count;
+   }
+
+   // The first record (in the order of the file) with the value key
+   template <typename T>
+   std::optional<BinView> find(typename T::CppType key) const
+   {
+      std::optional<BinView> res;
+      visitMatches<T>(key, [&](const BinView& record) {
+         res = record;
+         return false;
+      });
+      return res;
+   }
+
+   template <typename Msg, typename T>
+   std::optional<View<Msg, BinView>> find(typename T::CppType key) const
+   {
+      if (const auto record = find<T>(key))
+         return View<Msg, BinView>{*record};
+      return std::nullopt;
+   }
+
+ private:
+   std::unique_ptr<MappedFile> mFile;
+   DataSpan mData;
+   DataSpan mIndex;
+   int mFieldNo = 0;
+   StatisticsKind mKind = StatisticsKind::Signed;
+   std::uint64_t mSize = 0;
+
+   RecordIndex(DataSpan data, std::unique_ptr<MappedFile> index)
+      : RecordIndex(data, index->bytes())
+   {
+      mFile = std::move(index);
+   }
+
+   template <typename T>
+   std::optional<impl::StatisticsValue> keyOf(typename T::CppType key) const
+   {
+      impl::enforce(impl::statisticsKind<T>() == mKind, "Key type does not match the record index");
+      return impl::statisticsValue<T>(key);
+   }
+
+   index_format::Entry entry(std::uint64_t pos) const
+   {
+      index_format::Entry res;
+      memcpy(&res, mIndex.data() + index_format::headerSize + pos * index_format::entrySize, sizeof(res));
+      return res;
+   }
+
+   // first entry with a key >= key
+   std::uint64_t lowerBound(std::uint64_t key) const
+   {
+      std::uint64_t first = 0;
+      for (auto count = mSize; count > 0;)
+      {
+         const auto half = count / 2;
+         if (entry(first + half).key < key)
+         {
+            first += half + 1;
+            count -= half + 1;
+         }
+         else
+            count = half;
+      }
+      return first;
+   }
+
+   BinView recordAt(std::uint64_t offset) const
+   {
+      impl::enforce(offset < mData.size(), "Record offset in index is beyond the end of the file");
+      auto bin = mData.substr(offset);
+      return BinView{impl::popDelimitedRecord(bin)};
+   }
+
+   // calls f(BinView) for the records with the value key, until f returns false
+   template <typename T, typename F>
+   void visitMatches(typename T::CppType key, F&& f) const
+   {
+      const auto val = keyOf<T>(key);
+      if (!val)
+         return;
+      for (auto pos = lowerBound(val->key); pos < mSize && entry(pos).key == val->key; pos++)
+      {
+         const auto record = recordAt(entry(pos).offset);
+         // hash collisions
+         if constexpr (impl::statisticsKind<T>() == StatisticsKind::Bytes)
+            if (record.template get<T>(mFieldNo) != key)
+               continue;
+         if (!f(record))
+            return;
+      }
+   }
+};
+
+} // namespace pbview
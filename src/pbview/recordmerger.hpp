@@ -0,0 +1,222 @@
+#pragma once
+
+#include "losertree.hpp"
+#include "mappedrecordfile.hpp"
+#include "sortkey.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace pbview
+{
+
+// Merges sources of length delimited records (e.g. the bytes() of MappedRecordFiles), each
+// sorted by the keys of a SortKeyBuilder, into one sequence in global order:
+//   RecordMerger<> merger{{a.bytes(), b.bytes()}, keys};
+//   while (auto record = merger.next<Order>())
+//      ...
+// Only the head record of each source has a key, which is built once when the record becomes
+// the head and compared as memcmp-able string. The records are views into the sources, they
+// are never copied or deserialized. Records with equal keys are taken from the source with the
+// lower index first. Throws if a source turns out not to be sorted. keys and the sources must
+// outlive the merger.
+template <ParserMode mode = ParserMode::Fast>
+class RecordMerger
+{
+ public:
+   using BinView = BinMessageView<mode>;
+
+   RecordMerger(std::vector<DataSpan> sources, const SortKeyBuilder& keys)
+      : mKeys(keys), mHeads(sources.size()), mTree(initTree(sources))
+   {
+   }
+
+   RecordMerger(const RecordMerger&) = delete;
+   RecordMerger& operator=(const RecordMerger&) = delete;
+
+   // The next record in the order of the keys, empty after the last one
+   std::optional<BinView> next()
+   {
+      if (mTree.empty())
+         return {};
+      mSource = mTree.top();
+      auto& head = mHeads[mSource];
+      const auto record = head.record;
+      mDelimited = head.delimited;
+      mTree.advance(!pop(head));
+      return BinView{record};
+   }
+
+   template <typename Msg>
+   std::optional<View<Msg, BinView>> next()
+   {
+      if (auto record = next())
+         return View<Msg, BinView>{*record};
+      return {};
+   }
+
+   // Index of the source of the record returned by the last call of next()
+   std::size_t source() const
+   {
+      return mSource;
+   }
+
+   // The record returned by the last call of next() with its length (as in its source)
+   DataSpan delimitedRecord() const
+   {
+      return mDelimited;
+   }
+
+ private:
+   struct Head
+   {
+      DataSpan rest;
+      DataSpan record;
+      DataSpan delimited;
+      std::string key;
+      // for checking the order of the source
+      std::string nextKey;
+   };
+
+   // compares the keys of the heads (the vector of the heads is never resized)
+   struct HeadLess
+   {
+      const Head* heads;
+
+      bool operator()(std::size_t a, std::size_t b) const
+      {
+         return heads[a].key < heads[b].key;
+      }
+   };
+
+   const SortKeyBuilder& mKeys;
+   std::vector<Head> mHeads;
+   LoserTree<HeadLess> mTree;
+   std::size_t mSource = 0;
+   DataSpan mDelimited;
+
+   LoserTree<HeadLess> initTree(const std::vector<DataSpan>& sources)
+   {
+      std::vector<bool> exhausted;
+      for (std::size_t i = 0; i < sources.size(); i++)
+      {
+         mHeads[i].rest = sources[i];
+         exhausted.push_back(!pop(mHeads[i], true));
+      }
+      return LoserTree<HeadLess>{sources.size(), HeadLess{mHeads.data()}, std::move(exhausted)};
+   }
+
+   // reads the next record of a source into its head, false at the end of the source
+   bool pop(Head& head, bool first = false)
+   {
+      if (head.rest.empty())
+         return false;
+      const auto begin = head.rest.data();
+      head.record = impl::popDelimitedRecord(head.rest);
+      head.delimited = DataSpan{begin, static_cast<std::size_t>(head.rest.data() - begin)};
+      mKeys.build(BinView{head.record}, head.nextKey);
+      impl::enforce(first || head.key <= head.nextKey, "Record source is not sorted by the merge keys");
+      head.key.swap(head.nextKey);
+      return true;
+   }
+};
+
+struct MergeStats
+{
+   std::uint64_t records = 0;
+   std::uint64_t bytes = 0;
+   // number of writev() calls
+   std::uint64_t writes = 0;
+};
+
+namespace impl
+{
+   // collects byte ranges and writes them with writev(), adjacent ranges are joined
+   class VectoredWriter
+   {
+    public:
+      explicit VectoredWriter(int fd, std::size_t maxRanges = 1024)
+         : mFd(fd), mMaxRanges(maxRanges)
+      {
+         mRanges.reserve(maxRanges);
+      }
+
+      void write(DataSpan bytes)
+      {
+         if (bytes.empty())
+            return;
+         auto* data = const_cast<std::byte*>(bytes.data());
+         if (!mRanges.empty() && static_cast<std::byte*>(mRanges.back().iov_base) + mRanges.back().iov_len == data)
+         {
+            mRanges.back().iov_len += bytes.size();
+            return;
+         }
+         if (mRanges.size() == mMaxRanges)
+            flush();
+         mRanges.push_back(iovec{data, bytes.size()});
+      }
+
+      void flush()
+      {
+         auto* ranges = mRanges.data();
+         auto count = mRanges.size();
+         while (count > 0)
+         {
+            const auto written = ::writev(mFd, ranges, static_cast<int>(count));
+            if (written < 0 && errno == EINTR)
+               continue;
+            enforce(written >= 0, std::string{"Failed to write merged records: "} + std::strerror(errno));
+            mWrites++;
+            // skip the written ranges, a partially written range is continued
+            auto rest = static_cast<std::size_t>(written);
+            for (; count > 0 && rest >= ranges->iov_len; ranges++, count--)
+               rest -= ranges->iov_len;
+            if (count > 0)
+            {
+               ranges->iov_base = static_cast<std::byte*>(ranges->iov_base) + rest;
+               ranges->iov_len -= rest;
+            }
+         }
+         mRanges.clear();
+      }
+
+      std::uint64_t writes() const
+      {
+         return mWrites;
+      }
+
+    private:
+      int mFd;
+      std::size_t mMaxRanges;
+      std::vector<iovec> mRanges;
+      std::uint64_t mWrites = 0;
+   };
+}
+
+// Merges the sorted sources (see RecordMerger) and writes the length delimited records to the
+// file descriptor fd. The bytes are written straight from the sources with writev(), records
+// that follow each other in a source are written as one range.
+template <ParserMode mode = ParserMode::Fast>
+MergeStats mergeRecords(std::vector<DataSpan> sources, const SortKeyBuilder& keys, int fd)
+{
+   MergeStats stats;
+   RecordMerger<mode> merger{std::move(sources), keys};
+   impl::VectoredWriter out{fd};
+   while (merger.next())
+   {
+      stats.records++;
+      stats.bytes += merger.delimitedRecord().size();
+      out.write(merger.delimitedRecord());
+   }
+   out.flush();
+   stats.writes = out.writes();
+   return stats;
+}
+
+} // namespace pbview
@@ -0,0 +1,672 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace pbview
+{
+
+// A serialized message, that is split into several chunks of memory (e.g. the buffers of a network stack).
+// The chunks are not copied and have to outlive the sequence and all views on it.
+class ChunkSequence
+{
+ public:
+   explicit ChunkSequence(const std::vector<DataSpan>& chunks)
+   {
+      for (auto chunk : chunks)
+      {
+         if (chunk.empty())
+            continue;
+         mChunks.push_back(chunk);
+         mStarts.push_back(mSize);
+         mSize += chunk.size();
+      }
+   }
+
+   std::size_t size() const
+   {
+      return mSize;
+   }
+
+   std::size_t chunkCount() const
+   {
+      return mChunks.size();
+   }
+
+   DataSpan chunk(std::size_t idx) const
+   {
+      return mChunks[idx];
+   }
+
+   std::size_t chunkStart(std::size_t idx) const
+   {
+      return mStarts[idx];
+   }
+
+   // Index of the chunk that contains offset (chunkCount() for the end of the sequence)
+   std::size_t chunkIndexOf(std::size_t offset) const
+   {
+      if (offset >= mSize)
+         return mChunks.size();
+      return static_cast<std::size_t>(std::upper_bound(mStarts.begin(), mStarts.end(), offset) - mStarts.begin()) - 1;
+   }
+
+   // Calls f(DataSpan) with the parts of [begin, end) in the single chunks
+   template <typename F>
+   void forEachPart(std::size_t begin, std::size_t end, F&& f) const
+   {
+      for (auto idx = chunkIndexOf(begin); begin < end; idx++)
+      {
+         auto part = mChunks[idx].substr(begin - mStarts[idx], end - begin);
+         f(part);
+         begin += part.size();
+      }
+   }
+
+   void copy(std::size_t begin, std::size_t end, std::byte* out) const
+   {
+      forEachPart(begin, end, [&out](DataSpan part) {
+         memcpy(out, part.data(), part.size());
+         out += part.size();
+      });
+   }
+
+   // [begin, end) as flat memory: the chunk itself or a copy, that is owned by the sequence. A value
+   // spanning chunks is joined on its first access, later accesses return the same copy. Thread-safe.
+   DataSpan flat(std::size_t begin, std::size_t end) const
+   {
+      const auto idx = chunkIndexOf(begin);
+      if (idx < mChunks.size() && end - mStarts[idx] <= mChunks[idx].size())
+         return mChunks[idx].substr(begin - mStarts[idx], end - begin);
+
+      const auto key = std::make_pair(begin, end);
+      {
+         std::lock_guard<std::mutex> lock{mMutex};
+         if (auto it = mJoined.find(key); it != mJoined.end())
+            return DataSpan{it->second.get(), end - begin};
+      }
+
+      auto storage = std::make_unique<std::byte[]>(end - begin);
+      copy(begin, end, storage.get());
+
+      // another thread may have joined the value in the meantime
+      std::lock_guard<std::mutex> lock{mMutex};
+      const auto it = mJoined.emplace(key, std::move(storage)).first;
+      return DataSpan{it->second.get(), end - begin};
+   }
+
+ private:
+   std::vector<DataSpan> mChunks;
+   std::vector<std::size_t> mStarts;
+   std::size_t mSize = 0;
+
+   mutable std::mutex mMutex;
+   // joined copies of values spanning chunks by [begin, end)
+   mutable std::map<std::pair<std::size_t, std::size_t>, std::unique_ptr<std::byte[]>> mJoined;
+};
+
+// A length delimited value, that may span several chunks (referenced, not copied)
+class ChunkedBytes
+{
+ public:
+   ChunkedBytes() = default;
+
+   ChunkedBytes(const ChunkSequence& chunks, std::size_t begin, std::size_t end)
+      : mChunks(&chunks), mBegin(begin), mEnd(end)
+   {
+   }
+
+   std::size_t size() const
+   {
+      return mEnd - mBegin;
+   }
+
+   bool empty() const
+   {
+      return mBegin == mEnd;
+   }
+
+   // Calls f(DataSpan) with the parts of the value in the single chunks
+   template <typename F>
+   void forEachChunk(F&& f) const
+   {
+      if (mChunks)
+         mChunks->forEachPart(mBegin, mEnd, std::forward<F>(f));
+   }
+
+   std::vector<DataSpan> chunks() const
+   {
+      std::vector<DataSpan> res;
+      forEachChunk([&res](DataSpan part) { res.push_back(part); });
+      return res;
+   }
+
+   std::string toString() const
+   {
+      std::string res(size(), '\0');
+      if (mChunks)
+         mChunks->copy(mBegin, mEnd, reinterpret_cast<std::byte*>(res.data()));
+      return res;
+   }
+
+   friend bool operator==(const ChunkedBytes& l, std::string_view r)
+   {
+      if (l.size() != r.size())
+         return false;
+      bool equal = true;
+      l.forEachChunk([&](DataSpan part) {
+         equal = equal && memcmp(part.data(), r.data(), part.size()) == 0;
+         r.remove_prefix(part.size());
+      });
+      return equal;
+   }
+
+   friend bool operator!=(const ChunkedBytes& l, std::string_view r)
+   {
+      return !(l == r);
+   }
+
+ private:
+   const ChunkSequence* mChunks = nullptr;
+   std::size_t mBegin = 0;
+   std::size_t mEnd = 0;
+};
+
+namespace type
+{
+// string or bytes field, that is returned without copying by SegmentedBinMessageView, even if it spans several chunks
+struct Chunked
+{
+   using CppType = ChunkedBytes;
+   static constexpr auto serialization = Serialization::LengthDelimited;
+};
+} // namespace type
+
+// BinView on a message, that is split into several chunks of memory (also usable with the generated views).
+// Values are parsed directly from the chunks, only tags, varints and fixed values, that straddle the border
+// of two chunks, are copied into a small scratch buffer. Sub-messages are views on the same chunks.
+//
+// get<type::String>() and get<type::Bytes>() have to return flat std::string_views: values spanning several
+// chunks are copied into storage owned by the ChunkSequence. Use get<type::Chunked>() to avoid these copies.
+template <ParserMode mode = ParserMode::Fast>
+struct SegmentedBinMessageView
+{
+   explicit SegmentedBinMessageView(DataSpan span)
+      : SegmentedBinMessageView(std::vector<DataSpan>{span})
+   {
+   }
+
+   explicit SegmentedBinMessageView(const std::vector<DataSpan>& chunks)
+      : SegmentedBinMessageView(std::make_shared<const ChunkSequence>(chunks))
+   {
+   }
+
+   explicit SegmentedBinMessageView(std::shared_ptr<const ChunkSequence> chunks)
+      : mChunks(std::move(chunks)), mBegin(0), mEnd(mChunks->size())
+   {
+   }
+
+   SegmentedBinMessageView(std::shared_ptr<const ChunkSequence> chunks, std::size_t begin, std::size_t end)
+      : mChunks(std::move(chunks)), mBegin(begin), mEnd(end)
+   {
+      impl::enforce(begin <= end && end <= mChunks->size(), "Message is not part of the chunk sequence");
+   }
+
+   static SegmentedBinMessageView fromBytesString(std::string_view sv)
+   {
+      return SegmentedBinMessageView{DataSpan{reinterpret_cast<const std::byte *>(sv.data()), sv.size()}};
+   }
+
+   const ChunkSequence& chunks() const
+   {
+      return *mChunks;
+   }
+
+   // the bytes of the message within the chunks
+   ChunkedBytes bytes() const
+   {
+      return ChunkedBytes{*mChunks, mBegin, mEnd};
+   }
+
+ private:
+   using Reader = BinMessageView<mode>;
+
+   std::shared_ptr<const ChunkSequence> mChunks;
+   std::size_t mBegin;
+   std::size_t mEnd;
+
+   // Position within the chunks
+   class Cursor
+   {
+    public:
+      Cursor(const ChunkSequence& chunks, std::size_t begin, std::size_t end)
+         : mChunks(&chunks), mPos(begin), mEnd(end), mIdx(chunks.chunkIndexOf(begin))
+      {
+      }
+
+      bool empty() const
+      {
+         return mPos == mEnd;
+      }
+
+      std::size_t pos() const
+      {
+         return mPos;
+      }
+
+      std::size_t end() const
+      {
+         return mEnd;
+      }
+
+      // the rest of the current chunk (within the message)
+      DataSpan current() const
+      {
+         if (mPos == mEnd)
+            return {};
+         return mChunks->chunk(mIdx).substr(mPos - mChunks->chunkStart(mIdx), mEnd - mPos);
+      }
+
+      void advance(std::size_t n)
+      {
+         impl::enforce(n <= mEnd - mPos, "Input is shorter than the expected value");
+         mPos += n;
+         if (mIdx < mChunks->chunkCount() && mPos - mChunks->chunkStart(mIdx) >= mChunks->chunk(mIdx).size())
+            mIdx = mChunks->chunkIndexOf(mPos);
+      }
+
+      // Calls pop(DataSpan&) on the current chunk, if it contains at least maxLen bytes (or the rest of the message).
+      // Otherwise the bytes are copied from the following chunks into a scratch buffer.
+      template <typename Pop>
+      auto popContiguous(Pop&& pop)
+      {
+         // longest varint
+         constexpr std::size_t maxLen = 10;
+
+         const auto cur = current();
+         if (cur.size() >= maxLen || cur.size() == mEnd - mPos)
+         {
+            auto bin = cur;
+            auto res = pop(bin);
+            advance(cur.size() - bin.size());
+            return res;
+         }
+
+         // zero-filled, so that varints are terminated even without bounds checking
+         std::byte scratch[2 * maxLen]{};
+         const auto n = std::min(maxLen, mEnd - mPos);
+         mChunks->copy(mPos, mPos + n, scratch);
+
+         DataSpan bin{scratch, n};
+         auto res = pop(bin);
+         advance(n - bin.size());
+         return res;
+      }
+
+      std::uint32_t popTag()
+      {
+         if (empty())
+            return 0;
+         return popContiguous([](DataSpan& bin) { return Reader::popTag(bin); });
+      }
+
+      std::uint32_t popLength()
+      {
+         return popContiguous([](DataSpan& bin) { return Reader::template popVarint<std::uint32_t>(bin); });
+      }
+
+    private:
+      const ChunkSequence* mChunks;
+      std::size_t mPos;
+      std::size_t mEnd;
+      std::size_t mIdx;
+   };
+
+   Cursor cursor() const
+   {
+      return Cursor{*mChunks, mBegin, mEnd};
+   }
+
+   static void skipValue(Cursor& cursor, WireType type)
+   {
+      switch (type)
+      {
+      case WireType::Varint:
+         cursor.popContiguous([](DataSpan& bin) { return Reader::popVarint(bin); });
+         return;
+      case WireType::Bits32:
+         cursor.advance(sizeof(std::uint32_t));
+         return;
+      case WireType::Bits64:
+         cursor.advance(sizeof(std::uint64_t));
+         return;
+      case WireType::LengthDelimited:
+         cursor.advance(cursor.popLength());
+         return;
+      default:
+         throw std::runtime_error("Failed to skip field with unknown wire type " + std::to_string(static_cast<int>(type)));
+      }
+   }
+
+   static std::optional<WireType> seekToNextField(Cursor& cursor, int fieldNo)
+   {
+      while (true)
+      {
+         // runs of small fields within the current chunk are skipped in blocks
+         if constexpr (mode != ParserMode::StrictConforming)
+         {
+            const auto cur = cursor.current();
+            cursor.advance(impl::skipFieldsBelow(cur.data(), cur.size(), fieldNo));
+         }
+
+         const auto tag = cursor.popTag();
+         if (!tag)
+            return {};
+
+         const int currentFieldNumber = tag >> 3;
+         constexpr uint32_t WireTypeBitMask = 0b111;
+         const WireType type{tag & WireTypeBitMask};
+
+         if (currentFieldNumber == fieldNo)
+            return type;
+
+         if constexpr (mode != ParserMode::StrictConforming)
+         {
+            if (currentFieldNumber > fieldNo)
+               return {};
+         }
+
+         skipValue(cursor, type);
+      }
+   }
+
+   static std::optional<WireType> seekToField(Cursor& cursor, int fieldNo)
+   {
+      if constexpr (mode == ParserMode::StrictConforming)
+      {
+         std::optional<WireType> res;
+         auto pos = cursor;
+         while (auto next = seekToNextField(pos, fieldNo))
+         {
+            res = next;
+            cursor = pos;
+            skipValue(pos, *next);
+         }
+         return res;
+      }
+      else
+         return seekToNextField(cursor, fieldNo);
+   }
+
+   template <typename T>
+   auto popNextValue(Cursor& cursor) const -> typename T::CppType
+   {
+      using CppType = typename T::CppType;
+
+      if constexpr (T::serialization == Serialization::LengthDelimited)
+      {
+         const auto len = cursor.popLength();
+         const auto valueBegin = cursor.pos();
+         cursor.advance(len);
+
+         if constexpr (std::is_same_v<CppType, ChunkedBytes>)
+            return ChunkedBytes{*mChunks, valueBegin, valueBegin + len};
+         else if constexpr (std::is_constructible_v<CppType, SegmentedBinMessageView>)
+            return CppType{SegmentedBinMessageView{mChunks, valueBegin, valueBegin + len}};
+         else
+            return impl::Conv<CppType>::conv(mChunks->flat(valueBegin, valueBegin + len));
+      }
+      else
+         return cursor.popContiguous([](DataSpan& bin) { return Reader::template popNextValue<T>(bin); });
+   }
+
+   template <typename T>
+   auto popNextField(Cursor& cursor, int fieldNo) const -> std::optional<typename T::CppType>
+   {
+      if (auto wireType = seekToNextField(cursor, fieldNo))
+      {
+         if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+            impl::enforce(wireType == Reader::template wireTypeOf<T>(), "Invalid wire type!");
+         return popNextValue<T>(cursor);
+      }
+      return {};
+   }
+
+   // Elements of a repeated field: popNext(view, cursor) returns the next element or std::nullopt
+   template <typename T, typename PopNext>
+   struct Values
+       : ranges::view_facade<Values<T, PopNext>, ranges::finite>
+   {
+    private:
+      friend ranges::range_access;
+      using CppType = typename T::CppType;
+
+      std::optional<SegmentedBinMessageView> mView;
+      std::optional<Cursor> mStart;
+      PopNext mPopNext;
+
+      struct cursor
+      {
+       private:
+         const Values* mRng = nullptr;
+         std::optional<Cursor> mPos;
+         std::optional<CppType> mValue;
+
+       public:
+         cursor() = default;
+
+         explicit cursor(const Values& rng)
+             : mRng(&rng), mPos(rng.mStart)
+         {
+            next();
+         }
+
+         void next()
+         {
+            mValue.reset();
+            if (mPos)
+               mValue = mRng->mPopNext(*mRng->mView, *mPos);
+         }
+
+         CppType read() const
+         {
+            return *mValue;
+         }
+
+         bool equal(ranges::default_sentinel) const
+         {
+            return !mValue;
+         }
+
+         bool equal(const cursor& other) const
+         {
+            return (mValue.has_value() == other.mValue.has_value()) && (!mValue || mPos->pos() == other.mPos->pos());
+         }
+      };
+
+      cursor begin_cursor() const
+      {
+         return cursor{*this};
+      }
+
+    public:
+      Values() = default;
+
+      Values(const SegmentedBinMessageView& view, std::optional<Cursor> start, PopNext popNext)
+         : mView(view), mStart(start), mPopNext(popNext)
+      {
+      }
+
+      // Number of elements (scans the field, but does not decode the values)
+      std::size_t size() const
+      {
+         std::size_t n = 0;
+         for (auto it = begin_cursor(); !it.equal(ranges::default_sentinel{}); it.next())
+            n++;
+         return n;
+      }
+
+      template <typename OutputIt, typename = std::enable_if_t<!std::is_pointer_v<OutputIt>>>
+      OutputIt copyTo(OutputIt out) const
+      {
+         for (auto it = begin_cursor(); !it.equal(ranges::default_sentinel{}); it.next())
+            *out++ = it.read();
+         return out;
+      }
+
+      std::size_t copyTo(CppType* out, std::size_t capacity) const
+      {
+         std::size_t n = 0;
+         for (auto it = begin_cursor(); n < capacity && !it.equal(ranges::default_sentinel{}); it.next())
+            out[n++] = it.read();
+         return n;
+      }
+
+      template <typename Alloc>
+      void copyTo(std::vector<CppType, Alloc>& out) const
+      {
+         out.reserve(out.size() + size());
+         copyTo(std::back_inserter(out));
+      }
+   };
+
+   template <typename T>
+   struct PopRepeated
+   {
+      int fieldNo;
+
+      std::optional<typename T::CppType> operator()(const SegmentedBinMessageView& view, Cursor& cursor) const
+      {
+         return view.popNextField<T>(cursor, fieldNo);
+      }
+   };
+
+   template <typename T>
+   struct PopPacked
+   {
+      std::optional<typename T::CppType> operator()(const SegmentedBinMessageView& view, Cursor& cursor) const
+      {
+         if (cursor.empty())
+            return {};
+         return view.popNextValue<T>(cursor);
+      }
+   };
+
+ public:
+   bool has(int fieldNo) const
+   {
+      auto pos = cursor();
+      return seekToNextField(pos, fieldNo) != std::nullopt;
+   }
+
+   template <typename T>
+   auto get(int fieldNo) const -> typename std::optional<typename T::CppType>
+   {
+      auto pos = cursor();
+      if (auto wireType = seekToField(pos, fieldNo))
+      {
+         if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+            impl::enforce(wireType == Reader::template wireTypeOf<T>(), "Invalid wire type!");
+         return popNextValue<T>(pos);
+      }
+      return {};
+   }
+
+   template <typename T>
+   auto getRepeated(int fieldNo) const
+   {
+      return Values<T, PopRepeated<T>>{*this, cursor(), PopRepeated<T>{fieldNo}};
+   }
+
+   template <typename T>
+   auto getPackedRepeated(int fieldNo) const
+   {
+      auto pos = cursor();
+      std::optional<Cursor> values;
+      if (auto wireType = seekToNextField(pos, fieldNo))
+      {
+         if constexpr (mode != ParserMode::Fast_WithoutBoundsChecking)
+            impl::enforce(wireType == WireType::LengthDelimited, "Invalid wire type on reading packed repeated field");
+         const auto len = pos.popLength();
+         impl::enforce(len <= pos.end() - pos.pos(), "Input too short for expected packed repeated field");
+         values = Cursor{*mChunks, pos.pos(), pos.pos() + len};
+      }
+      return Values<T, PopPacked<T>>{*this, values, PopPacked<T>{}};
+   }
+};
+
+// ZeroCopyInputStream over the bytes of a view (e.g. for parsing with google/protobuf)
+class ChunkedBytesInputStream : public google::protobuf::io::ZeroCopyInputStream
+{
+ public:
+   explicit ChunkedBytesInputStream(const ChunkedBytes& bytes)
+      : mChunks(bytes.chunks())
+   {
+   }
+
+   bool Next(const void** data, int* size) override
+   {
+      if (mIdx == mChunks.size())
+         return false;
+      auto chunk = mChunks[mIdx].substr(mOffset);
+      *data = chunk.data();
+      *size = static_cast<int>(chunk.size());
+      mByteCount += chunk.size();
+      mIdx++;
+      mOffset = 0;
+      return true;
+   }
+
+   void BackUp(int count) override
+   {
+      mIdx--;
+      mOffset = mChunks[mIdx].size() - static_cast<std::size_t>(count);
+      mByteCount -= static_cast<std::size_t>(count);
+   }
+
+   bool Skip(int count) override
+   {
+      const void* data;
+      int size;
+      while (count > 0 && Next(&data, &size))
+      {
+         if (size > count)
+         {
+            BackUp(size - count);
+            return true;
+         }
+         count -= size;
+      }
+      return count == 0;
+   }
+
+   std::int64_t ByteCount() const override
+   {
+      return static_cast<std::int64_t>(mByteCount);
+   }
+
+ private:
+   std::vector<DataSpan> mChunks;
+   std::size_t mIdx = 0;
+   std::size_t mOffset = 0;
+   std::size_t mByteCount = 0;
+};
+
+template <typename T, ParserMode parserMode>
+T deserialize(const SegmentedBinMessageView<parserMode>& msgView)
+{
+   T msg;
+   ChunkedBytesInputStream stream{msgView.bytes()};
+   google::protobuf::io::CodedInputStream is{&stream};
+   msg.MergePartialFromCodedStream(&is);
+   return msg;
+}
+
+} // namespace pbview
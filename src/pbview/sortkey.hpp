@@ -0,0 +1,178 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace pbview
+{
+
+enum class SortOrder
+{
+   Ascending,
+   Descending
+};
+
+namespace impl
+{
+   // Sub-message as view with the parser mode of the parent
+   template <ParserMode mode>
+   struct SubMessage
+   {
+      using CppType = BinMessageView<mode>;
+      static constexpr auto serialization = Serialization::LengthDelimited;
+   };
+
+   template <typename UInt>
+   void appendBigEndian(std::string& out, UInt val)
+   {
+      for (int shift = (sizeof(UInt) - 1) * 8; shift >= 0; shift -= 8)
+         out.push_back(static_cast<char>(val >> shift));
+   }
+
+   // Appends an encoding of val, that compares like val with memcmp (as unsigned bytes):
+   // integers big endian with flipped sign bit, floating point numbers with flipped sign bit
+   // (and all bits if negative), strings and bytes with 0x00 escaped as 0x00 0xff and terminated
+   // by 0x00 0x00, so that no encoded string is a prefix of another one.
+   template <typename T>
+   void appendSortKey(std::string& out, typename T::CppType val)
+   {
+      using Cpp = typename T::CppType;
+      if constexpr (std::is_same_v<Cpp, std::string_view>)
+      {
+         for (char c : val)
+         {
+            out.push_back(c);
+            if (c == '\0')
+               out.push_back('\xff');
+         }
+         out.append(2, '\0');
+      }
+      else if constexpr (std::is_floating_point_v<Cpp>)
+      {
+         using Bits = std::conditional_t<sizeof(Cpp) == 4, std::uint32_t, std::uint64_t>;
+         constexpr Bits signBit = Bits{1} << (sizeof(Bits) * 8 - 1);
+         // -0.0 == 0.0, all NaNs are equal and greater than infinity
+         if (val == 0)
+            val = 0;
+         if (std::isnan(val))
+            val = std::numeric_limits<Cpp>::quiet_NaN();
+         Bits bits;
+         memcpy(&bits, &val, sizeof(bits));
+         appendBigEndian(out, (bits & signBit) ? Bits(~bits) : Bits(bits | signBit));
+      }
+      else if constexpr (std::is_same_v<Cpp, bool>)
+         out.push_back(val ? '\x01' : '\0');
+      else if constexpr (std::is_enum_v<Cpp> || std::is_signed_v<Cpp>)
+      {
+         using Int = typename std::conditional_t<std::is_enum_v<Cpp>, std::underlying_type<Cpp>, std::common_type<Cpp>>::type;
+         using UInt = std::make_unsigned_t<Int>;
+         appendBigEndian(out, static_cast<UInt>(static_cast<UInt>(static_cast<Int>(val)) ^ (UInt{1} << (sizeof(UInt) * 8 - 1))));
+      }
+      else
+      {
+         static_assert(std::is_unsigned_v<Cpp>, "Sort keys are only supported for scalar, string and bytes fields");
+         appendBigEndian(out, val);
+      }
+   }
+}
+
+// Builds keys of messages, that compare with memcmp (or std::string's operator<) like the
+// messages compare by a list of fields:
+//   SortKeyBuilder keys;
+//   keys.add<type::String>(14).add<type::Int64>(4, SortOrder::Descending).add<type::Int32>({17, 1});
+//   std::string key = keys(view);
+// Fields in sub-messages are given by their path (the field numbers of the sub-messages followed
+// by the number of the field). Records without a field (or its sub-message) sort before all
+// values in ascending order. The values are read with BinMessageView::get() (see impl::FieldReader
+// for which value of a repeated field is read), so building a key never deserializes the message.
+class SortKeyBuilder
+{
+ public:
+   template <typename T>
+   SortKeyBuilder& add(int fieldNo, SortOrder order = SortOrder::Ascending)
+   {
+      return add<T>(std::vector<int>{fieldNo}, order);
+   }
+
+   template <typename T>
+   SortKeyBuilder& add(std::vector<int> path, SortOrder order = SortOrder::Ascending)
+   {
+      impl::enforce(!path.empty(), "Empty field path for sort key");
+      mParts.push_back(Part{std::move(path), order,
+                            std::make_tuple(&appendField<T, ParserMode::Fast_WithoutBoundsChecking>, &appendField<T, ParserMode::Fast>,
+                                            &appendField<T, ParserMode::StrictConforming>)});
+      return *this;
+   }
+
+   // Number of fields of the keys
+   std::size_t size() const
+   {
+      return mParts.size();
+   }
+
+   // Writes the key of record to out (reusing its memory)
+   template <ParserMode mode>
+   void build(const BinMessageView<mode>& record, std::string& out) const
+   {
+      out.clear();
+      for (const auto& part : mParts)
+      {
+         const auto begin = out.size();
+         std::optional<BinMessageView<mode>> msg = record;
+         for (std::size_t i = 0; msg && i + 1 < part.path.size(); i++)
+            msg = msg->template get<impl::SubMessage<mode>>(part.path[i]);
+
+         if (msg)
+            std::get<Append<mode>>(part.appenders)(*msg, part.path.back(), out);
+         else
+            out.push_back('\0');
+
+         if (part.order == SortOrder::Descending)
+            for (auto i = begin; i < out.size(); i++)
+               out[i] = static_cast<char>(~out[i]);
+      }
+   }
+
+   template <ParserMode mode>
+   std::string operator()(const BinMessageView<mode>& record) const
+   {
+      std::string res;
+      build(record, res);
+      return res;
+   }
+
+ private:
+   template <ParserMode mode>
+   using Append = void (*)(const BinMessageView<mode>&, int, std::string&);
+
+   struct Part
+   {
+      std::vector<int> path;
+      SortOrder order;
+      std::tuple<Append<ParserMode::Fast_WithoutBoundsChecking>, Append<ParserMode::Fast>, Append<ParserMode::StrictConforming>> appenders;
+   };
+
+   std::vector<Part> mParts;
+
+   // a presence byte followed by the value
+   template <typename T, ParserMode mode>
+   static void appendField(const BinMessageView<mode>& msg, int fieldNo, std::string& out)
+   {
+      if (const auto val = msg.template get<T>(fieldNo))
+      {
+         out.push_back('\x01');
+         impl::appendSortKey<T>(out, *val);
+      }
+      else
+         out.push_back('\0');
+   }
+};
+
+} // namespace pbview
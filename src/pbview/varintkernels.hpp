@@ -0,0 +1,342 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PBVIEW_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace pbview
+{
+namespace impl
+{
+
+enum class SimdLevel
+{
+   Scalar,
+   Sse41,
+   Avx2
+};
+
+inline SimdLevel detectSimdLevel()
+{
+#ifdef PBVIEW_X86_KERNELS
+   static const SimdLevel level = [] {
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+         return SimdLevel::Avx2;
+      if (__builtin_cpu_supports("sse4.1"))
+         return SimdLevel::Sse41;
+      return SimdLevel::Scalar;
+   }();
+   return level;
+#else
+   return SimdLevel::Scalar;
+#endif
+}
+
+// Result of a bulk decoding step: the kernels stop at the first value they can't handle
+// (varints longer than 8 bytes, not enough input or output space left) and leave the rest
+// to the scalar decoder of the caller.
+struct BulkDecodeResult
+{
+   std::size_t bytesConsumed;
+   std::size_t valuesWritten;
+};
+
+// Packs the 7 bit groups of a varint of at most 8 bytes (continuation bits are ignored).
+inline std::uint64_t compactVarint(std::uint64_t word, std::size_t len)
+{
+   if (len < 8)
+      word &= (std::uint64_t{1} << (8 * len)) - 1;
+   word &= 0x7f7f7f7f7f7f7f7full;
+   word = (word & 0x007f007f007f007full) | ((word & 0x7f007f007f007f00ull) >> 1);
+   word = (word & 0x00003fff00003fffull) | ((word & 0x3fff00003fff0000ull) >> 2);
+   word = (word & 0x000000000fffffffull) | ((word & 0x0fffffff00000000ull) >> 4);
+   return word;
+}
+
+template <typename Int, bool zigZag>
+inline void storeValue(std::byte* out, std::uint64_t val)
+{
+   using UInt = std::make_unsigned_t<Int>;
+   auto n = static_cast<UInt>(val);
+   if constexpr (zigZag)
+      n = (n >> 1) ^ (~(n & 1) + 1);
+   memcpy(out, &n, sizeof(UInt));
+}
+
+// Decodes all varints with their last byte inside of [begin, begin + blockSize) with the help of the
+// terminator bitmask of the block. Requires at least blockSize + 8 readable bytes.
+template <typename Int, bool zigZag>
+inline std::size_t decodeBlockWithMask(const std::uint8_t* begin, std::uint32_t terminators, std::byte*& out, std::size_t& valuesWritten)
+{
+   std::size_t start = 0;
+   while (terminators)
+   {
+      const auto last = static_cast<std::size_t>(__builtin_ctz(terminators));
+      const auto len = last - start + 1;
+      if (len > 8)
+         break;
+
+      std::uint64_t word;
+      memcpy(&word, begin + start, sizeof(word));
+      storeValue<Int, zigZag>(out, compactVarint(word, len));
+      out += sizeof(Int);
+      valuesWritten++;
+
+      start = last + 1;
+      terminators &= terminators - 1;
+   }
+   return start;
+}
+
+#ifdef PBVIEW_X86_KERNELS
+
+// Widens 16 single byte varints to Int (zig-zag decoding is done on the bytes before sign extension).
+template <typename Int, bool zigZag>
+__attribute__((target("sse4.1"))) inline void widenBytes16(__m128i vals, std::byte* out)
+{
+   if constexpr (zigZag)
+   {
+      const __m128i magnitude = _mm_and_si128(_mm_srli_epi16(vals, 1), _mm_set1_epi8(0x7f));
+      const __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(vals, _mm_set1_epi8(1)));
+      vals = _mm_xor_si128(magnitude, sign);
+   }
+
+   // padded, as every load reads 16 bytes
+   alignas(16) std::uint8_t lanes[32];
+   _mm_store_si128(reinterpret_cast<__m128i*>(lanes), vals);
+
+   constexpr std::size_t perStore = 16 / sizeof(Int);
+   for (std::size_t i = 0; i < 16; i += perStore)
+   {
+      const __m128i part = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + i));
+      __m128i wide;
+      if constexpr (sizeof(Int) == 4)
+         wide = zigZag ? _mm_cvtepi8_epi32(part) : _mm_cvtepu8_epi32(part);
+      else
+         wide = zigZag ? _mm_cvtepi8_epi64(part) : _mm_cvtepu8_epi64(part);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * sizeof(Int)), wide);
+   }
+}
+
+template <typename Int, bool zigZag>
+__attribute__((target("sse4.1"))) BulkDecodeResult decodeVarintsSse41(const std::uint8_t* in, std::size_t inSize, std::byte* out, std::size_t capacity)
+{
+   constexpr std::size_t blockSize = 16;
+   std::size_t pos = 0;
+   std::size_t written = 0;
+
+   while (inSize - pos >= blockSize + 8 && capacity - written >= blockSize)
+   {
+      const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos));
+      const auto continuation = static_cast<std::uint32_t>(_mm_movemask_epi8(bytes));
+      if (continuation == 0)
+      {
+         widenBytes16<Int, zigZag>(bytes, out);
+         out += blockSize * sizeof(Int);
+         written += blockSize;
+         pos += blockSize;
+         continue;
+      }
+
+      const auto consumed = decodeBlockWithMask<Int, zigZag>(in + pos, ~continuation & 0xffffu, out, written);
+      if (consumed == 0)
+         break;
+      pos += consumed;
+   }
+
+   return {pos, written};
+}
+
+template <typename Int, bool zigZag>
+__attribute__((target("avx2"))) BulkDecodeResult decodeVarintsAvx2(const std::uint8_t* in, std::size_t inSize, std::byte* out, std::size_t capacity)
+{
+   constexpr std::size_t blockSize = 32;
+   std::size_t pos = 0;
+   std::size_t written = 0;
+
+   while (inSize - pos >= blockSize + 8 && capacity - written >= blockSize)
+   {
+      const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + pos));
+      const auto continuation = static_cast<std::uint32_t>(_mm256_movemask_epi8(bytes));
+      if (continuation == 0)
+      {
+         __m256i vals = bytes;
+         if constexpr (zigZag)
+         {
+            const __m256i magnitude = _mm256_and_si256(_mm256_srli_epi16(vals, 1), _mm256_set1_epi8(0x7f));
+            const __m256i sign = _mm256_sub_epi8(_mm256_setzero_si256(), _mm256_and_si256(vals, _mm256_set1_epi8(1)));
+            vals = _mm256_xor_si256(magnitude, sign);
+         }
+
+         // padded, as every load reads 16 bytes
+         alignas(32) std::uint8_t lanes[blockSize + 16];
+         _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), vals);
+         constexpr std::size_t perStore = 32 / sizeof(Int);
+         for (std::size_t i = 0; i < blockSize; i += perStore)
+         {
+            const __m128i part = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + i));
+            __m256i wide;
+            if constexpr (sizeof(Int) == 4)
+               wide = zigZag ? _mm256_cvtepi8_epi32(part) : _mm256_cvtepu8_epi32(part);
+            else
+               wide = zigZag ? _mm256_cvtepi8_epi64(part) : _mm256_cvtepu8_epi64(part);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * sizeof(Int)), wide);
+         }
+
+         out += blockSize * sizeof(Int);
+         written += blockSize;
+         pos += blockSize;
+         continue;
+      }
+
+      const auto consumed = decodeBlockWithMask<Int, zigZag>(in + pos, ~continuation, out, written);
+      if (consumed == 0)
+         break;
+      pos += consumed;
+   }
+
+   return {pos, written};
+}
+
+#endif
+
+// Decodes as many packed varints from in into out (an array of Int) as possible.
+// Returns early (with partial results), where the scalar decoder has to continue.
+template <typename Int, bool zigZag>
+BulkDecodeResult decodeVarints(const std::byte* in, std::size_t inSize, std::byte* out, std::size_t capacity, SimdLevel level)
+{
+   static_assert(sizeof(Int) == 4 || sizeof(Int) == 8);
+   auto bytes = reinterpret_cast<const std::uint8_t*>(in);
+
+   switch (level)
+   {
+#ifdef PBVIEW_X86_KERNELS
+   case SimdLevel::Avx2:
+      return decodeVarintsAvx2<Int, zigZag>(bytes, inSize, out, capacity);
+   case SimdLevel::Sse41:
+      return decodeVarintsSse41<Int, zigZag>(bytes, inSize, out, capacity);
+#endif
+   default:
+      return {0, 0};
+   }
+}
+
+// Bit i is set, if byte i of the 32 bytes at p is the last byte of a varint.
+inline std::uint32_t varintTerminators32(const std::uint8_t* p)
+{
+#ifdef __SSE2__
+   const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+   const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+   const auto continuation = static_cast<std::uint32_t>(_mm_movemask_epi8(low)) | (static_cast<std::uint32_t>(_mm_movemask_epi8(high)) << 16);
+   return ~continuation;
+#else
+   std::uint32_t terminators = 0;
+   for (std::size_t i = 0; i < 4; i++)
+   {
+      std::uint64_t word;
+      memcpy(&word, p + 8 * i, sizeof(word));
+      // gathers the inverted high bits of the 8 bytes in the top byte of the product
+      const auto bits = (~word & 0x8080808080808080ull) >> 7;
+      terminators |= static_cast<std::uint32_t>((bits * 0x0102040810204080ull) >> 56) << (8 * i);
+   }
+   return terminators;
+#endif
+}
+
+// Skips the fields at the beginning of in, as long as their field numbers are lower than fieldNo.
+// Works on blocks of 32 bytes: the varint terminators of a block are found at once and all
+// (tag, value) pairs starting in the block are skipped without looking at the single bytes.
+//
+// Stops in front of the first field it can't handle (field number >= fieldNo, unknown wire types,
+// values exceeding the input, malformed varints) or when less than 32 + 8 bytes are left and
+// returns the number of skipped bytes. The remaining fields are left to the scalar parser.
+inline std::size_t skipFieldsBelow(const std::byte* in, std::size_t inSize, int fieldNo)
+{
+   constexpr std::size_t blockSize = 32;
+   // tags and lengths are read as 8 byte words
+   constexpr std::size_t padding = 8;
+
+   auto bytes = reinterpret_cast<const std::uint8_t*>(in);
+   std::size_t pos = 0;
+
+   while (inSize - pos >= blockSize + padding)
+   {
+      const auto block = bytes + pos;
+      // one byte tags are checked before the block is loaded (fields are often read in the order of their field numbers)
+      if (block[0] < 0x80 && (block[0] >> 3) >= fieldNo)
+         break;
+
+      const std::uint64_t terminators = varintTerminators32(block);
+
+      // end of the varint starting at offset within the block (0, if it does not end within the block or is too long)
+      auto varintEnd = [terminators, block](std::size_t offset, std::size_t maxLen) -> std::size_t {
+         if (block[offset] < 0x80)
+            return offset + 1;
+         const auto rest = terminators >> offset;
+         const auto len = static_cast<std::size_t>(__builtin_ctzll(rest | (std::uint64_t{1} << 63))) + 1;
+         return (rest && len <= maxLen) ? offset + len : 0;
+      };
+      auto varintAt = [block](std::size_t begin, std::size_t end) -> std::uint32_t {
+         if (end - begin == 1)
+            return block[begin];
+         std::uint64_t word;
+         memcpy(&word, block + begin, sizeof(word));
+         return static_cast<std::uint32_t>(compactVarint(word, end - begin));
+      };
+
+      std::size_t offset = 0;
+      while (offset < blockSize)
+      {
+         const auto tagEnd = varintEnd(offset, 5);
+         if (!tagEnd)
+            break;
+
+         const auto tag = varintAt(offset, tagEnd);
+         if (tag == 0 || static_cast<int>(tag >> 3) >= fieldNo)
+            return pos + offset;
+
+         std::size_t next = 0;
+         switch (tag & 0b111)
+         {
+         case 0: // varint
+            next = varintEnd(tagEnd, 10);
+            break;
+         case 1: // 64 bit
+            next = tagEnd + 8;
+            break;
+         case 2: // length delimited
+            if (const auto lenEnd = varintEnd(tagEnd, 5))
+               next = lenEnd + varintAt(tagEnd, lenEnd);
+            break;
+         case 5: // 32 bit
+            next = tagEnd + 4;
+            break;
+         }
+
+         if (!next || next > inSize - pos)
+            break;
+         offset = next;
+      }
+
+      // the field at offset is handled with the next block (or by the scalar parser, if it can't be handled at all)
+      if (offset == 0)
+         break;
+      pos += offset;
+   }
+
+   return pos;
+}
+
+} // namespace impl
+} // namespace pbview
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "binmessageview.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pbview
+{
+
+// Thread pool with one task queue per worker. Workers take tasks from the back of their own
+// queue and steal from the front of the other queues when their own queue ran empty.
+//
+// Tasks get the index of the executing worker (0 <= worker < threadCount()), so that they can
+// use per-worker state without locking.
+class WorkStealingPool
+{
+ public:
+   using Task = std::function<void(std::size_t worker)>;
+
+   static std::size_t defaultThreadCount()
+   {
+      return std::max(1u, std::thread::hardware_concurrency());
+   }
+
+   explicit WorkStealingPool(std::size_t threadCount = defaultThreadCount())
+      : mQueues(impl::enforce(threadCount, "Thread pool needs at least one thread"))
+   {
+      for (std::size_t i = 0; i < threadCount; i++)
+         mThreads.emplace_back([this, i] { run(i); });
+   }
+
+   WorkStealingPool(const WorkStealingPool&) = delete;
+   WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+   // Finishes all queued tasks
+   ~WorkStealingPool()
+   {
+      {
+         std::lock_guard<std::mutex> lock{mMutex};
+         mStop = true;
+      }
+      mWakeUp.notify_all();
+      for (auto& thread : mThreads)
+         thread.join();
+   }
+
+   std::size_t threadCount() const
+   {
+      return mThreads.size();
+   }
+
+   // Queues a task. Tasks submitted by a worker are queued at the worker itself, others are
+   // distributed round robin.
+   void submit(Task task)
+   {
+      const auto idx = tCurrentPool == this ? tCurrentWorker : mNextQueue++ % mQueues.size();
+      {
+         std::lock_guard<std::mutex> lock{mMutex};
+         mQueued++;
+         mUnfinished++;
+      }
+      {
+         std::lock_guard<std::mutex> lock{mQueues[idx].mutex};
+         mQueues[idx].tasks.push_back(std::move(task));
+      }
+      mWakeUp.notify_one();
+   }
+
+   // Waits until all submitted tasks are finished and rethrows the first exception of a task
+   // (tasks that did not start yet are skipped after an exception). Must not be called by a task.
+   void wait()
+   {
+      std::unique_lock<std::mutex> lock{mMutex};
+      mDone.wait(lock, [this] { return mUnfinished == 0; });
+      if (auto error = std::exchange(mError, nullptr))
+         std::rethrow_exception(error);
+   }
+
+ private:
+   struct Queue
+   {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+   };
+
+   std::vector<Queue> mQueues;
+   std::vector<std::thread> mThreads;
+   std::atomic<std::size_t> mNextQueue{0};
+
+   // protects the counters, the error and the stop flag
+   std::mutex mMutex;
+   std::condition_variable mWakeUp;
+   std::condition_variable mDone;
+   std::size_t mQueued = 0;
+   std::size_t mUnfinished = 0;
+   std::exception_ptr mError;
+   bool mStop = false;
+
+   static inline thread_local const WorkStealingPool* tCurrentPool = nullptr;
+   static inline thread_local std::size_t tCurrentWorker = 0;
+
+   bool popOwn(std::size_t idx, Task& task)
+   {
+      auto& queue = mQueues[idx];
+      std::lock_guard<std::mutex> lock{queue.mutex};
+      if (queue.tasks.empty())
+         return false;
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      return true;
+   }
+
+   bool steal(std::size_t idx, Task& task)
+   {
+      for (std::size_t i = 1; i < mQueues.size(); i++)
+      {
+         auto& queue = mQueues[(idx + i) % mQueues.size()];
+         std::lock_guard<std::mutex> lock{queue.mutex};
+         if (queue.tasks.empty())
+            continue;
+         task = std::move(queue.tasks.front());
+         queue.tasks.pop_front();
+         return true;
+      }
+      return false;
+   }
+
+   void run(std::size_t idx)
+   {
+      tCurrentPool = this;
+      tCurrentWorker = idx;
+
+      while (true)
+      {
+         Task task;
+         if (popOwn(idx, task) || steal(idx, task))
+         {
+            bool cancelled;
+            {
+               std::lock_guard<std::mutex> lock{mMutex};
+               mQueued--;
+               cancelled = mError != nullptr;
+            }
+
+            std::exception_ptr error;
+            if (!cancelled)
+            {
+               try
+               {
+                  task(idx);
+               }
+               catch (...)
+               {
+                  error = std::current_exception();
+               }
+            }
+
+            std::lock_guard<std::mutex> lock{mMutex};
+            if (error && !mError)
+               mError = error;
+            if (--mUnfinished == 0)
+               mDone.notify_all();
+            continue;
+         }
+
+         std::unique_lock<std::mutex> lock{mMutex};
+         // a task may be counted but not yet be pushed to its queue: try again then
+         mWakeUp.wait(lock, [this] { return mStop || mQueued > 0; });
+         if (mStop && mQueued == 0)
+            return;
+      }
+   }
+};
+
+} // namespace pbview
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "blockcodec.hpp"
+
+#include <zlib.h>
+
+namespace pbview
+{
+
+// zlib compression of blocks (requires linking zlib)
+class ZlibCodec : public BlockCodec
+{
+ public:
+   static constexpr std::uint32_t codecId = 1;
+
+   explicit ZlibCodec(int level = Z_DEFAULT_COMPRESSION)
+      : mLevel(level)
+   {
+   }
+
+   std::uint32_t id() const override
+   {
+      return codecId;
+   }
+
+   void compress(DataSpan in, std::vector<std::byte>& out) const override
+   {
+      const auto offset = out.size();
+      auto outSize = compressBound(static_cast<uLong>(in.size()));
+      out.resize(offset + outSize);
+      const auto res = compress2(reinterpret_cast<Bytef*>(out.data() + offset), &outSize,
+                                 reinterpret_cast<const Bytef*>(in.data()), static_cast<uLong>(in.size()), mLevel);
+      impl::enforce(res == Z_OK, "zlib compression failed");
+      out.resize(offset + outSize);
+   }
+
+   void decompress(DataSpan in, std::byte* out, std::size_t outSize) const override
+   {
+      auto size = static_cast<uLongf>(outSize);
+      const auto res = uncompress(reinterpret_cast<Bytef*>(out), &size, reinterpret_cast<const Bytef*>(in.data()), static_cast<uLong>(in.size()));
+      impl::enforce(res == Z_OK && size == outSize, "Corrupt zlib compressed block");
+   }
+
+ private:
+   int mLevel;
+};
+
+} // namespace pbview
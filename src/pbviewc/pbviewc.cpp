@@ -2,9 +2,13 @@
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/compiler/importer.h>
 
+#include <common/cli.hpp>
+
 #include <sstream>
 #include <fstream>
 #include <string_view>
+#include <algorithm>
+#include <vector>
 
 #include <range/v3/view/take_while.hpp>
 #include <range/v3/view/drop_while.hpp>
@@ -230,6 +234,18 @@ struct VarImpl
    {
    }
 
+   static void writeViewIntoGetter(std::ostream& os, const google::protobuf::FieldDescriptor& field)
+   {
+   }
+
+   static void writeViewGatherGetters(std::ostream& os, const google::protobuf::FieldDescriptor& field)
+   {
+   }
+
+   static void writeViewManyGetter(std::ostream& os, const google::protobuf::Descriptor& desc)
+   {
+   }
+
    static void writeLookupTemplate(std::ostream& os, const google::protobuf::FileDescriptor& fileDesc, const google::protobuf::Descriptor& desc)
    {
       os << "template <>\n";
@@ -255,10 +271,19 @@ struct ViewImpl
       os << "    : mData(binMessage)\n";
       os << "  {}\n";
       os << "\n";
+      os << "  explicit " << desc.name() << NameSuffix << "(BinView binView)\n";
+      os << "    : mData(std::move(binView))\n";
+      os << "  {}\n";
+      os << "\n";
       os << "  static " << desc.name() << NameSuffix << " fromBytesString(std::string_view sv)\n";
       os << "  {\n";
       os << "     return " << desc.name() << NameSuffix << "{pbview::DataSpan{reinterpret_cast<const std::byte *>(sv.data()), sv.size()}};\n";
       os << "  }\n";
+      os << "\n";
+      os << "  const BinView& bin_view() const\n";
+      os << "  {\n";
+      os << "     return mData;\n";
+      os << "  }\n";
    }
 
    static void writeViewHasGetter(std::ostream& os, const google::protobuf::FieldDescriptor& field)
@@ -323,6 +348,65 @@ struct ViewImpl
       os << "  }\n";
    }
 
+   static void writeViewIntoGetter(std::ostream& os, const google::protobuf::FieldDescriptor& field)
+   {
+      os << "  // copies all elements at once, into an output iterator, a buffer (pointer + capacity) or a std::vector\n";
+      os << "  template <typename... Out>\n";
+      os << "  decltype(auto) " << field.name() << "_into(Out&&... out) const\n";
+      os << "  {\n";
+      os << "     return " << field.name() << "().copyTo(std::forward<Out>(out)...);\n";
+      os << "  }\n";
+   }
+
+   static void writeViewGatherGetters(std::ostream& os, const google::protobuf::FieldDescriptor& field)
+   {
+      auto subMsg = field.message_type();
+      if (!subMsg)
+         return;
+
+      for (int i=0; i < subMsg->field_count(); i++)
+      {
+         auto& subField = *subMsg->field(i);
+         if (subField.is_repeated() || subField.message_type())
+            continue;
+
+         os << "  // " << subField.name() << " of all elements in one pass (a column with a validity bitmap)\n";
+         os << "  pbview::Column<" << pbviewType(subField, TypeFor::SingleValue) << "> " << field.name() << "_" << subField.name() << "_column() const\n";
+         os << "  {\n";
+         os << "     return pbview::gather<" << pbviewType(subField, TypeFor::SingleValue) << ">(" << field.name() << "(), " << subField.number() << ");\n";
+         os << "  }\n";
+      }
+
+      os << "  // reads the given fields of all elements in one pass, e.g. auto [a, b] = " << field.name() << "_gather<"
+         << subMsg->name() << NameSuffixFull << "::fields::a, " << subMsg->name() << NameSuffixFull << "::fields::b>() (a tuple of columns)\n";
+      os << "  template <typename... Fields>\n";
+      os << "  auto " << field.name() << "_gather() const\n";
+      os << "  {\n";
+      os << "     return pbview::gather<Fields...>(" << field.name() << "());\n";
+      os << "  }\n";
+   }
+
+   static void writeViewManyGetter(std::ostream& os, const google::protobuf::Descriptor& desc)
+   {
+      os << "\n";
+      os << "  struct fields\n";
+      os << "  {\n";
+      for (int i=0; i < desc.field_count(); i++)
+      {
+         auto& field = *desc.field(i);
+         if (!field.is_repeated())
+            os << "    using " << field.name() << " = pbview::Field<" << pbviewType(field, TypeFor::SingleValue) << ", " << field.number() << ">;\n";
+      }
+      os << "  };\n";
+      os << "\n";
+      os << "  // reads the given fields in one pass, e.g. auto [a, b] = get_many<fields::a, fields::b>() (a tuple of std::optional)\n";
+      os << "  template <typename... Fields>\n";
+      os << "  auto get_many() const\n";
+      os << "  {\n";
+      os << "     return pbview::getMany<Fields...>(mData);\n";
+      os << "  }\n";
+   }
+
    static constexpr auto TemplateArgs = "typename BinView"sv;
    static constexpr auto NameSuffix = "ViewBase"sv;
    static constexpr auto NameSuffixFull = "ViewBase<BinView>"sv;
@@ -371,6 +455,8 @@ void writeMessage(std::ostream& os, const google::protobuf::FileDescriptor& file
       {
          T::writeViewSizeGetter(os, field);
          T::writeViewIndexGetter(os, field);
+         T::writeViewIntoGetter(os, field);
+         T::writeViewGatherGetters(os, field);
       }
       else
       {
@@ -379,6 +465,7 @@ void writeMessage(std::ostream& os, const google::protobuf::FileDescriptor& file
       }
       T::writeViewGetter(os, field);
    }
+   T::writeViewManyGetter(os, desc);
    os << "};\n";
 
    if (!fileDesc.package().empty())
@@ -390,6 +477,201 @@ void writeMessage(std::ostream& os, const google::protobuf::FileDescriptor& file
    os << "}\n";
 }
 
+// Struct with the values of selected (possibly nested) fields of a message, see readProjections()
+struct Projection
+{
+   using Path = std::vector<const google::protobuf::FieldDescriptor*>;
+
+   const google::protobuf::Descriptor* message;
+   std::vector<Path> paths;
+};
+
+std::string memberName(const Projection::Path& path)
+{
+   std::string res;
+   for (auto field : path)
+      res += (res.empty() ? ""s : "_"s) + field->name();
+   return res;
+}
+
+// Writes the visitor of the fields of one (sub-)message: the values of the leafs are stored in res, sub-messages are visited recursively.
+// Like get(), the fast modes use the first occurrence of a field (later ones are skipped by a mask of the assigned fields),
+// StrictConforming the last one (and merges the occurrences of sub-messages).
+void writeProjectionVisitor(std::ostream& os, std::string_view source, const google::protobuf::Descriptor& desc, const std::vector<const Projection::Path*>& paths, std::size_t depth, const std::string& indent)
+{
+   std::vector<const google::protobuf::FieldDescriptor*> fields;
+   for (auto path : paths)
+   {
+      if (std::find(fields.begin(), fields.end(), (*path)[depth]) == fields.end())
+         fields.push_back((*path)[depth]);
+   }
+   std::sort(fields.begin(), fields.end(), [](auto l, auto r) { return l->number() < r->number(); });
+   if (fields.size() > 64)
+      throw std::runtime_error{"More than 64 fields of message '" + desc.full_name() + "' can't be projected"};
+
+   const auto assigned = "assigned" + std::to_string(depth);
+   os << indent << "std::uint64_t " << assigned << " = 0;\n";
+   os << indent << source << ".visitFields([&](int fieldNo, auto& field) {\n";
+   os << indent << "   switch (fieldNo)\n";
+   os << indent << "   {\n";
+   for (std::size_t i = 0; i < fields.size(); i++)
+   {
+      auto field = fields[i];
+      const auto bit = "(std::uint64_t{1} << " + std::to_string(i) + ")";
+      os << indent << "   case " << desc.name() << "::" << numberConstant(*field) << ":\n";
+      os << indent << "   {\n";
+      os << indent << "      if (mode != pbview::ParserMode::StrictConforming && (" << assigned << " & " << bit << "))\n";
+      os << indent << "         break;\n";
+      os << indent << "      " << assigned << " |= " << bit << ";\n";
+      if (field->message_type())
+      {
+         std::vector<const Projection::Path*> subPaths;
+         for (auto path : paths)
+         {
+            if ((*path)[depth] == field)
+               subPaths.push_back(path);
+         }
+         writeProjectionVisitor(os, "field.message()", *field->message_type(), subPaths, depth + 1, indent + "      ");
+      }
+      else
+      {
+         auto path = *std::find_if(paths.begin(), paths.end(), [&](auto p) { return (*p)[depth] == field; });
+         os << indent << "      res." << memberName(*path) << " = field.template value<" << pbviewType(*field, TypeFor::SingleValue) << ">();\n";
+      }
+      os << indent << "      break;\n";
+      os << indent << "   }\n";
+   }
+   os << indent << "   }\n";
+   os << indent << "}, " << fields.back()->number() << ");\n";
+}
+
+void writeProjection(std::ostream& os, const google::protobuf::FileDescriptor& fileDesc, const Projection& projection)
+{
+   auto& desc = *projection.message;
+   const auto name = desc.name() + "Projection";
+
+   if (!fileDesc.package().empty())
+   {
+      os << "\n";
+      os << "namespace " << packageToNamespace(fileDesc.package()) << '\n';
+      os << "{\n";
+   }
+   os << "// " << desc.name() << " reduced to the fields:";
+   for (auto& path : projection.paths)
+   {
+      os << (&path == &projection.paths.front() ? " " : ", ");
+      for (auto field : path)
+         os << (field == path.front() ? "" : ".") << field->name();
+   }
+   os << "\n";
+   os << "struct " << name << "\n";
+   os << "{\n";
+   for (auto& path : projection.paths)
+   {
+      auto& leaf = *path.back();
+      os << "  " << cppType(leaf, "") << " " << memberName(path) << " = "
+         << leaf.containing_type()->name() << "::default_instance()." << leaf.name() << "();\n";
+   }
+   os << "\n";
+   os << "  // fills all members in one pass over the serialized message\n";
+   os << "  template <pbview::ParserMode mode = pbview::ParserMode::Fast>\n";
+   os << "  static " << name << " decode(pbview::DataSpan bytes)\n";
+   os << "  {\n";
+   os << "     " << name << " res;\n";
+   std::vector<const Projection::Path*> paths;
+   for (auto& path : projection.paths)
+      paths.push_back(&path);
+   writeProjectionVisitor(os, "pbview::BinMessageView<mode>{bytes}", desc, paths, 0, "     ");
+   os << "     return res;\n";
+   os << "  }\n";
+   os << "\n";
+   os << "  template <template <pbview::ParserMode> class BinView, pbview::ParserMode mode>\n";
+   os << "  static " << name << " decode(const " << desc.name() << "ViewBase<BinView<mode>>& view)\n";
+   os << "  {\n";
+   os << "     return decode<mode>(view.bin_view().bytes);\n";
+   os << "  }\n";
+   os << "};\n";
+   if (!fileDesc.package().empty())
+      os << "}\n";
+}
+
+Projection::Path resolveProjectionPath(const google::protobuf::Descriptor& message, std::string_view path)
+{
+   Projection::Path res;
+   auto desc = &message;
+   while (true)
+   {
+      const auto pos = path.find('.');
+      const auto name = std::string{path.substr(0, pos)};
+      if (!desc)
+         throw std::runtime_error{"'" + res.back()->name() + "' is not a message"};
+
+      auto field = desc->FindFieldByName(name);
+      if (!field)
+         throw std::runtime_error{"Unknown field '" + name + "' in message '" + desc->full_name() + "'"};
+      if (field->is_repeated())
+         throw std::runtime_error{"Repeated field '" + name + "' can't be projected"};
+      res.push_back(field);
+
+      if (pos == std::string_view::npos)
+         break;
+      desc = field->message_type();
+      path.remove_prefix(pos + 1);
+   }
+
+   if (res.back()->message_type())
+      throw std::runtime_error{"Message field '" + res.back()->name() + "' can't be projected, select the required fields of it"};
+   return res;
+}
+
+// Reads the projections from a file with lines of the form:
+//    package.MessageName: field, sub_message.field, ...
+// Empty lines and comments (starting with '#') are ignored.
+std::vector<Projection> readProjections(const std::string& fileName, const google::protobuf::DescriptorPool& pool)
+{
+   std::ifstream in{fileName};
+   if (!in)
+      throw std::runtime_error{"Can't open projection file '" + fileName + "'"};
+
+   std::vector<Projection> res;
+   std::string line;
+   for (int lineNo = 1; std::getline(in, line); lineNo++)
+   {
+      try
+      {
+         line = line.substr(0, line.find('#'));
+         std::replace(line.begin(), line.end(), ',', ' ');
+         if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+         const auto colon = line.find(':');
+         if (colon == std::string::npos)
+            throw std::runtime_error{"Expected 'package.MessageName: field, sub_message.field, ...'"};
+
+         std::string messageName;
+         std::istringstream{line.substr(0, colon)} >> messageName;
+         Projection projection{pool.FindMessageTypeByName(messageName), {}};
+         if (!projection.message)
+            throw std::runtime_error{"Unknown message '" + messageName + "'"};
+
+         std::istringstream fields{line.substr(colon + 1)};
+         std::string path;
+         while (fields >> path)
+            projection.paths.push_back(resolveProjectionPath(*projection.message, path));
+         if (projection.paths.empty())
+            throw std::runtime_error{"No fields given for message '" + messageName + "'"};
+
+         res.push_back(std::move(projection));
+      }
+      catch (std::exception& e)
+      {
+         throw std::runtime_error{fileName + ":" + std::to_string(lineNo) + ": " + e.what()};
+      }
+   }
+
+   return res;
+}
+
 constexpr auto viewHeaderHeader = R"(#pragma once
 
 #include <string_view>
@@ -397,6 +679,7 @@ constexpr auto viewHeaderHeader = R"(#pragma once
 #include <range/v3/front.hpp>
 
 #include <pbview/binmessageview.hpp>
+#include <pbview/gather.hpp>
 
 )"sv;
 
@@ -412,7 +695,7 @@ void writeVarHeader(std::ostream& os, const google::protobuf::FileDescriptor& fi
       writeMessage<VarImpl>(os, fileDesc, *fileDesc.message_type(i));
 }
 
-void writeViewHeader(std::ostream& os, const google::protobuf::FileDescriptor& fileDesc)
+void writeViewHeader(std::ostream& os, const google::protobuf::FileDescriptor& fileDesc, const std::vector<Projection>& projections)
 {
    os << viewHeaderHeader;
    
@@ -421,6 +704,12 @@ void writeViewHeader(std::ostream& os, const google::protobuf::FileDescriptor& f
 
    for (int i=0; i < fileDesc.message_type_count(); i++)
       writeMessage<ViewImpl>(os, fileDesc, *fileDesc.message_type(i));
+
+   for (auto& projection : projections)
+   {
+      if (projection.message->file() == &fileDesc)
+         writeProjection(os, fileDesc, projection);
+   }
 }
 
 std::string_view parentDir(std::string_view path)
@@ -447,14 +736,6 @@ std::string_view fileName(std::string_view path)
    return path.substr(pos);
 }
 
-bool startsWith(std::string_view val, std::string_view part)
-{
-   if (val.size() < part.size())
-      return false;
-
-   return val.substr(0, part.size()) == part;
-}
-
 auto startsWith(std::string_view part)
 {
    return [part](std::string_view in){ return startsWith(in, part); };
@@ -473,27 +754,6 @@ auto startsWithOneOf(Args... parts)
    };
 }
 
-template <typename Rng>
-std::optional<std::string_view> optionalParameter(Rng&& params, std::string_view name)
-{
-   for (auto&& p : params)
-   {
-      if (startsWith(p, name))
-         return p.substr(name.size());
-   }
-
-   return {};
-}
-
-template <typename Rng>
-std::string_view requiredParameter(Rng&& params, std::string_view name)
-{
-   if (auto p = optionalParameter(params, name))
-      return *p;
-
-   throw std::runtime_error("The option '" + std::string{name} + "' is missing!");
-} 
-
 std::string_view paramValue(std::string_view param)
 {
    if (startsWith(param, "--"))
@@ -547,13 +807,19 @@ int main(int argc, char* argsCStr[])
 	   auto errorCollector = std::make_unique<ExceptionErrorCollector>();
 	   auto importer = std::make_unique<google::protobuf::compiler::Importer>(sourceTree.get(), errorCollector.get());
 
+      std::vector<std::pair<std::string_view, const google::protobuf::FileDescriptor*>> fileDescs;
       for (auto&& file : files)
-      {
-    	   auto fileDesc = importer->pool()->FindFileByName(std::string{file});
+         fileDescs.emplace_back(file, importer->pool()->FindFileByName(std::string{file}));
+
+      std::vector<Projection> projections;
+      if (auto projectionFile = optionalParameter(opts, "--projections="))
+         projections = readProjections(std::string{*projectionFile}, *importer->pool());
 
+      for (auto&& [file, fileDesc] : fileDescs)
+      {
          {         
             std::ofstream viewFile{std::string{outDir} + "/" + replaceProtoExtension(file, ".pbview.h")};
-            writeViewHeader(viewFile, *fileDesc);
+            writeViewHeader(viewFile, *fileDesc, projections);
          }
          {
             std::ofstream varFile{std::string{outDir} + "/" + replaceProtoExtension(file, ".pbvar.h")};
@@ -571,6 +837,10 @@ int main(int argc, char* argsCStr[])
                               directories will be searched in order.  If not
                               given, the current working directory is used.
   --cpp_out=OUT_DIR           Generate C++ header and source.
+  --projections=FILE          Generate structs with the values of selected
+                              fields and a one-pass decode() for them.
+                              Lines of FILE have the form
+                              'package.Message: field, sub_message.field'.
       )" << std::endl;
 		std::cerr << "Error: " << e.what() << std::endl;
 		return 1;
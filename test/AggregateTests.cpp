@@ -0,0 +1,179 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/aggregate.hpp>
+#include <pbview/blockrecordfile.hpp>
+#include "TestHelpers.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <map>
+#include <sstream>
+
+namespace
+{
+using pbview_test::serialize;
+using pbview_test::TempFile;
+using Msg = pbview::samples::AllTypes;
+namespace type = pbview::type;
+using pbview::AggregateField;
+using pbview::IndexField;
+
+// string_field: region (or missing), sint32_field: -2..2, double_field: price, int64_field: quantity (or missing)
+std::vector<Msg> makeRecords(int count)
+{
+    std::vector<Msg> msgs(count);
+    for (int i = 0; i < count; i++)
+    {
+        auto& msg = msgs[i];
+        if (i % 9)
+            msg.set_string_field(i % 4 == 0 ? std::string("reg\0ion", 7) : "region" + std::to_string(i % 4));
+        msg.set_sint32_field(i % 5 - 2);
+        msg.set_double_field(i * 0.5);
+        if (i % 3)
+            msg.set_int64_field(i % 100 - 50);
+    }
+    return msgs;
+}
+
+struct Expected
+{
+    std::uint64_t records = 0;
+    double priceSum = 0;
+    std::uint64_t quantities = 0;
+    std::optional<double> minQuantity, maxQuantity;
+};
+}
+
+TEST_CASE("aggregate groups by several fields")
+{
+    const auto msgs = makeRecords(20000);
+    TempFile file{serialize(msgs)};
+    pbview::MappedRecordFile<> records{file.path};
+
+    std::map<std::pair<std::optional<std::string>, std::int64_t>, Expected> expected;
+    for (const auto& msg : msgs)
+    {
+        auto& group = expected[{msg.has_string_field() ? std::optional{msg.string_field()} : std::nullopt, msg.sint32_field()}];
+        group.records++;
+        group.priceSum += msg.double_field();
+        if (msg.has_int64_field())
+        {
+            const double quantity = msg.int64_field();
+            group.quantities++;
+            group.minQuantity = std::min(group.minQuantity.value_or(quantity), quantity);
+            group.maxQuantity = std::max(group.maxQuantity.value_or(quantity), quantity);
+        }
+    }
+
+    pbview::ParallelScanOptions options;
+    options.threadCount = 3;
+    options.chunkSize = 10000;
+    const auto res = pbview::aggregate(records, {IndexField::of<type::String>(14), IndexField::of<type::Sint32>(7)},
+                                       {AggregateField::count(), AggregateField::sum<type::Double>(1), AggregateField::count(4),
+                                        AggregateField::min<type::Int64>(4), AggregateField::max<type::Int64>(4),
+                                        AggregateField::avg<type::Double>(1)},
+                                       options);
+
+    // the groups are ordered like the map: missing strings first, then by string and number
+    REQUIRE(res.groups.size() == expected.size());
+    auto it = expected.begin();
+    for (const auto& group : res.groups)
+    {
+        const auto& [key, exp] = *it++;
+        REQUIRE(group.keys.size() == 2);
+        if (key.first)
+            REQUIRE(std::get<std::string>(group.keys[0]) == *key.first);
+        else
+            REQUIRE(std::holds_alternative<std::monostate>(group.keys[0]));
+        REQUIRE(std::get<std::int64_t>(group.keys[1]) == key.second);
+
+        REQUIRE(group.records == exp.records);
+        REQUIRE(group.values[0] == static_cast<double>(exp.records));
+        REQUIRE(*group.values[1] == Approx(exp.priceSum));
+        REQUIRE(group.values[2] == static_cast<double>(exp.quantities));
+        REQUIRE(group.values[3] == exp.minQuantity);
+        REQUIRE(group.values[4] == exp.maxQuantity);
+        REQUIRE(*group.values[5] == Approx(exp.priceSum / static_cast<double>(exp.records)));
+    }
+}
+
+TEST_CASE("aggregate without group-by fields")
+{
+    const auto msgs = makeRecords(5000);
+    TempFile file{serialize(msgs)};
+    pbview::MappedRecordFile<> records{file.path};
+
+    double sum = 0;
+    for (const auto& msg : msgs)
+        sum += msg.double_field();
+
+    const auto res = pbview::aggregate(records, {}, {AggregateField::sum<type::Double>(1), AggregateField::min<type::Uint64>(6)});
+    REQUIRE(res.groups.size() == 1);
+    REQUIRE(res.groups[0].keys.empty());
+    REQUIRE(res.groups[0].records == msgs.size());
+    REQUIRE(*res.groups[0].values[0] == Approx(sum));
+    // no record has uint64_field
+    REQUIRE(res.groups[0].values[1] == std::nullopt);
+}
+
+TEST_CASE("aggregate groups by floating point and unsigned fields")
+{
+    std::vector<Msg> msgs(100);
+    for (int i = 0; i < 100; i++)
+    {
+        msgs[i].set_double_field(i % 3 == 0 ? -1.5 : 2.25);
+        msgs[i].set_bool_field(i % 2);
+    }
+    TempFile file{serialize(msgs)};
+    pbview::MappedRecordFile<> records{file.path};
+
+    const auto res = pbview::aggregate(records, {IndexField::of<type::Double>(1), IndexField::of<type::Bool>(13)}, {AggregateField::count()});
+    REQUIRE(res.groups.size() == 4);
+    REQUIRE(res.groups[0].keys == std::vector<pbview::GroupValue>{-1.5, std::uint64_t{0}});
+    REQUIRE(res.groups[1].keys == std::vector<pbview::GroupValue>{-1.5, std::uint64_t{1}});
+    REQUIRE(res.groups[2].keys == std::vector<pbview::GroupValue>{2.25, std::uint64_t{0}});
+    REQUIRE(res.groups[3].keys == std::vector<pbview::GroupValue>{2.25, std::uint64_t{1}});
+    REQUIRE(res.groups[0].records + res.groups[1].records == 34);
+}
+
+TEMPLATE_TEST_CASE_SIG("aggregate reads duplicated fields like get()", "", ((pbview::ParserMode mode), mode), pbview::ParserMode::Fast_WithoutBoundsChecking,
+                       pbview::ParserMode::Fast, pbview::ParserMode::StrictConforming)
+{
+    // concatenated messages: double_field and string_field twice, int64_field after higher field numbers
+    std::ostringstream os;
+    pbview::BlockRecordWriter writer{os};
+    for (int i = 0; i < 1000; i++)
+    {
+        Msg first;
+        first.set_double_field(i);
+        first.set_string_field(i % 2 ? "odd" : "even");
+        Msg second;
+        second.set_double_field(-i);
+        second.set_int64_field(i);
+        second.set_string_field("second");
+        const auto record = first.SerializeAsString() + second.SerializeAsString();
+        writer.add(pbview_test::span(record));
+    }
+    writer.close();
+    const auto data = os.str();
+    pbview::BlockRecordReader<mode> reader{pbview_test::span(data)};
+
+    std::map<std::string, Expected> expected;
+    reader.forEachRecord([&](pbview::BinMessageView<mode> record) {
+        auto& exp = expected[std::string{*record.template get<type::String>(14)}];
+        exp.records++;
+        exp.priceSum += *record.template get<type::Double>(1);
+        exp.quantities += record.has(4);
+    });
+    // the fast modes read the first occurrence, StrictConforming the last
+    REQUIRE(expected.size() == (mode == pbview::ParserMode::StrictConforming ? 1 : 2));
+
+    const auto res = pbview::aggregate(reader, {IndexField::of<type::String>(14)}, {AggregateField::sum<type::Double>(1), AggregateField::count(4)});
+    REQUIRE(res.groups.size() == expected.size());
+    for (const auto& group : res.groups)
+    {
+        const auto& exp = expected.at(std::get<std::string>(group.keys[0]));
+        REQUIRE(group.records == exp.records);
+        REQUIRE(group.values[0] == exp.priceSum);
+        REQUIRE(group.values[1] == static_cast<double>(exp.quantities));
+    }
+}
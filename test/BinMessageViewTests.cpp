@@ -454,3 +454,224 @@ TEST_CASE("BinMessageView on message with packed repeated fields")
     REQUIRE(ranges::to_vector(allTypes.myenum_field() | ranges::view::transform([](int i){ return static_cast<pbview::samples::MyEnum>(i); })) == 
             ranges::to_vector(msg.getPackedRepeated<pbview::type::Enum<pbview::samples::MyEnum>>(pbview::samples::AllTypesRepeated::kMyenumFieldFieldNumber)));
 }
+
+TEST_CASE("BinMessageView decodes packed repeated fields in bulk")
+{
+    pbview::samples::AllTypesRepeatedPacked allTypes;
+
+    // mix of one byte values, longer varints and (for int32/int64) negative values that need 10 bytes
+    for (int i = 0; i < 1000; i++)
+    {
+        const std::int64_t val = (i % 7 == 0) ? -i * 1000003ll : (i % 5 == 0) ? i * 977 : i % 64;
+        allTypes.add_int32_field(static_cast<std::int32_t>(val));
+        allTypes.add_int64_field(val * 1000003);
+        allTypes.add_uint32_field(static_cast<std::uint32_t>(val));
+        allTypes.add_sint32_field(static_cast<std::int32_t>(val));
+        allTypes.add_sint64_field(val);
+        allTypes.add_double_field(val / 3.0);
+        allTypes.add_bool_field(val % 2);
+        allTypes.add_myenum_field(static_cast<pbview::samples::MyEnum>(i % 3));
+    }
+
+    auto binStr = allTypes.SerializeAsString();
+    auto msg = pbview::BinMessageView<>::fromBytesString(binStr);
+
+    auto decodeWith = [](auto&& rng, pbview::impl::SimdLevel level) {
+        using CppType = std::decay_t<decltype(*rng.begin())>;
+        auto size = rng.size();
+        std::unique_ptr<CppType[]> buf{new CppType[size]};
+        auto decoded = rng.decodeInto(buf.get(), size, level);
+        return std::vector<CppType>(buf.get(), buf.get() + decoded);
+    };
+
+    using Level = pbview::impl::SimdLevel;
+    for (auto level : {Level::Scalar, Level::Sse41, Level::Avx2})
+    {
+        if (level > pbview::impl::detectSimdLevel())
+            continue;
+
+        INFO("SIMD level " << static_cast<int>(level));
+
+        using Msg = pbview::samples::AllTypesRepeatedPacked;
+        REQUIRE(ranges::to_vector(allTypes.int32_field()) == decodeWith(msg.getPackedRepeated<pbview::type::Int32>(Msg::kInt32FieldFieldNumber), level));
+        REQUIRE(ranges::to_vector(allTypes.int64_field()) == decodeWith(msg.getPackedRepeated<pbview::type::Int64>(Msg::kInt64FieldFieldNumber), level));
+        REQUIRE(ranges::to_vector(allTypes.uint32_field()) == decodeWith(msg.getPackedRepeated<pbview::type::Uint32>(Msg::kUint32FieldFieldNumber), level));
+        REQUIRE(ranges::to_vector(allTypes.sint32_field()) == decodeWith(msg.getPackedRepeated<pbview::type::Sint32>(Msg::kSint32FieldFieldNumber), level));
+        REQUIRE(ranges::to_vector(allTypes.sint64_field()) == decodeWith(msg.getPackedRepeated<pbview::type::Sint64>(Msg::kSint64FieldFieldNumber), level));
+        REQUIRE(ranges::to_vector(allTypes.double_field()) == decodeWith(msg.getPackedRepeated<pbview::type::Double>(Msg::kDoubleFieldFieldNumber), level));
+        REQUIRE(ranges::to_vector(allTypes.bool_field()) == decodeWith(msg.getPackedRepeated<pbview::type::Bool>(Msg::kBoolFieldFieldNumber), level));
+        REQUIRE(ranges::to_vector(msg.getPackedRepeated<pbview::type::Enum<pbview::samples::MyEnum>>(Msg::kMyenumFieldFieldNumber)) ==
+                decodeWith(msg.getPackedRepeated<pbview::type::Enum<pbview::samples::MyEnum>>(Msg::kMyenumFieldFieldNumber), level));
+
+        // output buffer smaller than the input
+        std::vector<std::int64_t> partial(100);
+        REQUIRE(msg.getPackedRepeated<pbview::type::Sint64>(Msg::kSint64FieldFieldNumber).decodeInto(partial.data(), partial.size(), level) == 100);
+        REQUIRE(partial == std::vector<std::int64_t>(allTypes.sint64_field().begin(), allTypes.sint64_field().begin() + 100));
+    }
+
+    REQUIRE(msg.getPackedRepeated<pbview::type::Int32>(pbview::samples::AllTypes::kStringFieldFieldNumber).size() == 0);
+}
+
+TEMPLATE_TEST_CASE("BinMessageView skips long runs of small fields", "",
+                   pbview::BinMessageView<pbview::ParserMode::Fast>,
+                   pbview::BinMessageView<pbview::ParserMode::Fast_WithoutBoundsChecking>)
+{
+    using Msg = pbview::samples::AllTypesRepeated;
+    Msg allTypes;
+
+    // different lengths of the fields, so that they start at all offsets of the blocks
+    for (int i = 0; i < 300; i++)
+    {
+        allTypes.add_double_field(i);
+        allTypes.add_float_field(i);
+        allTypes.add_int32_field(i % 3 == 0 ? -i : i * i);
+        allTypes.add_uint64_field(std::uint64_t{1} << (i % 64));
+        allTypes.add_sint32_field(-i);
+        allTypes.add_fixed32_field(i);
+        allTypes.add_sfixed64_field(-i);
+        allTypes.add_bool_field(i % 2);
+        allTypes.add_string_field(std::string(i % 50, 'X'));
+    }
+    allTypes.add_mysubmsg_field()->set_id(42);
+    allTypes.mutable_mysubmsg_field(0)->set_value("asdf");
+
+    auto binStr = allTypes.SerializeAsString();
+    auto msg = TestType::fromBytesString(binStr);
+
+    REQUIRE(ranges::to_vector(allTypes.double_field()) == ranges::to_vector(msg.template getRepeated<pbview::type::Double>(Msg::kDoubleFieldFieldNumber)));
+    REQUIRE(ranges::to_vector(allTypes.float_field()) == ranges::to_vector(msg.template getRepeated<pbview::type::Float>(Msg::kFloatFieldFieldNumber)));
+    REQUIRE(ranges::to_vector(allTypes.int32_field()) == ranges::to_vector(msg.template getRepeated<pbview::type::Int32>(Msg::kInt32FieldFieldNumber)));
+    REQUIRE(ranges::to_vector(allTypes.uint64_field()) == ranges::to_vector(msg.template getRepeated<pbview::type::Uint64>(Msg::kUint64FieldFieldNumber)));
+    REQUIRE(ranges::to_vector(allTypes.sint32_field()) == ranges::to_vector(msg.template getRepeated<pbview::type::Sint32>(Msg::kSint32FieldFieldNumber)));
+    REQUIRE(ranges::to_vector(allTypes.fixed32_field()) == ranges::to_vector(msg.template getRepeated<pbview::type::Fixed32>(Msg::kFixed32FieldFieldNumber)));
+    REQUIRE(ranges::to_vector(allTypes.sfixed64_field()) == ranges::to_vector(msg.template getRepeated<pbview::type::Sfixed64>(Msg::kSfixed64FieldFieldNumber)));
+    REQUIRE(ranges::to_vector(allTypes.bool_field()) == ranges::to_vector(msg.template getRepeated<pbview::type::Bool>(Msg::kBoolFieldFieldNumber)));
+    REQUIRE(msg.template getRepeated<pbview::type::String>(Msg::kStringFieldFieldNumber).size() == 300);
+    REQUIRE_FALSE(msg.has(Msg::kBytesFieldFieldNumber));
+    REQUIRE_FALSE(msg.has(Msg::kMyenumFieldFieldNumber));
+
+    auto subMsg = msg.template get<pbview::type::Message>(Msg::kMysubmsgFieldFieldNumber);
+    REQUIRE(subMsg);
+    REQUIRE(subMsg->template get<pbview::type::Int32>(pbview::samples::MySubMsg::kIdFieldNumber) == 42);
+
+    // the blocks stop in front of fields with higher field numbers (even if not sorted)
+    auto unsorted = binStr + allTypes.SerializeAsString();
+    auto unsortedMsg = TestType::fromBytesString(unsorted);
+    REQUIRE(unsortedMsg.template getRepeated<pbview::type::Double>(Msg::kDoubleFieldFieldNumber).size() == 300);
+}
+
+TEST_CASE("BinMessageView detects truncated messages while skipping fields in blocks")
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    allTypes.set_int32_field(1);
+    allTypes.set_fixed64_field(2);
+    allTypes.set_string_field(std::string(100, 'X'));
+    allTypes.mutable_mysubmsg_field()->set_id(3);
+    allTypes.mutable_mysubmsg_field()->set_value("asdf");
+
+    auto binStr = allTypes.SerializeAsString();
+    auto truncated = binStr.substr(0, binStr.size() - 60);
+
+    auto msg = pbview::BinMessageView<pbview::ParserMode::Fast>::fromBytesString(truncated);
+    REQUIRE(msg.get<pbview::type::Fixed64>(Msg::kFixed64FieldFieldNumber) == 2u);
+    REQUIRE_THROWS(msg.has(Msg::kMysubmsgFieldFieldNumber));
+
+    // unknown wire types are left to the scalar parser, which rejects them
+    auto invalid = std::string(48, '\x08') + "\x0f" + binStr;
+    REQUIRE_THROWS(pbview::BinMessageView<pbview::ParserMode::Fast>::fromBytesString(invalid).has(Msg::kMysubmsgFieldFieldNumber));
+}
+
+TEMPLATE_TEST_CASE("BinMessageView reads many fields in one pass", "",
+                   pbview::BinMessageView<pbview::ParserMode::Fast>,
+                   pbview::BinMessageView<pbview::ParserMode::Fast_WithoutBoundsChecking>,
+                   pbview::BinMessageView<pbview::ParserMode::StrictConforming>)
+{
+    using Msg = pbview::samples::AllTypes;
+    using pbview::Field;
+    namespace type = pbview::type;
+
+    Msg allTypes;
+    allTypes.set_double_field(3.1415926);
+    allTypes.set_int32_field(142);
+    allTypes.set_sint64_field(-642);
+    allTypes.set_string_field(std::string(100, 'X'));
+    allTypes.set_myenum_field(pbview::samples::MyEnumVal3);
+    allTypes.mutable_mysubmsg_field()->set_id(314);
+    allTypes.mutable_mysubmsg_field()->set_value("asdf");
+
+    auto binStr = allTypes.SerializeAsString();
+    auto msg = TestType::fromBytesString(binStr);
+
+    auto [str, i32, missing, d, sub, i32Again] = msg.template getMany<
+        Field<type::String, Msg::kStringFieldFieldNumber>,
+        Field<type::Int32, Msg::kInt32FieldFieldNumber>,
+        Field<type::Float, Msg::kFloatFieldFieldNumber>,
+        Field<type::Double, Msg::kDoubleFieldFieldNumber>,
+        Field<type::Message, Msg::kMysubmsgFieldFieldNumber>,
+        Field<type::Int32, Msg::kInt32FieldFieldNumber>>();
+
+    REQUIRE(str == allTypes.string_field());
+    REQUIRE(i32 == 142);
+    REQUIRE(i32Again == 142);
+    REQUIRE(missing == std::nullopt);
+    REQUIRE(d == allTypes.double_field());
+    REQUIRE(sub);
+    REQUIRE(sub->template get<type::Int32>(pbview::samples::MySubMsg::kIdFieldNumber) == 314);
+
+    // only fields up to the largest requested one are parsed
+    auto [sint64, enumVal] = msg.template getMany<Field<type::Sint64, Msg::kSint64FieldFieldNumber>, Field<type::Enum<pbview::samples::MyEnum>, Msg::kMyenumFieldFieldNumber>>();
+    REQUIRE(sint64 == -642);
+    REQUIRE(enumVal == pbview::samples::MyEnumVal3);
+
+    auto [none] = TestType{pbview::DataSpan{}}.template getMany<Field<type::Int32, Msg::kInt32FieldFieldNumber>>();
+    REQUIRE(none == std::nullopt);
+}
+
+TEST_CASE("BinMessageView reads many fields in one pass with irregular encoding")
+{
+    using Msg = pbview::samples::AllTypes;
+    using pbview::Field;
+    namespace type = pbview::type;
+
+    Msg first;
+    first.set_int32_field(1);
+    first.set_string_field("first");
+    Msg second;
+    second.set_int32_field(2);
+
+    auto binStr = first.SerializeAsString() + second.SerializeAsString();
+    using Int32Field = Field<type::Int32, Msg::kInt32FieldFieldNumber>;
+    using StringField = Field<type::String, Msg::kStringFieldFieldNumber>;
+
+    auto strict = pbview::BinMessageView<pbview::ParserMode::StrictConforming>::fromBytesString(binStr).getMany<Int32Field, StringField>();
+    REQUIRE(strict == std::make_tuple(std::optional{2}, std::optional{"first"sv}));
+
+    auto fast = pbview::BinMessageView<pbview::ParserMode::Fast>::fromBytesString(binStr).getMany<Int32Field, StringField>();
+    REQUIRE(fast == std::make_tuple(std::optional{1}, std::optional{"first"sv}));
+
+    REQUIRE_THROWS(pbview::BinMessageView<pbview::ParserMode::Fast>::fromBytesString(binStr)
+                      .getMany<Field<type::Double, Msg::kInt32FieldFieldNumber>>());
+}
+
+TEST_CASE("BinMessageView reads the encoded values of fields")
+{
+    using Msg = pbview::samples::AllTypes;
+
+    Msg allTypes;
+    allTypes.set_int32_field(300);
+    allTypes.set_fixed32_field(0x04030201);
+    allTypes.set_string_field("key");
+
+    auto binStr = allTypes.SerializeAsString();
+    auto msg = pbview::BinMessageView<>::fromBytesString(binStr);
+    auto raw = [&](int fieldNo) {
+        auto res = msg.getRaw(fieldNo);
+        return res ? std::optional{std::string{reinterpret_cast<const char*>(res->data()), res->size()}} : std::nullopt;
+    };
+
+    REQUIRE(raw(Msg::kInt32FieldFieldNumber) == "\xac\x02"s);
+    REQUIRE(raw(Msg::kFixed32FieldFieldNumber) == "\x01\x02\x03\x04"s);
+    REQUIRE(raw(Msg::kStringFieldFieldNumber) == "key"s);
+    REQUIRE(raw(Msg::kInt64FieldFieldNumber) == std::nullopt);
+}
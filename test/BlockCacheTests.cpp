@@ -0,0 +1,341 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/blockrecordfile.hpp>
+#include <pbview/parallelscan.hpp>
+#include <pbview/zlibcodec.hpp>
+#include "TestHelpers.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+#include <thread>
+
+namespace
+{
+using pbview_test::span;
+using Msg = pbview::samples::AllTypes;
+
+// counts the decompressed blocks
+struct CountingCodec : pbview::ZlibCodec
+{
+    mutable std::atomic<int> decompressions{0};
+
+    void decompress(pbview::DataSpan in, std::byte* out, std::size_t outSize) const override
+    {
+        decompressions++;
+        ZlibCodec::decompress(in, out, outSize);
+    }
+};
+
+std::string writeCompressed(int count, std::shared_ptr<const pbview::BlockCodec> codec)
+{
+    std::ostringstream os;
+    pbview::BlockWriterOptions options;
+    options.blockSize = 512;
+    options.codec = std::move(codec);
+    pbview::BlockRecordWriter writer{os, options};
+    for (int i = 0; i < count; i++)
+    {
+        Msg msg;
+        msg.set_int32_field(i);
+        msg.set_string_field(std::string(i % 100, 'X'));
+        writer.add(msg);
+    }
+    writer.close();
+    return os.str();
+}
+}
+
+TEST_CASE("BufferPool reuses released buffers")
+{
+    auto pool = pbview::BufferPool::create(2);
+    auto first = pool->acquire(100);
+    auto second = pool->acquire(200);
+    auto third = pool->acquire(300);
+    REQUIRE(first->size() == 100);
+    REQUIRE(pool->pooledCount() == 0);
+
+    auto firstData = first->data();
+    first.reset();
+    REQUIRE(pool->pooledCount() == 1);
+    REQUIRE(pool->acquire(50)->data() == firstData);
+
+    second.reset();
+    third.reset();
+    REQUIRE(pool->pooledCount() == 2);
+
+    // buffers outliving their pool are freed
+    auto late = pool->acquire(10);
+    pool.reset();
+    late.reset();
+}
+
+TEST_CASE("BlockCache evicts unpinned blocks in LRU order")
+{
+    pbview::BlockCache cache{250};
+    int loads = 0;
+    auto load = [&](std::byte* out, std::size_t size) {
+        loads++;
+        std::fill(out, out + size, std::byte{42});
+    };
+
+    auto a = cache.get({1, 0}, 100, load);
+    auto b = cache.get({1, 100}, 100, load);
+    REQUIRE(loads == 2);
+    REQUIRE(a->size() == 100);
+    REQUIRE((*a)[99] == std::byte{42});
+    REQUIRE(cache.get({1, 0}, 100, load) == a);
+    REQUIRE(cache.get({2, 0}, 100, load)->size() == 100);
+    REQUIRE(loads == 3);
+
+    // all blocks but {2, 0} are pinned
+    REQUIRE(cache.stats().size == 300);
+    REQUIRE(cache.stats().evictions == 0);
+
+    b.reset();
+    cache.get({1, 200}, 10, load);
+    // {1, 100} is the least recently used unpinned block
+    auto stats = cache.stats();
+    REQUIRE(stats.evictions == 1);
+    REQUIRE(stats.size == 210);
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 4);
+
+    cache.get({1, 100}, 100, load);
+    REQUIRE(loads == 5);
+    // pinned blocks are still valid
+    REQUIRE((*a)[0] == std::byte{42});
+}
+
+TEST_CASE("BlockCache retries failed loads")
+{
+    pbview::BlockCache cache{1000};
+    REQUIRE_THROWS(cache.get({1, 0}, 10, [](std::byte*, std::size_t) { throw std::runtime_error("corrupt"); }));
+    REQUIRE(cache.get({1, 0}, 10, [](std::byte* out, std::size_t size) { std::fill(out, out + size, std::byte{1}); })->size() == 10);
+}
+
+TEST_CASE("BlockCache doesn't keep entries of failed loads")
+{
+    pbview::BlockCache cache{1000};
+    auto fail = [](std::byte*, std::size_t) { throw std::runtime_error("corrupt"); };
+
+    for (int pass = 0; pass < 3; pass++)
+        for (std::uint64_t offset = 0; offset < 100; offset++)
+            REQUIRE_THROWS(cache.get({1, offset}, 10, fail));
+
+    auto stats = cache.stats();
+    REQUIRE(stats.entries == 0);
+    REQUIRE(stats.size == 0);
+    REQUIRE(stats.hits == 0);
+    REQUIRE(stats.misses == 300);
+    REQUIRE(stats.evictions == 0);
+
+    SECTION("with threads waiting for the failed load")
+    {
+        std::atomic<bool> failed{false};
+        std::atomic<int> loads{0};
+        auto failOnce = [&](std::byte* out, std::size_t size) {
+            loads++;
+            if (!failed.exchange(true))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                throw std::runtime_error("corrupt");
+            }
+            std::fill(out, out + size, std::byte{1});
+        };
+
+        std::atomic<int> failures{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&] {
+                try
+                {
+                    cache.get({2, 0}, 10, failOnce);
+                }
+                catch (const std::runtime_error&)
+                {
+                    failures++;
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+
+        REQUIRE(failures == 1);
+        REQUIRE(cache.get({2, 0}, 10, failOnce)->size() == 10);
+        stats = cache.stats();
+        REQUIRE(stats.entries == 1);
+        REQUIRE(stats.size == 10);
+    }
+}
+
+TEST_CASE("BlockRecordReader on compressed blocks")
+{
+    auto codec = std::make_shared<CountingCodec>();
+    auto data = writeCompressed(3000, codec);
+    // compare to the uncompressed size
+    REQUIRE(data.size() * 3 < [] {
+        std::ostringstream os;
+        pbview::BlockRecordWriter writer{os, 512};
+        for (int i = 0; i < 3000; i++)
+        {
+            Msg msg;
+            msg.set_int32_field(i);
+            msg.set_string_field(std::string(i % 100, 'X'));
+            writer.add(msg);
+        }
+        writer.close();
+        return os.str().size();
+    }());
+
+    REQUIRE_THROWS(pbview::BlockRecordReader<>{span(data)});
+
+    pbview::BlockReaderOptions options;
+    options.codec = codec;
+
+    SECTION("without cache")
+    {
+        pbview::BlockRecordReader<> reader{span(data), options};
+        REQUIRE(reader.compressed());
+        for (int pass = 0; pass < 2; pass++)
+        {
+            int i = 0;
+            reader.forEachRecord([&](pbview::BinMessageView<> record) {
+                REQUIRE(pbview::View<Msg>{record}.int32_field() == i++);
+            });
+            REQUIRE(i == 3000);
+        }
+        const auto blocks = codec->decompressions.load();
+        REQUIRE(blocks > 2);
+        REQUIRE(blocks % 2 == 0);
+    }
+
+    SECTION("with shared cache")
+    {
+        options.cache = std::make_shared<pbview::BlockCache>(1 << 20);
+        pbview::BlockRecordReader<> reader{span(data), options};
+        pbview::ParallelScanOptions scanOptions;
+        scanOptions.threadCount = 4;
+        scanOptions.chunkSize = 1000;
+
+        for (int pass = 0; pass < 3; pass++)
+        {
+            auto sums = pbview::parallelForEachRecord(reader, std::int64_t{0}, [](std::int64_t& sum, pbview::BinMessageView<> record) {
+                sum += pbview::View<Msg>{record}.int32_field();
+            }, scanOptions);
+            REQUIRE(std::accumulate(sums.begin(), sums.end(), std::int64_t{0}) == 2999 * 3000 / 2);
+        }
+        // hot blocks are decompressed once
+        const auto stats = options.cache->stats();
+        REQUIRE(static_cast<std::uint64_t>(codec->decompressions) == stats.misses);
+        REQUIRE(stats.hits == 2 * stats.misses);
+    }
+
+    SECTION("readers of the same file share the cache")
+    {
+        options.cache = std::make_shared<pbview::BlockCache>(1 << 20);
+        auto count = [&](pbview::DataSpan bytes) {
+            int n = 0;
+            pbview::BlockRecordReader<>{bytes, options}.forEachRecord([&](auto) { n++; });
+            return n;
+        };
+
+        REQUIRE(count(span(data)) == 3000);
+        const auto misses = options.cache->stats().misses;
+        REQUIRE(misses > 2);
+
+        // another reader, also on a copy of the file
+        const auto copy = data;
+        REQUIRE(count(span(data)) == 3000);
+        REQUIRE(count(span(copy)) == 3000);
+        REQUIRE(options.cache->stats().misses == misses);
+        REQUIRE(options.cache->stats().hits == 2 * misses);
+        REQUIRE(static_cast<std::uint64_t>(codec->decompressions) == misses);
+
+        // another file with the same records
+        const auto other = writeCompressed(3000, codec);
+        REQUIRE(count(span(other)) == 3000);
+        REQUIRE(options.cache->stats().misses == 2 * misses);
+    }
+
+    SECTION("blocks stay pinned after eviction")
+    {
+        options.cache = std::make_shared<pbview::BlockCache>(1);
+        pbview::BlockRecordReader<> reader{span(data), options};
+
+        std::vector<pbview::BlockRecordReader<>::Block> blocks;
+        reader.forEachBlock(0, data.size(), [&](const auto& block) { blocks.push_back(block); });
+        REQUIRE(options.cache->stats().evictions == 0);
+
+        auto third = reader.block(blocks[2].offset);
+        REQUIRE(third.payload == blocks[2].payload);
+        REQUIRE(ranges::to_vector(third.records()).size() == third.recordCount);
+
+        int i = 0;
+        for (const auto& block : blocks)
+            for (auto record : block.records())
+                REQUIRE(pbview::View<Msg>{record}.int32_field() == i++);
+        REQUIRE(i == 3000);
+
+        // released pins can be evicted (all blocks but the still pinned third one)
+        const auto blockCount = blocks.size();
+        blocks.clear();
+        reader.block(third.offset);
+        REQUIRE(options.cache->stats().evictions == blockCount - 1);
+    }
+
+    SECTION("records keep their block pinned")
+    {
+        auto check = [&] {
+            pbview::BlockRecordReader<> reader{span(data), options};
+            std::vector<pbview::BlockRecordReader<>::Record> records;
+            reader.forEachRecord([&](const auto& record) {
+                if (pbview::View<Msg>{record}.int32_field() % 500 == 0)
+                    records.push_back(record);
+            });
+            // reading the file again reuses all unpinned buffers
+            reader.forEachRecord([](auto) {});
+
+            REQUIRE(records.size() == 6);
+            for (std::size_t i = 0; i < records.size(); i++)
+            {
+                REQUIRE(records[i].pin);
+                REQUIRE(pbview::View<Msg>{records[i]}.int32_field() == static_cast<int>(i * 500));
+                REQUIRE(pbview::View<Msg>{records[i]}.string_field().size() == 0);
+            }
+            return records;
+        };
+
+        SECTION("without cache")
+        {
+            check();
+        }
+
+        SECTION("evicted from the cache")
+        {
+            options.cache = std::make_shared<pbview::BlockCache>(1);
+            auto records = check();
+            const auto evictions = options.cache->stats().evictions;
+            REQUIRE(evictions > 0);
+
+            // the pinned blocks are evicted once the records are released
+            records.clear();
+            pbview::BlockRecordReader<>{span(data), options}.block(pbview::block_format::fileHeaderSize);
+            REQUIRE(options.cache->stats().evictions > evictions);
+        }
+    }
+
+    SECTION("corrupt compressed data")
+    {
+        std::vector<std::uint64_t> offsets;
+        pbview::BlockRecordReader<>{span(data), options}.forEachBlock(0, data.size(), [&](const auto& block) { offsets.push_back(block.offset); });
+
+        // a valid checksum over corrupted compressed data
+        options.verifyChecksums = false;
+        data[offsets[3] + 40] ^= 0x55;
+        REQUIRE_THROWS(pbview::BlockRecordReader<>{span(data), options}.forEachRecord([](auto) {}));
+
+        options.skipCorruptBlocks = true;
+        REQUIRE(pbview::BlockRecordReader<>{span(data), options}.forEachRecord([](auto) {}) == 1);
+    }
+}
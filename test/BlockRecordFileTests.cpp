@@ -0,0 +1,204 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/blockrecordfile.hpp>
+#include <pbview/parallelscan.hpp>
+#include "TestHelpers.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+using namespace std::literals;
+
+namespace
+{
+using pbview_test::span;
+using pbview_test::TempFile;
+using Msg = pbview::samples::AllTypes;
+
+Msg sampleRecord(int i)
+{
+    Msg msg;
+    msg.set_int32_field(i);
+    msg.set_string_field(std::string(i % 50, 'X'));
+    // a few records larger than the block size
+    if (i % 97 == 0)
+        msg.set_bytes_field(std::string(3000, 'Y'));
+    return msg;
+}
+
+std::string writeBlocks(int count, std::uint32_t blockSize)
+{
+    std::ostringstream os;
+    pbview::BlockRecordWriter writer{os, blockSize};
+    for (int i = 0; i < count; i++)
+    {
+        // all ways of adding records
+        auto msg = sampleRecord(i);
+        if (i % 3 == 0)
+            writer.add(msg);
+        else if (i % 3 == 1)
+            writer.add(pbview::BinMessageView<>::fromBytesString(msg.SerializeAsString()));
+        else
+        {
+            auto str = msg.SerializeAsString();
+            writer.add(pbview::DataSpan{reinterpret_cast<const std::byte*>(str.data()), str.size()});
+        }
+    }
+    REQUIRE(writer.recordCount() == static_cast<std::uint64_t>(count));
+    writer.close();
+    return os.str();
+}
+}
+
+TEST_CASE("CRC32C of known inputs")
+{
+    auto crc = [](std::string_view str) { return pbview::impl::crc32c(reinterpret_cast<const std::byte*>(str.data()), str.size()); };
+    REQUIRE(crc("") == 0);
+    REQUIRE(crc("123456789") == 0xe3069283);
+    REQUIRE(crc(std::string(32, '\0')) == 0x8a9136aa);
+    auto str = "The quick brown fox jumps over the lazy dog"s;
+    REQUIRE(pbview::impl::crc32c(reinterpret_cast<const std::byte*>(str.data()) + 10, str.size() - 10,
+                                 pbview::impl::crc32c(reinterpret_cast<const std::byte*>(str.data()), 10)) == crc(str));
+    REQUIRE(pbview::impl::crc32cScalar(~0u, reinterpret_cast<const std::uint8_t*>(str.data()), str.size()) == ~crc(str));
+}
+
+TEMPLATE_TEST_CASE_SIG("BlockRecordReader reads all records written by BlockRecordWriter", "", ((pbview::ParserMode mode), mode),
+                       pbview::ParserMode::Fast_WithoutBoundsChecking, pbview::ParserMode::Fast, pbview::ParserMode::StrictConforming)
+{
+    for (std::uint32_t blockSize : {64u, 1000u, 65536u})
+    {
+        INFO("block size " << blockSize);
+        auto data = writeBlocks(1000, blockSize);
+        pbview::BlockRecordReader<mode> reader{span(data)};
+        REQUIRE(reader.blockSize() == blockSize);
+
+        int i = 0;
+        REQUIRE(reader.forEachRecord([&](pbview::BinMessageView<mode> record) {
+            auto view = pbview::View<Msg, pbview::BinMessageView<mode>>{record};
+            REQUIRE(view.int32_field() == i);
+            REQUIRE(view.string_field().size() == static_cast<std::size_t>(i % 50));
+            REQUIRE(view.bytes_field().size() == (i % 97 == 0 ? 3000u : 0u));
+            // zero-copy
+            REQUIRE(record.bytes.data() > reinterpret_cast<const std::byte*>(data.data()));
+            REQUIRE(record.bytes.data() < reinterpret_cast<const std::byte*>(data.data() + data.size()));
+            i++;
+        }) == 0);
+        REQUIRE(i == 1000);
+
+        // blocks start at block aligned offsets
+        std::uint64_t blockRecords = 0;
+        reader.forEachBlock(0, data.size(), [&](const auto& block) {
+            REQUIRE((block.offset - pbview::block_format::fileHeaderSize) % blockSize == 0);
+            blockRecords += block.recordCount;
+            REQUIRE(ranges::distance(block.records()) == block.recordCount);
+        });
+        REQUIRE(blockRecords == 1000);
+    }
+}
+
+TEST_CASE("BlockRecordReader on disjoint byte ranges")
+{
+    auto data = writeBlocks(2000, 512);
+    pbview::BlockRecordReader<> reader{span(data)};
+
+    for (std::size_t rangeSize : {1, 100, 512, 777, 100000})
+    {
+        INFO("range size " << rangeSize);
+        std::vector<int> seen;
+        for (std::size_t begin = 0; begin < data.size(); begin += rangeSize)
+        {
+            reader.forEachRecord(begin, begin + rangeSize, [&](pbview::BinMessageView<> record) {
+                seen.push_back(pbview::View<Msg>{record}.int32_field());
+            });
+        }
+        REQUIRE(seen.size() == 2000);
+        for (int i = 0; i < 2000; i++)
+            REQUIRE(seen[i] == i);
+    }
+}
+
+TEST_CASE("BlockRecordReader with parallelForEachRecord")
+{
+    auto data = writeBlocks(3000, 1024);
+
+    const TempFile file{data};
+    pbview::BlockRecordReader<pbview::ParserMode::Fast_WithoutBoundsChecking> reader{file.path};
+
+    for (std::size_t chunkSize : {100, 4096, 1 << 20})
+    {
+        pbview::ParallelScanOptions options;
+        options.threadCount = 3;
+        options.chunkSize = chunkSize;
+        auto sums = pbview::parallelForEachRecord(reader, std::int64_t{0}, [](std::int64_t& sum, pbview::BinMessageView<pbview::ParserMode::Fast_WithoutBoundsChecking> record) {
+            sum += pbview::View<Msg, pbview::BinMessageView<pbview::ParserMode::Fast_WithoutBoundsChecking>>{record}.int32_field();
+        }, options);
+        REQUIRE(std::accumulate(sums.begin(), sums.end(), std::int64_t{0}) == 2999 * 3000 / 2);
+    }
+}
+
+TEST_CASE("BlockRecordReader on corrupted files")
+{
+    auto data = writeBlocks(1000, 256);
+    auto countRecords = [](const auto& reader) {
+        std::size_t count = 0;
+        auto skipped = reader.forEachRecord([&](auto) { count++; });
+        return std::make_pair(count, skipped);
+    };
+
+    REQUIRE_THROWS(pbview::BlockRecordReader<>{span(data.substr(0, 20))});
+    REQUIRE_THROWS(pbview::BlockRecordReader<>{span("x" + data.substr(1))});
+    pbview::BlockReaderOptions unverified;
+    unverified.verifyChecksums = false;
+    REQUIRE_THROWS(pbview::BlockRecordReader<pbview::ParserMode::Fast_WithoutBoundsChecking>{span(data), unverified});
+
+    // offset of the 10th block
+    std::vector<std::uint64_t> blockOffsets;
+    pbview::BlockRecordReader<>{span(data)}.forEachBlock(0, data.size(), [&](const auto& block) { blockOffsets.push_back(block.offset); });
+    const auto offset = blockOffsets.at(10);
+
+    SECTION("corrupted payload")
+    {
+        data[offset + 40] ^= 1;
+        REQUIRE_THROWS(countRecords(pbview::BlockRecordReader<>{span(data)}));
+
+        pbview::BlockReaderOptions options;
+        options.skipCorruptBlocks = true;
+        auto [count, skipped] = countRecords(pbview::BlockRecordReader<>{span(data), options});
+        REQUIRE(skipped == 1);
+        REQUIRE(count < 1000);
+        REQUIRE(count > 990);
+    }
+
+    SECTION("corrupted header")
+    {
+        // a wrong payload size must not hide the following blocks
+        data[offset + 20] ^= 0x40;
+        REQUIRE_THROWS(countRecords(pbview::BlockRecordReader<>{span(data)}));
+
+        pbview::BlockReaderOptions options;
+        options.skipCorruptBlocks = true;
+        auto [count, skipped] = countRecords(pbview::BlockRecordReader<>{span(data), options});
+        REQUIRE(skipped == 1);
+        REQUIRE(count < 1000);
+        REQUIRE(count > 990);
+    }
+
+    SECTION("corrupted length of a record")
+    {
+        auto str = data;
+        str[offset + 32] = '\x7f';
+
+        REQUIRE_THROWS(countRecords(pbview::BlockRecordReader<>{span(str), unverified}));
+        pbview::BlockReaderOptions options = unverified;
+        options.skipCorruptBlocks = true;
+        auto [count, skipped] = countRecords(pbview::BlockRecordReader<>{span(str), options});
+        REQUIRE(skipped == 1);
+        REQUIRE(count > 990);
+    }
+
+    SECTION("truncated file")
+    {
+        data.resize(data.size() - 10);
+        REQUIRE_THROWS(countRecords(pbview::BlockRecordReader<>{span(data)}));
+    }
+}
@@ -0,0 +1,293 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/blockrecordfile.hpp>
+#include <pbview/zlibcodec.hpp>
+#include "TestHelpers.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+using namespace std::literals;
+
+namespace
+{
+using pbview_test::span;
+using Msg = pbview::samples::AllTypes;
+using pbview::FieldPredicate;
+using pbview::StatisticsField;
+namespace type = pbview::type;
+
+// int64_field: increasing timestamp, string_field: customer id, double_field: unordered, uint32_field: only in every 7th record
+Msg sampleRecord(int i)
+{
+    Msg msg;
+    msg.set_int32_field(i);
+    msg.set_int64_field(1'000'000 + i * 10);
+    msg.set_string_field("customer-" + std::to_string(i * 7919 % 1000));
+    msg.set_double_field((i * 31 % 200) - 100.5);
+    if (i % 7 == 0)
+        msg.set_uint32_field(i);
+    return msg;
+}
+
+std::string writeRecords(int count, pbview::BlockWriterOptions options)
+{
+    std::ostringstream os;
+    pbview::BlockRecordWriter writer{os, options};
+    for (int i = 0; i < count; i++)
+        writer.add(sampleRecord(i));
+    writer.close();
+    return os.str();
+}
+
+pbview::BlockWriterOptions statisticsOptions()
+{
+    pbview::BlockWriterOptions options;
+    options.blockSize = 1024;
+    options.statistics = {StatisticsField::of<type::Int64>(4), StatisticsField::of<type::String>(14),
+                          StatisticsField::of<type::Double>(1).withBloomFilter(), StatisticsField::of<type::Uint32>(5)};
+    return options;
+}
+
+// records matching the predicates, counted by reading all records
+template <typename Reader>
+std::vector<int> expectedMatches(const Reader& reader, const std::vector<FieldPredicate>& predicates)
+{
+    std::vector<int> res;
+    reader.forEachRecord([&](pbview::BinMessageView<> record) {
+        if (std::all_of(predicates.begin(), predicates.end(), [&](const auto& p) { return p.matches(record); }))
+            res.push_back(pbview::View<Msg>{record}.int32_field());
+    });
+    return res;
+}
+}
+
+TEST_CASE("FieldPredicate on records")
+{
+    auto msg = sampleRecord(7);
+    auto str = msg.SerializeAsString();
+    auto view = pbview::BinMessageView<>::fromBytesString(str);
+    const auto ts = msg.int64_field();
+
+    REQUIRE(FieldPredicate::equal<type::Int64>(4, ts).matches(view));
+    REQUIRE(!FieldPredicate::equal<type::Int64>(4, ts + 1).matches(view));
+    REQUIRE(FieldPredicate::between<type::Int64>(4, ts - 5, ts).matches(view));
+    REQUIRE(FieldPredicate::between<type::Int64>(4, ts, ts + 5).matches(view));
+    REQUIRE(!FieldPredicate::between<type::Int64>(4, ts + 1, ts + 5).matches(view));
+    REQUIRE(!FieldPredicate::between<type::Int64>(4, ts, ts - 1).matches(view));
+    REQUIRE(FieldPredicate::lessEqual<type::Int64>(4, ts).matches(view));
+    REQUIRE(!FieldPredicate::less<type::Int64>(4, ts).matches(view));
+    REQUIRE(FieldPredicate::greaterEqual<type::Int64>(4, ts).matches(view));
+    REQUIRE(!FieldPredicate::greater<type::Int64>(4, ts).matches(view));
+    REQUIRE(FieldPredicate::greater<type::Int64>(4, std::numeric_limits<std::int64_t>::min()).matches(view));
+    REQUIRE(!FieldPredicate::less<type::Int64>(4, std::numeric_limits<std::int64_t>::min()).matches(view));
+
+    // negative and fractional numbers keep their order
+    REQUIRE(msg.double_field() < 0);
+    REQUIRE(FieldPredicate::between<type::Double>(1, -1e9, msg.double_field()).matches(view));
+    REQUIRE(FieldPredicate::greater<type::Double>(1, -std::numeric_limits<double>::infinity()).matches(view));
+    REQUIRE(!FieldPredicate::greater<type::Double>(1, msg.double_field()).matches(view));
+    REQUIRE(!FieldPredicate::less<type::Double>(1, std::nan("")).matches(view));
+
+    REQUIRE(FieldPredicate::equal<type::String>(14, msg.string_field()).matches(view));
+    REQUIRE(!FieldPredicate::equal<type::String>(14, "customer-").matches(view));
+    REQUIRE(FieldPredicate::equal<type::Uint32>(5, 7).matches(view));
+
+    // missing fields never match
+    REQUIRE(!FieldPredicate::greaterEqual<type::Sint32>(7, std::numeric_limits<std::int32_t>::min()).matches(view));
+}
+
+TEMPLATE_TEST_CASE_SIG("BlockRecordReader::scan prunes blocks by statistics", "", ((bool compressed), compressed), false, true)
+{
+    auto writerOptions = statisticsOptions();
+    pbview::BlockReaderOptions readerOptions;
+    if (compressed)
+    {
+        writerOptions.codec = readerOptions.codec = std::make_shared<pbview::ZlibCodec>();
+        readerOptions.cache = std::make_shared<pbview::BlockCache>(1 << 20);
+    }
+    auto data = writeRecords(5000, writerOptions);
+    pbview::BlockRecordReader<> reader{span(data), readerOptions};
+    REQUIRE(reader.hasStatistics());
+
+    std::uint64_t blockCount = 0;
+    reader.forEachBlock(0, data.size(), [&](const auto& block) {
+        blockCount++;
+        REQUIRE(!block.statistics.empty());
+    });
+    REQUIRE(blockCount > 20);
+
+    auto check = [&](const std::vector<FieldPredicate>& predicates) {
+        const auto expected = expectedMatches(reader, predicates);
+        const auto misses = compressed ? readerOptions.cache->stats().misses : 0;
+        std::vector<int> matches;
+        auto res = reader.scan(predicates, [&](pbview::BinMessageView<> record) { matches.push_back(pbview::View<Msg>{record}.int32_field()); });
+        REQUIRE(matches == expected);
+        REQUIRE(res.matchedRecords == expected.size());
+        REQUIRE(res.scannedBlocks + res.prunedBlocks == blockCount);
+        REQUIRE(res.skippedBlocks == 0);
+        // pruned blocks are not decompressed
+        if (compressed)
+            REQUIRE(readerOptions.cache->stats().misses == misses);
+        return res;
+    };
+
+    SECTION("range on a sorted field")
+    {
+        auto res = check({FieldPredicate::between<type::Int64>(4, 1'020'000, 1'020'500)});
+        REQUIRE(res.matchedRecords == 51);
+        REQUIRE(res.scannedBlocks <= 3);
+
+        REQUIRE(check({FieldPredicate::less<type::Int64>(4, 0)}).prunedBlocks == blockCount);
+        REQUIRE(check({FieldPredicate::greaterEqual<type::Int64>(4, 1'000'000)}).prunedBlocks == 0);
+    }
+
+    SECTION("equality with Bloom filters")
+    {
+        auto res = check({FieldPredicate::equal<type::String>(14, "customer-42")});
+        REQUIRE(res.matchedRecords == 5);
+        REQUIRE(res.prunedBlocks > blockCount / 2);
+
+        REQUIRE(check({FieldPredicate::equal<type::String>(14, "nobody")}).prunedBlocks > blockCount * 9 / 10);
+        // doubles have min/max and a Bloom filter
+        REQUIRE(check({FieldPredicate::equal<type::Double>(1, 3.25)}).prunedBlocks > blockCount / 2);
+        REQUIRE(check({FieldPredicate::greater<type::Double>(1, 99.5)}).prunedBlocks == blockCount);
+    }
+
+    SECTION("conjunctions")
+    {
+        auto res = check({FieldPredicate::greaterEqual<type::Int64>(4, 1'030'000), FieldPredicate::equal<type::String>(14, "customer-42"),
+                          FieldPredicate::lessEqual<type::Double>(1, 0.0)});
+        REQUIRE(res.prunedBlocks > blockCount / 2);
+        check({FieldPredicate::equal<type::Uint32>(5, 700), FieldPredicate::equal<type::Int32>(3, 700)});
+    }
+
+    SECTION("fields without statistics")
+    {
+        REQUIRE(check({FieldPredicate::lessEqual<type::Int32>(3, 10)}).prunedBlocks == 0);
+        // statistics of another kind are ignored
+        REQUIRE(check({FieldPredicate::less<type::Uint64>(4, 1)}).prunedBlocks == 0);
+        // no record has the field
+        REQUIRE(check({FieldPredicate::equal<type::Sint64>(8, 0)}).prunedBlocks == 0);
+    }
+
+    SECTION("scan of byte ranges")
+    {
+        const std::vector<FieldPredicate> predicates{FieldPredicate::equal<type::String>(14, "customer-42")};
+        pbview::ScanResult total;
+        std::size_t matches = 0;
+        for (std::size_t begin = 0; begin < data.size(); begin += 3000)
+            total += reader.scan(begin, begin + 3000, predicates, [&](auto) { matches++; });
+        REQUIRE(total.matchedRecords == 5);
+        REQUIRE(matches == 5);
+        REQUIRE(total.scannedBlocks + total.prunedBlocks == blockCount);
+    }
+}
+
+TEMPLATE_TEST_CASE_SIG("Block statistics cover all occurrences of a field", "", ((pbview::ParserMode mode), mode), pbview::ParserMode::Fast,
+                       pbview::ParserMode::StrictConforming)
+{
+    // concatenated messages (as written by hashJoinConcatenated): int32_field after higher field
+    // numbers, int64_field and string_field twice
+    auto options = statisticsOptions();
+    options.statistics.push_back(StatisticsField::of<type::Int32>(3));
+    std::ostringstream os;
+    pbview::BlockRecordWriter writer{os, options};
+    for (int i = 0; i < 2000; i++)
+    {
+        Msg first;
+        first.set_int64_field(i);
+        first.set_string_field("first-" + std::to_string(i));
+        Msg second;
+        second.set_int32_field(i);
+        second.set_int64_field(1'000'000 + i);
+        second.set_string_field("last-" + std::to_string(i));
+        const auto record = first.SerializeAsString() + second.SerializeAsString();
+        writer.add(span(record));
+    }
+    writer.close();
+    const auto data = os.str();
+
+    pbview::BlockRecordReader<mode> reader{span(data)};
+    for (const auto& predicate : {FieldPredicate::equal<type::Int32>(3, 700), FieldPredicate::equal<type::Int64>(4, 700),
+                                  FieldPredicate::equal<type::Int64>(4, 1'000'700), FieldPredicate::equal<type::String>(14, "first-700"),
+                                  FieldPredicate::equal<type::String>(14, "last-700")})
+    {
+        std::vector<pbview::DataSpan> expected;
+        reader.forEachRecord([&](pbview::BinMessageView<mode> record) {
+            if (predicate.matches(record))
+                expected.push_back(record.bytes);
+        });
+        std::vector<pbview::DataSpan> matches;
+        auto res = reader.scan({predicate}, [&](pbview::BinMessageView<mode> record) { matches.push_back(record.bytes); });
+        REQUIRE(matches == expected);
+        REQUIRE(res.prunedBlocks > 0);
+    }
+
+    // the fast modes read the first value, StrictConforming the last
+    const auto firstMatches = reader.scan({FieldPredicate::equal<type::Int64>(4, 700)}, [](auto) {}).matchedRecords;
+    REQUIRE(firstMatches == (mode == pbview::ParserMode::StrictConforming ? 0 : 1));
+}
+
+TEST_CASE("Block statistics of fields missing in whole blocks")
+{
+    auto options = statisticsOptions();
+    std::ostringstream os;
+    pbview::BlockRecordWriter writer{os, options};
+    for (int i = 0; i < 1000; i++)
+    {
+        auto msg = sampleRecord(i);
+        // only the records of the first and the last block have the field
+        if (i > 50 && i < 950)
+            msg.clear_uint32_field();
+        writer.add(msg);
+    }
+    writer.close();
+    auto data = os.str();
+
+    pbview::BlockRecordReader<> reader{span(data)};
+    std::vector<int> matches;
+    auto res = reader.scan({FieldPredicate::greaterEqual<type::Uint32>(5, 0)}, [&](pbview::BinMessageView<> record) {
+        matches.push_back(pbview::View<Msg>{record}.int32_field());
+    });
+    REQUIRE(matches.size() == 15);
+    REQUIRE(res.scannedBlocks <= 6);
+    REQUIRE(res.prunedBlocks > 20);
+}
+
+TEST_CASE("Block statistics are checked")
+{
+    auto options = statisticsOptions();
+    options.statistics.push_back(StatisticsField::of<type::Bytes>(15));
+    options.statistics.back().bloomBitsPerValue = 0;
+    REQUIRE_THROWS(writeRecords(10, options));
+
+    // files without statistics are scanned completely
+    auto data = writeRecords(2000, pbview::BlockWriterOptions{1024});
+    pbview::BlockRecordReader<> reader{span(data)};
+    REQUIRE(!reader.hasStatistics());
+    auto res = reader.scan({FieldPredicate::equal<type::String>(14, "customer-42")}, [](auto) {});
+    REQUIRE(res.matchedRecords == 2);
+    REQUIRE(res.prunedBlocks == 0);
+
+    SECTION("corrupt statistics")
+    {
+        auto data = writeRecords(2000, statisticsOptions());
+        std::vector<std::uint64_t> offsets;
+        pbview::BlockRecordReader<>{span(data)}.forEachBlock(0, data.size(), [&](const auto& block) { offsets.push_back(block.offset); });
+        // in the statistics (after the block header and their size)
+        data[offsets.at(5) + 40] ^= 0x10;
+
+        const std::vector<FieldPredicate> predicates{FieldPredicate::greaterEqual<type::Int64>(4, 0)};
+        REQUIRE_THROWS(pbview::BlockRecordReader<>{span(data)}.scan(predicates, [](auto) {}));
+
+        pbview::BlockReaderOptions skipping;
+        skipping.skipCorruptBlocks = true;
+        std::size_t count = 0;
+        res = pbview::BlockRecordReader<>{span(data), skipping}.scan(predicates, [&](auto) { count++; });
+        REQUIRE(res.skippedBlocks == 1);
+        REQUIRE(res.matchedRecords == count);
+        REQUIRE(count < 2000);
+        REQUIRE(count > 1900);
+    }
+}
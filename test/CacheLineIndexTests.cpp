@@ -0,0 +1,151 @@
+#include <limits>
+#include <thread>
+
+#include <test/samples-pb2.pbview.h>
+#include <pbview/cachelineindex.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <range/v3/to_container.hpp>
+
+using namespace std::literals;
+
+namespace
+{
+pbview::samples::AllTypesRepeated wideMessage()
+{
+    pbview::samples::AllTypesRepeated msg;
+    for (int i = 0; i < 100; i++)
+    {
+        msg.add_double_field(i);
+        msg.add_int32_field(i);
+        msg.add_sint64_field(-i);
+        msg.add_string_field(std::string(i, 'X'));
+
+        auto subMsg = msg.add_mysubmsg_field();
+        subMsg->set_id(i);
+        subMsg->set_value(std::string(i * 3, 'Y'));
+    }
+    msg.add_bool_field(true);
+    return msg;
+}
+}
+
+TEST_CASE("CacheLineIndex stores the first field of each line")
+{
+    auto msg = wideMessage();
+    auto binStr = msg.SerializeAsString();
+    auto bytes = pbview::BinMessageView<>::fromBytesString(binStr).bytes;
+
+    pbview::CacheLineIndex index{bytes};
+    const auto& table = *index.tableFor(bytes);
+
+    REQUIRE(table.size() > 1);
+    REQUIRE(table.size() <= binStr.size() / pbview::CacheLineIndex::lineSize + 1);
+    REQUIRE(table.front().firstFieldNo == pbview::samples::AllTypesRepeated::kDoubleFieldFieldNumber);
+    REQUIRE(table.front().offset == 0);
+    REQUIRE(std::is_sorted(table.begin(), table.end(), [](auto&& l, auto&& r) { return l.firstFieldNo < r.firstFieldNo; }));
+    REQUIRE(index.tableFor(bytes) == index.tableFor(bytes));
+
+    REQUIRE_THROWS(index.tableFor(pbview::DataSpan{}));
+}
+
+TEST_CASE("CacheLineIndexedBinMessageView as BinView of a generated view")
+{
+    using Msg = pbview::samples::AllTypesRepeated;
+    using BinView = pbview::CacheLineIndexedBinMessageView<>;
+    using View = pbview::View<Msg, BinView>;
+
+    auto msg = wideMessage();
+    auto binStr = msg.SerializeAsString();
+    pbview::CacheLineIndex index{pbview::BinMessageView<>::fromBytesString(binStr).bytes};
+    auto view = View{BinView::fromIndex(index)};
+
+    REQUIRE(view.bool_field_size() == 1);
+    REQUIRE(ranges::to_vector(msg.sint64_field()) == ranges::to_vector(view.sint64_field()));
+    REQUIRE(ranges::to_vector(msg.double_field()) == ranges::to_vector(view.double_field()));
+    REQUIRE(view.string_field(99) == msg.string_field(99));
+    REQUIRE(view.bytes_field_size() == 0);
+    REQUIRE(view.uint64_field_size() == 0);
+
+    REQUIRE(view.mysubmsg_field_size() == msg.mysubmsg_field_size());
+    for (int i = 0; i < msg.mysubmsg_field_size(); i++)
+    {
+        REQUIRE(view.mysubmsg_field(i).value() == msg.mysubmsg_field(i).value());
+        REQUIRE(view.mysubmsg_field(i).id() == msg.mysubmsg_field(i).id());
+    }
+}
+
+TEST_CASE("CacheLineIndexedBinMessageView on sub-messages")
+{
+    using Msg = pbview::samples::AllTypes;
+    using BinView = pbview::CacheLineIndexedBinMessageView<>;
+    using View = pbview::View<Msg, BinView>;
+
+    Msg msg;
+    msg.set_string_field(std::string(1000, 'X'));
+    msg.mutable_mysubmsg_field()->set_value(std::string(1000, 'Y'));
+    msg.mutable_mysubmsg_field()->set_id(42);
+
+    auto binStr = msg.SerializeAsString();
+    pbview::CacheLineIndex index{pbview::BinMessageView<>::fromBytesString(binStr).bytes};
+    auto view = View{BinView::fromIndex(index)};
+
+    REQUIRE(view.mysubmsg_field().id() == 42);
+    REQUIRE(view.mysubmsg_field().value() == msg.mysubmsg_field().value());
+    REQUIRE(view.string_field() == msg.string_field());
+    REQUIRE_FALSE(view.has_int32_field());
+    REQUIRE_FALSE(view.has_bytes_field());
+
+    // without index
+    auto plainView = View::fromBytesString(binStr);
+    REQUIRE(plainView.mysubmsg_field().id() == 42);
+}
+
+TEST_CASE("CacheLineIndex scans small messages without table")
+{
+    pbview::samples::AllTypes msg;
+    msg.set_string_field(std::string(1000, 'X'));
+    msg.mutable_mysubmsg_field()->set_id(42);
+    msg.mutable_mysubmsg_field()->set_value("small");
+
+    auto binStr = msg.SerializeAsString();
+    auto bytes = pbview::BinMessageView<>::fromBytesString(binStr).bytes;
+    pbview::CacheLineIndex index{bytes};
+
+    auto sub = pbview::BinMessageView<>{bytes}.getRaw(pbview::samples::AllTypes::kMysubmsgFieldFieldNumber);
+    REQUIRE(sub);
+    REQUIRE(sub->size() <= pbview::CacheLineIndex::lineSize);
+    REQUIRE(index.tableFor(*sub) == nullptr);
+    REQUIRE(index.tableFor(bytes) != nullptr);
+
+    using BinView = pbview::CacheLineIndexedBinMessageView<>;
+    auto view = pbview::View<pbview::samples::AllTypes, BinView>{BinView::fromIndex(index)};
+    REQUIRE(view.mysubmsg_field().id() == 42);
+}
+
+TEST_CASE("CacheLineIndex builds each table once for concurrent lookups")
+{
+    auto msg = wideMessage();
+    auto binStr = msg.SerializeAsString();
+    auto bytes = pbview::BinMessageView<>::fromBytesString(binStr).bytes;
+    pbview::CacheLineIndex index{bytes};
+
+    std::vector<pbview::DataSpan> subs;
+    for (auto sub : pbview::BinMessageView<>{bytes}.getRepeated<pbview::type::Message>(pbview::samples::AllTypesRepeated::kMysubmsgFieldFieldNumber))
+        subs.push_back(sub.bytes);
+    std::vector<std::vector<const pbview::CacheLineIndex::Table*>> tables(4);
+    std::vector<std::thread> threads;
+    for (auto& t : tables)
+        threads.emplace_back([&] {
+            for (auto sub : subs)
+                t.push_back(index.tableFor(sub));
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    for (auto& t : tables)
+        REQUIRE(t == tables.front());
+    REQUIRE(std::count(tables.front().begin(), tables.front().end(), nullptr) > 0);
+    REQUIRE(std::count(tables.front().begin(), tables.front().end(), nullptr) < static_cast<std::ptrdiff_t>(subs.size()));
+}
@@ -0,0 +1,216 @@
+#include <limits>
+#include <thread>
+
+#include <test/samples-pb2.pbview.h>
+#include <pbview/cachingbinmessageview.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <range/v3/to_container.hpp>
+
+using namespace std::literals;
+
+namespace
+{
+void init(pbview::samples::AllTypes& allTypes)
+{
+    allTypes.set_double_field(3.1415926);
+    allTypes.set_int32_field(142);
+    allTypes.set_sint64_field(-642);
+    allTypes.set_fixed64_field(842);
+    allTypes.set_string_field("Lorem ipsum");
+    allTypes.set_myenum_field(pbview::samples::MyEnumVal3);
+    allTypes.mutable_mysubmsg_field()->set_id(314);
+    allTypes.mutable_mysubmsg_field()->set_value("asdf");
+}
+}
+
+TEMPLATE_TEST_CASE("CachingBinMessageView as BinView of a generated view", "",
+                   pbview::CachingBinMessageView<pbview::ParserMode::Fast>,
+                   pbview::CachingBinMessageView<pbview::ParserMode::Fast_WithoutBoundsChecking>,
+                   pbview::CachingBinMessageView<pbview::ParserMode::StrictConforming>)
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    init(allTypes);
+    using View = pbview::View<Msg, TestType>;
+
+    auto binStr = allTypes.SerializeAsString();
+    auto view = View::fromBytesString(binStr);
+
+    // repeated lookups, forward and backward
+    for (int i = 0; i < 2; i++)
+    {
+        REQUIRE_FALSE(view.has_float_field());
+        REQUIRE(allTypes.int32_field()    == view.int32_field());
+        REQUIRE(allTypes.mysubmsg_field().id() == view.mysubmsg_field().id());
+        REQUIRE(allTypes.fixed64_field()  == view.fixed64_field());
+        REQUIRE_FALSE(view.has_bytes_field());
+        REQUIRE(allTypes.double_field()   == view.double_field());
+        REQUIRE(allTypes.myenum_field()   == view.myenum_field());
+        REQUIRE(allTypes.string_field()   == view.string_field());
+        REQUIRE(allTypes.sint64_field()   == view.sint64_field());
+        REQUIRE_FALSE(view.has_uint32_field());
+    }
+
+    auto copy = view;
+    REQUIRE(copy.string_field() == "Lorem ipsum");
+}
+
+TEST_CASE("CachingBinMessageView on repeated fields")
+{
+    pbview::samples::AllTypesRepeated repeated;
+    pbview::samples::AllTypesRepeatedPacked packed;
+    for (auto i : {142, std::numeric_limits<std::int32_t>::min(), std::numeric_limits<std::int32_t>::max()})
+    {
+        repeated.add_sint32_field(i);
+        repeated.add_sfixed32_field(i);
+        packed.add_sint32_field(i);
+        packed.add_sfixed32_field(i);
+    }
+
+    {
+        auto binStr = repeated.SerializeAsString();
+        auto view = pbview::View<pbview::samples::AllTypesRepeated, pbview::CachingBinMessageView<>>::fromBytesString(binStr);
+
+        REQUIRE(ranges::to_vector(repeated.sfixed32_field()) == ranges::to_vector(view.sfixed32_field()));
+        REQUIRE(ranges::to_vector(repeated.sint32_field()) == ranges::to_vector(view.sint32_field()));
+        REQUIRE(ranges::to_vector(repeated.sfixed32_field()) == ranges::to_vector(view.sfixed32_field()));
+        REQUIRE(view.int32_field_size() == 0);
+    }
+
+    {
+        auto binStr = packed.SerializeAsString();
+        auto view = pbview::View<pbview::samples::AllTypesRepeatedPacked, pbview::CachingBinMessageView<>>::fromBytesString(binStr);
+
+        REQUIRE(ranges::to_vector(packed.sfixed32_field()) == ranges::to_vector(view.sfixed32_field()));
+        REQUIRE(ranges::to_vector(packed.sint32_field()) == ranges::to_vector(view.sint32_field()));
+        REQUIRE(view.int32_field_size() == 0);
+    }
+}
+
+TEST_CASE("CachingBinMessageView on fields with large field numbers")
+{
+    using Msg = pbview::samples::SparseFields;
+    Msg msg;
+    msg.set_low_field(1);
+    msg.set_high_field(-1000);
+    msg.add_packed_field(-3);
+    msg.add_packed_field(4);
+
+    auto binStr = msg.SerializeAsString();
+    auto view = pbview::View<Msg, pbview::CachingBinMessageView<>>::fromBytesString(binStr);
+
+    REQUIRE(view.high_field() == -1000);
+    REQUIRE(view.low_field() == 1);
+    REQUIRE(ranges::to_vector(view.packed_field()) == std::vector<std::int32_t>{-3, 4});
+    REQUIRE_FALSE(view.has_boundary_field());
+}
+
+TEST_CASE("CachingBinMessageView with irregular encoding")
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg first;
+    first.set_int32_field(1);
+    first.set_string_field("first");
+    Msg second;
+    second.set_int32_field(2);
+
+    auto binStr = first.SerializeAsString() + second.SerializeAsString();
+
+    auto strict = pbview::CachingBinMessageView<pbview::ParserMode::StrictConforming>::fromBytesString(binStr);
+    REQUIRE(strict.get<pbview::type::String>(Msg::kStringFieldFieldNumber) == "first"sv);
+    REQUIRE(strict.get<pbview::type::Int32>(Msg::kInt32FieldFieldNumber) == 2);
+    REQUIRE(strict.get<pbview::type::Int32>(Msg::kInt32FieldFieldNumber) == 2);
+}
+
+TEMPLATE_TEST_CASE_SIG("CachingBinMessageView on unsorted fields reads like BinMessageView", "", ((pbview::ParserMode mode), mode),
+                       pbview::ParserMode::Fast_WithoutBoundsChecking, pbview::ParserMode::Fast, pbview::ParserMode::StrictConforming)
+{
+    using pbview::type::Int32;
+    // field 5 = 1, field 3 = 7, field 5 = 2, field 1 = 9, field 7 = 4, field 3 = 8
+    const auto binStr = "\x28\x01\x18\x07\x28\x02\x08\x09\x38\x04\x18\x08"s;
+    const auto plain = pbview::BinMessageView<mode>::fromBytesString(binStr);
+
+    auto check = [&](const std::vector<int>& fieldNos) {
+        auto caching = pbview::CachingBinMessageView<mode>::fromBytesString(binStr);
+        // the first lookup of a view is not cached
+        for (int pass = 0; pass < 3; pass++)
+        {
+            for (int fieldNo : fieldNos)
+            {
+                INFO("field " << fieldNo << ", pass " << pass);
+                REQUIRE(caching.template get<Int32>(fieldNo) == plain.template get<Int32>(fieldNo));
+                REQUIRE(caching.has(fieldNo) == plain.has(fieldNo));
+                REQUIRE(ranges::to_vector(caching.template getRepeated<Int32>(fieldNo)) == ranges::to_vector(plain.template getRepeated<Int32>(fieldNo)));
+            }
+        }
+    };
+
+    check({1, 2, 3, 4, 5, 6, 7, 8});
+    check({8, 7, 6, 5, 4, 3, 2, 1});
+    check({5, 5, 3, 1, 7});
+    check({7, 5, 3, 1});
+}
+
+TEST_CASE("CachingBinMessageView copies before and after the first lookup")
+{
+    using Msg = pbview::samples::AllTypes;
+    using View = pbview::View<Msg, pbview::CachingBinMessageView<>>;
+    Msg allTypes;
+    init(allTypes);
+
+    auto binStr = allTypes.SerializeAsString();
+    auto view = View::fromBytesString(binStr);
+    // no cache yet
+    auto early = view;
+    View defaultView;
+    REQUIRE(defaultView.int32_field() == 0);
+
+    REQUIRE(view.string_field() == "Lorem ipsum");
+    // sharing the cache of view
+    auto late = view;
+    REQUIRE(late.int32_field() == 142);
+    REQUIRE(early.mysubmsg_field().id() == 314);
+
+    defaultView = late;
+    late = std::move(early);
+    late = late;
+    REQUIRE(defaultView.sint64_field() == -642);
+    REQUIRE(late.fixed64_field() == 842);
+    REQUIRE(view.myenum_field() == pbview::samples::MyEnumVal3);
+}
+
+TEST_CASE("CachingBinMessageView with concurrent readers")
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    init(allTypes);
+
+    auto binStr = allTypes.SerializeAsString();
+
+    // every thread reads the same views, so that the first accesses (filling the caches) race
+    std::vector<pbview::View<Msg, pbview::CachingBinMessageView<>>> views;
+    for (int i = 0; i < 1000; i++)
+        views.push_back(pbview::View<Msg, pbview::CachingBinMessageView<>>::fromBytesString(binStr));
+
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&, t] {
+            for (auto& view : views)
+            {
+                bool ok = (t % 2 == 0)
+                    ? view.string_field() == "Lorem ipsum" && view.int32_field() == 142
+                    : view.mysubmsg_field().id() == 314 && view.int32_field() == 142 && !view.has_float_field();
+                if (!ok)
+                    failures++;
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    REQUIRE(failures == 0);
+}
@@ -0,0 +1,91 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/columns.hpp>
+
+#include <catch2/catch.hpp>
+
+namespace
+{
+using Msg = pbview::samples::AllTypes;
+namespace type = pbview::type;
+using pbview::Field;
+
+// int64_field: position (every 3rd missing), string_field: every 5th missing, double_field: position / 4
+std::vector<std::string> makeMessages(int count)
+{
+    std::vector<std::string> res;
+    for (int i = 0; i < count; i++)
+    {
+        Msg msg;
+        if (i % 3)
+            msg.set_int64_field(i);
+        if (i % 5)
+            msg.set_string_field("s" + std::to_string(i));
+        msg.set_double_field(i / 4.0);
+        res.push_back(msg.SerializeAsString());
+    }
+    return res;
+}
+
+std::vector<pbview::DataSpan> spans(const std::vector<std::string>& messages)
+{
+    std::vector<pbview::DataSpan> res;
+    for (const auto& msg : messages)
+        res.emplace_back(reinterpret_cast<const std::byte*>(msg.data()), msg.size());
+    return res;
+}
+}
+
+TEST_CASE("extractColumn reads one field of many messages")
+{
+    const auto messages = makeMessages(1000);
+    const auto bins = spans(messages);
+
+    pbview::ColumnOptions options;
+    SECTION("on the calling thread")
+    {
+    }
+    SECTION("in parallel")
+    {
+        options.threadCount = 3;
+        options.chunkSize = 100;
+    }
+
+    const auto column = pbview::extractColumn<type::Int64>(bins, Msg::kInt64FieldFieldNumber, options);
+    REQUIRE(column.size() == messages.size());
+    REQUIRE(column.validity.size() == 16);
+    for (std::size_t i = 0; i < messages.size(); i++)
+    {
+        REQUIRE(column.valid(i) == (i % 3 != 0));
+        REQUIRE(column.values[i] == (i % 3 ? static_cast<std::int64_t>(i) : 0));
+    }
+    REQUIRE(column.validCount() == 666);
+    REQUIRE(pbview::extractColumn<pbview::ParserMode::StrictConforming, type::Int64>(bins, Msg::kInt64FieldFieldNumber, options).values == column.values);
+
+    REQUIRE(pbview::extractColumn<type::Int64>({}, Msg::kInt64FieldFieldNumber).size() == 0);
+}
+
+TEST_CASE("extractColumns reads several fields of many messages in one pass")
+{
+    const auto messages = makeMessages(5000);
+    const auto bins = spans(messages);
+
+    pbview::ColumnOptions options;
+    options.threadCount = 4;
+    options.chunkSize = 300;
+    const auto [strings, doubles, int64s] = pbview::extractColumns<Field<type::String, Msg::kStringFieldFieldNumber>,
+                                                                   Field<type::Double, Msg::kDoubleFieldFieldNumber>,
+                                                                   Field<type::Int64, Msg::kInt64FieldFieldNumber>>(bins, options);
+    REQUIRE(strings.size() == messages.size());
+    for (std::size_t i = 0; i < messages.size(); i++)
+    {
+        const auto view = pbview::BinMessageView<>{bins[i]};
+        REQUIRE(strings.valid(i) == (i % 5 != 0));
+        REQUIRE(std::optional{strings.values[i]} == (strings.valid(i) ? view.get<type::String>(Msg::kStringFieldFieldNumber) : std::optional{std::string_view{}}));
+        REQUIRE(doubles.valid(i));
+        REQUIRE(doubles.values[i] == i / 4.0);
+        REQUIRE(int64s.valid(i) == (i % 3 != 0));
+    }
+
+    const auto [strict] = pbview::extractColumns<pbview::ParserMode::StrictConforming, Field<type::Double, Msg::kDoubleFieldFieldNumber>>(bins);
+    REQUIRE(strict.values == doubles.values);
+}
@@ -0,0 +1,170 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/delimitedstreamreader.hpp>
+
+#include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <catch2/catch.hpp>
+
+using namespace std::literals;
+
+namespace
+{
+std::vector<pbview::samples::AllTypes> sampleRecords()
+{
+    std::vector<pbview::samples::AllTypes> records;
+    for (int i = 0; i < 200; i++)
+    {
+        pbview::samples::AllTypes msg;
+        msg.set_int32_field(i);
+        msg.set_string_field(std::string(i % 50 * i % 7 * 10, 'X'));
+        if (i % 3 == 0)
+            msg.mutable_mysubmsg_field()->set_id(i * 1000);
+        records.push_back(msg);
+    }
+    // empty and large records
+    records.emplace_back();
+    records.emplace_back().set_bytes_field(std::string(100000, 'Y'));
+    records.emplace_back().set_int32_field(-1);
+    return records;
+}
+
+std::string writeDelimited(const std::vector<pbview::samples::AllTypes>& records)
+{
+    std::string res;
+    {
+        google::protobuf::io::StringOutputStream os{&res};
+        for (const auto& msg : records)
+            google::protobuf::util::SerializeDelimitedToZeroCopyStream(msg, &os);
+    }
+    return res;
+}
+
+std::string gzip(const std::string& data)
+{
+    std::string res;
+    {
+        google::protobuf::io::StringOutputStream os{&res};
+        google::protobuf::io::GzipOutputStream gzipOs{&os};
+        void* buf;
+        int size;
+        std::size_t pos = 0;
+        while (pos < data.size() && gzipOs.Next(&buf, &size))
+        {
+            const auto n = std::min(static_cast<std::size_t>(size), data.size() - pos);
+            memcpy(buf, data.data() + pos, n);
+            gzipOs.BackUp(size - static_cast<int>(n));
+            pos += n;
+        }
+        gzipOs.Close();
+    }
+    return res;
+}
+
+template <typename Reader>
+void requireRecords(Reader& reader, const std::vector<pbview::samples::AllTypes>& records)
+{
+    using Msg = pbview::samples::AllTypes;
+    for (const auto& msg : records)
+    {
+        auto view = reader.template next<Msg>();
+        REQUIRE(view);
+        REQUIRE(view->int32_field() == msg.int32_field());
+        REQUIRE(view->string_field() == msg.string_field());
+        REQUIRE(view->bytes_field() == msg.bytes_field());
+        REQUIRE(view->has_mysubmsg_field() == msg.has_mysubmsg_field());
+        REQUIRE(view->mysubmsg_field().id() == msg.mysubmsg_field().id());
+    }
+    REQUIRE_FALSE(reader.next());
+    REQUIRE_FALSE(reader.next());
+    REQUIRE(reader.recordCount() == records.size());
+}
+}
+
+TEST_CASE("DelimitedStreamReader on flat and chunked streams")
+{
+    auto records = sampleRecords();
+    auto data = writeDelimited(records);
+
+    SECTION("in one buffer")
+    {
+        google::protobuf::io::ArrayInputStream is{data.data(), static_cast<int>(data.size())};
+        pbview::DelimitedStreamReader<> reader{is};
+        requireRecords(reader, records);
+        REQUIRE(reader.stitchedCount() == 0);
+        REQUIRE(reader.bufferCapacity() == 0);
+    }
+
+    for (int blockSize : {1, 2, 7, 100, 4096})
+    {
+        DYNAMIC_SECTION("in blocks of " << blockSize << " bytes")
+        {
+            google::protobuf::io::ArrayInputStream is{data.data(), static_cast<int>(data.size()), blockSize};
+            pbview::DelimitedStreamReader<pbview::ParserMode::StrictConforming> reader{is};
+            requireRecords(reader, records);
+            REQUIRE(reader.stitchedCount() > 0);
+            // the buffer is reused, so it only grows up to the size of the largest record
+            REQUIRE(reader.bufferCapacity() <= 100010);
+        }
+    }
+}
+
+TEST_CASE("DelimitedStreamReader on gzip compressed streams")
+{
+    auto records = sampleRecords();
+    auto compressed = gzip(writeDelimited(records));
+
+    for (int blockSize : {3, 64, 65536})
+    {
+        INFO("block size " << blockSize);
+        google::protobuf::io::ArrayInputStream is{compressed.data(), static_cast<int>(compressed.size()), blockSize};
+        google::protobuf::io::GzipInputStream gzipIs{&is, google::protobuf::io::GzipInputStream::AUTO, 1024};
+        pbview::DelimitedStreamReader<> reader{gzipIs};
+        requireRecords(reader, records);
+        REQUIRE(reader.stitchedCount() < records.size());
+    }
+}
+
+TEST_CASE("DelimitedStreamReader returns unread data to the stream")
+{
+    pbview::samples::AllTypes msg;
+    msg.set_int32_field(42);
+    auto data = writeDelimited({msg, msg}) + "trailer";
+
+    google::protobuf::io::ArrayInputStream is{data.data(), static_cast<int>(data.size())};
+    {
+        pbview::DelimitedStreamReader<> reader{is};
+        REQUIRE(reader.next<pbview::samples::AllTypes>()->int32_field() == 42);
+        REQUIRE(reader.next<pbview::samples::AllTypes>()->int32_field() == 42);
+    }
+    REQUIRE(is.ByteCount() == static_cast<std::int64_t>(data.size() - "trailer"sv.size()));
+}
+
+TEST_CASE("DelimitedStreamReader on truncated and invalid streams")
+{
+    pbview::samples::AllTypes msg;
+    msg.set_string_field("Lorem ipsum");
+    auto data = writeDelimited({msg});
+
+    for (std::size_t len = 1; len < data.size(); len++)
+    {
+        INFO("truncated to " << len);
+        google::protobuf::io::ArrayInputStream is{data.data(), static_cast<int>(len), 2};
+        pbview::DelimitedStreamReader<> reader{is};
+        REQUIRE_THROWS(reader.next());
+    }
+
+    {
+        auto invalid = std::string(11, '\xff');
+        google::protobuf::io::ArrayInputStream is{invalid.data(), static_cast<int>(invalid.size())};
+        pbview::DelimitedStreamReader<> reader{is};
+        REQUIRE_THROWS(reader.next());
+    }
+
+    {
+        google::protobuf::io::ArrayInputStream is{data.data(), static_cast<int>(data.size())};
+        pbview::DelimitedStreamReader<> reader{is, 4};
+        REQUIRE_THROWS(reader.next());
+    }
+}
@@ -0,0 +1,177 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/externalsort.hpp>
+#include "TestHelpers.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <numeric>
+#include <random>
+#include <sstream>
+
+namespace
+{
+using pbview_test::serialize;
+using pbview_test::TempFile;
+using Msg = pbview::samples::AllTypes;
+namespace type = pbview::type;
+using pbview::SortOrder;
+
+// int32_field: position in the file, string_field and sint64_field: with duplicates
+std::vector<Msg> makeRecords(int count)
+{
+    std::mt19937 rnd{7};
+    std::vector<Msg> msgs(count);
+    for (int i = 0; i < count; i++)
+    {
+        auto& msg = msgs[i];
+        msg.set_int32_field(i);
+        if (rnd() % 10)
+            msg.set_string_field("s" + std::to_string(rnd() % 20));
+        msg.set_sint64_field(static_cast<std::int64_t>(rnd() % 7) - 3);
+        // some large records with long length prefixes
+        if (i % 97 == 0)
+            msg.set_bytes_field(std::string(5000, 'X'));
+    }
+    return msgs;
+}
+
+// values of int32_field of the records in os
+std::vector<int> positions(const std::string& sorted)
+{
+    std::vector<int> res;
+    TempFile file{sorted};
+    // the file has to outlive the loop over its records
+    const pbview::MappedRecordFile<> records{file.path};
+    for (auto record : records.records())
+        res.push_back(*record.get<type::Int32>(3));
+    return res;
+}
+
+template <pbview::ParserMode mode = pbview::ParserMode::Fast>
+std::string sort(const std::string& data, const pbview::SortKeyBuilder& keys, pbview::ExternalSortOptions options,
+                 pbview::ExternalSortStats* stats = nullptr)
+{
+    TempFile file{data};
+    pbview::MappedRecordFile<mode> records{file.path};
+    std::ostringstream os;
+    const auto res = pbview::sortRecords(records, keys, os, options);
+    if (stats)
+        *stats = res;
+    return os.str();
+}
+}
+
+TEST_CASE("LoserTree merges sorted sources stably")
+{
+    std::mt19937 rnd{1};
+    for (std::size_t k : {0, 1, 2, 3, 5, 8, 13})
+    {
+        // (value, source) with few distinct values
+        std::vector<std::vector<std::pair<int, std::size_t>>> sources(k);
+        std::vector<std::pair<int, std::size_t>> expected;
+        for (std::size_t s = 0; s < k; s++)
+        {
+            for (auto n = rnd() % 30; n > 0; n--)
+                sources[s].emplace_back(static_cast<int>(rnd() % 10), s);
+            std::sort(sources[s].begin(), sources[s].end());
+            expected.insert(expected.end(), sources[s].begin(), sources[s].end());
+        }
+        std::sort(expected.begin(), expected.end());
+
+        std::vector<std::size_t> pos(k);
+        std::vector<bool> exhausted;
+        for (const auto& source : sources)
+            exhausted.push_back(source.empty());
+        auto less = [&](std::size_t a, std::size_t b) { return sources[a][pos[a]].first < sources[b][pos[b]].first; };
+        std::vector<std::pair<int, std::size_t>> merged;
+        for (pbview::LoserTree<decltype(less)> tree{k, less, exhausted}; !tree.empty();)
+        {
+            const auto s = tree.top();
+            merged.push_back(sources[s][pos[s]]);
+            tree.advance(++pos[s] == sources[s].size());
+        }
+        INFO(k);
+        REQUIRE(merged == expected);
+    }
+}
+
+TEMPLATE_TEST_CASE_SIG("sortRecords sorts by several fields", "", ((pbview::ParserMode mode), mode), pbview::ParserMode::Fast_WithoutBoundsChecking,
+                       pbview::ParserMode::Fast, pbview::ParserMode::StrictConforming)
+{
+    const auto msgs = makeRecords(5000);
+    const auto data = serialize(msgs);
+
+    pbview::SortKeyBuilder keys;
+    keys.add<type::String>(14).add<type::Sint64>(8, SortOrder::Descending);
+
+    // records with equal keys in the order of the input
+    std::vector<int> expected(msgs.size());
+    std::iota(expected.begin(), expected.end(), 0);
+    std::stable_sort(expected.begin(), expected.end(), [&](int a, int b) {
+        auto tie = [](const Msg& m) { return std::make_tuple(m.has_string_field(), m.string_field(), -m.sint64_field()); };
+        return tie(msgs[a]) < tie(msgs[b]);
+    });
+
+    pbview::ExternalSortOptions options;
+    options.threadCount = 3;
+    pbview::ExternalSortStats stats;
+
+    SECTION("in memory")
+    {
+        const auto sorted = sort<mode>(data, keys, options, &stats);
+        REQUIRE(stats.runs == 1);
+        REQUIRE(positions(sorted) == expected);
+        REQUIRE(sorted.size() == data.size());
+    }
+
+    SECTION("with spilled runs")
+    {
+        options.memoryLimit = 20000;
+        const auto sorted = sort<mode>(data, keys, options, &stats);
+        REQUIRE(stats.runs > 10);
+        REQUIRE(positions(sorted) == expected);
+        REQUIRE(sorted.size() == data.size());
+    }
+
+    REQUIRE(stats.records == msgs.size());
+    REQUIRE(stats.bytes == data.size());
+}
+
+TEST_CASE("sortRecords copies the records verbatim")
+{
+    // unknown fields and fields out of order are kept
+    std::string data;
+    for (int i = 0; i < 100; i++)
+    {
+        std::string record;
+        record += "\xa0\x06";  // field 100 (varint)
+        record += static_cast<char>(i % 50);
+        record += "\x18";      // field 3 (int32_field)
+        record += static_cast<char>(99 - i);
+        data += static_cast<char>(record.size()) + record;
+    }
+
+    pbview::SortKeyBuilder keys;
+    keys.add<type::Int32>(3);
+    pbview::ExternalSortOptions options;
+    options.memoryLimit = 1000;
+    pbview::ExternalSortStats stats;
+    // field 3 after field 100 is only found by StrictConforming
+    const auto sorted = sort<pbview::ParserMode::StrictConforming>(data, keys, options, &stats);
+    REQUIRE(stats.runs > 1);
+
+    std::string expected;
+    for (int i = 99; i >= 0; i--)
+        expected += data.substr(i * 6, 6);
+    REQUIRE(sorted == expected);
+}
+
+TEST_CASE("sortRecords with empty input")
+{
+    pbview::SortKeyBuilder keys;
+    keys.add<type::Int32>(3);
+    pbview::ExternalSortStats stats;
+    REQUIRE(sort("", keys, {}, &stats).empty());
+    REQUIRE(stats.records == 0);
+    REQUIRE(stats.runs == 0);
+}
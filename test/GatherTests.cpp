@@ -0,0 +1,73 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/gather.hpp>
+
+#include <catch2/catch.hpp>
+
+namespace
+{
+using Msg = pbview::samples::AllTypesRepeated;
+using SubMsg = pbview::samples::MySubMsg;
+namespace type = pbview::type;
+using pbview::Field;
+
+// 200 sub-messages, id: position (every 3rd missing), value: "v" + position (every 7th missing)
+std::string makeMessage()
+{
+    Msg msg;
+    msg.add_int32_field(42);
+    for (int i = 0; i < 200; i++)
+    {
+        auto* sub = msg.add_mysubmsg_field();
+        if (i % 3)
+            sub->set_id(i);
+        if (i % 7)
+            sub->set_value("v" + std::to_string(i));
+    }
+    msg.add_string_field("after");
+    // id and value are required
+    return msg.SerializePartialAsString();
+}
+}
+
+TEST_CASE("gather reads one field of all repeated sub-messages")
+{
+    const auto bin = makeMessage();
+    const pbview::BinMessageView<> view{pbview::DataSpan{reinterpret_cast<const std::byte*>(bin.data()), bin.size()}};
+
+    const auto ids = pbview::gather<type::Int32>(view.getRepeated<type::Message>(Msg::kMysubmsgFieldFieldNumber), SubMsg::kIdFieldNumber);
+    REQUIRE(ids.size() == 200);
+    REQUIRE(ids.validity.size() == 4);
+    REQUIRE(ids.validCount() == 133);
+    for (std::size_t i = 0; i < ids.size(); i++)
+    {
+        REQUIRE(ids.valid(i) == (i % 3 != 0));
+        REQUIRE(ids.values[i] == (i % 3 ? static_cast<std::int32_t>(i) : 0));
+    }
+
+    REQUIRE(pbview::gather<type::Int32>(view.getRepeated<type::Message>(Msg::kMysubmsgFieldFieldNumber + 1), SubMsg::kIdFieldNumber).size() == 0);
+}
+
+TEST_CASE("gather reads several fields of all repeated sub-messages in one pass")
+{
+    const auto bin = makeMessage();
+    const auto view = pbview::View<Msg>::fromBytesString(bin);
+
+    const auto [values, ids] = pbview::gather<Field<type::String, SubMsg::kValueFieldNumber>,
+                                              Field<type::Int32, SubMsg::kIdFieldNumber>>(view.mysubmsg_field());
+    REQUIRE(values.size() == 200);
+    REQUIRE(ids.size() == 200);
+    for (std::size_t i = 0; i < values.size(); i++)
+    {
+        REQUIRE(values.valid(i) == (i % 7 != 0));
+        REQUIRE(values.values[i] == (i % 7 ? "v" + std::to_string(i) : ""));
+        REQUIRE(ids.valid(i) == (i % 3 != 0));
+    }
+    REQUIRE(ids.values == pbview::gather<type::Int32>(view.mysubmsg_field(), SubMsg::kIdFieldNumber).values);
+
+    // the generated getters
+    REQUIRE(view.mysubmsg_field_id_column().values == ids.values);
+    REQUIRE(view.mysubmsg_field_value_column().validity == values.validity);
+    using SubView = pbview::View<SubMsg>;
+    const auto [generatedIds] = view.mysubmsg_field_gather<SubView::fields::id>();
+    REQUIRE(generatedIds.validity == ids.validity);
+}
@@ -1,6 +1,8 @@
 #include <limits>
+#include <memory_resource>
 
 #include <test/samples-pb2.pbview.h>
+#include <pbview/cachingbinmessageview.hpp>
 
 #include <catch2/catch.hpp>
 
@@ -415,3 +417,197 @@ TEST_CASE("GeneratedView on message with packed repeated fields")
     REQUIRE(ranges::to_vector(allTypes.myenum_field()) == 
             ranges::to_vector(view.myenum_field()));
 }
+
+TEST_CASE("GeneratedView copies repeated fields into caller-provided buffers")
+{
+    pbview::samples::AllTypesRepeated repeated;
+    pbview::samples::AllTypesRepeatedPacked packed;
+    for (int i = 0; i < 100; i++)
+    {
+        repeated.add_fixed64_field(i * 1000003ull);
+        repeated.add_sint32_field(-i);
+        repeated.add_string_field(std::string(i % 5, 'X'));
+        packed.add_float_field(i / 7.f);
+        packed.add_int64_field(i * 1000003ll);
+        packed.add_bool_field(i % 3 == 0);
+    }
+    repeated.add_mysubmsg_field()->set_id(42);
+    repeated.mutable_mysubmsg_field(0)->set_value("");
+
+    auto repeatedStr = repeated.SerializeAsString();
+    auto repeatedView = pbview::View<pbview::samples::AllTypesRepeated>::fromBytesString(repeatedStr);
+    auto packedStr = packed.SerializeAsString();
+    auto packedView = pbview::View<pbview::samples::AllTypesRepeatedPacked>::fromBytesString(packedStr);
+
+    {
+        std::vector<std::uint64_t> fixed64{1};
+        repeatedView.fixed64_field_into(fixed64);
+        REQUIRE(fixed64.size() == 101);
+        REQUIRE(std::vector<std::uint64_t>(fixed64.begin() + 1, fixed64.end()) == ranges::to_vector(repeated.fixed64_field()));
+
+        std::pmr::monotonic_buffer_resource resource;
+        std::pmr::vector<std::int32_t> sint32{&resource};
+        repeatedView.sint32_field_into(sint32);
+        REQUIRE(std::vector<std::int32_t>(sint32.begin(), sint32.end()) == ranges::to_vector(repeated.sint32_field()));
+
+        std::vector<std::string_view> strings;
+        repeatedView.string_field_into(std::back_inserter(strings));
+        REQUIRE(ranges::to_vector(strings | toString) == ranges::to_vector(repeated.string_field()));
+
+        std::vector<pbview::View<pbview::samples::MySubMsg>> subMsgs;
+        repeatedView.mysubmsg_field_into(subMsgs);
+        REQUIRE(subMsgs.size() == 1);
+        REQUIRE(subMsgs[0].id() == 42);
+
+        std::uint64_t buf[10];
+        REQUIRE(repeatedView.fixed64_field_into(buf, 10) == 10);
+        REQUIRE(buf[9] == repeated.fixed64_field(9));
+    }
+
+    {
+        std::vector<float> floats;
+        packedView.float_field_into(floats);
+        REQUIRE(floats == ranges::to_vector(packed.float_field()));
+
+        std::pmr::vector<std::int64_t> int64s;
+        packedView.int64_field_into(int64s);
+        REQUIRE(std::vector<std::int64_t>(int64s.begin(), int64s.end()) == ranges::to_vector(packed.int64_field()));
+
+        std::vector<bool> bools;
+        packedView.bool_field_into(bools);
+        REQUIRE(bools == ranges::to_vector(packed.bool_field()));
+
+        std::vector<std::int64_t> empty;
+        packedView.sint64_field_into(empty);
+        REQUIRE(empty.empty());
+    }
+}
+
+TEMPLATE_TEST_CASE("GeneratedView reads many fields in one pass", "",
+                   pbview::BinMessageView<>,
+                   pbview::BinMessageView<pbview::ParserMode::StrictConforming>,
+                   pbview::CachingBinMessageView<>)
+{
+    using Msg = pbview::samples::AllTypes;
+    using View = pbview::View<Msg, TestType>;
+    using Fields = typename View::fields;
+
+    Msg allTypes;
+    allTypes.set_int32_field(142);
+    allTypes.set_string_field("Lorem ipsum");
+    allTypes.set_myenum_field(pbview::samples::MyEnumVal2);
+    allTypes.mutable_mysubmsg_field()->set_id(314);
+    allTypes.mutable_mysubmsg_field()->set_value("asdf");
+
+    auto binStr = allTypes.SerializeAsString();
+    auto view = View::fromBytesString(binStr);
+
+    auto [subMsg, str, i32, b, myEnum] = view.template get_many<typename Fields::mysubmsg_field, typename Fields::string_field, typename Fields::int32_field,
+                                                                typename Fields::bool_field, typename Fields::myenum_field>();
+    REQUIRE(subMsg);
+    REQUIRE(subMsg->id() == 314);
+    REQUIRE(subMsg->value() == "asdf");
+    REQUIRE(str == "Lorem ipsum"sv);
+    REQUIRE(i32 == 142);
+    REQUIRE(b == std::nullopt);
+    REQUIRE(myEnum == pbview::samples::MyEnumVal2);
+}
+
+TEMPLATE_TEST_CASE("GeneratedProjection decodes the selected fields in one pass", "",
+                   pbview::BinMessageView<>,
+                   pbview::BinMessageView<pbview::ParserMode::StrictConforming>,
+                   pbview::CachingBinMessageView<>)
+{
+    using Msg = pbview::samples::AllTypes;
+    using View = pbview::View<Msg, TestType>;
+
+    Msg allTypes;
+    allTypes.set_double_field(3.1415926);
+    allTypes.set_int32_field(142);
+    allTypes.set_sint64_field(-642);
+    allTypes.set_string_field("Lorem ipsum");
+    allTypes.set_myenum_field(pbview::samples::MyEnumVal2);
+    allTypes.mutable_mysubmsg_field()->set_id(314);
+    allTypes.mutable_mysubmsg_field()->set_value("asdf");
+
+    auto binStr = allTypes.SerializeAsString();
+    auto projection = pbview::samples::AllTypesProjection::decode(View::fromBytesString(binStr));
+
+    REQUIRE(projection.double_field == allTypes.double_field());
+    REQUIRE(projection.int32_field == 142);
+    REQUIRE(projection.string_field == "Lorem ipsum"sv);
+    REQUIRE(projection.myenum_field == pbview::samples::MyEnumVal2);
+    REQUIRE(projection.mysubmsg_field_id == 314);
+    REQUIRE(projection.mysubmsg_field_value == "asdf"sv);
+
+    // missing fields have their default values
+    Msg empty;
+    empty.set_string_field("Lorem ipsum");
+    binStr = empty.SerializeAsString();
+    projection = pbview::samples::AllTypesProjection::decode(View::fromBytesString(binStr));
+
+    REQUIRE(projection.string_field == "Lorem ipsum"sv);
+    REQUIRE(projection.int32_field == empty.int32_field());
+    REQUIRE(projection.myenum_field == empty.myenum_field());
+    REQUIRE(projection.mysubmsg_field_id == empty.mysubmsg_field().id());
+}
+
+TEMPLATE_TEST_CASE("GeneratedProjection reads duplicated fields like the getters", "",
+                   pbview::BinMessageView<>,
+                   pbview::BinMessageView<pbview::ParserMode::StrictConforming>,
+                   pbview::CachingBinMessageView<>)
+{
+    using Msg = pbview::samples::AllTypes;
+    using View = pbview::View<Msg, TestType>;
+
+    Msg first;
+    first.set_int32_field(1);
+    first.set_string_field("first");
+    first.mutable_mysubmsg_field()->set_id(10);
+    first.mutable_mysubmsg_field()->set_value("a");
+    Msg second;
+    second.set_int32_field(2);
+    second.set_string_field("second");
+    second.mutable_mysubmsg_field()->set_id(20);
+
+    // every field occurs twice (the sub-message value only in the first occurrence)
+    const auto binStr = first.SerializeAsString() + second.SerializePartialAsString();
+    auto view = View::fromBytesString(binStr);
+    auto projection = pbview::samples::AllTypesProjection::decode(view);
+
+    REQUIRE(projection.int32_field == view.int32_field());
+    REQUIRE(projection.string_field == view.string_field());
+    REQUIRE(projection.mysubmsg_field_id == view.mysubmsg_field().id());
+    if constexpr (std::is_same_v<TestType, pbview::BinMessageView<pbview::ParserMode::StrictConforming>>)
+    {
+        // the occurrences of sub-messages are merged
+        Msg merged;
+        merged.ParseFromString(binStr);
+        REQUIRE(projection.int32_field == 2);
+        REQUIRE(projection.mysubmsg_field_id == merged.mysubmsg_field().id());
+        REQUIRE(projection.mysubmsg_field_value == merged.mysubmsg_field().value());
+    }
+    else
+    {
+        REQUIRE(projection.int32_field == 1);
+        REQUIRE(projection.mysubmsg_field_value == view.mysubmsg_field().value());
+    }
+}
+
+TEST_CASE("GeneratedProjection on fields with large field numbers")
+{
+    using Msg = pbview::samples::SparseFields;
+    Msg msg;
+    msg.set_low_field(1);
+    msg.set_high_field(-1000);
+    msg.add_packed_field(-3);
+    msg.mutable_mysubmsg_field()->set_id(42);
+    msg.mutable_mysubmsg_field()->set_value("");
+
+    auto binStr = msg.SerializeAsString();
+    auto projection = pbview::samples::SparseFieldsProjection::decode(pbview::View<Msg>::fromBytesString(binStr));
+    REQUIRE(projection.high_field == -1000);
+    REQUIRE(projection.mysubmsg_field_id == 42);
+
+    static_assert(std::is_aggregate_v<pbview::samples::SparseFieldsProjection>);
+}
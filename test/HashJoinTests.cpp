@@ -0,0 +1,207 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/hashjoin.hpp>
+#include "TestHelpers.hpp"
+
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <catch2/catch.hpp>
+
+#include <random>
+#include <sstream>
+
+namespace
+{
+using pbview_test::serialize;
+using pbview_test::span;
+using Msg = pbview::samples::AllTypes;
+namespace type = pbview::type;
+using pbview::IndexField;
+
+// build side: int32_field: position, string_field: key (some keys twice, some missing)
+// probe side: int64_field: position, string_field: key, sint32_field: position of a build record
+struct Sides
+{
+    std::vector<Msg> build;
+    std::vector<Msg> probe;
+};
+
+Sides makeSides(int buildCount, int probeCount)
+{
+    std::mt19937 rnd{11};
+    Sides res;
+    for (int i = 0; i < buildCount; i++)
+    {
+        auto& msg = res.build.emplace_back();
+        msg.set_int32_field(i);
+        if (i % 13)
+            msg.set_string_field("k" + std::to_string(i % (buildCount - buildCount / 10)));
+    }
+    for (int i = 0; i < probeCount; i++)
+    {
+        auto& msg = res.probe.emplace_back();
+        msg.set_int64_field(i);
+        if (i % 17)
+            msg.set_string_field("k" + std::to_string(rnd() % (buildCount + 50)));
+        msg.set_sint32_field(static_cast<std::int32_t>(rnd() % (buildCount + 50)));
+    }
+    return res;
+}
+
+using Pairs = std::vector<std::pair<std::int32_t, std::int64_t>>;
+
+// (build position, probe position) of the matches, in probe order, then build order
+Pairs expectedPairs(const Sides& sides, bool byString)
+{
+    Pairs res;
+    for (const auto& p : sides.probe)
+    {
+        for (const auto& b : sides.build)
+        {
+            const bool match = byString ? p.has_string_field() && b.has_string_field() && p.string_field() == b.string_field()
+                                        : p.sint32_field() == b.int32_field();
+            if (match)
+                res.emplace_back(b.int32_field(), p.int64_field());
+        }
+    }
+    return res;
+}
+
+Pairs join(const std::string& build, const IndexField& buildKey, const std::string& probe, const IndexField& probeKey,
+           pbview::HashJoinOptions options, pbview::HashJoinStats& stats)
+{
+    Pairs res;
+    stats = pbview::hashJoin(span(build), buildKey, span(probe), probeKey, [&](pbview::BinMessageView<> b, pbview::BinMessageView<> p) {
+        res.emplace_back(*b.get<type::Int32>(3), *p.get<type::Int64>(4));
+    }, options);
+    return res;
+}
+}
+
+TEST_CASE("hashJoin joins on string fields")
+{
+    const auto sides = makeSides(500, 3000);
+    const auto build = serialize(sides.build);
+    const auto probe = serialize(sides.probe);
+    auto expected = expectedPairs(sides, true);
+    REQUIRE(expected.size() > 1000);
+
+    pbview::HashJoinOptions options;
+    pbview::HashJoinStats stats;
+
+    SECTION("in memory")
+    {
+        REQUIRE(join(build, IndexField::of<type::String>(14), probe, IndexField::of<type::String>(14), options, stats) == expected);
+        REQUIRE(stats.partitions == 0);
+    }
+
+    SECTION("grace hash join")
+    {
+        options.memoryLimit = 4000;
+        auto res = join(build, IndexField::of<type::String>(14), probe, IndexField::of<type::String>(14), options, stats);
+        REQUIRE(stats.partitions > 2);
+        std::sort(res.begin(), res.end());
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(res == expected);
+    }
+
+    REQUIRE(stats.buildRecords == sides.build.size());
+    REQUIRE(stats.probeRecords == sides.probe.size());
+    REQUIRE(stats.matches == expected.size());
+}
+
+TEST_CASE("hashJoin joins fields of different integer types")
+{
+    const auto sides = makeSides(300, 1000);
+    const auto build = serialize(sides.build);
+    const auto probe = serialize(sides.probe);
+    auto expected = expectedPairs(sides, false);
+
+    pbview::HashJoinOptions options;
+    pbview::HashJoinStats stats;
+    REQUIRE(join(build, IndexField::of<type::Int32>(3), probe, IndexField::of<type::Sint32>(7), options, stats) == expected);
+
+    options.partitionCount = 7;
+    auto res = join(build, IndexField::of<type::Int32>(3), probe, IndexField::of<type::Sint32>(7), options, stats);
+    REQUIRE(stats.partitions == 7);
+    std::sort(res.begin(), res.end());
+    std::sort(expected.begin(), expected.end());
+    REQUIRE(res == expected);
+
+    REQUIRE_THROWS_WITH(join(build, IndexField::of<type::Int32>(3), probe, IndexField::of<type::String>(14), options, stats),
+                        "The key fields of a join have different types");
+}
+
+TEST_CASE("hashJoin partitions large partitions again")
+{
+    auto sides = makeSides(500, 2000);
+    // a skewed key
+    for (int i = 0; i < 500; i += 3)
+        sides.build[i].set_string_field("hot");
+    for (int i = 0; i < 2000; i += 50)
+        sides.probe[i].set_string_field("hot");
+    const auto build = serialize(sides.build);
+    const auto probe = serialize(sides.probe);
+    auto expected = expectedPairs(sides, true);
+    std::sort(expected.begin(), expected.end());
+
+    pbview::HashJoinOptions options;
+    options.memoryLimit = 4000;
+    options.partitionCount = 2;
+    pbview::HashJoinStats stats;
+    auto res = join(build, IndexField::of<type::String>(14), probe, IndexField::of<type::String>(14), options, stats);
+    REQUIRE(stats.partitions > 2);
+    std::sort(res.begin(), res.end());
+    REQUIRE(res == expected);
+
+    // the records of the hot key exceed the memory limit, but can't be split
+    options.partitionCount = 0;
+    options.memoryLimit = 1000;
+    res = join(build, IndexField::of<type::String>(14), probe, IndexField::of<type::String>(14), options, stats);
+    std::sort(res.begin(), res.end());
+    REQUIRE(res == expected);
+
+    options.partitionCount = pbview::maxJoinPartitions + 1;
+    REQUIRE_THROWS(join(build, IndexField::of<type::String>(14), probe, IndexField::of<type::String>(14), options, stats));
+}
+
+TEST_CASE("hashJoinConcatenated writes merged messages")
+{
+    const auto sides = makeSides(100, 400);
+    const auto build = serialize(sides.build);
+    const auto probe = serialize(sides.probe);
+    const auto expected = expectedPairs(sides, true);
+
+    std::ostringstream os;
+    const auto stats = pbview::hashJoinConcatenated(span(build), IndexField::of<type::String>(14), span(probe), IndexField::of<type::String>(14), os);
+    REQUIRE(stats.matches == expected.size());
+
+    const auto joined = os.str();
+    google::protobuf::io::ArrayInputStream is{joined.data(), static_cast<int>(joined.size())};
+    Pairs res;
+    Msg msg;
+    bool clean = false;
+    while (google::protobuf::util::ParseDelimitedFromZeroCopyStream(&msg, &is, &clean))
+    {
+        REQUIRE(msg.has_int32_field());
+        REQUIRE(msg.has_int64_field());
+        res.emplace_back(msg.int32_field(), msg.int64_field());
+    }
+    REQUIRE(clean);
+    REQUIRE(res == expected);
+
+    // the probe fields follow the build fields (string_field = 14 before int64_field = 4): StrictConforming finds all of them,
+    // the fast modes stop at the higher field number
+    using StrictView = pbview::BinMessageView<pbview::ParserMode::StrictConforming>;
+    res.clear();
+    for (auto record : pbview::DelimitedRecords<StrictView>{span(joined)})
+    {
+        const pbview::View<Msg, StrictView> view{record};
+        REQUIRE(view.has_int64_field());
+        REQUIRE(view.has_sint32_field());
+        res.emplace_back(view.int32_field(), view.int64_field());
+
+        REQUIRE_FALSE(pbview::View<Msg>{pbview::BinMessageView<>{record.bytes}}.has_int64_field());
+    }
+    REQUIRE(res == expected);
+}
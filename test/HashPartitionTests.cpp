@@ -0,0 +1,102 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/hashpartition.hpp>
+#include "TestHelpers.hpp"
+
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <catch2/catch.hpp>
+
+#include <map>
+#include <numeric>
+#include <sstream>
+
+namespace
+{
+using pbview_test::span;
+using pbview_test::TempFile;
+using Msg = pbview::samples::AllTypes;
+namespace type = pbview::type;
+
+// int32_field: position, string_field: one of 50 keys (or missing)
+std::string makeRecords(int count)
+{
+    std::ostringstream os;
+    for (int i = 0; i < count; i++)
+    {
+        Msg msg;
+        msg.set_int32_field(i);
+        if (i % 11)
+            msg.set_string_field("key" + std::to_string(i * 7 % 50));
+        google::protobuf::util::SerializeDelimitedToOstream(msg, &os);
+    }
+    return os.str();
+}
+}
+
+TEST_CASE("hashPartition splits records by the hash of a field")
+{
+    const auto data = makeRecords(10000);
+    TempFile file{data};
+    pbview::MappedRecordFile<> records{file.path};
+
+    pbview::HashPartitionOptions options;
+    options.bufferSize = 1000;
+    options.scan.threadCount = 3;
+    options.scan.chunkSize = 4096;
+
+    std::vector<std::ostringstream> streams(5);
+    std::vector<std::ostream*> outputs;
+    for (auto& os : streams)
+        outputs.push_back(&os);
+    const auto stats = pbview::hashPartition(records, Msg::kStringFieldFieldNumber, outputs, options);
+
+    std::vector<int> positions;
+    std::map<std::string, std::size_t> partitionOfKey;
+    for (std::size_t p = 0; p < streams.size(); p++)
+    {
+        const auto partition = streams[p].str();
+        REQUIRE(stats.bytes[p] == partition.size());
+        std::uint64_t count = 0;
+        for (auto record : pbview::DelimitedRecords<pbview::BinMessageView<>>{span(partition)})
+        {
+            count++;
+            positions.push_back(*record.get<type::Int32>(Msg::kInt32FieldFieldNumber));
+            const auto key = std::string{record.get<type::String>(Msg::kStringFieldFieldNumber).value_or("<missing>")};
+            // all records of a key are in one partition
+            REQUIRE(partitionOfKey.emplace(key, p).first->second == p);
+            REQUIRE(pbview::hashPartitionOf(record.getRaw(Msg::kStringFieldFieldNumber).value_or(pbview::DataSpan{}), streams.size()) == p);
+        }
+        REQUIRE(stats.records[p] == count);
+    }
+
+    // each record is written once
+    std::sort(positions.begin(), positions.end());
+    std::vector<int> expected(10000);
+    std::iota(expected.begin(), expected.end(), 0);
+    REQUIRE(positions == expected);
+    // the keys are spread over the partitions
+    REQUIRE(partitionOfKey.size() == 51);
+    for (auto records : stats.records)
+        REQUIRE(records > 0);
+}
+
+TEST_CASE("hashPartition writes files")
+{
+    const auto data = makeRecords(500);
+    TempFile file{data};
+    pbview::MappedRecordFile<> records{file.path};
+
+    TempFile first, second;
+    const auto stats = pbview::hashPartition(records, Msg::kInt32FieldFieldNumber, std::vector<std::string>{first.path, second.path});
+    REQUIRE(stats.records[0] + stats.records[1] == 500);
+    REQUIRE(stats.bytes[0] + stats.bytes[1] == data.size());
+
+    pbview::MappedRecordFile<> part{second.path};
+    std::uint64_t count = 0;
+    for (auto record : part.records())
+    {
+        count++;
+        REQUIRE(pbview::hashPartitionOf(*record.getRaw(Msg::kInt32FieldFieldNumber), 2) == 1);
+    }
+    REQUIRE(count == stats.records[1]);
+}
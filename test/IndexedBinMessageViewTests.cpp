@@ -0,0 +1,185 @@
+#include <limits>
+
+#include <test/samples-pb2.pbview.h>
+#include <pbview/indexedbinmessageview.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <range/v3/to_container.hpp>
+
+using namespace std::literals;
+
+TEST_CASE("IndexedBinMessageView as BinView of a generated view")
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    using View = pbview::View<Msg, pbview::IndexedBinMessageView<>>;
+
+    allTypes.set_double_field(3.1415926);
+    allTypes.set_float_field(3.14);
+    allTypes.set_int32_field(142);
+    allTypes.set_int64_field(242);
+    allTypes.set_uint32_field(342);
+    allTypes.set_uint64_field(442);
+    allTypes.set_sint32_field(542);
+    allTypes.set_sint64_field(642);
+    allTypes.set_fixed32_field(742);
+    allTypes.set_fixed64_field(842);
+    allTypes.set_sfixed32_field(942);
+    allTypes.set_sfixed64_field(1042);
+    allTypes.set_bool_field(true);
+    allTypes.set_string_field("Lorem ipsum");
+    allTypes.set_bytes_field("Lorem\0ipsum"s);
+
+    allTypes.set_myenum_field(pbview::samples::MyEnumVal2);
+
+    allTypes.mutable_mysubmsg_field()->set_id(314);
+    allTypes.mutable_mysubmsg_field()->set_value("asdf");
+
+    auto binStr = allTypes.SerializeAsString();
+    auto view = View::fromBytesString(binStr);
+
+    // access in reverse order, to make sure no state of previous lookups is used
+    REQUIRE(allTypes.mysubmsg_field().value() == view.mysubmsg_field().value());
+    REQUIRE(allTypes.mysubmsg_field().id()    == view.mysubmsg_field().id());
+    REQUIRE(allTypes.myenum_field()   == view.myenum_field());
+    REQUIRE(allTypes.bytes_field()    == view.bytes_field());
+    REQUIRE(allTypes.string_field()   == view.string_field());
+    REQUIRE(allTypes.bool_field()     == view.bool_field());
+    REQUIRE(allTypes.sfixed64_field() == view.sfixed64_field());
+    REQUIRE(allTypes.sfixed32_field() == view.sfixed32_field());
+    REQUIRE(allTypes.fixed64_field()  == view.fixed64_field());
+    REQUIRE(allTypes.fixed32_field()  == view.fixed32_field());
+    REQUIRE(allTypes.sint64_field()   == view.sint64_field());
+    REQUIRE(allTypes.sint32_field()   == view.sint32_field());
+    REQUIRE(allTypes.uint64_field()   == view.uint64_field());
+    REQUIRE(allTypes.uint32_field()   == view.uint32_field());
+    REQUIRE(allTypes.int64_field()    == view.int64_field());
+    REQUIRE(allTypes.int32_field()    == view.int32_field());
+    REQUIRE(allTypes.float_field()    == view.float_field());
+    REQUIRE(allTypes.double_field()   == view.double_field());
+
+    auto emptyView = View::fromBytesString("");
+    REQUIRE_FALSE(emptyView.has_int32_field());
+    REQUIRE_FALSE(emptyView.has_mysubmsg_field());
+    REQUIRE(emptyView.int32_field() == 0);
+}
+
+TEST_CASE("IndexedBinMessageView on repeated and packed repeated fields")
+{
+    pbview::samples::AllTypesRepeated repeated;
+    pbview::samples::AllTypesRepeatedPacked packed;
+    for (auto i : {142, std::numeric_limits<std::int32_t>::min(), std::numeric_limits<std::int32_t>::max()})
+    {
+        repeated.add_int32_field(i);
+        repeated.add_sint32_field(i);
+        packed.add_int32_field(i);
+        packed.add_sint32_field(i);
+    }
+    repeated.add_string_field("Lorem ipsum");
+    repeated.add_string_field("");
+
+    {
+        auto binStr = repeated.SerializeAsString();
+        auto view = pbview::View<pbview::samples::AllTypesRepeated, pbview::IndexedBinMessageView<>>::fromBytesString(binStr);
+
+        REQUIRE(ranges::to_vector(repeated.sint32_field()) == ranges::to_vector(view.sint32_field()));
+        REQUIRE(ranges::to_vector(repeated.int32_field()) == ranges::to_vector(view.int32_field()));
+        REQUIRE(view.string_field_size() == 2);
+        REQUIRE(view.string_field(0) == "Lorem ipsum");
+        REQUIRE(view.double_field_size() == 0);
+    }
+
+    {
+        auto binStr = packed.SerializeAsString();
+        auto view = pbview::View<pbview::samples::AllTypesRepeatedPacked, pbview::IndexedBinMessageView<>>::fromBytesString(binStr);
+
+        REQUIRE(ranges::to_vector(packed.sint32_field()) == ranges::to_vector(view.sint32_field()));
+        REQUIRE(ranges::to_vector(packed.int32_field()) == ranges::to_vector(view.int32_field()));
+        REQUIRE(view.double_field_size() == 0);
+    }
+}
+
+TEST_CASE("IndexedBinMessageView on large field numbers")
+{
+    using Msg = pbview::samples::SparseFields;
+    Msg msg;
+    msg.set_low_field(1);
+    msg.set_boundary_field("boundary");
+    msg.set_high_field(-1000);
+    msg.add_repeated_field(1);
+    msg.add_repeated_field(2);
+    msg.add_packed_field(-3);
+    msg.add_packed_field(4);
+    msg.mutable_mysubmsg_field()->set_id(42);
+    msg.mutable_mysubmsg_field()->set_value("max field number");
+
+    auto binStr = msg.SerializeAsString();
+    auto view = pbview::View<Msg, pbview::IndexedBinMessageView<>>::fromBytesString(binStr);
+
+    REQUIRE(view.low_field() == 1);
+    REQUIRE(view.boundary_field() == "boundary");
+    REQUIRE(view.high_field() == -1000);
+    REQUIRE(ranges::to_vector(view.repeated_field()) == std::vector<std::int32_t>{1, 2});
+    REQUIRE(ranges::to_vector(view.packed_field()) == std::vector<std::int32_t>{-3, 4});
+    REQUIRE(view.mysubmsg_field().id() == 42);
+    REQUIRE(view.mysubmsg_field().value() == "max field number");
+
+    auto indexed = pbview::IndexedBinMessageView<>::fromBytesString(binStr);
+    REQUIRE_FALSE(indexed.has(2));
+    REQUIRE_FALSE(indexed.has(999));
+    REQUIRE_FALSE(indexed.has(1001));
+    REQUIRE_THROWS(indexed.get<pbview::type::Int32>(Msg::kBoundaryFieldFieldNumber));
+}
+
+TEST_CASE("IndexedBinMessageView on fields with irregular encoding")
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg first;
+    first.set_int32_field(1);
+    first.set_string_field("first");
+    Msg second;
+    second.set_int32_field(2);
+
+    // merged messages: the fields are not ordered by field number and int32_field occurs twice
+    auto binStr = first.SerializeAsString() + second.SerializeAsString();
+
+    auto fast = pbview::IndexedBinMessageView<pbview::ParserMode::Fast>::fromBytesString(binStr);
+    REQUIRE(fast.get<pbview::type::Int32>(Msg::kInt32FieldFieldNumber) == 1);
+    REQUIRE(fast.get<pbview::type::String>(Msg::kStringFieldFieldNumber) == "first"sv);
+
+    auto strict = pbview::IndexedBinMessageView<pbview::ParserMode::StrictConforming>::fromBytesString(binStr);
+    REQUIRE(strict.get<pbview::type::Int32>(Msg::kInt32FieldFieldNumber) == 2);
+    REQUIRE(strict.get<pbview::type::String>(Msg::kStringFieldFieldNumber) == "first"sv);
+
+    Msg parsed;
+    parsed.ParseFromString(binStr);
+    REQUIRE(pbview::deserialize<Msg>(strict).int32_field() == parsed.int32_field());
+}
+
+TEST_CASE("IndexedBinMessageView on truncated input")
+{
+    pbview::samples::AllTypes allTypes;
+    allTypes.set_string_field("Lorem ipsum");
+
+    auto binStr = allTypes.SerializeAsString();
+    binStr.pop_back();
+
+    REQUIRE_THROWS(pbview::IndexedBinMessageView<>::fromBytesString(binStr));
+}
+
+TEST_CASE("IndexedBinMessageView validates the whole message on construction")
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    allTypes.set_int32_field(142);
+    allTypes.set_string_field("Lorem ipsum");
+
+    auto binStr = allTypes.SerializeAsString();
+    binStr.pop_back();
+
+    // the fields in front of the malformed tail are readable without the index
+    REQUIRE(pbview::View<Msg>::fromBytesString(binStr).int32_field() == 142);
+    REQUIRE_THROWS((pbview::View<Msg, pbview::IndexedBinMessageView<>>::fromBytesString(binStr)));
+    REQUIRE_THROWS((pbview::View<Msg, pbview::IndexedBinMessageView<pbview::ParserMode::StrictConforming>>::fromBytesString(binStr)));
+}
@@ -0,0 +1,102 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/mappedrecordfile.hpp>
+#include "TestHelpers.hpp"
+
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+#include <range/v3/to_container.hpp>
+
+namespace
+{
+using pbview_test::TempFile;
+std::string writeRecords(int count)
+{
+    std::ostringstream os;
+    for (int i = 0; i < count; i++)
+    {
+        pbview::samples::AllTypes msg;
+        msg.set_int32_field(i);
+        msg.set_string_field(std::string(i % 300, 'X'));
+        google::protobuf::util::SerializeDelimitedToOstream(msg, &os);
+    }
+    return os.str();
+}
+}
+
+TEST_CASE("MappedRecordFile scans records forward")
+{
+    using Msg = pbview::samples::AllTypes;
+    TempFile file{writeRecords(1000)};
+
+    for (auto options : {pbview::MappingOptions{}, pbview::MappingOptions{false, true, true, true}})
+    {
+        pbview::MappedRecordFile<> records{file.path, options};
+
+        int i = 0;
+        for (auto view : records.records<Msg>())
+        {
+            REQUIRE(view.int32_field() == i);
+            REQUIRE(view.string_field().size() == static_cast<std::size_t>(i % 300));
+            // zero-copy: views point into the mapping
+            REQUIRE(view.bin_view().bytes.data() >= records.bytes().data());
+            REQUIRE(view.bin_view().bytes.data() < records.bytes().data() + records.bytes().size());
+            i++;
+        }
+        REQUIRE(i == 1000);
+
+        auto binViews = ranges::to_vector(records.records());
+        REQUIRE(binViews.size() == 1000);
+        REQUIRE(binViews[7].get<pbview::type::Int32>(Msg::kInt32FieldFieldNumber) == 7);
+    }
+}
+
+TEST_CASE("MappedRecordFile with offset table")
+{
+    using Msg = pbview::samples::AllTypes;
+    TempFile file{writeRecords(500)};
+
+    pbview::MappedRecordFile<pbview::ParserMode::StrictConforming> records{file.path};
+    REQUIRE_FALSE(records.hasOffsetTable());
+    REQUIRE_THROWS(records.size());
+
+    records.buildOffsetTable();
+    REQUIRE(records.hasOffsetTable());
+    REQUIRE(records.size() == 500);
+    REQUIRE(records.at<Msg>(0).int32_field() == 0);
+    REQUIRE(records.at<Msg>(499).int32_field() == 499);
+    REQUIRE(records[321].get<pbview::type::Int32>(Msg::kInt32FieldFieldNumber) == 321);
+    REQUIRE_THROWS(records[500]);
+
+    // offset tables can be reused
+    pbview::MappedRecordFile<> other{file.path};
+    other.setOffsetTable(records.offsets());
+    REQUIRE(other.at<Msg>(123).int32_field() == 123);
+    REQUIRE_THROWS(other.setOffsetTable({records.bytes().size()}));
+
+    auto moved = std::move(other);
+    REQUIRE(moved.at<Msg>(124).int32_field() == 124);
+    REQUIRE(other.bytes().empty());
+}
+
+TEST_CASE("MappedRecordFile on empty, missing and truncated files")
+{
+    TempFile empty{""};
+    pbview::MappedRecordFile<> emptyRecords{empty.path};
+    REQUIRE(emptyRecords.bytes().empty());
+    REQUIRE(ranges::to_vector(emptyRecords.records()).empty());
+    emptyRecords.buildOffsetTable();
+    REQUIRE(emptyRecords.size() == 0);
+
+    REQUIRE_THROWS(pbview::MappedRecordFile<>{empty.path + ".missing"});
+
+    auto content = writeRecords(10);
+    content.resize(content.size() - 1);
+    TempFile truncated{content};
+    pbview::MappedRecordFile<> truncatedRecords{truncated.path};
+    REQUIRE_THROWS(ranges::to_vector(truncatedRecords.records()));
+    REQUIRE_THROWS(truncatedRecords.buildOffsetTable());
+}
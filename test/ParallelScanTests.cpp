@@ -0,0 +1,159 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/parallelscan.hpp>
+#include "TestHelpers.hpp"
+
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <catch2/catch.hpp>
+
+#include <numeric>
+#include <set>
+#include <sstream>
+
+namespace
+{
+using pbview_test::TempFile;
+std::string writeRecords(int count)
+{
+    std::ostringstream os;
+    for (int i = 0; i < count; i++)
+    {
+        pbview::samples::AllTypes msg;
+        msg.set_int32_field(i);
+        msg.set_string_field(std::string(i % 100, 'X'));
+        google::protobuf::util::SerializeDelimitedToOstream(msg, &os);
+    }
+    return os.str();
+}
+}
+
+TEST_CASE("WorkStealingPool runs all tasks")
+{
+    for (std::size_t threadCount : {1, 2, 7})
+    {
+        INFO(threadCount << " threads");
+        pbview::WorkStealingPool pool{threadCount};
+        REQUIRE(pool.threadCount() == threadCount);
+
+        std::vector<std::int64_t> sums(threadCount);
+        for (int i = 0; i < 100; i++)
+        {
+            pool.submit([&pool, &sums, i](std::size_t worker) {
+                sums[worker] += i;
+                // tasks may submit further tasks
+                if (i % 10 == 0)
+                    pool.submit([&sums, i](std::size_t worker) { sums[worker] += 1000 * i; });
+            });
+        }
+        pool.wait();
+        REQUIRE(std::accumulate(sums.begin(), sums.end(), std::int64_t{0}) == 4950 + 1000 * 450);
+
+        // the pool can be reused after waiting
+        pool.submit([&sums](std::size_t worker) { sums[worker] += 1; });
+        pool.wait();
+        REQUIRE(std::accumulate(sums.begin(), sums.end(), std::int64_t{0}) == 4950 + 1000 * 450 + 1);
+    }
+}
+
+TEST_CASE("WorkStealingPool rethrows exceptions of tasks")
+{
+    pbview::WorkStealingPool pool{3};
+    std::atomic<int> count{0};
+    for (int i = 0; i < 10; i++)
+        pool.submit([&count, i](std::size_t) {
+            count++;
+            if (i == 5)
+                throw std::runtime_error("task failed");
+        });
+    REQUIRE_THROWS_WITH(pool.wait(), "task failed");
+    REQUIRE(count > 0);
+
+    pool.submit([&count](std::size_t) { count = 42; });
+    REQUIRE_NOTHROW(pool.wait());
+    REQUIRE(count == 42);
+}
+
+TEST_CASE("parallelForEachRecord with per-thread reducers")
+{
+    using Msg = pbview::samples::AllTypes;
+    TempFile file{writeRecords(5000)};
+    pbview::MappedRecordFile<> records{file.path};
+
+    struct Stats
+    {
+        std::int64_t sum = 0;
+        std::size_t count = 0;
+        std::size_t stringBytes = 0;
+    };
+
+    for (bool withOffsetTable : {false, true})
+    {
+        if (withOffsetTable)
+            records.buildOffsetTable();
+
+        for (std::size_t threadCount : {1, 4})
+        {
+            for (std::size_t chunkSize : {1, 1000, 1 << 20})
+            {
+                INFO("offset table " << withOffsetTable << ", " << threadCount << " threads, chunk size " << chunkSize);
+                pbview::ParallelScanOptions options;
+                options.threadCount = threadCount;
+                options.chunkSize = chunkSize;
+
+                auto reducers = pbview::parallelForEachRecord(records, Stats{}, [](Stats& stats, pbview::BinMessageView<> record) {
+                    auto view = pbview::View<Msg>{record};
+                    stats.sum += view.int32_field();
+                    stats.stringBytes += view.string_field().size();
+                    stats.count++;
+                }, options);
+                REQUIRE(reducers.size() == threadCount);
+
+                Stats total;
+                for (const auto& stats : reducers)
+                {
+                    total.sum += stats.sum;
+                    total.count += stats.count;
+                    total.stringBytes += stats.stringBytes;
+                }
+                REQUIRE(total.count == 5000);
+                REQUIRE(total.sum == 4999 * 5000 / 2);
+                REQUIRE(total.stringBytes == 50 * 99 * 50);
+            }
+        }
+    }
+}
+
+TEST_CASE("parallelForEachRecord on a shared pool")
+{
+    using Msg = pbview::samples::AllTypes;
+    TempFile file{writeRecords(1000)};
+    pbview::MappedRecordFile<> records{file.path};
+
+    pbview::WorkStealingPool pool{3};
+    pbview::ParallelScanOptions options;
+    options.pool = &pool;
+    options.chunkSize = 500;
+
+    std::mutex mutex;
+    std::set<int> seen;
+    int duplicates = 0;
+    pbview::parallelForEachRecord(records, [&](pbview::BinMessageView<> record) {
+        std::lock_guard<std::mutex> lock{mutex};
+        duplicates += !seen.insert(pbview::View<Msg>{record}.int32_field()).second;
+    }, options);
+    REQUIRE(seen.size() == 1000);
+    REQUIRE(duplicates == 0);
+
+    // exceptions of the callback
+    REQUIRE_THROWS_WITH(pbview::parallelForEachRecord(records, [](pbview::BinMessageView<> record) {
+        if (pbview::View<Msg>{record}.int32_field() == 777)
+            throw std::runtime_error("callback failed");
+    }, options), "callback failed");
+
+    // invalid framing
+    auto content = writeRecords(1000);
+    content.resize(content.size() - 1);
+    TempFile truncated{content};
+    pbview::MappedRecordFile<> truncatedRecords{truncated.path};
+    REQUIRE_THROWS(pbview::parallelForEachRecord(truncatedRecords, [](pbview::BinMessageView<>) {}, options));
+}
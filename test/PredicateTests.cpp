@@ -0,0 +1,161 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/predicate.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <random>
+
+namespace
+{
+using Msg = pbview::samples::AllTypes;
+namespace type = pbview::type;
+using pbview::Predicate;
+
+// random messages, some fields missing (mysubmsg_field without its required value)
+std::vector<Msg> makeMessages(int count)
+{
+    std::mt19937 rng{42};
+    std::vector<Msg> msgs(count);
+    for (int i = 0; i < count; i++)
+    {
+        auto& msg = msgs[i];
+        if (rng() % 4)
+            msg.set_int32_field(rng() % 10);
+        if (rng() % 3)
+            msg.set_int64_field(static_cast<int>(rng() % 300) - 50);
+        if (rng() % 2)
+            msg.set_string_field(rng() % 2 ? "xylo" + std::to_string(i) : "abc");
+        if (rng() % 2)
+            msg.mutable_mysubmsg_field()->set_id(rng() % 100);
+        msg.set_myenum_field(rng() % 2 ? pbview::samples::MyEnumVal1 : pbview::samples::MyEnumVal2);
+    }
+    return msgs;
+}
+
+template <pbview::ParserMode mode>
+void requireSameMatches(const Predicate& pred, const std::vector<Msg>& msgs, bool (*expected)(const Msg&))
+{
+    auto plan = pred.compile();
+    for (const auto& msg : msgs)
+    {
+        const auto bin = msg.SerializePartialAsString();
+        REQUIRE(plan(pbview::BinMessageView<mode>::fromBytesString(bin)) == expected(msg));
+    }
+    REQUIRE(plan.stats().messages == msgs.size());
+}
+}
+
+TEST_CASE("Predicate matches conjunctions and disjunctions of conditions")
+{
+    const auto msgs = makeMessages(5000);
+
+    const auto conjunction = Predicate::equal<type::Int32>(Msg::kInt32FieldFieldNumber, 4) &&
+                             Predicate::greater<type::Int64>(Msg::kInt64FieldFieldNumber, 100) &&
+                             Predicate::startsWith<type::String>(Msg::kStringFieldFieldNumber, "xy");
+    auto expectedConjunction = [](const Msg& msg) {
+        return msg.has_int32_field() && msg.int32_field() == 4 && msg.has_int64_field() && msg.int64_field() > 100 &&
+               msg.has_string_field() && msg.string_field().rfind("xy", 0) == 0;
+    };
+    requireSameMatches<pbview::ParserMode::Fast>(conjunction, msgs, expectedConjunction);
+    requireSameMatches<pbview::ParserMode::Fast_WithoutBoundsChecking>(conjunction, msgs, expectedConjunction);
+    requireSameMatches<pbview::ParserMode::StrictConforming>(conjunction, msgs, expectedConjunction);
+
+    // with a condition on a field of a sub-message
+    const auto mixed = ((Predicate::lessEqual<type::Int32>(Msg::kInt32FieldFieldNumber, 2) ||
+                         Predicate::greaterEqual<type::Int32>({Msg::kMysubmsgFieldFieldNumber, 1}, 50)) &&
+                        Predicate::equal<type::Enum<pbview::samples::MyEnum>>(Msg::kMyenumFieldFieldNumber, pbview::samples::MyEnumVal2)) ||
+                       Predicate::between<type::Int64>(Msg::kInt64FieldFieldNumber, 0, 10);
+    auto expectedMixed = [](const Msg& msg) {
+        const bool sub = (msg.has_int32_field() && msg.int32_field() <= 2) ||
+                         (msg.has_mysubmsg_field() && msg.mysubmsg_field().has_id() && msg.mysubmsg_field().id() >= 50);
+        return (sub && msg.myenum_field() == pbview::samples::MyEnumVal2) ||
+               (msg.has_int64_field() && msg.int64_field() >= 0 && msg.int64_field() <= 10);
+    };
+    requireSameMatches<pbview::ParserMode::Fast>(mixed, msgs, expectedMixed);
+    requireSameMatches<pbview::ParserMode::StrictConforming>(mixed, msgs, expectedMixed);
+}
+
+TEST_CASE("Predicate stops when the outcome is known")
+{
+    Msg msg;
+    msg.set_int32_field(1);
+    msg.set_int64_field(2);
+    msg.set_string_field("xyz");
+    const auto bin = msg.SerializeAsString();
+
+    auto plan = (Predicate::equal<type::Int32>(Msg::kInt32FieldFieldNumber, 5) &&
+                 Predicate::equal<type::Int64>(Msg::kInt64FieldFieldNumber, 2) &&
+                 Predicate::equal<type::String>(Msg::kStringFieldFieldNumber, "xyz")).compile();
+    REQUIRE_FALSE(plan(pbview::BinMessageView<>::fromBytesString(bin)));
+    // only int32_field was read
+    REQUIRE(plan.stats().conditionsEvaluated == 1);
+
+    auto orPlan = (Predicate::equal<type::Int64>(Msg::kInt64FieldFieldNumber, 2) ||
+                   Predicate::startsWith<type::String>(Msg::kStringFieldFieldNumber, "a")).compile();
+    REQUIRE(orPlan(pbview::BinMessageView<>::fromBytesString(bin)));
+    REQUIRE(orPlan.stats().conditionsEvaluated == 1);
+}
+
+TEST_CASE("Predicate evaluates the most selective conditions first")
+{
+    // StrictConforming only knows the values at the end of the message, the condition on
+    // string_field rules out every message
+    Msg msg;
+    msg.set_int32_field(1);
+    msg.set_string_field("abc");
+    const auto bin = msg.SerializeAsString();
+    const auto view = pbview::BinMessageView<pbview::ParserMode::StrictConforming>::fromBytesString(bin);
+
+    auto plan = (Predicate::equal<type::Int32>(Msg::kInt32FieldFieldNumber, 1) &&
+                 Predicate::equal<type::String>(Msg::kStringFieldFieldNumber, "xyz")).compile();
+    for (int i = 0; i < 1023; i++)
+        REQUIRE_FALSE(plan(view));
+    REQUIRE(plan.stats().conditionsEvaluated == 2 * 1023);
+
+    for (int i = 0; i < 1000; i++)
+        REQUIRE_FALSE(plan(view));
+    REQUIRE(plan.stats().conditionsEvaluated == 2 * 1023 + 1000);
+    REQUIRE(plan.stats().matches == 0);
+}
+
+TEST_CASE("Predicate compares the same occurrence of duplicated fields as get()")
+{
+    // concatenated messages: int32_field twice, the second one after int64_field
+    Msg first;
+    first.set_int32_field(1);
+    first.set_int64_field(5);
+    Msg second;
+    second.set_int32_field(2);
+    const auto bin = first.SerializeAsString() + second.SerializeAsString();
+
+    auto requireLikeGet = [&](auto view) {
+        const auto value = view.template get<type::Int32>(Msg::kInt32FieldFieldNumber);
+        REQUIRE(value);
+        for (int expected : {1, 2})
+        {
+            auto plan = (Predicate::equal<type::Int32>(Msg::kInt32FieldFieldNumber, expected) &&
+                         Predicate::equal<type::Int64>(Msg::kInt64FieldFieldNumber, 5)).compile();
+            REQUIRE(plan(view) == (*value == expected));
+            REQUIRE(pbview::FieldPredicate::equal<type::Int32>(Msg::kInt32FieldFieldNumber, expected).matches(view) == (*value == expected));
+        }
+    };
+    requireLikeGet(pbview::BinMessageView<pbview::ParserMode::Fast>::fromBytesString(bin));
+    requireLikeGet(pbview::BinMessageView<pbview::ParserMode::Fast_WithoutBoundsChecking>::fromBytesString(bin));
+    requireLikeGet(pbview::BinMessageView<pbview::ParserMode::StrictConforming>::fromBytesString(bin));
+
+    REQUIRE(*pbview::BinMessageView<>::fromBytesString(bin).get<type::Int32>(Msg::kInt32FieldFieldNumber) == 1);
+    REQUIRE(*pbview::BinMessageView<pbview::ParserMode::StrictConforming>::fromBytesString(bin).get<type::Int32>(Msg::kInt32FieldFieldNumber) == 2);
+}
+
+TEST_CASE("FieldPredicate::startsWith")
+{
+    Msg msg;
+    msg.set_string_field("prefix and more");
+    const auto bin = msg.SerializeAsString();
+    const auto view = pbview::BinMessageView<>::fromBytesString(bin);
+
+    REQUIRE(pbview::FieldPredicate::startsWith<type::String>(Msg::kStringFieldFieldNumber, "prefix").matches(view));
+    REQUIRE(pbview::FieldPredicate::startsWith<type::String>(Msg::kStringFieldFieldNumber, "").matches(view));
+    REQUIRE_FALSE(pbview::FieldPredicate::startsWith<type::String>(Msg::kStringFieldFieldNumber, "more").matches(view));
+    REQUIRE_FALSE(pbview::FieldPredicate::startsWith<type::Bytes>(Msg::kBytesFieldFieldNumber, "").matches(view));
+}
@@ -0,0 +1,194 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/recordindex.hpp>
+#include "TestHelpers.hpp"
+
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+namespace
+{
+using pbview_test::span;
+using pbview_test::TempFile;
+using Msg = pbview::samples::AllTypes;
+namespace type = pbview::type;
+
+// int64_field: unique and shuffled, sint32_field: negative and with duplicates, string_field: with duplicates,
+// double_field: only in every 3rd record
+std::string writeRecords(int count)
+{
+    std::ostringstream os;
+    for (int i = 0; i < count; i++)
+    {
+        Msg msg;
+        msg.set_int32_field(i);
+        msg.set_int64_field(static_cast<std::int64_t>(i) * 7919 % count);
+        msg.set_sint32_field(i % 100 - 50);
+        msg.set_string_field("key-" + std::to_string(i % 250));
+        if (i % 3 == 0)
+            msg.set_double_field(i * -0.5);
+        // some large records with long length prefixes
+        if (i % 101 == 0)
+            msg.set_bytes_field(std::string(20000, 'X'));
+        google::protobuf::util::SerializeDelimitedToOstream(msg, &os);
+    }
+    return os.str();
+}
+
+template <pbview::ParserMode mode>
+std::string buildIndex(const pbview::MappedRecordFile<mode>& file, const pbview::IndexField& field, std::size_t threads = 2)
+{
+    std::ostringstream os;
+    pbview::ParallelScanOptions options;
+    options.threadCount = threads;
+    options.chunkSize = 10000;
+    pbview::buildRecordIndex(file, field, os, options);
+    return os.str();
+}
+
+template <typename Index>
+std::vector<int> lookup(const Index& index, const std::string& key)
+{
+    std::vector<int> res;
+    index.template forEachRecord<type::String>(key, [&](const auto& record) { res.push_back(*record.template get<type::Int32>(3)); });
+    return res;
+}
+}
+
+using pbview::ParserMode;
+
+TEST_CASE("RecordIndex looks up records by a unique key")
+{
+    TempFile data{writeRecords(5000)};
+    pbview::MappedRecordFile<> file{data.path};
+    TempFile indexFile{buildIndex(file, pbview::IndexField::of<type::Int64>(4))};
+
+    pbview::RecordIndex<> index{file, indexFile.path};
+    REQUIRE(index.size() == 5000);
+    REQUIRE(index.fieldNo() == 4);
+    REQUIRE(index.kind() == pbview::StatisticsKind::Signed);
+
+    for (std::int64_t key = 0; key < 5000; key++)
+    {
+        auto view = index.find<Msg, type::Int64>(key);
+        REQUIRE(view);
+        REQUIRE(view->int64_field() == key);
+        REQUIRE(static_cast<std::int64_t>(view->int32_field()) * 7919 % 5000 == key);
+        // zero-copy
+        REQUIRE(view->bin_view().bytes.data() > file.bytes().data());
+        REQUIRE(view->bin_view().bytes.data() < file.bytes().data() + file.bytes().size());
+    }
+    REQUIRE(!index.find<type::Int64>(5000));
+    REQUIRE(!index.find<type::Int64>(-1));
+    REQUIRE_THROWS(index.find<type::Uint64>(1));
+
+    std::vector<std::int64_t> keys;
+    REQUIRE(index.forEachRecordInRange<type::Int64>(100, 199, [&](pbview::BinMessageView<> record) {
+        keys.push_back(pbview::View<Msg>{record}.int64_field());
+    }) == 100);
+    REQUIRE(std::is_sorted(keys.begin(), keys.end()));
+    REQUIRE(keys.front() == 100);
+    REQUIRE(keys.back() == 199);
+}
+
+TEMPLATE_TEST_CASE_SIG("RecordIndex with duplicate keys", "", ((ParserMode mode), mode), ParserMode::Fast_WithoutBoundsChecking, ParserMode::Fast,
+                       ParserMode::StrictConforming)
+{
+    TempFile data{writeRecords(3000)};
+    pbview::MappedRecordFile<mode> file{data.path};
+
+    SECTION("signed numbers")
+    {
+        const auto indexData = buildIndex(file, pbview::IndexField::of<type::Sint32>(7), 1);
+        pbview::RecordIndex<mode> index{file.bytes(), span(indexData)};
+        for (std::int32_t key : {-50, -1, 0, 49})
+        {
+            std::vector<int> found;
+            REQUIRE(index.template forEachRecord<type::Sint32>(key, [&](pbview::BinMessageView<mode> record) {
+                found.push_back(*record.template get<type::Int32>(3));
+            }) == 30);
+            // in the order of the file
+            REQUIRE(std::is_sorted(found.begin(), found.end()));
+            for (int i : found)
+                REQUIRE(i % 100 - 50 == key);
+        }
+        std::size_t count = 0;
+        index.template forEachRecordInRange<type::Sint32>(-10, 9, [&](auto) { count++; });
+        REQUIRE(count == 600);
+        REQUIRE(index.template forEachRecordInRange<type::Sint32>(60, 70, [](auto) {}) == 0);
+    }
+
+    SECTION("strings")
+    {
+        const auto indexData = buildIndex(file, pbview::IndexField::of<type::String>(14), 3);
+        pbview::RecordIndex<mode> index{file.bytes(), span(indexData)};
+        REQUIRE(index.size() == 3000);
+        REQUIRE(lookup(index, "key-7") == std::vector<int>{7, 257, 507, 757, 1007, 1257, 1507, 1757, 2007, 2257, 2507, 2757});
+        REQUIRE(lookup(index, "key-").empty());
+        REQUIRE(lookup(index, "key-2500").empty());
+    }
+
+    SECTION("missing fields and floating point numbers")
+    {
+        const auto indexData = buildIndex(file, pbview::IndexField::of<type::Double>(1));
+        pbview::RecordIndex<mode> index{file.bytes(), span(indexData)};
+        REQUIRE(index.size() == 1000);
+        REQUIRE(index.template find<type::Double>(-1.5));
+        REQUIRE(!index.template find<type::Double>(-1.0));
+        // -0.0 == 0.0
+        REQUIRE(index.template find<type::Double>(-0.0));
+        REQUIRE(!index.template find<type::Double>(std::nan("")));
+
+        std::vector<double> values;
+        index.template forEachRecordInRange<type::Double>(-10, 0, [&](pbview::BinMessageView<mode> record) {
+            values.push_back(*record.template get<type::Double>(1));
+        });
+        REQUIRE(values == std::vector<double>{-9.0, -7.5, -6.0, -4.5, -3.0, -1.5, 0.0});
+    }
+}
+
+TEST_CASE("RecordIndex on records with padded length prefixes")
+{
+    // valid varints, that are longer than their shortest encoding (as written by other writers)
+    std::string data;
+    for (int i = 0; i < 1000; i++)
+    {
+        Msg msg;
+        msg.set_int32_field(i);
+        msg.set_int64_field(999 - i);
+        const auto record = msg.SerializeAsString();
+        REQUIRE(record.size() < 0x80);
+        data += static_cast<char>(record.size() | 0x80);
+        for (int padding = 0; padding < i % 4; padding++)
+            data += '\x80';
+        data += '\0';
+        data += record;
+    }
+    TempFile dataFile{data};
+    pbview::MappedRecordFile<> file{dataFile.path};
+    const auto indexData = buildIndex(file, pbview::IndexField::of<type::Int64>(4));
+    pbview::RecordIndex<> index{file.bytes(), span(indexData)};
+
+    REQUIRE(index.size() == 1000);
+    for (std::int64_t key = 0; key < 1000; key++)
+    {
+        const auto view = index.find<Msg, type::Int64>(key);
+        REQUIRE(view);
+        REQUIRE(view->int32_field() == 999 - key);
+    }
+}
+
+TEST_CASE("RecordIndex rejects invalid index files")
+{
+    TempFile data{writeRecords(100)};
+    pbview::MappedRecordFile<> file{data.path};
+    auto indexData = buildIndex(file, pbview::IndexField::of<type::Int64>(4));
+
+    REQUIRE_THROWS(pbview::RecordIndex<>{file.bytes(), span("x" + indexData.substr(1))});
+    REQUIRE_THROWS(pbview::RecordIndex<>{file.bytes(), span(indexData.substr(0, indexData.size() - 1))});
+    // index of another file
+    REQUIRE_THROWS(pbview::RecordIndex<>{file.bytes().substr(1), span(indexData)});
+    REQUIRE_THROWS(pbview::RecordIndex<>{file, "/nonexistent/index"});
+}
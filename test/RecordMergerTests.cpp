@@ -0,0 +1,139 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/recordmerger.hpp>
+#include "TestHelpers.hpp"
+
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace
+{
+using pbview_test::span;
+using Msg = pbview::samples::AllTypes;
+namespace type = pbview::type;
+using pbview::SortOrder;
+
+// shards of records sorted by sint64_field (descending), int32_field: (shard, position in shard)
+std::vector<std::string> makeShards(std::size_t shardCount)
+{
+    std::mt19937 rnd{3};
+    std::vector<std::string> shards;
+    for (std::size_t s = 0; s < shardCount; s++)
+    {
+        std::vector<std::int64_t> values(rnd() % 200);
+        for (auto& val : values)
+            val = static_cast<std::int64_t>(rnd() % 50) - 25;
+        std::sort(values.rbegin(), values.rend());
+
+        std::ostringstream os;
+        for (std::size_t i = 0; i < values.size(); i++)
+        {
+            Msg msg;
+            msg.set_int32_field(static_cast<std::int32_t>(s * 1000 + i));
+            msg.set_sint64_field(values[i]);
+            google::protobuf::util::SerializeDelimitedToOstream(msg, &os);
+        }
+        shards.push_back(os.str());
+    }
+    return shards;
+}
+
+// (sint64_field, int32_field) of all records of the shards, in the expected order of the merge
+std::vector<std::pair<std::int64_t, std::int32_t>> expectedOrder(const std::vector<std::string>& shards)
+{
+    std::vector<std::pair<std::int64_t, std::int32_t>> res;
+    for (const auto& shard : shards)
+        for (auto record : pbview::DelimitedRecords<pbview::BinMessageView<>, pbview::View<Msg>>{span(shard)})
+            res.emplace_back(record.sint64_field(), record.int32_field());
+    // equal keys: lower shard first, then in the order of the shard
+    std::stable_sort(res.begin(), res.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    return res;
+}
+
+pbview::SortKeyBuilder sint64Descending()
+{
+    pbview::SortKeyBuilder keys;
+    keys.add<type::Sint64>(8, SortOrder::Descending);
+    return keys;
+}
+}
+
+TEST_CASE("RecordMerger merges sorted sources")
+{
+    const auto keys = sint64Descending();
+    for (std::size_t shardCount : {0, 1, 2, 7, 16})
+    {
+        const auto shards = makeShards(shardCount);
+        std::vector<pbview::DataSpan> sources;
+        for (const auto& shard : shards)
+            sources.push_back(span(shard));
+
+        pbview::RecordMerger<> merger{sources, keys};
+        std::vector<std::pair<std::int64_t, std::int32_t>> merged;
+        while (auto record = merger.next<Msg>())
+        {
+            REQUIRE(merger.source() == static_cast<std::size_t>(record->int32_field() / 1000));
+            // the views point into the sources
+            const auto delimited = merger.delimitedRecord();
+            REQUIRE(delimited.data() >= sources[merger.source()].data());
+            REQUIRE(delimited.data() + delimited.size() == record->bin_view().bytes.data() + record->bin_view().bytes.size());
+            merged.emplace_back(record->sint64_field(), record->int32_field());
+        }
+        INFO(shardCount);
+        REQUIRE(merged == expectedOrder(shards));
+        REQUIRE_FALSE(merger.next());
+    }
+}
+
+TEST_CASE("RecordMerger rejects unsorted sources")
+{
+    auto shards = makeShards(2);
+    // an ascending pair of values
+    std::ostringstream os;
+    for (std::int64_t val : {-100, 100})
+    {
+        Msg msg;
+        msg.set_sint64_field(val);
+        google::protobuf::util::SerializeDelimitedToOstream(msg, &os);
+    }
+    shards[1] += os.str();
+
+    const auto keys = sint64Descending();
+    pbview::RecordMerger<> merger{{span(shards[0]), span(shards[1])}, keys};
+    REQUIRE_THROWS_WITH([&] { while (merger.next()) {} }(), "Record source is not sorted by the merge keys");
+}
+
+TEST_CASE("mergeRecords writes the merged records with writev")
+{
+    const auto shards = makeShards(5);
+    std::vector<pbview::DataSpan> sources;
+    std::size_t size = 0;
+    for (const auto& shard : shards)
+    {
+        sources.push_back(span(shard));
+        size += shard.size();
+    }
+
+    char name[] = "/tmp/pbview_test_XXXXXX";
+    const int fd = mkstemp(name);
+    REQUIRE(fd >= 0);
+    const auto stats = pbview::mergeRecords(sources, sint64Descending(), fd);
+    ::close(fd);
+
+    std::ifstream is{name, std::ios::binary};
+    const std::string merged{std::istreambuf_iterator<char>{is}, {}};
+    ::unlink(name);
+
+    REQUIRE(stats.bytes == size);
+    REQUIRE(merged.size() == size);
+    REQUIRE(stats.writes >= 1);
+    std::vector<std::pair<std::int64_t, std::int32_t>> res;
+    for (auto record : pbview::DelimitedRecords<pbview::BinMessageView<>, pbview::View<Msg>>{span(merged)})
+        res.emplace_back(record.sint64_field(), record.int32_field());
+    REQUIRE(stats.records == res.size());
+    REQUIRE(res == expectedOrder(shards));
+}
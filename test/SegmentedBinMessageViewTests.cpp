@@ -0,0 +1,189 @@
+#include <limits>
+
+#include <test/samples-pb2.pbview.h>
+#include <pbview/segmentedbinmessageview.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <range/v3/to_container.hpp>
+
+using namespace std::literals;
+
+namespace
+{
+// splits binStr into chunks of the given size (the last one may be shorter)
+std::vector<pbview::DataSpan> split(const std::string& binStr, std::size_t chunkSize)
+{
+    std::vector<pbview::DataSpan> chunks;
+    auto bytes = pbview::BinMessageView<>::fromBytesString(binStr).bytes;
+    while (!bytes.empty())
+    {
+        chunks.push_back(bytes.substr(0, chunkSize));
+        bytes.remove_prefix(chunks.back().size());
+    }
+    return chunks;
+}
+
+void init(pbview::samples::AllTypes& allTypes)
+{
+    allTypes.set_double_field(3.1415926);
+    allTypes.set_float_field(3.14f);
+    allTypes.set_int32_field(-142);
+    allTypes.set_uint64_field(std::numeric_limits<std::uint64_t>::max());
+    allTypes.set_sint64_field(-642);
+    allTypes.set_fixed64_field(842);
+    allTypes.set_sfixed32_field(-942);
+    allTypes.set_bool_field(true);
+    allTypes.set_string_field(std::string(100, 'X') + "Lorem ipsum");
+    allTypes.set_bytes_field("Lorem\0ipsum"s);
+    allTypes.set_myenum_field(pbview::samples::MyEnumVal3);
+    allTypes.mutable_mysubmsg_field()->set_id(314);
+    allTypes.mutable_mysubmsg_field()->set_value("asdf");
+}
+}
+
+TEST_CASE("SegmentedBinMessageView as BinView of a generated view")
+{
+    using Msg = pbview::samples::AllTypes;
+    using BinView = pbview::SegmentedBinMessageView<>;
+    using View = pbview::View<Msg, BinView>;
+
+    Msg allTypes;
+    init(allTypes);
+    auto binStr = allTypes.SerializeAsString();
+
+    for (std::size_t chunkSize : {1, 2, 3, 7, 16, 64, 1000})
+    {
+        INFO("chunk size " << chunkSize);
+        auto view = View{BinView{split(binStr, chunkSize)}};
+
+        REQUIRE(view.double_field() == allTypes.double_field());
+        REQUIRE(view.float_field() == allTypes.float_field());
+        REQUIRE(view.int32_field() == allTypes.int32_field());
+        REQUIRE(view.uint64_field() == allTypes.uint64_field());
+        REQUIRE(view.sint64_field() == allTypes.sint64_field());
+        REQUIRE(view.fixed64_field() == allTypes.fixed64_field());
+        REQUIRE(view.sfixed32_field() == allTypes.sfixed32_field());
+        REQUIRE(view.bool_field() == allTypes.bool_field());
+        REQUIRE(view.string_field() == allTypes.string_field());
+        REQUIRE(view.bytes_field() == allTypes.bytes_field());
+        REQUIRE(view.myenum_field() == allTypes.myenum_field());
+        REQUIRE(view.mysubmsg_field().id() == 314);
+        REQUIRE(view.mysubmsg_field().value() == "asdf");
+        REQUIRE_FALSE(view.has_uint32_field());
+        REQUIRE_FALSE(view.has_fixed32_field());
+
+        REQUIRE(pbview::deserialize<Msg>(view.bin_view()).SerializeAsString() == binStr);
+    }
+}
+
+TEST_CASE("SegmentedBinMessageView returns strings spanning chunks without copying")
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    init(allTypes);
+    auto binStr = allTypes.SerializeAsString();
+
+    auto chunks = split(binStr, 16);
+    auto view = pbview::SegmentedBinMessageView<>{chunks};
+
+    auto str = view.get<pbview::type::Chunked>(Msg::kStringFieldFieldNumber);
+    REQUIRE(str);
+    REQUIRE(*str == allTypes.string_field());
+    REQUIRE(str->toString() == allTypes.string_field());
+    REQUIRE(str->chunks().size() > 1);
+    for (auto part : str->chunks())
+    {
+        auto inChunk = std::any_of(chunks.begin(), chunks.end(), [&](pbview::DataSpan chunk) {
+            return part.data() >= chunk.data() && part.data() + part.size() <= chunk.data() + chunk.size();
+        });
+        REQUIRE(inChunk);
+    }
+
+    REQUIRE(view.get<pbview::type::Chunked>(Msg::kUint32FieldFieldNumber) == std::nullopt);
+
+    // flat string_views have to be joined, but only once
+    const auto joined = view.get<pbview::type::String>(Msg::kStringFieldFieldNumber);
+    REQUIRE(joined == allTypes.string_field());
+    REQUIRE(view.get<pbview::type::String>(Msg::kStringFieldFieldNumber)->data() == joined->data());
+}
+
+TEST_CASE("SegmentedBinMessageView on repeated fields")
+{
+    pbview::samples::AllTypesRepeated repeated;
+    pbview::samples::AllTypesRepeatedPacked packed;
+    for (int i = 0; i < 100; i++)
+    {
+        auto val = (i % 3 == 0) ? -i * 100003 : i;
+        repeated.add_sint32_field(val);
+        repeated.add_int64_field(val);
+        repeated.add_sfixed32_field(val);
+        repeated.add_string_field(std::string(i, 'X'));
+        packed.add_sint32_field(val);
+        packed.add_int64_field(val);
+        packed.add_sfixed32_field(val);
+        packed.add_double_field(val);
+    }
+
+    for (std::size_t chunkSize : {1, 5, 64})
+    {
+        INFO("chunk size " << chunkSize);
+
+        {
+            using Msg = pbview::samples::AllTypesRepeated;
+            auto binStr = repeated.SerializeAsString();
+            auto view = pbview::View<Msg, pbview::SegmentedBinMessageView<>>{pbview::SegmentedBinMessageView<>{split(binStr, chunkSize)}};
+
+            REQUIRE(ranges::to_vector(repeated.sint32_field()) == ranges::to_vector(view.sint32_field()));
+            REQUIRE(ranges::to_vector(repeated.int64_field()) == ranges::to_vector(view.int64_field()));
+            REQUIRE(ranges::to_vector(repeated.sfixed32_field()) == ranges::to_vector(view.sfixed32_field()));
+            REQUIRE(view.string_field_size() == 100);
+            REQUIRE(view.string_field(99) == repeated.string_field(99));
+            REQUIRE(view.double_field_size() == 0);
+
+            std::vector<std::int64_t> values;
+            view.int64_field_into(values);
+            REQUIRE(ranges::to_vector(repeated.int64_field()) == values);
+        }
+
+        {
+            using Msg = pbview::samples::AllTypesRepeatedPacked;
+            auto binStr = packed.SerializeAsString();
+            auto view = pbview::View<Msg, pbview::SegmentedBinMessageView<>>{pbview::SegmentedBinMessageView<>{split(binStr, chunkSize)}};
+
+            REQUIRE(ranges::to_vector(packed.sint32_field()) == ranges::to_vector(view.sint32_field()));
+            REQUIRE(ranges::to_vector(packed.int64_field()) == ranges::to_vector(view.int64_field()));
+            REQUIRE(ranges::to_vector(packed.sfixed32_field()) == ranges::to_vector(view.sfixed32_field()));
+            REQUIRE(ranges::to_vector(packed.double_field()) == ranges::to_vector(view.double_field()));
+            REQUIRE(view.bool_field_size() == 0);
+        }
+    }
+}
+
+TEST_CASE("SegmentedBinMessageView with irregular encoding and truncated input")
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg first;
+    first.set_int32_field(1);
+    first.set_string_field("first");
+    Msg second;
+    second.set_int32_field(2);
+
+    auto binStr = first.SerializeAsString() + second.SerializeAsString();
+    auto chunks = split(binStr, 3);
+
+    auto strict = pbview::SegmentedBinMessageView<pbview::ParserMode::StrictConforming>{chunks};
+    REQUIRE(strict.get<pbview::type::String>(Msg::kStringFieldFieldNumber) == "first"sv);
+    REQUIRE(strict.get<pbview::type::Int32>(Msg::kInt32FieldFieldNumber) == 2);
+
+    auto fast = pbview::SegmentedBinMessageView<>{chunks};
+    REQUIRE(fast.get<pbview::type::Int32>(Msg::kInt32FieldFieldNumber) == 1);
+    REQUIRE_THROWS(fast.get<pbview::type::Double>(Msg::kInt32FieldFieldNumber));
+
+    Msg large;
+    init(large);
+    auto truncated = large.SerializeAsString();
+    truncated.resize(truncated.size() - 10);
+    auto truncatedView = pbview::SegmentedBinMessageView<>{split(truncated, 7)};
+    REQUIRE_THROWS(truncatedView.get<pbview::type::Message>(Msg::kMysubmsgFieldFieldNumber));
+}
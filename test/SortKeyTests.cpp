@@ -0,0 +1,132 @@
+#include <test/samples-pb2.pbview.h>
+#include <pbview/sortkey.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <random>
+
+namespace
+{
+using Msg = pbview::samples::AllTypes;
+namespace type = pbview::type;
+using pbview::SortOrder;
+
+template <typename T>
+std::string keyOf(typename T::CppType val)
+{
+    std::string res;
+    pbview::impl::appendSortKey<T>(res, val);
+    return res;
+}
+
+// the keys of the values are ordered like the values
+template <typename T, typename Cpp = typename T::CppType>
+void checkOrder(std::vector<Cpp> values)
+{
+    std::sort(values.begin(), values.end());
+    for (std::size_t i = 0; i + 1 < values.size(); i++)
+    {
+        INFO(i);
+        const auto a = keyOf<T>(values[i]);
+        const auto b = keyOf<T>(values[i + 1]);
+        REQUIRE((values[i] < values[i + 1]) == (a < b));
+        REQUIRE((values[i] == values[i + 1]) == (a == b));
+        REQUIRE(std::memcmp(a.data(), b.data(), std::min(a.size(), b.size())) <= 0);
+    }
+}
+}
+
+TEST_CASE("Sort keys of values compare like the values")
+{
+    checkOrder<type::Int32>({std::numeric_limits<std::int32_t>::min(), -70000, -256, -1, 0, 1, 255, 256, 70000, std::numeric_limits<std::int32_t>::max()});
+    checkOrder<type::Sint64>({std::numeric_limits<std::int64_t>::min(), -(1ll << 40), -1, 0, 1, 1ll << 40, std::numeric_limits<std::int64_t>::max()});
+    checkOrder<type::Uint32>({0, 1, 255, 256, 1u << 31, std::numeric_limits<std::uint32_t>::max()});
+    checkOrder<type::Fixed64>({0, 1, 1ull << 63, std::numeric_limits<std::uint64_t>::max()});
+    checkOrder<type::Bool>({false, true});
+    checkOrder<type::Enum<pbview::samples::MyEnum>>({pbview::samples::MyEnumVal1, pbview::samples::MyEnumVal2, pbview::samples::MyEnumVal3});
+
+    const auto inf = std::numeric_limits<double>::infinity();
+    checkOrder<type::Double>({-inf, -1e300, -1.5, -std::numeric_limits<double>::denorm_min(), 0.0, std::numeric_limits<double>::denorm_min(), 1e-300, 1.5, 1e300, inf});
+    checkOrder<type::Float>({-std::numeric_limits<float>::infinity(), -3.5f, -0.0f, 1e-20f, 3.5f, std::numeric_limits<float>::max()});
+    REQUIRE(keyOf<type::Double>(-0.0) == keyOf<type::Double>(0.0));
+    REQUIRE(keyOf<type::Double>(std::nan("1")) == keyOf<type::Double>(-std::nan("2")));
+    REQUIRE(keyOf<type::Double>(std::nan("")) > keyOf<type::Double>(inf));
+    REQUIRE(keyOf<type::Float>(1.0f).size() == 4);
+
+    using namespace std::literals;
+    checkOrder<type::String>({""sv, "\0"sv, "\0\0"sv, "\0\x01"sv, "\x01"sv, "a"sv, "a\0"sv, "a\0b"sv, "ab"sv, "b"sv, "\xff"sv, "\xff\xff"sv});
+}
+
+TEST_CASE("SortKeyBuilder orders messages like a comparator over several fields")
+{
+    std::mt19937 rnd{42};
+    std::vector<Msg> msgs(2000);
+    for (auto& msg : msgs)
+    {
+        // few distinct values, so that the later fields decide
+        if (rnd() % 10)
+            msg.set_string_field(std::string(rnd() % 3, static_cast<char>('a' + rnd() % 2)));
+        msg.set_sint64_field(static_cast<std::int64_t>(rnd() % 5) - 2);
+        if (rnd() % 10)
+        {
+            msg.mutable_mysubmsg_field()->set_id(static_cast<int>(rnd() % 1000) - 500);
+            msg.mutable_mysubmsg_field()->set_value("");
+        }
+        msg.set_double_field(std::uniform_real_distribution<double>{-10, 10}(rnd));
+    }
+
+    pbview::SortKeyBuilder keys;
+    keys.add<type::String>(14).add<type::Sint64>(8, SortOrder::Descending).add<type::Int32>({17, 1}).add<type::Double>(1, SortOrder::Descending);
+    REQUIRE(keys.size() == 4);
+
+    // reference order: missing values first, sint64_field and double_field descending
+    auto less = [](const Msg& a, const Msg& b) {
+        auto tie = [](const Msg& m) {
+            return std::make_tuple(m.has_string_field(), m.string_field(), -m.sint64_field(), m.has_mysubmsg_field(), m.mysubmsg_field().id(), -m.double_field());
+        };
+        return tie(a) < tie(b);
+    };
+
+    std::vector<std::string> serialized;
+    for (const auto& msg : msgs)
+        serialized.push_back(msg.SerializeAsString());
+    std::vector<std::pair<std::string, std::size_t>> keyed;
+    std::string key;
+    for (std::size_t i = 0; i < msgs.size(); i++)
+    {
+        keys.build(pbview::BinMessageView<>::fromBytesString(serialized[i]), key);
+        keyed.emplace_back(key, i);
+        // same keys with all parser modes
+        REQUIRE(keys(pbview::BinMessageView<pbview::ParserMode::StrictConforming>::fromBytesString(serialized[i])) == key);
+        REQUIRE(keys(pbview::BinMessageView<pbview::ParserMode::Fast_WithoutBoundsChecking>::fromBytesString(serialized[i])) == key);
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    for (std::size_t i = 0; i + 1 < keyed.size(); i++)
+    {
+        const auto& a = msgs[keyed[i].second];
+        const auto& b = msgs[keyed[i + 1].second];
+        REQUIRE(!less(b, a));
+        REQUIRE(less(a, b) == (keyed[i].first < keyed[i + 1].first));
+    }
+}
+
+TEST_CASE("SortKeyBuilder with missing sub-messages")
+{
+    Msg withSub;
+    withSub.mutable_mysubmsg_field()->set_id(std::numeric_limits<std::int32_t>::min());
+    withSub.mutable_mysubmsg_field()->set_value("x");
+    const auto withSubStr = withSub.SerializeAsString();
+    const auto emptyStr = Msg{}.SerializeAsString();
+
+    pbview::SortKeyBuilder asc;
+    asc.add<type::Int32>({17, 1});
+    pbview::SortKeyBuilder desc;
+    desc.add<type::Int32>({17, 1}, SortOrder::Descending);
+
+    auto withSubView = pbview::BinMessageView<>::fromBytesString(withSubStr);
+    auto emptyView = pbview::BinMessageView<>::fromBytesString(emptyStr);
+    REQUIRE(asc(emptyView) < asc(withSubView));
+    REQUIRE(desc(emptyView) > desc(withSubView));
+    REQUIRE_THROWS(pbview::SortKeyBuilder{}.add<type::Int32>(std::vector<int>{}));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <pbview/binmessageview.hpp>
+
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// helpers shared by the tests
+namespace pbview_test
+{
+// file with a unique name, that is removed on destruction
+struct TempFile
+{
+    std::string path;
+
+    explicit TempFile(const std::string& content = {})
+    {
+        char name[] = "/tmp/pbview_test_XXXXXX";
+        const int fd = mkstemp(name);
+        REQUIRE(fd >= 0);
+        ::close(fd);
+        path = name;
+        std::ofstream os{path, std::ios::binary};
+        os << content;
+    }
+
+    TempFile(const TempFile&) = delete;
+    TempFile& operator=(const TempFile&) = delete;
+
+    ~TempFile()
+    {
+        ::unlink(path.c_str());
+    }
+};
+
+inline pbview::DataSpan span(const std::string& str)
+{
+    return pbview::DataSpan{reinterpret_cast<const std::byte*>(str.data()), str.size()};
+}
+
+// the messages as length delimited records
+template <typename Msg>
+std::string serialize(const std::vector<Msg>& msgs)
+{
+    std::ostringstream os;
+    for (const auto& msg : msgs)
+        google::protobuf::util::SerializeDelimitedToOstream(msg, &os);
+    return os.str();
+}
+} // namespace pbview_test
@@ -1,7 +1,33 @@
+#include <fstream>
+#include <sstream>
 #include <limits>
+#include <numeric>
+#include <unordered_map>
 
 #include <test/samples-pb2.pbview.h>
 #include <test/samples-pb2.pbvar.h>
+#include <pbview/indexedbinmessageview.hpp>
+#include <pbview/cachingbinmessageview.hpp>
+#include <pbview/cachelineindex.hpp>
+#include <pbview/segmentedbinmessageview.hpp>
+#include <pbview/delimitedstreamreader.hpp>
+#include <pbview/mappedrecordfile.hpp>
+#include <pbview/parallelscan.hpp>
+#include <pbview/blockrecordfile.hpp>
+#include <pbview/recordindex.hpp>
+#include <pbview/sortkey.hpp>
+#include <pbview/externalsort.hpp>
+#include <pbview/recordmerger.hpp>
+#include <pbview/hashjoin.hpp>
+#include <pbview/hashpartition.hpp>
+#include <pbview/aggregate.hpp>
+#include <pbview/columns.hpp>
+#include <pbview/gather.hpp>
+#include <pbview/predicate.hpp>
+
+#include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
 
 #include <range/v3/to_container.hpp>
 #include <range/v3/view/zip.hpp>
@@ -328,5 +354,1103 @@ void benchSimpleMessage_Fast_Variant(benchmark::State& state)
 }
 BENCHMARK(benchSimpleMessage_Fast_Variant);
 
+template <typename BinReader>
+void benchManyFieldsOfSimpleMessage(benchmark::State& state)
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    init(allTypes);
+
+    using View = pbview::View<Msg, BinReader>;
+
+    auto binStr = allTypes.SerializeAsString();
+
+    for (auto _ : state) {
+       auto view = View::fromBytesString(binStr);
+       benchmark::DoNotOptimize(view);
+
+       auto sum = view.int32_field() + view.int64_field() + view.fixed64_field() + view.sfixed64_field() + view.string_field().size() + view.mysubmsg_field().id();
+       benchmark::DoNotOptimize(sum);
+       if (sum != 14+24+84+104+11+314)
+          throw std::runtime_error("Unexpected result!");
+    }
+}
+
+void benchManyFieldsOfSimpleMessage_Fast(benchmark::State& state)
+{
+    benchManyFieldsOfSimpleMessage<pbview::BinMessageView<pbview::ParserMode::Fast>>(state);
+}
+BENCHMARK(benchManyFieldsOfSimpleMessage_Fast);
+
+void benchManyFieldsOfSimpleMessage_Indexed(benchmark::State& state)
+{
+    benchManyFieldsOfSimpleMessage<pbview::IndexedBinMessageView<pbview::ParserMode::Fast>>(state);
+}
+BENCHMARK(benchManyFieldsOfSimpleMessage_Indexed);
+
+void benchManyFieldsOfSimpleMessage_Caching(benchmark::State& state)
+{
+    benchManyFieldsOfSimpleMessage<pbview::CachingBinMessageView<pbview::ParserMode::Fast>>(state);
+}
+BENCHMARK(benchManyFieldsOfSimpleMessage_Caching);
+
+void benchManyFieldsOfSimpleMessage_GetMany(benchmark::State& state)
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    init(allTypes);
+
+    using View = pbview::View<Msg>;
+    using Fields = View::fields;
+
+    auto binStr = allTypes.SerializeAsString();
+
+    for (auto _ : state) {
+       auto view = View::fromBytesString(binStr);
+       benchmark::DoNotOptimize(view);
+
+       auto [i32, i64, f64, sf64, str, subMsg] = view.get_many<Fields::int32_field, Fields::int64_field, Fields::fixed64_field,
+                                                               Fields::sfixed64_field, Fields::string_field, Fields::mysubmsg_field>();
+       auto sum = *i32 + *i64 + *f64 + *sf64 + str->size() + subMsg->id();
+       benchmark::DoNotOptimize(sum);
+       if (sum != 14+24+84+104+11+314)
+          throw std::runtime_error("Unexpected result!");
+    }
+}
+BENCHMARK(benchManyFieldsOfSimpleMessage_GetMany);
+
+void benchManyFieldsOfSimpleMessage_Projection(benchmark::State& state)
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    init(allTypes);
+
+    auto binStr = allTypes.SerializeAsString();
+
+    for (auto _ : state) {
+       auto view = pbview::View<Msg>::fromBytesString(binStr);
+       benchmark::DoNotOptimize(view);
+
+       auto projection = pbview::samples::AllTypesProjection::decode(view);
+       auto sum = projection.int32_field + projection.string_field.size() + projection.mysubmsg_field_id;
+       benchmark::DoNotOptimize(sum);
+       if (sum != 14+11+314)
+          throw std::runtime_error("Unexpected result!");
+    }
+}
+BENCHMARK(benchManyFieldsOfSimpleMessage_Projection);
+
+std::vector<pbview::DataSpan> splitIntoChunks(const std::string& binStr, std::size_t chunkSize)
+{
+    std::vector<pbview::DataSpan> chunks;
+    auto bytes = pbview::BinMessageView<>::fromBytesString(binStr).bytes;
+    while (!bytes.empty())
+    {
+        chunks.push_back(bytes.substr(0, chunkSize));
+        bytes.remove_prefix(chunks.back().size());
+    }
+    return chunks;
+}
+
+template <typename BinReader>
+void benchManyFieldsOfChunkedMessage(benchmark::State& state)
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    init(allTypes);
+    // large payload before the sub-message, as received in packets of a network stack
+    allTypes.set_bytes_field(std::string(1 << 16, 'X'));
+
+    using View = pbview::View<Msg, BinReader>;
+
+    auto binStr = allTypes.SerializeAsString();
+    auto chunks = splitIntoChunks(binStr, state.range(0));
+
+    for (auto _ : state) {
+       View view;
+       std::string joined;
+       if constexpr (std::is_same_v<BinReader, pbview::SegmentedBinMessageView<>>)
+          view = View{BinReader{chunks}};
+       else
+       {
+          // the chunks have to be copied into one flat buffer
+          for (auto chunk : chunks)
+             joined.append(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+          view = View::fromBytesString(joined);
+       }
+       benchmark::DoNotOptimize(view);
+
+       auto sum = view.int32_field() + view.int64_field() + view.fixed64_field() + view.sfixed64_field() + view.mysubmsg_field().id();
+       benchmark::DoNotOptimize(sum);
+       if (sum != 14+24+84+104+314)
+          throw std::runtime_error("Unexpected result!");
+    }
+}
+
+void benchManyFieldsOfChunkedMessage_Joined(benchmark::State& state)
+{
+    benchManyFieldsOfChunkedMessage<pbview::BinMessageView<>>(state);
+}
+BENCHMARK(benchManyFieldsOfChunkedMessage_Joined)->Arg(64)->Arg(1500);
+
+void benchManyFieldsOfChunkedMessage_Segmented(benchmark::State& state)
+{
+    benchManyFieldsOfChunkedMessage<pbview::SegmentedBinMessageView<>>(state);
+}
+BENCHMARK(benchManyFieldsOfChunkedMessage_Segmented)->Arg(64)->Arg(1500);
+
+std::string gzipDelimitedRecords(int count)
+{
+    std::string res;
+    {
+        google::protobuf::io::StringOutputStream os{&res};
+        google::protobuf::io::GzipOutputStream gzipOs{&os};
+        for (int i = 0; i < count; i++)
+        {
+            pbview::samples::AllTypes allTypes;
+            init(allTypes);
+            allTypes.set_int32_field(i);
+            google::protobuf::util::SerializeDelimitedToZeroCopyStream(allTypes, &gzipOs);
+        }
+    }
+    return res;
+}
+
+void benchGzipDelimitedStream_Deserialize(benchmark::State& state)
+{
+    auto compressed = gzipDelimitedRecords(10000);
+
+    for (auto _ : state) {
+       google::protobuf::io::ArrayInputStream is{compressed.data(), static_cast<int>(compressed.size())};
+       google::protobuf::io::GzipInputStream gzipIs{&is};
+       std::int64_t sum = 0;
+       pbview::samples::AllTypes msg;
+       bool cleanEof = false;
+       while (google::protobuf::util::ParseDelimitedFromZeroCopyStream(&msg, &gzipIs, &cleanEof))
+          sum += msg.int32_field() + msg.mysubmsg_field().id();
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 10000);
+}
+BENCHMARK(benchGzipDelimitedStream_Deserialize);
+
+void benchGzipDelimitedStream_Reader(benchmark::State& state)
+{
+    auto compressed = gzipDelimitedRecords(10000);
+
+    for (auto _ : state) {
+       google::protobuf::io::ArrayInputStream is{compressed.data(), static_cast<int>(compressed.size())};
+       google::protobuf::io::GzipInputStream gzipIs{&is};
+       std::int64_t sum = 0;
+       pbview::DelimitedStreamReader<> reader{gzipIs};
+       while (auto view = reader.next<pbview::samples::AllTypes>())
+          sum += view->int32_field() + view->mysubmsg_field().id();
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 10000);
+}
+BENCHMARK(benchGzipDelimitedStream_Reader);
+
+// file of 100000 delimited records, written once and removed at exit
+const std::string& recordFilePath()
+{
+    struct RecordFile
+    {
+        std::string path;
+
+        RecordFile()
+        {
+            char name[] = "/tmp/pbview_bench_XXXXXX";
+            google::protobuf::io::FileOutputStream os{mkstemp(name)};
+            os.SetCloseOnDelete(true);
+            for (int i = 0; i < 100000; i++)
+            {
+                pbview::samples::AllTypes allTypes;
+                init(allTypes);
+                allTypes.set_int32_field(i);
+                google::protobuf::util::SerializeDelimitedToZeroCopyStream(allTypes, &os);
+            }
+            path = name;
+        }
+
+        ~RecordFile()
+        {
+            ::unlink(path.c_str());
+        }
+    };
+    static const RecordFile file;
+    return file.path;
+}
+
+void benchRecordFile_Read(benchmark::State& state)
+{
+    const auto& path = recordFilePath();
+
+    for (auto _ : state) {
+       const int fd = ::open(path.c_str(), O_RDONLY);
+       google::protobuf::io::FileInputStream is{fd};
+       is.SetCloseOnDelete(true);
+       std::int64_t sum = 0;
+       pbview::DelimitedStreamReader<> reader{is};
+       while (auto view = reader.next<pbview::samples::AllTypes>())
+          sum += view->int32_field() + view->mysubmsg_field().id();
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchRecordFile_Read);
+
+void benchRecordFile_Mapped(benchmark::State& state)
+{
+    const auto& path = recordFilePath();
+
+    for (auto _ : state) {
+       pbview::MappedRecordFile<> file{path};
+       std::int64_t sum = 0;
+       for (auto view : file.records<pbview::samples::AllTypes>())
+          sum += view.int32_field() + view.mysubmsg_field().id();
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchRecordFile_Mapped);
+
+void benchRecordFile_Parallel(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    if (state.range(1))
+        file.buildOffsetTable();
+    pbview::WorkStealingPool pool{static_cast<std::size_t>(state.range(0))};
+    pbview::ParallelScanOptions options;
+    options.pool = &pool;
+    options.chunkSize = 256 << 10;
+
+    for (auto _ : state) {
+       auto sums = pbview::parallelForEachRecord(file, std::int64_t{0}, [](std::int64_t& sum, pbview::BinMessageView<> record) {
+          auto view = pbview::View<pbview::samples::AllTypes>{record};
+          sum += view.int32_field() + view.mysubmsg_field().id();
+       }, options);
+       benchmark::DoNotOptimize(sums);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+    state.SetBytesProcessed(state.iterations() * file.bytes().size());
+}
+// scaling from 1 to N threads, with and without offset table
+BENCHMARK(benchRecordFile_Parallel)->Apply([](benchmark::internal::Benchmark* b) {
+    const int maxThreads = std::max(2u, std::thread::hardware_concurrency());
+    for (int withOffsetTable : {0, 1})
+    {
+        for (int threads = 1; threads < maxThreads; threads *= 2)
+            b->Args({threads, withOffsetTable});
+        b->Args({maxThreads, withOffsetTable});
+    }
+})->ArgNames({"threads", "offsets"})->UseRealTime();
+
+// finds a record by int32_field, by scanning the file or with a RecordIndex
+void benchRecordFile_FindByScan(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    std::int32_t key = 0;
+
+    for (auto _ : state) {
+       key = (key + 7919) % 100000;
+       for (auto view : file.records<pbview::samples::AllTypes>())
+       {
+          if (view.int32_field() == key)
+          {
+             benchmark::DoNotOptimize(view.mysubmsg_field().id());
+             break;
+          }
+       }
+    }
+}
+BENCHMARK(benchRecordFile_FindByScan);
+
+void benchRecordFile_FindByIndex(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    std::ostringstream os;
+    pbview::buildRecordIndex(file, pbview::IndexField::of<pbview::type::Int32>(3), os);
+    const auto indexData = os.str();
+    pbview::RecordIndex<> index{file.bytes(), pbview::DataSpan{reinterpret_cast<const std::byte*>(indexData.data()), indexData.size()}};
+    std::int32_t key = 0;
+
+    for (auto _ : state) {
+       key = (key + 7919) % 100000;
+       auto view = index.find<pbview::samples::AllTypes, pbview::type::Int32>(key);
+       benchmark::DoNotOptimize(view->mysubmsg_field().id());
+    }
+}
+BENCHMARK(benchRecordFile_FindByIndex);
+
+// sorts the records by string_field and int32_field (descending)
+void benchSortRecords_Deserialize(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+
+    for (auto _ : state) {
+       std::vector<pbview::samples::AllTypes> msgs;
+       for (auto record : file.records())
+          msgs.emplace_back().ParseFromArray(record.bytes.data(), static_cast<int>(record.bytes.size()));
+       std::sort(msgs.begin(), msgs.end(), [](const auto& a, const auto& b) {
+          return std::make_tuple(std::string_view{a.string_field()}, -a.int32_field()) < std::make_tuple(std::string_view{b.string_field()}, -b.int32_field());
+       });
+       benchmark::DoNotOptimize(msgs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchSortRecords_Deserialize);
+
+void benchSortRecords_SortKeys(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    pbview::SortKeyBuilder keys;
+    keys.add<pbview::type::String>(14).add<pbview::type::Int32>(3, pbview::SortOrder::Descending);
+
+    for (auto _ : state) {
+       std::vector<std::pair<std::string, pbview::DataSpan>> sorted;
+       for (auto record : file.records())
+          sorted.emplace_back(keys(record), record.bytes);
+       std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+       benchmark::DoNotOptimize(sorted.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchSortRecords_SortKeys);
+
+// sortRecords() in memory and with spilled runs of 4 MB
+void benchSortRecords_External(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    pbview::SortKeyBuilder keys;
+    keys.add<pbview::type::String>(14).add<pbview::type::Int32>(3, pbview::SortOrder::Descending);
+    pbview::WorkStealingPool pool;
+    pbview::ExternalSortOptions options;
+    options.pool = &pool;
+    if (state.range(0))
+        options.memoryLimit = 4 << 20;
+
+    for (auto _ : state) {
+       std::ostringstream os;
+       auto stats = pbview::sortRecords(file, keys, os, options);
+       benchmark::DoNotOptimize(stats);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+    state.SetBytesProcessed(state.iterations() * file.bytes().size());
+}
+BENCHMARK(benchSortRecords_External)->Arg(0)->Arg(1)->ArgName("spill")->UseRealTime();
+
+// the records of recordFilePath() in 16 shards (by int32_field % 16), each sorted by int32_field
+const std::vector<std::string>& recordShards()
+{
+    static const auto shards = [] {
+        std::vector<std::string> res(16);
+        pbview::MappedRecordFile<> file{recordFilePath()};
+        std::size_t i = 0;
+        for (auto record : file.records())
+        {
+            std::array<std::byte, 10> len;
+            res[i % res.size()].append(reinterpret_cast<const char*>(len.data()), pbview::block_format::encodeVarint(len.data(), record.bytes.size()));
+            res[i++ % res.size()].append(reinterpret_cast<const char*>(record.bytes.data()), record.bytes.size());
+        }
+        return res;
+    }();
+    return shards;
+}
+
+std::vector<pbview::DataSpan> recordShardSpans()
+{
+    std::vector<pbview::DataSpan> res;
+    for (const auto& shard : recordShards())
+        res.emplace_back(reinterpret_cast<const std::byte*>(shard.data()), shard.size());
+    return res;
+}
+
+void benchMergeRecords_Deserialize(benchmark::State& state)
+{
+    const auto shards = recordShardSpans();
+
+    for (auto _ : state) {
+       std::vector<pbview::samples::AllTypes> msgs;
+       for (auto shard : shards)
+          for (auto record : pbview::DelimitedRecords<pbview::BinMessageView<>>{shard})
+             msgs.emplace_back().ParseFromArray(record.bytes.data(), static_cast<int>(record.bytes.size()));
+       std::stable_sort(msgs.begin(), msgs.end(), [](const auto& a, const auto& b) { return a.int32_field() < b.int32_field(); });
+       benchmark::DoNotOptimize(msgs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchMergeRecords_Deserialize);
+
+void benchMergeRecords_Merger(benchmark::State& state)
+{
+    const auto shards = recordShardSpans();
+    pbview::SortKeyBuilder keys;
+    keys.add<pbview::type::Int32>(3);
+
+    for (auto _ : state) {
+       pbview::RecordMerger<> merger{shards, keys};
+       std::int64_t sum = 0;
+       while (auto view = merger.next<pbview::samples::AllTypes>())
+          sum += view->mysubmsg_field().id();
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchMergeRecords_Merger);
+
+void benchMergeRecords_Writev(benchmark::State& state)
+{
+    const auto shards = recordShardSpans();
+    pbview::SortKeyBuilder keys;
+    keys.add<pbview::type::Int32>(3);
+    const int fd = ::open("/dev/null", O_WRONLY);
+
+    std::uint64_t bytes = 0;
+    for (auto _ : state) {
+       auto stats = pbview::mergeRecords(shards, keys, fd);
+       bytes += stats.bytes;
+    }
+    ::close(fd);
+    state.SetItemsProcessed(state.iterations() * 100000);
+    state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+}
+BENCHMARK(benchMergeRecords_Writev);
+
+// joins the records of one shard (by int32_field) with all records
+void benchHashJoin_Deserialize(benchmark::State& state)
+{
+    const auto shards = recordShardSpans();
+    pbview::MappedRecordFile<> file{recordFilePath()};
+
+    for (auto _ : state) {
+       std::unordered_multimap<std::int32_t, pbview::samples::AllTypes> table;
+       for (auto record : pbview::DelimitedRecords<pbview::BinMessageView<>>{shards[0]})
+       {
+          pbview::samples::AllTypes msg;
+          msg.ParseFromArray(record.bytes.data(), static_cast<int>(record.bytes.size()));
+          table.emplace(msg.int32_field(), std::move(msg));
+       }
+       std::int64_t sum = 0;
+       for (auto record : file.records())
+       {
+          pbview::samples::AllTypes msg;
+          msg.ParseFromArray(record.bytes.data(), static_cast<int>(record.bytes.size()));
+          auto [begin, end] = table.equal_range(msg.int32_field());
+          for (auto it = begin; it != end; ++it)
+             sum += it->second.mysubmsg_field().id() + msg.mysubmsg_field().id();
+       }
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchHashJoin_Deserialize);
+
+void benchHashJoin_Views(benchmark::State& state)
+{
+    const auto shards = recordShardSpans();
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    const auto key = pbview::IndexField::of<pbview::type::Int32>(3);
+    pbview::HashJoinOptions options;
+    if (state.range(0))
+        options.partitionCount = 16;
+
+    for (auto _ : state) {
+       std::int64_t sum = 0;
+       pbview::hashJoin(shards[0], key, file.bytes(), key, [&sum](pbview::BinMessageView<> build, pbview::BinMessageView<> probe) {
+          sum += pbview::View<pbview::samples::AllTypes>{build}.mysubmsg_field().id() + pbview::View<pbview::samples::AllTypes>{probe}.mysubmsg_field().id();
+       }, options);
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchHashJoin_Views)->Arg(0)->Arg(1)->ArgName("grace");
+
+// splits the records into 16 partitions by string_field, written to /dev/null
+void benchHashPartition_Deserialize(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    std::vector<std::ofstream> outputs(16);
+    for (auto& os : outputs)
+        os.open("/dev/null", std::ios::binary);
+
+    for (auto _ : state) {
+       for (auto record : file.records())
+       {
+          pbview::samples::AllTypes msg;
+          msg.ParseFromArray(record.bytes.data(), static_cast<int>(record.bytes.size()));
+          auto& os = outputs[std::hash<std::string>{}(msg.string_field()) % outputs.size()];
+          google::protobuf::util::SerializeDelimitedToOstream(msg, &os);
+       }
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+    state.SetBytesProcessed(state.iterations() * file.bytes().size());
+}
+BENCHMARK(benchHashPartition_Deserialize);
+
+void benchHashPartition_Views(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    std::vector<std::ofstream> files(16);
+    std::vector<std::ostream*> outputs;
+    for (auto& os : files)
+    {
+        os.open("/dev/null", std::ios::binary);
+        outputs.push_back(&os);
+    }
+    pbview::WorkStealingPool pool{static_cast<std::size_t>(state.range(0))};
+    pbview::HashPartitionOptions options;
+    options.scan.pool = &pool;
+
+    for (auto _ : state) {
+       auto stats = pbview::hashPartition(file, 14, outputs, options);
+       benchmark::DoNotOptimize(stats);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+    state.SetBytesProcessed(state.iterations() * file.bytes().size());
+}
+BENCHMARK(benchHashPartition_Views)->Arg(1)->Arg(4)->ArgName("threads")->UseRealTime();
+
+// file of 1000000 records with string_field: one of 32 regions, double_field: price, removed at exit
+const std::string& salesFilePath()
+{
+    struct SalesFile
+    {
+        std::string path;
+
+        SalesFile()
+        {
+            char name[] = "/tmp/pbview_bench_XXXXXX";
+            google::protobuf::io::FileOutputStream os{mkstemp(name)};
+            os.SetCloseOnDelete(true);
+            for (int i = 0; i < 1000000; i++)
+            {
+                pbview::samples::AllTypes allTypes;
+                init(allTypes);
+                allTypes.set_string_field("region" + std::to_string(i * 7919 % 32));
+                allTypes.set_double_field(i % 1000 * 0.25);
+                google::protobuf::util::SerializeDelimitedToZeroCopyStream(allTypes, &os);
+            }
+            path = name;
+        }
+
+        ~SalesFile()
+        {
+            ::unlink(path.c_str());
+        }
+    };
+    static const SalesFile file;
+    return file.path;
+}
+
+// sum of price grouped by region
+void benchAggregate_Deserialize(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{salesFilePath()};
+
+    for (auto _ : state) {
+       std::unordered_map<std::string, double> sums;
+       pbview::samples::AllTypes msg;
+       for (auto record : file.records())
+       {
+          msg.ParseFromArray(record.bytes.data(), static_cast<int>(record.bytes.size()));
+          sums[msg.string_field()] += msg.double_field();
+       }
+       benchmark::DoNotOptimize(sums);
+    }
+    state.SetItemsProcessed(state.iterations() * 1000000);
+}
+BENCHMARK(benchAggregate_Deserialize);
+
+void benchAggregate_GroupBy(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{salesFilePath()};
+    pbview::WorkStealingPool pool{static_cast<std::size_t>(state.range(0))};
+    pbview::ParallelScanOptions options;
+    options.pool = &pool;
+    const std::vector<pbview::IndexField> groupBy{pbview::IndexField::of<pbview::type::String>(14)};
+    const std::vector<pbview::AggregateField> aggregates{pbview::AggregateField::sum<pbview::type::Double>(1)};
+
+    for (auto _ : state) {
+       auto res = pbview::aggregate(file, groupBy, aggregates, options);
+       benchmark::DoNotOptimize(res);
+    }
+    state.SetItemsProcessed(state.iterations() * 1000000);
+}
+BENCHMARK(benchAggregate_GroupBy)->Arg(1)->Arg(4)->ArgName("threads")->UseRealTime();
+
+// the records of recordFilePath() as spans
+std::vector<pbview::DataSpan> recordSpans(const pbview::MappedRecordFile<>& file)
+{
+    std::vector<pbview::DataSpan> res;
+    for (auto record : file.records())
+        res.push_back(record.bytes);
+    return res;
+}
+
+// three fields of each record into columns
+void benchExtractColumns_Get(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    const auto records = recordSpans(file);
+
+    for (auto _ : state) {
+       std::vector<std::int32_t> ints(records.size());
+       std::vector<std::string_view> strings(records.size());
+       std::vector<double> doubles(records.size());
+       for (std::size_t i = 0; i < records.size(); i++)
+       {
+          const pbview::BinMessageView<> view{records[i]};
+          ints[i] = view.get<pbview::type::Int32>(3).value_or(0);
+          strings[i] = view.get<pbview::type::String>(14).value_or(std::string_view{});
+          doubles[i] = view.get<pbview::type::Double>(1).value_or(0);
+       }
+       benchmark::DoNotOptimize(ints.data());
+       benchmark::DoNotOptimize(strings.data());
+       benchmark::DoNotOptimize(doubles.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchExtractColumns_Get);
+
+void benchExtractColumns_Batch(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    const auto records = recordSpans(file);
+    pbview::WorkStealingPool pool{static_cast<std::size_t>(state.range(0))};
+    pbview::ColumnOptions options;
+    options.pool = &pool;
+
+    for (auto _ : state) {
+       auto columns = pbview::extractColumns<pbview::Field<pbview::type::Int32, 3>, pbview::Field<pbview::type::String, 14>,
+                                             pbview::Field<pbview::type::Double, 1>>(records, options);
+       benchmark::DoNotOptimize(columns);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchExtractColumns_Batch)->Arg(1)->Arg(4)->ArgName("threads")->UseRealTime();
+
+// AllTypesRepeated with 1000 sub-messages
+const std::string& manySubMessages()
+{
+    static const std::string bin = [] {
+       Msg msg;
+       for (int i = 0; i < 1000; i++)
+       {
+          auto* sub = msg.add_mysubmsg_field();
+          sub->set_id(i);
+          sub->set_value("value" + std::to_string(i));
+       }
+       return msg.SerializeAsString();
+    }();
+    return bin;
+}
+
+void benchGatherSubMessages_Accumulate(benchmark::State& state)
+{
+    const auto view = pbview::View<Msg>::fromBytesString(manySubMessages());
+
+    for (auto _ : state) {
+       auto sum = ranges::accumulate(view.mysubmsg_field(), std::int64_t{0}, ranges::plus{}, &pbview::View<pbview::samples::MySubMsg>::id);
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(benchGatherSubMessages_Accumulate);
+
+void benchGatherSubMessages_Gather(benchmark::State& state)
+{
+    const auto view = pbview::View<Msg>::fromBytesString(manySubMessages());
+
+    for (auto _ : state) {
+       auto ids = view.mysubmsg_field_id_column();
+       auto sum = std::accumulate(ids.values.begin(), ids.values.end(), std::int64_t{0});
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(benchGatherSubMessages_Gather);
+
+void benchGatherSubMessages_TwoFieldsGet(benchmark::State& state)
+{
+    const auto view = pbview::View<Msg>::fromBytesString(manySubMessages());
+
+    for (auto _ : state) {
+       std::vector<std::int32_t> ids;
+       std::vector<std::string_view> values;
+       for (auto sub : view.mysubmsg_field())
+       {
+          ids.push_back(sub.id());
+          values.push_back(sub.value());
+       }
+       benchmark::DoNotOptimize(ids.data());
+       benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(benchGatherSubMessages_TwoFieldsGet);
+
+void benchGatherSubMessages_TwoFieldsGather(benchmark::State& state)
+{
+    using SubView = pbview::View<pbview::samples::MySubMsg>;
+    const auto view = pbview::View<Msg>::fromBytesString(manySubMessages());
+
+    for (auto _ : state) {
+       auto columns = view.mysubmsg_field_gather<SubView::fields::id, SubView::fields::value>();
+       benchmark::DoNotOptimize(columns);
+    }
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(benchGatherSubMessages_TwoFieldsGather);
+
+// records with int32_field >= 90000, string_field starting with "Lorem" and mysubmsg_field.id == 314
+void benchFilterRecords_Deserialize(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    const auto records = recordSpans(file);
+
+    for (auto _ : state) {
+       std::size_t matches = 0;
+       pbview::samples::AllTypes msg;
+       for (auto record : records)
+       {
+          msg.ParseFromArray(record.data(), static_cast<int>(record.size()));
+          matches += msg.int32_field() >= 90000 && msg.string_field().rfind("Lorem", 0) == 0 && msg.mysubmsg_field().id() == 314;
+       }
+       if (matches != 10000)
+          throw std::runtime_error("Unexpected result!");
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchFilterRecords_Deserialize);
+
+void benchFilterRecords_Get(benchmark::State& state)
+{
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    const auto records = recordSpans(file);
+
+    for (auto _ : state) {
+       std::size_t matches = 0;
+       for (auto record : records)
+       {
+          const pbview::BinMessageView<> view{record};
+          matches += view.get<pbview::type::Int32>(3).value_or(0) >= 90000 &&
+                     view.get<pbview::type::String>(14).value_or(std::string_view{}).substr(0, 5) == "Lorem" &&
+                     view.get<pbview::type::Message>(17)->get<pbview::type::Int32>(1) == 314;
+       }
+       if (matches != 10000)
+          throw std::runtime_error("Unexpected result!");
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchFilterRecords_Get);
+
+void benchFilterRecords_Predicate(benchmark::State& state)
+{
+    using pbview::Predicate;
+    pbview::MappedRecordFile<> file{recordFilePath()};
+    const auto records = recordSpans(file);
+    auto plan = (Predicate::greaterEqual<pbview::type::Int32>(3, 90000) && Predicate::startsWith<pbview::type::String>(14, "Lorem") &&
+                 Predicate::equal<pbview::type::Int32>({17, 1}, 314)).compile();
+
+    for (auto _ : state) {
+       std::size_t matches = 0;
+       for (auto record : records)
+          matches += plan(pbview::BinMessageView<>{record});
+       if (matches != 10000)
+          throw std::runtime_error("Unexpected result!");
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchFilterRecords_Predicate);
+
+// the records of recordFilePath() in the block based format, removed at exit
+struct BlockFile
+{
+    std::string path;
+
+    explicit BlockFile(pbview::BlockWriterOptions options = {})
+    {
+        char name[] = "/tmp/pbview_bench_XXXXXX";
+        ::close(mkstemp(name));
+        path = name;
+        std::ofstream os{path, std::ios::binary};
+        pbview::BlockRecordWriter writer{os, std::move(options)};
+        pbview::MappedRecordFile<> records{recordFilePath()};
+        for (auto record : records.records())
+            writer.add(record);
+    }
+
+    ~BlockFile()
+    {
+        ::unlink(path.c_str());
+    }
+};
+
+const std::string& blockFilePath()
+{
+    static const BlockFile file;
+    return file.path;
+}
+
+template <pbview::ParserMode mode>
+void benchBlockFile_Parallel(benchmark::State& state)
+{
+    pbview::BlockRecordReader<mode> file{blockFilePath()};
+    pbview::WorkStealingPool pool{static_cast<std::size_t>(state.range(0))};
+    pbview::ParallelScanOptions options;
+    options.pool = &pool;
+    options.chunkSize = 256 << 10;
+
+    for (auto _ : state) {
+       auto sums = pbview::parallelForEachRecord(file, std::int64_t{0}, [](std::int64_t& sum, pbview::BinMessageView<mode> record) {
+          auto view = pbview::View<pbview::samples::AllTypes, pbview::BinMessageView<mode>>{record};
+          sum += view.int32_field() + view.mysubmsg_field().id();
+       }, options);
+       benchmark::DoNotOptimize(sums);
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+    state.SetBytesProcessed(state.iterations() * file.bytes().size());
+}
+
+void benchBlockFile_Parallel_Fast(benchmark::State& state)
+{
+    benchBlockFile_Parallel<pbview::ParserMode::Fast>(state);
+}
+BENCHMARK(benchBlockFile_Parallel_Fast)->Arg(1)->Arg(std::max(2u, std::thread::hardware_concurrency()))->ArgNames({"threads"})->UseRealTime();
+
+void benchBlockFile_Parallel_WithoutBoundsChecking(benchmark::State& state)
+{
+    benchBlockFile_Parallel<pbview::ParserMode::Fast_WithoutBoundsChecking>(state);
+}
+BENCHMARK(benchBlockFile_Parallel_WithoutBoundsChecking)->Arg(1)->Arg(std::max(2u, std::thread::hardware_concurrency()))->ArgNames({"threads"})->UseRealTime();
+
+// selects 1% of the records by a range of int32_field (ascending in the file), with and without min/max statistics of the blocks
+void benchBlockFile_Scan(benchmark::State& state)
+{
+    static const BlockFile withStatistics{[] {
+        pbview::BlockWriterOptions options;
+        options.statistics = {pbview::StatisticsField::of<pbview::type::Int32>(3)};
+        return options;
+    }()};
+    pbview::BlockRecordReader<> file{state.range(0) ? withStatistics.path : blockFilePath()};
+    const std::vector<pbview::FieldPredicate> predicates{pbview::FieldPredicate::between<pbview::type::Int32>(3, 50000, 50999)};
+
+    for (auto _ : state) {
+       std::int64_t sum = 0;
+       auto res = file.scan(predicates, [&](pbview::BinMessageView<> record) {
+          sum += pbview::View<pbview::samples::AllTypes>{record}.mysubmsg_field().id();
+       });
+       benchmark::DoNotOptimize(sum);
+       state.counters["pruned"] = res.prunedBlocks;
+    }
+    state.SetItemsProcessed(state.iterations() * 100000);
+}
+BENCHMARK(benchBlockFile_Scan)->Arg(0)->Arg(1)->ArgNames({"statistics"});
+
+template <typename BinReader>
+void benchRepeatedAccessOfSameView(benchmark::State& state)
+{
+    using Msg = pbview::samples::AllTypes;
+    Msg allTypes;
+    init(allTypes);
+
+    using View = pbview::View<Msg, BinReader>;
+
+    auto binStr = allTypes.SerializeAsString();
+    auto view = View::fromBytesString(binStr);
+
+    for (auto _ : state) {
+       auto val = view.fixed64_field() + view.sfixed64_field() + view.myenum_field();
+       benchmark::DoNotOptimize(val);
+       if (val != 84+104+1)
+          throw std::runtime_error("Unexpected result!");
+    }
+}
+
+void benchRepeatedAccessOfSameView_Fast(benchmark::State& state)
+{
+    benchRepeatedAccessOfSameView<pbview::BinMessageView<pbview::ParserMode::Fast>>(state);
+}
+BENCHMARK(benchRepeatedAccessOfSameView_Fast);
+
+void benchRepeatedAccessOfSameView_Caching(benchmark::State& state)
+{
+    benchRepeatedAccessOfSameView<pbview::CachingBinMessageView<pbview::ParserMode::Fast>>(state);
+}
+BENCHMARK(benchRepeatedAccessOfSameView_Caching);
+
+// a view per sub-message, that is read once
+template <typename BinReader>
+void benchSubMessagesOfRepeatedField(benchmark::State& state)
+{
+    const auto view = pbview::View<Msg, BinReader>::fromBytesString(manySubMessages());
+
+    for (auto _ : state) {
+       std::int64_t sum = 0;
+       for (auto sub : view.mysubmsg_field())
+          sum += sub.id();
+       benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+
+void benchSubMessagesOfRepeatedField_Fast(benchmark::State& state)
+{
+    benchSubMessagesOfRepeatedField<pbview::BinMessageView<pbview::ParserMode::Fast>>(state);
+}
+BENCHMARK(benchSubMessagesOfRepeatedField_Fast);
+
+void benchSubMessagesOfRepeatedField_Caching(benchmark::State& state)
+{
+    benchSubMessagesOfRepeatedField<pbview::CachingBinMessageView<pbview::ParserMode::Fast>>(state);
+}
+BENCHMARK(benchSubMessagesOfRepeatedField_Caching);
+
+void initWide(Msg& allTypes)
+{
+    for (int i = 0; i < 100; i++)
+    {
+        allTypes.add_double_field(i);
+        allTypes.add_int32_field(i);
+        allTypes.add_sint64_field(-i);
+        allTypes.add_string_field(std::string(i % 16, 'X'));
+    }
+    allTypes.add_bool_field(true);
+}
+
+void benchHighFieldOfWideMessage_Fast(benchmark::State& state)
+{
+    Msg allTypes;
+    initWide(allTypes);
+
+    auto binStr = allTypes.SerializeAsString();
+    auto view = pbview::View<Msg>::fromBytesString(binStr);
+
+    for (auto _ : state) {
+       auto val = view.bool_field(0);
+       benchmark::DoNotOptimize(val);
+       if (!val)
+          throw std::runtime_error("Unexpected result!");
+    }
+}
+BENCHMARK(benchHighFieldOfWideMessage_Fast);
+
+void benchHighFieldOfWideMessage_CacheLineIndex(benchmark::State& state)
+{
+    Msg allTypes;
+    initWide(allTypes);
+
+    using BinView = pbview::CacheLineIndexedBinMessageView<pbview::ParserMode::Fast>;
+
+    auto binStr = allTypes.SerializeAsString();
+    pbview::CacheLineIndex index{pbview::BinMessageView<>::fromBytesString(binStr).bytes};
+    auto view = pbview::View<Msg, BinView>{BinView::fromIndex(index)};
+
+    for (auto _ : state) {
+       auto val = view.bool_field(0);
+       benchmark::DoNotOptimize(val);
+       if (!val)
+          throw std::runtime_error("Unexpected result!");
+    }
+}
+BENCHMARK(benchHighFieldOfWideMessage_CacheLineIndex);
+
+void benchHighFieldAfterSmallFields_Fast(benchmark::State& state)
+{
+    Msg allTypes;
+    for (int i = 0; i < 200; i++)
+    {
+        allTypes.add_int32_field(i);
+        allTypes.add_sint64_field(-i * 1000);
+        allTypes.add_fixed32_field(i);
+    }
+    allTypes.add_bool_field(true);
+
+    auto binStr = allTypes.SerializeAsString();
+    auto view = pbview::View<Msg>::fromBytesString(binStr);
+
+    for (auto _ : state) {
+       auto val = view.bool_field(0);
+       benchmark::DoNotOptimize(val);
+       if (!val)
+          throw std::runtime_error("Unexpected result!");
+    }
+}
+BENCHMARK(benchHighFieldAfterSmallFields_Fast);
+
+template <typename T>
+void benchPackedRepeated(benchmark::State& state, bool bulk)
+{
+    pbview::samples::AllTypesRepeatedPacked allTypes;
+    for (int i = 0; i < 100000; i++)
+    {
+        allTypes.add_int64_field(i % 100);
+        allTypes.add_sint32_field(i % 128 - 64);
+        allTypes.add_myenum_field(static_cast<pbview::samples::MyEnum>(i % 3));
+    }
+
+    using Msg = pbview::samples::AllTypesRepeatedPacked;
+    int fieldNo = std::is_same_v<T, pbview::type::Int64> ? Msg::kInt64FieldFieldNumber
+                : std::is_same_v<T, pbview::type::Sint32> ? Msg::kSint32FieldFieldNumber
+                : Msg::kMyenumFieldFieldNumber;
+
+    auto binStr = allTypes.SerializeAsString();
+    auto msg = pbview::BinMessageView<>::fromBytesString(binStr);
+
+    std::vector<typename T::CppType> values(100000);
+    for (auto _ : state) {
+       auto rng = msg.getPackedRepeated<T>(fieldNo);
+       if (bulk)
+       {
+          if (rng.decodeInto(values.data(), values.size()) != values.size())
+             throw std::runtime_error("Unexpected result!");
+       }
+       else
+       {
+          auto out = values.begin();
+          for (auto val : rng)
+             *out++ = val;
+       }
+       benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+void benchPackedInt64_Cursor(benchmark::State& state)
+{
+    benchPackedRepeated<pbview::type::Int64>(state, false);
+}
+BENCHMARK(benchPackedInt64_Cursor);
+
+void benchPackedInt64_Bulk(benchmark::State& state)
+{
+    benchPackedRepeated<pbview::type::Int64>(state, true);
+}
+BENCHMARK(benchPackedInt64_Bulk);
+
+void benchPackedSint32_Cursor(benchmark::State& state)
+{
+    benchPackedRepeated<pbview::type::Sint32>(state, false);
+}
+BENCHMARK(benchPackedSint32_Cursor);
+
+void benchPackedSint32_Bulk(benchmark::State& state)
+{
+    benchPackedRepeated<pbview::type::Sint32>(state, true);
+}
+BENCHMARK(benchPackedSint32_Bulk);
+
+void benchPackedEnum_Cursor(benchmark::State& state)
+{
+    benchPackedRepeated<pbview::type::Enum<pbview::samples::MyEnum>>(state, false);
+}
+BENCHMARK(benchPackedEnum_Cursor);
+
+void benchPackedEnum_Bulk(benchmark::State& state)
+{
+    benchPackedRepeated<pbview::type::Enum<pbview::samples::MyEnum>>(state, true);
+}
+BENCHMARK(benchPackedEnum_Bulk);
 
 BENCHMARK_MAIN();